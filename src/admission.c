@@ -0,0 +1,283 @@
+//
+// Admission control for backend processes: a cap on how many run at once,
+// optionally shared between processes through lock files, with one FIFO
+// queue per priority class and queue-time statistics.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ADMISSION_PATH_SIZE 4096
+#define ADMISSION_WAIT_BUCKETS 40       // Powers of two of microseconds
+#define ADMISSION_POLL_NS 5000000       // Retry interval for slots held by other processes
+
+// A request waiting for a slot; lives on the waiting thread's stack
+typedef struct AdmissionWaiter {
+    struct AdmissionWaiter *next;
+} AdmissionWaiter;
+
+typedef struct {
+    AdmissionWaiter *head;
+    AdmissionWaiter *tail;
+    int waiting;
+    int running;
+    unsigned long long admitted;
+    double total_wait;
+    double max_wait;
+    unsigned long long wait_histogram[ADMISSION_WAIT_BUCKETS];
+} AdmissionQueue;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;     // A slot was released or the queues moved
+    int max_processes;          // 0 for no limit
+    int running;
+    int *lock_fds;              // One slot lock file per process slot, or NULL
+    int *lock_held;             // Slots held by this process
+    AdmissionQueue queues[DE430_PRIORITY_COUNT];
+} admission = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .changed = PTHREAD_COND_INITIALIZER,
+};
+
+static double admission_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void admission_close_locks(void) {
+    if (admission.lock_fds) {
+        for (int i = 0; i < admission.max_processes; i++) {
+            if (admission.lock_fds[i] >= 0) close(admission.lock_fds[i]);
+        }
+    }
+    de430_free(admission.lock_fds);
+    de430_free(admission.lock_held);
+    admission.lock_fds = NULL;
+    admission.lock_held = NULL;
+}
+
+int de430_set_backend_limit(int max_processes, const char *lock_path) {
+    if (max_processes < 0) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    pthread_mutex_lock(&admission.lock);
+
+    int busy = admission.running > 0;
+    for (int p = 0; p < DE430_PRIORITY_COUNT; p++) {
+        if (admission.queues[p].waiting > 0) busy = 1;
+    }
+    if (busy) {
+        pthread_mutex_unlock(&admission.lock);
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    admission_close_locks();
+    admission.max_processes = max_processes;
+
+    int status = DE430_ERROR_NONE;
+    if (lock_path && max_processes > 0) {
+        admission.lock_fds = de430_malloc((size_t)max_processes * sizeof(int));
+        admission.lock_held = de430_calloc((size_t)max_processes, sizeof(int));
+        if (!admission.lock_fds || !admission.lock_held) {
+            status = DE430_ERROR_MEMORY_ALLOCATION;
+        } else {
+            for (int i = 0; i < max_processes; i++) {
+                admission.lock_fds[i] = -1;
+            }
+            for (int i = 0; status == DE430_ERROR_NONE && i < max_processes; i++) {
+                char path[ADMISSION_PATH_SIZE];
+                if (snprintf(path, sizeof(path), "%s.%d", lock_path, i) < (int)sizeof(path)) {
+                    admission.lock_fds[i] = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+                }
+                if (admission.lock_fds[i] < 0) {
+                    status = DE430_ERROR_FILE_IO;
+                }
+            }
+        }
+
+        // On failure no limit is left in place
+        if (status != DE430_ERROR_NONE) {
+            admission_close_locks();
+            admission.max_processes = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&admission.lock);
+    return status;
+}
+
+// The waiter allowed to start next: the oldest one of the most urgent class
+static AdmissionWaiter* admission_head(void) {
+    for (int p = 0; p < DE430_PRIORITY_COUNT; p++) {
+        if (admission.queues[p].head) return admission.queues[p].head;
+    }
+    return NULL;
+}
+
+// Take a process slot if one is free. Returns the slot lock index, -1 when
+// there are no lock files, or -2 when every slot is taken.
+static int admission_take_slot(void) {
+    if (admission.max_processes == 0) return -1;
+    if (admission.running >= admission.max_processes) return -2;
+    if (!admission.lock_fds) return -1;
+
+    for (int i = 0; i < admission.max_processes; i++) {
+        if (admission.lock_held[i]) continue;
+        if (flock(admission.lock_fds[i], LOCK_EX | LOCK_NB) == 0) {
+            admission.lock_held[i] = 1;
+            return i;
+        }
+    }
+    return -2;
+}
+
+static void admission_record_wait(AdmissionQueue *queue, double wait) {
+    queue->admitted++;
+    queue->total_wait += wait;
+    if (wait > queue->max_wait) queue->max_wait = wait;
+
+    int bucket = 0;
+    for (double limit = 1e-6; wait >= limit && bucket < ADMISSION_WAIT_BUCKETS - 1; limit *= 2.0) {
+        bucket++;
+    }
+    queue->wait_histogram[bucket]++;
+}
+
+int de430_backend_acquire(DE430Priority priority, DE430BackendSlot *slot) {
+    if ((int)priority < 0 || priority >= DE430_PRIORITY_COUNT || !slot) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    AdmissionQueue *queue = &admission.queues[priority];
+    AdmissionWaiter waiter = {NULL};
+    double start = admission_now();
+
+    pthread_mutex_lock(&admission.lock);
+
+    if (queue->tail) {
+        queue->tail->next = &waiter;
+    } else {
+        queue->head = &waiter;
+    }
+    queue->tail = &waiter;
+    queue->waiting++;
+
+    int lock_slot;
+    for (;;) {
+        if (admission_head() == &waiter && (lock_slot = admission_take_slot()) != -2) {
+            break;
+        }
+
+        if (admission_head() == &waiter && admission.lock_fds && admission.running < admission.max_processes) {
+            // The free slots are held by other processes, which cannot
+            // signal us; look again shortly
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += ADMISSION_POLL_NS;
+            if (until.tv_nsec >= 1000000000L) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&admission.changed, &admission.lock, &until);
+        } else {
+            pthread_cond_wait(&admission.changed, &admission.lock);
+        }
+    }
+
+    queue->head = waiter.next;
+    if (!queue->head) queue->tail = NULL;
+    queue->waiting--;
+    queue->running++;
+    admission.running++;
+    admission_record_wait(queue, admission_now() - start);
+
+    // The next waiter may be able to start as well
+    pthread_cond_broadcast(&admission.changed);
+    pthread_mutex_unlock(&admission.lock);
+
+    slot->priority = priority;
+    slot->lock_slot = lock_slot;
+    return DE430_ERROR_NONE;
+}
+
+void de430_backend_release(DE430BackendSlot *slot) {
+    if (!slot) return;
+
+    pthread_mutex_lock(&admission.lock);
+
+    if (slot->lock_slot >= 0 && admission.lock_fds) {
+        flock(admission.lock_fds[slot->lock_slot], LOCK_UN);
+        admission.lock_held[slot->lock_slot] = 0;
+    }
+    admission.queues[slot->priority].running--;
+    admission.running--;
+
+    pthread_cond_broadcast(&admission.changed);
+    pthread_mutex_unlock(&admission.lock);
+
+    slot->lock_slot = -1;
+}
+
+// Upper bound of the histogram bucket holding the given fraction of waits
+static double admission_percentile(const AdmissionQueue *queue, double fraction) {
+    if (queue->admitted == 0) return 0.0;
+
+    unsigned long long rank = (unsigned long long)(fraction * (double)queue->admitted);
+    if (rank >= queue->admitted) rank = queue->admitted - 1;
+
+    unsigned long long seen = 0;
+    double limit = 1e-6;
+    for (int bucket = 0; bucket < ADMISSION_WAIT_BUCKETS; bucket++, limit *= 2.0) {
+        seen += queue->wait_histogram[bucket];
+        if (seen > rank) {
+            return limit < queue->max_wait ? limit : queue->max_wait;
+        }
+    }
+    return queue->max_wait;
+}
+
+int de430_get_queue_stats(DE430Priority priority, DE430QueueStats *stats) {
+    if ((int)priority < 0 || priority >= DE430_PRIORITY_COUNT || !stats) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    pthread_mutex_lock(&admission.lock);
+
+    const AdmissionQueue *queue = &admission.queues[priority];
+    stats->admitted = queue->admitted;
+    stats->waiting = queue->waiting;
+    stats->running = queue->running;
+    stats->total_wait = queue->total_wait;
+    stats->max_wait = queue->max_wait;
+    stats->p50_wait = admission_percentile(queue, 0.50);
+    stats->p99_wait = admission_percentile(queue, 0.99);
+
+    pthread_mutex_unlock(&admission.lock);
+    return DE430_ERROR_NONE;
+}
+
+void de430_reset_queue_stats(void) {
+    pthread_mutex_lock(&admission.lock);
+
+    for (int p = 0; p < DE430_PRIORITY_COUNT; p++) {
+        AdmissionQueue *queue = &admission.queues[p];
+        queue->admitted = 0;
+        queue->total_wait = 0.0;
+        queue->max_wait = 0.0;
+        memset(queue->wait_histogram, 0, sizeof(queue->wait_histogram));
+    }
+
+    pthread_mutex_unlock(&admission.lock);
+}
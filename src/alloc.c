@@ -0,0 +1,135 @@
+//
+// Replaceable allocator used by the whole library, with per-thread counters.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+#include "cJSON.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void* alloc_default_malloc(size_t size, void *context) {
+    (void)context;
+    return malloc(size);
+}
+
+static void* alloc_default_realloc(void *ptr, size_t size, void *context) {
+    (void)context;
+    return realloc(ptr, size);
+}
+
+static void alloc_default_free(void *ptr, void *context) {
+    (void)context;
+    free(ptr);
+}
+
+static struct {
+    DE430MallocFn malloc_fn;
+    DE430ReallocFn realloc_fn;
+    DE430FreeFn free_fn;
+    void *context;
+} alloc_current = {alloc_default_malloc, alloc_default_realloc, alloc_default_free, NULL};
+
+// Allocations made by the calling thread since its last reset
+static _Thread_local DE430AllocStats alloc_stats;
+
+static void* CJSON_CDECL alloc_cjson_malloc(size_t size) {
+    return de430_malloc(size);
+}
+
+static void CJSON_CDECL alloc_cjson_free(void *ptr) {
+    de430_free(ptr);
+}
+
+static void alloc_install_cjson_hooks(void) {
+    cJSON_Hooks hooks = {alloc_cjson_malloc, alloc_cjson_free};
+    cJSON_InitHooks(&hooks);
+}
+
+static pthread_once_t alloc_cjson_once = PTHREAD_ONCE_INIT;
+
+void de430_alloc_use_for_cjson(void) {
+    pthread_once(&alloc_cjson_once, alloc_install_cjson_hooks);
+}
+
+int de430_set_allocator(DE430MallocFn malloc_fn, DE430ReallocFn realloc_fn, DE430FreeFn free_fn, void *context) {
+    if (!malloc_fn && !realloc_fn && !free_fn) {
+        malloc_fn = alloc_default_malloc;
+        realloc_fn = alloc_default_realloc;
+        free_fn = alloc_default_free;
+        context = NULL;
+    } else if (!malloc_fn || !realloc_fn || !free_fn) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    alloc_current.malloc_fn = malloc_fn;
+    alloc_current.realloc_fn = realloc_fn;
+    alloc_current.free_fn = free_fn;
+    alloc_current.context = context;
+
+    de430_alloc_use_for_cjson();
+    return DE430_ERROR_NONE;
+}
+
+void de430_get_alloc_stats(DE430AllocStats *stats) {
+    if (stats) *stats = alloc_stats;
+}
+
+void de430_reset_alloc_stats(void) {
+    memset(&alloc_stats, 0, sizeof(alloc_stats));
+}
+
+void de430_alloc_stats_add(const DE430AllocStats *stats) {
+    alloc_stats.allocations += stats->allocations;
+    alloc_stats.frees += stats->frees;
+    alloc_stats.bytes += stats->bytes;
+}
+
+void* de430_malloc(size_t size) {
+    void *ptr = alloc_current.malloc_fn(size, alloc_current.context);
+    if (ptr) {
+        alloc_stats.allocations++;
+        alloc_stats.bytes += size;
+    }
+    return ptr;
+}
+
+void* de430_calloc(size_t count, size_t size) {
+    if (size > 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    void *ptr = de430_malloc(count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void* de430_realloc(void *ptr, size_t size) {
+    void *grown = alloc_current.realloc_fn(ptr, size, alloc_current.context);
+    if (grown) {
+        alloc_stats.allocations++;
+        alloc_stats.bytes += size;
+    }
+    return grown;
+}
+
+void de430_free(void *ptr) {
+    if (!ptr) return;
+
+    alloc_current.free_fn(ptr, alloc_current.context);
+    alloc_stats.frees++;
+}
+
+char* de430_strdup(const char *s) {
+    size_t size = strlen(s) + 1;
+    char *copy = de430_malloc(size);
+    if (copy) {
+        memcpy(copy, s, size);
+    }
+    return copy;
+}
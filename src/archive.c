@@ -0,0 +1,356 @@
+//
+// Lazy, per-object access to binary archives.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct DE430Archive {
+    DE430BinaryReader reader;
+    DE430BinaryHeader header;
+    DE430BinaryDirectoryEntry *entries;
+    DE430EphemerisData **loaded;        // Per object, NULL until loaded
+    DE430ZoneDictionary dictionary;
+    DE430BinaryZoneMap **zones;         // Per object, NULL until first used
+};
+
+// Read the points of one object, touching only that object's bytes
+static int archive_read_object(DE430Archive *archive, int index, DE430EphemerisData *object) {
+    const DE430BinaryDirectoryEntry *entry = &archive->entries[index];
+
+    if (entry->record_size == 0) {
+        // Variable-length records have to go through the decoder
+        return de430_binary_load_entry(&archive->reader, entry, object);
+    }
+
+    memset(object, 0, sizeof(DE430EphemerisData));
+    strncpy(object->object_name, entry->name, sizeof(object->object_name) - 1);
+
+    object->points = de430_malloc(entry->point_count > 0 ? entry->point_count * sizeof(DE430EphemerisPoint) : 1);
+    if (!object->points) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    // Fixed-size records are read in place with a single positioned read
+    int status = de430_pread_all(archive->reader.fd, object->points,
+                                 (size_t)entry->point_count * sizeof(DE430EphemerisPoint), entry->offset);
+    if (status != DE430_ERROR_NONE) {
+        de430_free(object->points);
+        object->points = NULL;
+        return status;
+    }
+    de430_binary_terminate_points(object->points, entry->point_count);
+
+    object->count = entry->point_count;
+    return DE430_ERROR_NONE;
+}
+
+int de430_archive_open(const char *filename, DE430Archive **archive) {
+    if (!filename || !archive) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430Archive *a = de430_calloc(1, sizeof(DE430Archive));
+    if (!a) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = de430_binary_reader_open(&a->reader, filename);
+    if (status != DE430_ERROR_NONE) {
+        de430_free(a);
+        return status;
+    }
+
+    // Read file header
+    status = de430_pread_all(a->reader.fd, &a->header, sizeof(a->header), 0);
+    if (status == DE430_ERROR_NONE) {
+        status = de430_binary_check_header(&a->header);
+    }
+
+    if (status == DE430_ERROR_NONE && a->header.version == DE430_BINARY_VERSION_2) {
+        // The directory sits right after the header; nothing else is read
+        size_t size = (size_t)a->header.object_count * sizeof(DE430BinaryDirectoryEntry);
+        uint64_t file_size = 0;
+        status = de430_file_size(a->reader.fd, &file_size);
+        if (status == DE430_ERROR_NONE && size > file_size) {
+            status = DE430_ERROR_PARSE_FAILED;
+        }
+        if (status == DE430_ERROR_NONE) {
+            a->entries = de430_malloc(size > 0 ? size : 1);
+            if (!a->entries) {
+                status = DE430_ERROR_MEMORY_ALLOCATION;
+            } else {
+                status = de430_pread_all(a->reader.fd, a->entries, size, sizeof(a->header));
+            }
+        }
+
+        for (uint32_t i = 0; i < a->header.object_count && status == DE430_ERROR_NONE; i++) {
+            status = de430_binary_check_entry(&a->entries[i], file_size);
+        }
+    } else if (status == DE430_ERROR_NONE) {
+        // Version 1 has no directory, so one scan is needed to build it
+        status = de430_binary_reader_seek(&a->reader, sizeof(a->header));
+        if (status == DE430_ERROR_NONE) {
+            status = de430_binary_read_directory(&a->reader, &a->header, &a->entries);
+        }
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = de430_zone_dictionary_read(a->reader.fd, &a->header, &a->dictionary);
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        a->loaded = de430_calloc(a->header.object_count > 0 ? a->header.object_count : 1,
+                           sizeof(DE430EphemerisData*));
+        a->zones = de430_calloc(a->header.object_count > 0 ? a->header.object_count : 1,
+                          sizeof(DE430BinaryZoneMap*));
+        if (!a->loaded || !a->zones) {
+            status = DE430_ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        de430_binary_reader_close(&a->reader);
+        de430_free(a->loaded);
+        de430_free(a->zones);
+        de430_free(a->entries);
+        de430_free(a);
+        return status;
+    }
+
+    *archive = a;
+    return DE430_ERROR_NONE;
+}
+
+int de430_archive_object_count(const DE430Archive *archive) {
+    if (!archive) return 0;
+    return (int)archive->header.object_count;
+}
+
+const char* de430_archive_object_name(const DE430Archive *archive, int index) {
+    if (!archive || index < 0 || index >= (int)archive->header.object_count) {
+        return NULL;
+    }
+    return archive->entries[index].name;
+}
+
+int de430_archive_point_count(const DE430Archive *archive, int index) {
+    if (!archive || index < 0 || index >= (int)archive->header.object_count) {
+        return -1;
+    }
+    return (int)archive->entries[index].point_count;
+}
+
+int de430_archive_find_object(const DE430Archive *archive, const char *name) {
+    if (!archive || !name) return -1;
+
+    for (uint32_t i = 0; i < archive->header.object_count; i++) {
+        if (strcmp(archive->entries[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+int de430_archive_load_object(DE430Archive *archive, const char *name, const DE430EphemerisData **object) {
+    if (!archive || !name || !object) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    int index = de430_archive_find_object(archive, name);
+    if (index < 0) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    // Already resident
+    if (archive->loaded[index]) {
+        *object = archive->loaded[index];
+        return DE430_ERROR_NONE;
+    }
+
+    DE430EphemerisData *data = de430_malloc(sizeof(DE430EphemerisData));
+    if (!data) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = archive_read_object(archive, index, data);
+    if (status != DE430_ERROR_NONE) {
+        de430_free(data);
+        return status;
+    }
+
+    archive->loaded[index] = data;
+    *object = data;
+    return DE430_ERROR_NONE;
+}
+
+int de430_archive_load_objects(DE430Archive *archive, const char *const *names, int name_count,
+                               DE430EphemerisData **result, int *count) {
+    if (!archive || !names || name_count <= 0 || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    *result = de430_calloc(name_count, sizeof(DE430EphemerisData));
+    if (!*result) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = DE430_ERROR_NONE;
+    for (int i = 0; i < name_count && status == DE430_ERROR_NONE; i++) {
+        int index = de430_archive_find_object(archive, names[i]);
+        if (index < 0) {
+            status = DE430_ERROR_INVALID_CONFIG;
+        } else {
+            status = archive_read_object(archive, index, &(*result)[i]);
+        }
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free_data(*result, name_count);
+        *result = NULL;
+        return status;
+    }
+
+    *count = name_count;
+    return DE430_ERROR_NONE;
+}
+
+int de430_archive_release_object(DE430Archive *archive, const char *name) {
+    if (!archive || !name) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    int index = de430_archive_find_object(archive, name);
+    if (index < 0) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    de430_free_data(archive->loaded[index], 1);
+    archive->loaded[index] = NULL;
+    return DE430_ERROR_NONE;
+}
+
+// Zone maps of an object, read on first use
+static const DE430BinaryZoneMap* archive_zones(DE430Archive *archive, int index, int *status) {
+    const DE430BinaryDirectoryEntry *entry = &archive->entries[index];
+    *status = DE430_ERROR_NONE;
+
+    if (!archive->zones[index] && entry->zone_count > 0) {
+        DE430BinaryZoneMap *zones = de430_malloc(entry->zone_count * sizeof(DE430BinaryZoneMap));
+        if (!zones) {
+            *status = DE430_ERROR_MEMORY_ALLOCATION;
+            return NULL;
+        }
+
+        *status = de430_pread_all(archive->reader.fd, zones, entry->zone_count * sizeof(DE430BinaryZoneMap),
+                                  entry->zone_offset);
+        if (*status != DE430_ERROR_NONE) {
+            de430_free(zones);
+            return NULL;
+        }
+
+        archive->zones[index] = zones;
+    }
+
+    return archive->zones[index];
+}
+
+int de430_archive_zone_count(const DE430Archive *archive, int index) {
+    if (!archive || index < 0 || index >= (int)archive->header.object_count) {
+        return -1;
+    }
+    return (int)archive->entries[index].zone_count;
+}
+
+// Look up one block, validating the indices
+static const DE430BinaryZoneMap* archive_zone(DE430Archive *archive, int index, int block, int *status) {
+    if (!archive || index < 0 || index >= (int)archive->header.object_count ||
+        block < 0 || block >= (int)archive->entries[index].zone_count) {
+        *status = DE430_ERROR_INVALID_CONFIG;
+        return NULL;
+    }
+
+    const DE430BinaryZoneMap *zones = archive_zones(archive, index, status);
+    return zones ? &zones[block] : NULL;
+}
+
+int de430_archive_zone_map(DE430Archive *archive, int index, int block, DE430ZoneMap *zone) {
+    int status;
+    const DE430BinaryZoneMap *stored = archive_zone(archive, index, block, &status);
+    if (!stored || !zone) {
+        return stored ? DE430_ERROR_INVALID_CONFIG : status;
+    }
+
+    const DE430BinaryDirectoryEntry *entry = &archive->entries[index];
+    zone->first_point = block * (int)entry->zone_block_size;
+    zone->point_count = (int)entry->point_count - zone->first_point < (int)entry->zone_block_size
+                        ? (int)entry->point_count - zone->first_point : (int)entry->zone_block_size;
+    memcpy(zone->min, stored->min, sizeof(zone->min));
+    memcpy(zone->max, stored->max, sizeof(zone->max));
+    return DE430_ERROR_NONE;
+}
+
+int de430_archive_zone_may_match(DE430Archive *archive, int index, int block, const DE430Filter *filter) {
+    int status;
+    const DE430BinaryZoneMap *zone = archive_zone(archive, index, block, &status);
+    if (!zone) {
+        return status;
+    }
+
+    uint64_t mask[2];
+    int use_mask = de430_zone_filter_mask(&archive->dictionary, filter, mask);
+    return de430_zone_map_may_match(zone, filter, use_mask ? mask : NULL);
+}
+
+int de430_archive_load_filtered(DE430Archive *archive, const DE430Filter *filter,
+                                DE430EphemerisData **result, int *count) {
+    if (!archive || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    uint32_t object_count = archive->header.object_count;
+    *result = de430_calloc(object_count > 0 ? object_count : 1, sizeof(DE430EphemerisData));
+    if (!*result) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    uint64_t mask[2];
+    int use_mask = de430_zone_filter_mask(&archive->dictionary, filter, mask);
+
+    int selected = 0;
+    int status = DE430_ERROR_NONE;
+    for (uint32_t i = 0; i < object_count && status == DE430_ERROR_NONE; i++) {
+        if (!de430_filter_match_object(filter, archive->entries[i].name)) continue;
+
+        status = de430_binary_load_entry_filtered(&archive->reader, &archive->entries[i], filter,
+                                                  use_mask ? mask : NULL, &(*result)[selected++]);
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free_data(*result, selected);
+        *result = NULL;
+        return status;
+    }
+
+    *count = selected;
+    return DE430_ERROR_NONE;
+}
+
+void de430_archive_close(DE430Archive *archive) {
+    if (!archive) return;
+
+    for (uint32_t i = 0; i < archive->header.object_count; i++) {
+        de430_free_data(archive->loaded[i], 1);
+        de430_free(archive->zones[i]);
+    }
+
+    de430_free(archive->zones);
+    de430_free(archive->loaded);
+    de430_free(archive->entries);
+    de430_binary_reader_close(&archive->reader);
+    de430_free(archive);
+}
@@ -0,0 +1,1671 @@
+//
+// Apache Arrow IPC file (Feather v2) writer and reader.
+//
+// The flatbuffer metadata is built and parsed by hand, so no Arrow or
+// flatbuffers library is needed. Like the binary format, buffers are
+// written in host byte order, which must be little-endian.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ARROW_MAGIC "ARROW1"
+#define ARROW_MAGIC_SIZE 6
+#define ARROW_CONTINUATION 0xFFFFFFFFu
+#define ARROW_METADATA_V5 4
+
+// Message bodies and every buffer inside them start on this boundary, so a
+// memory-mapped file can be used in place
+#define ARROW_ALIGNMENT 64
+
+// Rows gathered into a column at a time while writing
+#define ARROW_GATHER_ROWS 8192
+
+// Message header union
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_DICTIONARY_BATCH 2
+#define ARROW_HEADER_RECORD_BATCH 3
+
+// Type union
+#define ARROW_TYPE_NULL 1
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_FLOATING_POINT 3
+#define ARROW_TYPE_BINARY 4
+#define ARROW_TYPE_UTF8 5
+#define ARROW_TYPE_BOOL 6
+#define ARROW_TYPE_DECIMAL 7
+#define ARROW_TYPE_DATE 8
+#define ARROW_TYPE_TIME 9
+#define ARROW_TYPE_TIMESTAMP 10
+#define ARROW_TYPE_INTERVAL 11
+#define ARROW_TYPE_FIXED_SIZE_BINARY 15
+#define ARROW_TYPE_DURATION 18
+#define ARROW_TYPE_LARGE_BINARY 19
+#define ARROW_TYPE_LARGE_UTF8 20
+
+#define ARROW_PRECISION_SINGLE 1
+#define ARROW_PRECISION_DOUBLE 2
+
+// Dictionary ids of the two string columns
+#define ARROW_OBJECT_DICTIONARY 0
+#define ARROW_CONSTELLATION_DICTIONARY 1
+
+// object_name, one column per DE430Field, constellation
+#define ARROW_COLUMN_COUNT (DE430_FIELD_COUNT + 2)
+
+// Column names, the same as the CSV header
+static const char *const arrow_value_columns[DE430_FIELD_COUNT] = {
+    "jd", "pos_x", "pos_y", "pos_z", "ra", "dec", "magnitude", "phase", "angular_size",
+    "physical_size", "albedo", "sun_dist", "earth_dist", "sun_ang_dist", "theta_edo",
+    "ecliptic_lng", "ecliptic_dist", "ecliptic_lat"
+};
+
+// Flatbuffer structs, laid out as in the Arrow schema
+typedef struct {
+    int64_t length;
+    int64_t null_count;
+} ArrowFieldNode;
+
+typedef struct {
+    int64_t offset;
+    int64_t length;
+} ArrowBuffer;
+
+typedef struct {
+    int64_t offset;
+    int32_t metadata_length;
+    int32_t padding;
+    int64_t body_length;
+} ArrowBlock;
+
+static size_t arrow_align(size_t size) {
+    return (size + ARROW_ALIGNMENT - 1) & ~(size_t)(ARROW_ALIGNMENT - 1);
+}
+
+// ---------------------------------------------------------------------------
+// Flatbuffer builder
+//
+// Like the reference implementation, the buffer is built back to front:
+// children are written before the tables that point at them, and a
+// reference is the number of bytes written up to and including the object.
+// ---------------------------------------------------------------------------
+
+#define FLAT_MAX_FIELDS 8
+
+typedef struct {
+    unsigned char *data;    // Contents occupy the last `size` bytes
+    size_t size;
+    size_t capacity;
+    int status;
+} FlatBuilder;
+
+typedef struct {
+    uint32_t fields[FLAT_MAX_FIELDS];   // Reference of each field, 0 if absent
+    int field_count;
+    uint32_t start;                     // Builder size when the table was begun
+} FlatTable;
+
+static const unsigned char arrow_zeros[ARROW_ALIGNMENT];
+
+static void flat_reset(FlatBuilder *b) {
+    b->size = 0;
+    b->status = DE430_ERROR_NONE;
+}
+
+static const unsigned char* flat_bytes(const FlatBuilder *b) {
+    return b->data + b->capacity - b->size;
+}
+
+static void flat_push(FlatBuilder *b, const void *src, size_t size) {
+    if (b->status != DE430_ERROR_NONE || size == 0) return;
+
+    if (b->size + size > b->capacity) {
+        size_t capacity = b->capacity > 0 ? b->capacity * 2 : 1024;
+        while (capacity < b->size + size) capacity *= 2;
+
+        unsigned char *data = de430_malloc(capacity);
+        if (!data) {
+            b->status = DE430_ERROR_MEMORY_ALLOCATION;
+            return;
+        }
+        if (b->size > 0) {
+            memcpy(data + capacity - b->size, flat_bytes(b), b->size);
+        }
+        de430_free(b->data);
+        b->data = data;
+        b->capacity = capacity;
+    }
+
+    b->size += size;
+    memcpy(b->data + b->capacity - b->size, src, size);
+}
+
+// Pad so that after `additional` more bytes the size is a multiple of `alignment`
+static void flat_prep(FlatBuilder *b, size_t alignment, size_t additional) {
+    size_t pad = (alignment - (b->size + additional) % alignment) % alignment;
+    flat_push(b, arrow_zeros, pad);
+}
+
+// Write an offset to `target` at the current position
+static void flat_push_offset(FlatBuilder *b, uint32_t target) {
+    flat_prep(b, 4, 0);
+    uint32_t relative = (uint32_t)(b->size + 4 - target);
+    flat_push(b, &relative, 4);
+}
+
+static uint32_t flat_string(FlatBuilder *b, const char *value, size_t length) {
+    uint32_t length32 = (uint32_t)length;
+    flat_prep(b, 4, length + 1);
+    flat_push(b, arrow_zeros, 1);
+    flat_push(b, value, length);
+    flat_push(b, &length32, 4);
+    return (uint32_t)b->size;
+}
+
+// Vector of scalars or structs, copied as they are laid out in memory
+static uint32_t flat_vector(FlatBuilder *b, const void *elements, uint32_t count, size_t element_size,
+                            size_t alignment) {
+    flat_prep(b, 4, count * element_size);
+    flat_prep(b, alignment, count * element_size);
+    flat_push(b, elements, count * element_size);
+    flat_push(b, &count, 4);
+    return (uint32_t)b->size;
+}
+
+static uint32_t flat_offset_vector(FlatBuilder *b, const uint32_t *targets, uint32_t count) {
+    flat_prep(b, 4, count * 4);
+    for (uint32_t i = count; i-- > 0;) {
+        flat_push_offset(b, targets[i]);
+    }
+    flat_push(b, &count, 4);
+    return (uint32_t)b->size;
+}
+
+static void flat_table_begin(FlatBuilder *b, FlatTable *table) {
+    memset(table, 0, sizeof(FlatTable));
+    table->start = (uint32_t)b->size;
+}
+
+static void flat_table_mark(FlatBuilder *b, FlatTable *table, int slot) {
+    table->fields[slot] = (uint32_t)b->size;
+    if (slot >= table->field_count) {
+        table->field_count = slot + 1;
+    }
+}
+
+static void flat_table_scalar(FlatBuilder *b, FlatTable *table, int slot, const void *value, size_t size) {
+    flat_prep(b, size, 0);
+    flat_push(b, value, size);
+    flat_table_mark(b, table, slot);
+}
+
+static void flat_table_offset(FlatBuilder *b, FlatTable *table, int slot, uint32_t target) {
+    flat_push_offset(b, target);
+    flat_table_mark(b, table, slot);
+}
+
+// Finish a table and write its vtable in front of it
+static uint32_t flat_table_end(FlatBuilder *b, FlatTable *table) {
+    int32_t vtable_offset = 0;
+    flat_prep(b, 4, 0);
+    flat_push(b, &vtable_offset, 4);
+    uint32_t object = (uint32_t)b->size;
+
+    for (int i = table->field_count - 1; i >= 0; i--) {
+        uint16_t field_offset = table->fields[i] ? (uint16_t)(object - table->fields[i]) : 0;
+        flat_push(b, &field_offset, 2);
+    }
+    uint16_t object_size = (uint16_t)(object - table->start);
+    uint16_t vtable_size = (uint16_t)(4 + 2 * table->field_count);
+    flat_push(b, &object_size, 2);
+    flat_push(b, &vtable_size, 2);
+
+    if (b->status != DE430_ERROR_NONE) return 0;
+
+    // The vtable sits before the table, at table position minus this offset
+    vtable_offset = (int32_t)(b->size - object);
+    memcpy(b->data + b->capacity - object, &vtable_offset, 4);
+    return object;
+}
+
+static void flat_finish(FlatBuilder *b, uint32_t root) {
+    flat_prep(b, 8, 4);
+    flat_push_offset(b, root);
+}
+
+// ---------------------------------------------------------------------------
+// Flatbuffer reader, bounds-checked against the buffer it was given
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    int bad;                    // Set when anything pointed outside the buffer
+} FlatReader;
+
+static uint64_t flat_read(FlatReader *r, size_t position, size_t size) {
+    if (position > r->size || size > r->size - position) {
+        r->bad = 1;
+        return 0;
+    }
+
+    uint64_t value = 0;
+    memcpy(&value, r->data + position, size);
+    return value;
+}
+
+// Follow the offset stored at `position`
+static size_t flat_deref(FlatReader *r, size_t position) {
+    if (!position) return 0;
+    uint64_t target = position + flat_read(r, position, 4);
+    if (target >= r->size) {
+        r->bad = 1;
+        return 0;
+    }
+    return (size_t)target;
+}
+
+static size_t flat_root(FlatReader *r) {
+    uint64_t root = flat_read(r, 0, 4);
+    if (root < 4 || root >= r->size) {
+        r->bad = 1;
+        return 0;
+    }
+    return (size_t)root;
+}
+
+// Position of a table field, or 0 if it is absent
+static size_t flat_field(FlatReader *r, size_t table, int slot) {
+    if (!table) return 0;
+
+    int64_t vtable = (int64_t)table - (int32_t)flat_read(r, table, 4);
+    if (vtable < 0 || (uint64_t)vtable >= r->size) {
+        r->bad = 1;
+        return 0;
+    }
+
+    uint16_t vtable_size = (uint16_t)flat_read(r, (size_t)vtable, 2);
+    if ((size_t)(4 + 2 * slot) + 2 > vtable_size) return 0;
+
+    uint16_t offset = (uint16_t)flat_read(r, (size_t)vtable + 4 + 2 * slot, 2);
+    return offset ? table + offset : 0;
+}
+
+static int64_t flat_int(FlatReader *r, size_t table, int slot, size_t size, int64_t default_value) {
+    size_t position = flat_field(r, table, slot);
+    if (!position) return default_value;
+
+    uint64_t value = flat_read(r, position, size);
+    if (size == 1 || size == 8) return (int64_t)value;
+
+    // Sign-extend shorts and ints
+    int shift = 64 - 8 * (int)size;
+    return (int64_t)(value << shift) >> shift;
+}
+
+static size_t flat_table(FlatReader *r, size_t table, int slot) {
+    return flat_deref(r, flat_field(r, table, slot));
+}
+
+// Start of a vector's elements, with the element count in *length
+static size_t flat_vector_at(FlatReader *r, size_t table, int slot, size_t element_size, uint32_t *length) {
+    size_t vector = flat_table(r, table, slot);
+    *length = 0;
+    if (!vector) return 0;
+
+    uint32_t count = (uint32_t)flat_read(r, vector, 4);
+    if (r->bad || count > (r->size - vector - 4) / element_size) {
+        r->bad = 1;
+        return 0;
+    }
+
+    *length = count;
+    return vector + 4;
+}
+
+// ---------------------------------------------------------------------------
+// Metadata
+// ---------------------------------------------------------------------------
+
+static uint32_t arrow_build_int_type(FlatBuilder *b, int32_t bit_width, uint8_t is_signed) {
+    FlatTable table;
+    flat_table_begin(b, &table);
+    flat_table_scalar(b, &table, 0, &bit_width, 4);
+    flat_table_scalar(b, &table, 1, &is_signed, 1);
+    return flat_table_end(b, &table);
+}
+
+// A float64 column, or a dictionary-encoded string column when dictionary_id >= 0
+static uint32_t arrow_build_field(FlatBuilder *b, const char *name, int64_t dictionary_id) {
+    uint32_t name_ref = flat_string(b, name, strlen(name));
+    uint32_t children = flat_offset_vector(b, NULL, 0);
+    uint32_t dictionary = 0;
+    uint32_t type;
+    uint8_t type_type;
+    FlatTable table;
+
+    if (dictionary_id < 0) {
+        int16_t precision = ARROW_PRECISION_DOUBLE;
+        flat_table_begin(b, &table);
+        flat_table_scalar(b, &table, 0, &precision, 2);
+        type = flat_table_end(b, &table);
+        type_type = ARROW_TYPE_FLOATING_POINT;
+    } else {
+        flat_table_begin(b, &table);
+        type = flat_table_end(b, &table);
+        type_type = ARROW_TYPE_UTF8;
+
+        uint32_t index_type = arrow_build_int_type(b, 32, 1);
+        flat_table_begin(b, &table);
+        flat_table_scalar(b, &table, 0, &dictionary_id, 8);
+        flat_table_offset(b, &table, 1, index_type);
+        dictionary = flat_table_end(b, &table);
+    }
+
+    uint8_t nullable = 1;
+    flat_table_begin(b, &table);
+    flat_table_offset(b, &table, 0, name_ref);
+    flat_table_scalar(b, &table, 1, &nullable, 1);
+    flat_table_scalar(b, &table, 2, &type_type, 1);
+    flat_table_offset(b, &table, 3, type);
+    if (dictionary) {
+        flat_table_offset(b, &table, 4, dictionary);
+    }
+    flat_table_offset(b, &table, 5, children);
+    return flat_table_end(b, &table);
+}
+
+static uint32_t arrow_build_schema(FlatBuilder *b) {
+    uint32_t fields[ARROW_COLUMN_COUNT];
+
+    fields[0] = arrow_build_field(b, "object_name", ARROW_OBJECT_DICTIONARY);
+    for (int i = 0; i < DE430_FIELD_COUNT; i++) {
+        fields[1 + i] = arrow_build_field(b, arrow_value_columns[i], -1);
+    }
+    fields[ARROW_COLUMN_COUNT - 1] = arrow_build_field(b, "constellation", ARROW_CONSTELLATION_DICTIONARY);
+
+    uint32_t field_vector = flat_offset_vector(b, fields, ARROW_COLUMN_COUNT);
+
+    FlatTable table;
+    flat_table_begin(b, &table);
+    flat_table_offset(b, &table, 1, field_vector);
+    return flat_table_end(b, &table);
+}
+
+static uint32_t arrow_build_record_batch(FlatBuilder *b, int64_t length, const ArrowFieldNode *nodes, int node_count,
+                                         const ArrowBuffer *buffers, int buffer_count) {
+    uint32_t node_vector = flat_vector(b, nodes, (uint32_t)node_count, sizeof(ArrowFieldNode), 8);
+    uint32_t buffer_vector = flat_vector(b, buffers, (uint32_t)buffer_count, sizeof(ArrowBuffer), 8);
+
+    FlatTable table;
+    flat_table_begin(b, &table);
+    flat_table_scalar(b, &table, 0, &length, 8);
+    flat_table_offset(b, &table, 1, node_vector);
+    flat_table_offset(b, &table, 2, buffer_vector);
+    return flat_table_end(b, &table);
+}
+
+// Wrap a header in a Message and finish the buffer
+static void arrow_finish_message(FlatBuilder *b, uint8_t header_type, uint32_t header, int64_t body_length) {
+    int16_t version = ARROW_METADATA_V5;
+
+    FlatTable table;
+    flat_table_begin(b, &table);
+    flat_table_scalar(b, &table, 0, &version, 2);
+    flat_table_scalar(b, &table, 1, &header_type, 1);
+    flat_table_offset(b, &table, 2, header);
+    flat_table_scalar(b, &table, 3, &body_length, 8);
+    flat_finish(b, flat_table_end(b, &table));
+}
+
+// ---------------------------------------------------------------------------
+// Writer
+// ---------------------------------------------------------------------------
+
+// Distinct constellation names, hashed for lookup while planning
+typedef struct {
+    const char **names;         // Values in first-seen order, pointing into the data
+    int count;
+    int capacity;
+    int *slots;                 // Open-addressed table of indices into names, -1 if empty
+    int slot_count;
+} ArrowDictionary;
+
+typedef struct {
+    FILE *fp;
+    uint64_t offset;                // Bytes written so far
+    FlatBuilder builder;
+    unsigned char *gather;          // One column's worth of ARROW_GATHER_ROWS values
+    int32_t **constellations;       // Per object, dictionary index of every point (-1 for none)
+    ArrowDictionary dictionary;
+    ArrowBlock dictionary_blocks[2];
+    ArrowBlock *batch_blocks;
+    int batch_count;
+} ArrowWriter;
+
+static uint32_t arrow_hash(const char *name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int arrow_dictionary_grow(ArrowDictionary *dictionary) {
+    int slot_count = dictionary->slot_count > 0 ? dictionary->slot_count * 2 : 256;
+    int *slots = de430_malloc(slot_count * sizeof(int));
+    const char **names = de430_realloc(dictionary->names, (slot_count / 2) * sizeof(const char*));
+    if (!slots || !names) {
+        de430_free(slots);
+        if (names) dictionary->names = names;
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    memset(slots, 0xff, slot_count * sizeof(int));
+    for (int i = 0; i < dictionary->count; i++) {
+        const char *name = names[i];
+        size_t length = strnlen(name, sizeof(((DE430EphemerisPoint*)0)->constellation) - 1);
+        uint32_t slot = arrow_hash(name, length) & (slot_count - 1);
+        while (slots[slot] >= 0) slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = i;
+    }
+
+    de430_free(dictionary->slots);
+    dictionary->slots = slots;
+    dictionary->slot_count = slot_count;
+    dictionary->names = names;
+    dictionary->capacity = slot_count / 2;
+    return DE430_ERROR_NONE;
+}
+
+// Index of a constellation in the dictionary, adding it if new
+static int arrow_dictionary_index(ArrowDictionary *dictionary, const char *name, int32_t *index) {
+    size_t max_length = sizeof(((DE430EphemerisPoint*)0)->constellation) - 1;
+    size_t length = strnlen(name, max_length);
+
+    if (dictionary->count == dictionary->capacity) {
+        int status = arrow_dictionary_grow(dictionary);
+        if (status != DE430_ERROR_NONE) return status;
+    }
+
+    uint32_t slot = arrow_hash(name, length) & (dictionary->slot_count - 1);
+    while (dictionary->slots[slot] >= 0) {
+        const char *candidate = dictionary->names[dictionary->slots[slot]];
+        if (strncmp(candidate, name, max_length) == 0) {
+            *index = dictionary->slots[slot];
+            return DE430_ERROR_NONE;
+        }
+        slot = (slot + 1) & (dictionary->slot_count - 1);
+    }
+
+    dictionary->slots[slot] = dictionary->count;
+    dictionary->names[dictionary->count] = name;
+    *index = dictionary->count++;
+    return DE430_ERROR_NONE;
+}
+
+// Assign every point its constellation's dictionary index
+static int arrow_plan(ArrowWriter *writer, const DE430EphemerisData *data, int count) {
+    writer->constellations = de430_calloc(count, sizeof(int32_t*));
+    if (!writer->constellations) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    size_t max_length = sizeof(data->points->constellation) - 1;
+    for (int i = 0; i < count; i++) {
+        if (data[i].count <= 0) continue;
+
+        int32_t *indices = de430_malloc(data[i].count * sizeof(int32_t));
+        if (!indices) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        writer->constellations[i] = indices;
+
+        const char *previous = NULL;
+        int32_t previous_index = -1;
+        for (int j = 0; j < data[i].count; j++) {
+            const char *name = data[i].points[j].constellation;
+
+            // Consecutive points are usually in the same constellation
+            if (previous && strncmp(previous, name, max_length) == 0) {
+                indices[j] = previous_index;
+                continue;
+            }
+
+            if (name[0] == '\0') {
+                indices[j] = -1;
+            } else {
+                int status = arrow_dictionary_index(&writer->dictionary, name, &indices[j]);
+                if (status != DE430_ERROR_NONE) return status;
+            }
+            previous = name;
+            previous_index = indices[j];
+        }
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+static int arrow_put(ArrowWriter *writer, const void *data, size_t size) {
+    if (size > 0 && fwrite(data, 1, size, writer->fp) != size) {
+        return DE430_ERROR_FILE_IO;
+    }
+    writer->offset += size;
+    return DE430_ERROR_NONE;
+}
+
+static int arrow_pad(ArrowWriter *writer) {
+    return arrow_put(writer, arrow_zeros, (ARROW_ALIGNMENT - writer->offset % ARROW_ALIGNMENT) % ARROW_ALIGNMENT);
+}
+
+// Write the finished flatbuffer as an encapsulated message, padded so the
+// body that follows starts on an ARROW_ALIGNMENT boundary
+static int arrow_write_metadata(ArrowWriter *writer, ArrowBlock *block) {
+    FlatBuilder *b = &writer->builder;
+    if (b->status != DE430_ERROR_NONE) {
+        return b->status;
+    }
+
+    uint64_t end = writer->offset + 8 + b->size;
+    size_t pad = (ARROW_ALIGNMENT - end % ARROW_ALIGNMENT) % ARROW_ALIGNMENT;
+    uint32_t prefix[2] = {ARROW_CONTINUATION, (uint32_t)(b->size + pad)};
+
+    memset(block, 0, sizeof(ArrowBlock));
+    block->offset = (int64_t)writer->offset;
+
+    int status = arrow_put(writer, prefix, sizeof(prefix));
+    if (status == DE430_ERROR_NONE) status = arrow_put(writer, flat_bytes(b), b->size);
+    if (status == DE430_ERROR_NONE) status = arrow_pad(writer);
+
+    block->metadata_length = (int32_t)(writer->offset - (uint64_t)block->offset);
+    return status;
+}
+
+// Dictionary batch holding one string column
+static int arrow_write_dictionary(ArrowWriter *writer, int64_t id, const char *const *values, int count,
+                                  size_t stride, size_t max_length, ArrowBlock *block) {
+    int32_t *offsets = de430_malloc((count + 1) * sizeof(int32_t));
+    if (!offsets) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    offsets[0] = 0;
+    for (int i = 0; i < count; i++) {
+        const char *value = stride ? (const char*)values + i * stride : values[i];
+        offsets[i + 1] = offsets[i] + (int32_t)strnlen(value, max_length);
+    }
+
+    ArrowFieldNode node = {count, 0};
+    ArrowBuffer buffers[3] = {
+        {0, 0},
+        {0, (int64_t)((count + 1) * sizeof(int32_t))},
+        {(int64_t)arrow_align((count + 1) * sizeof(int32_t)), offsets[count]}
+    };
+    int64_t body_length = buffers[2].offset + (int64_t)arrow_align((size_t)offsets[count]);
+
+    FlatBuilder *b = &writer->builder;
+    flat_reset(b);
+    uint32_t batch = arrow_build_record_batch(b, count, &node, 1, buffers, 3);
+    FlatTable table;
+    flat_table_begin(b, &table);
+    flat_table_scalar(b, &table, 0, &id, 8);
+    flat_table_offset(b, &table, 1, batch);
+    arrow_finish_message(b, ARROW_HEADER_DICTIONARY_BATCH, flat_table_end(b, &table), body_length);
+
+    int status = arrow_write_metadata(writer, block);
+    if (status == DE430_ERROR_NONE) status = arrow_put(writer, offsets, (count + 1) * sizeof(int32_t));
+    if (status == DE430_ERROR_NONE) status = arrow_pad(writer);
+    for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+        const char *value = stride ? (const char*)values + i * stride : values[i];
+        status = arrow_put(writer, value, (size_t)(offsets[i + 1] - offsets[i]));
+    }
+    if (status == DE430_ERROR_NONE) status = arrow_pad(writer);
+
+    block->body_length = body_length;
+    de430_free(offsets);
+    return status;
+}
+
+// Record batch holding points [first, first + count) of one object
+static int arrow_write_batch(ArrowWriter *writer, const DE430EphemerisData *obj, int object_index,
+                             const int32_t *constellations, int first, int count, ArrowBlock *block) {
+    int64_t null_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (constellations[first + i] < 0) null_count++;
+    }
+
+    ArrowFieldNode nodes[ARROW_COLUMN_COUNT];
+    ArrowBuffer buffers[ARROW_COLUMN_COUNT * 2];
+    int64_t body_length = 0;
+    int k = 0;
+
+#define ARROW_ADD_BUFFER(size) do { \
+        buffers[k].offset = body_length; \
+        buffers[k].length = (int64_t)(size); \
+        body_length += (int64_t)arrow_align((size_t)(size)); \
+        k++; \
+    } while (0)
+
+    for (int c = 0; c < ARROW_COLUMN_COUNT; c++) {
+        nodes[c].length = count;
+        nodes[c].null_count = 0;
+    }
+    nodes[ARROW_COLUMN_COUNT - 1].null_count = null_count;
+
+    ARROW_ADD_BUFFER(0);
+    ARROW_ADD_BUFFER((size_t)count * sizeof(int32_t));
+    for (int f = 0; f < DE430_FIELD_COUNT; f++) {
+        ARROW_ADD_BUFFER(0);
+        ARROW_ADD_BUFFER((size_t)count * sizeof(double));
+    }
+    ARROW_ADD_BUFFER(null_count > 0 ? ((size_t)count + 7) / 8 : 0);
+    ARROW_ADD_BUFFER((size_t)count * sizeof(int32_t));
+
+#undef ARROW_ADD_BUFFER
+
+    FlatBuilder *b = &writer->builder;
+    flat_reset(b);
+    uint32_t batch = arrow_build_record_batch(b, count, nodes, ARROW_COLUMN_COUNT, buffers, k);
+    arrow_finish_message(b, ARROW_HEADER_RECORD_BATCH, batch, body_length);
+
+    int status = arrow_write_metadata(writer, block);
+    block->body_length = body_length;
+
+    const DE430EphemerisPoint *points = obj->points + first;
+    int32_t *indices = (int32_t*)writer->gather;
+    double *values = (double*)writer->gather;
+
+    // object_name: the same dictionary index on every row
+    for (int i = 0; i < ARROW_GATHER_ROWS; i++) {
+        indices[i] = object_index;
+    }
+    for (int done = 0; done < count && status == DE430_ERROR_NONE; done += ARROW_GATHER_ROWS) {
+        int n = count - done < ARROW_GATHER_ROWS ? count - done : ARROW_GATHER_ROWS;
+        status = arrow_put(writer, indices, n * sizeof(int32_t));
+    }
+    if (status == DE430_ERROR_NONE) status = arrow_pad(writer);
+
+    // Numeric columns, transposed from the point records
+    for (int f = 0; f < DE430_FIELD_COUNT && status == DE430_ERROR_NONE; f++) {
+        for (int done = 0; done < count && status == DE430_ERROR_NONE; done += ARROW_GATHER_ROWS) {
+            int n = count - done < ARROW_GATHER_ROWS ? count - done : ARROW_GATHER_ROWS;
+            for (int i = 0; i < n; i++) {
+                values[i] = de430_point_field(&points[done + i], (DE430Field)f);
+            }
+            status = arrow_put(writer, values, n * sizeof(double));
+        }
+        if (status == DE430_ERROR_NONE) status = arrow_pad(writer);
+    }
+
+    // constellation: validity bitmap when some points have none, then indices
+    if (null_count > 0) {
+        unsigned char *bits = writer->gather;
+        for (int done = 0; done < count && status == DE430_ERROR_NONE; done += ARROW_GATHER_ROWS) {
+            int n = count - done < ARROW_GATHER_ROWS ? count - done : ARROW_GATHER_ROWS;
+            memset(bits, 0, (n + 7) / 8);
+            for (int i = 0; i < n; i++) {
+                if (constellations[first + done + i] >= 0) {
+                    bits[i / 8] |= (unsigned char)(1u << (i % 8));
+                }
+            }
+            status = arrow_put(writer, bits, (n + 7) / 8);
+        }
+        if (status == DE430_ERROR_NONE) status = arrow_pad(writer);
+    }
+
+    for (int done = 0; done < count && status == DE430_ERROR_NONE; done += ARROW_GATHER_ROWS) {
+        int n = count - done < ARROW_GATHER_ROWS ? count - done : ARROW_GATHER_ROWS;
+        for (int i = 0; i < n; i++) {
+            int32_t index = constellations[first + done + i];
+            indices[i] = index >= 0 ? index : 0;
+        }
+        status = arrow_put(writer, indices, n * sizeof(int32_t));
+    }
+    if (status == DE430_ERROR_NONE) status = arrow_pad(writer);
+
+    return status;
+}
+
+static int arrow_write_footer(ArrowWriter *writer) {
+    FlatBuilder *b = &writer->builder;
+    flat_reset(b);
+
+    uint32_t schema = arrow_build_schema(b);
+    uint32_t dictionaries = flat_vector(b, writer->dictionary_blocks, 2, sizeof(ArrowBlock), 8);
+    uint32_t batches = flat_vector(b, writer->batch_blocks, (uint32_t)writer->batch_count, sizeof(ArrowBlock), 8);
+
+    int16_t version = ARROW_METADATA_V5;
+    FlatTable table;
+    flat_table_begin(b, &table);
+    flat_table_scalar(b, &table, 0, &version, 2);
+    flat_table_offset(b, &table, 1, schema);
+    flat_table_offset(b, &table, 2, dictionaries);
+    flat_table_offset(b, &table, 3, batches);
+    flat_finish(b, flat_table_end(b, &table));
+
+    if (b->status != DE430_ERROR_NONE) {
+        return b->status;
+    }
+
+    int32_t footer_length = (int32_t)b->size;
+    int status = arrow_put(writer, flat_bytes(b), b->size);
+    if (status == DE430_ERROR_NONE) status = arrow_put(writer, &footer_length, 4);
+    if (status == DE430_ERROR_NONE) status = arrow_put(writer, ARROW_MAGIC, ARROW_MAGIC_SIZE);
+    return status;
+}
+
+static int arrow_write_file(ArrowWriter *writer, const DE430EphemerisData *data, int count, int batch_points) {
+    // Magic, padded to 8 bytes
+    int status = arrow_put(writer, ARROW_MAGIC "\0\0", ARROW_MAGIC_SIZE + 2);
+
+    ArrowBlock schema_block;
+    if (status == DE430_ERROR_NONE) {
+        flat_reset(&writer->builder);
+        uint32_t schema = arrow_build_schema(&writer->builder);
+        arrow_finish_message(&writer->builder, ARROW_HEADER_SCHEMA, schema, 0);
+        status = arrow_write_metadata(writer, &schema_block);
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = arrow_write_dictionary(writer, ARROW_OBJECT_DICTIONARY, (const char *const*)data[0].object_name,
+                                        count, sizeof(DE430EphemerisData), sizeof(data->object_name) - 1,
+                                        &writer->dictionary_blocks[0]);
+    }
+    if (status == DE430_ERROR_NONE) {
+        status = arrow_write_dictionary(writer, ARROW_CONSTELLATION_DICTIONARY, writer->dictionary.names,
+                                        writer->dictionary.count, 0, sizeof(data->points->constellation) - 1,
+                                        &writer->dictionary_blocks[1]);
+    }
+
+    for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+        int step = batch_points > 0 ? batch_points : data[i].count;
+        for (int first = 0; first < data[i].count && status == DE430_ERROR_NONE; first += step) {
+            int n = data[i].count - first < step ? data[i].count - first : step;
+            status = arrow_write_batch(writer, &data[i], i, writer->constellations[i], first, n,
+                                       &writer->batch_blocks[writer->batch_count++]);
+        }
+    }
+
+    // End-of-stream marker, then the footer
+    if (status == DE430_ERROR_NONE) {
+        uint32_t end_of_stream[2] = {ARROW_CONTINUATION, 0};
+        status = arrow_put(writer, end_of_stream, sizeof(end_of_stream));
+    }
+    if (status == DE430_ERROR_NONE) {
+        status = arrow_write_footer(writer);
+    }
+
+    return status;
+}
+
+void de430_init_arrow_options(DE430ArrowOptions *options) {
+    if (!options) return;
+
+    memset(options, 0, sizeof(DE430ArrowOptions));
+    options->batch_points = 0;
+}
+
+int de430_save_to_arrow_ex(const DE430EphemerisData *data, int count, const char *filename,
+                           const DE430ArrowOptions *options) {
+    if (!data || count <= 0 || !filename) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430ArrowOptions defaults;
+    if (!options) {
+        de430_init_arrow_options(&defaults);
+        options = &defaults;
+    }
+    if (options->batch_points < 0) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    ArrowWriter writer;
+    memset(&writer, 0, sizeof(writer));
+
+    int batch_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (data[i].count <= 0) continue;
+        int step = options->batch_points > 0 ? options->batch_points : data[i].count;
+        batch_count += (data[i].count + step - 1) / step;
+    }
+
+    int status = DE430_ERROR_NONE;
+    writer.batch_blocks = de430_malloc((batch_count > 0 ? batch_count : 1) * sizeof(ArrowBlock));
+    writer.gather = de430_malloc(ARROW_GATHER_ROWS * sizeof(double));
+    if (!writer.batch_blocks || !writer.gather) {
+        status = DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = arrow_plan(&writer, data, count);
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        writer.fp = fopen(filename, "wb");
+        if (!writer.fp) {
+            status = DE430_ERROR_FILE_IO;
+        }
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = arrow_write_file(&writer, data, count, options->batch_points);
+    }
+
+    if (writer.fp && fclose(writer.fp) != 0 && status == DE430_ERROR_NONE) {
+        status = DE430_ERROR_FILE_IO;
+    }
+
+    if (writer.constellations) {
+        for (int i = 0; i < count; i++) {
+            de430_free(writer.constellations[i]);
+        }
+        de430_free(writer.constellations);
+    }
+    de430_free(writer.dictionary.names);
+    de430_free(writer.dictionary.slots);
+    de430_free(writer.builder.data);
+    de430_free(writer.batch_blocks);
+    de430_free(writer.gather);
+    return status;
+}
+
+int de430_save_to_arrow(const DE430EphemerisData *data, int count, const char *filename) {
+    return de430_save_to_arrow_ex(data, count, filename, NULL);
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+// ---------------------------------------------------------------------------
+
+#define ARROW_ROLE_IGNORED 0
+#define ARROW_ROLE_OBJECT 1
+#define ARROW_ROLE_CONSTELLATION 2
+#define ARROW_ROLE_VALUE 3
+
+typedef struct {
+    int role;
+    int field;                  // DE430Field of a value column
+    int type;                   // Arrow type of the values (the dictionary's values if encoded)
+    int value_bytes;            // Float width, or string offset width
+    int buffer_count;           // Buffers the column takes in a record batch
+    int64_t dictionary_id;      // -1 if not dictionary-encoded
+    int index_bytes;
+    int index_signed;
+} ArrowColumn;
+
+// One column's buffers within a record batch body
+typedef struct {
+    const unsigned char *buffers[3];
+    uint64_t lengths[3];
+    int64_t null_count;
+} ArrowArray;
+
+typedef struct {
+    int64_t id;
+    char **values;
+    int count;
+    int capacity;
+    int *objects;               // Result object of each value, for the object_name dictionary
+} ArrowReadDictionary;
+
+typedef struct {
+    int fd;
+    uint64_t file_size;
+
+    ArrowColumn *columns;
+    int column_count;
+    int object_column;
+    int constellation_column;
+
+    ArrowReadDictionary *dictionaries;
+    int dictionary_count;
+
+    unsigned char *message;     // Metadata and body of the block being decoded
+    size_t message_capacity;
+
+    ArrowArray *arrays;
+    int *row_objects;
+    DE430EphemerisPoint **rows;
+    int64_t row_capacity;
+
+    DE430EphemerisData *objects;
+    int *point_capacities;
+    int object_count;
+    int object_capacity;
+    int last_object;            // Cache for objects looked up by name
+} ArrowReader;
+
+static int arrow_buffer_count(int type) {
+    switch (type) {
+        case ARROW_TYPE_NULL:
+            return 0;
+        case ARROW_TYPE_INT:
+        case ARROW_TYPE_FLOATING_POINT:
+        case ARROW_TYPE_BOOL:
+        case ARROW_TYPE_DECIMAL:
+        case ARROW_TYPE_DATE:
+        case ARROW_TYPE_TIME:
+        case ARROW_TYPE_TIMESTAMP:
+        case ARROW_TYPE_INTERVAL:
+        case ARROW_TYPE_FIXED_SIZE_BINARY:
+        case ARROW_TYPE_DURATION:
+            return 2;
+        case ARROW_TYPE_BINARY:
+        case ARROW_TYPE_UTF8:
+        case ARROW_TYPE_LARGE_BINARY:
+        case ARROW_TYPE_LARGE_UTF8:
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+static int arrow_parse_field(FlatReader *r, size_t field, ArrowColumn *column) {
+    memset(column, 0, sizeof(ArrowColumn));
+    column->dictionary_id = -1;
+
+    uint32_t child_count = 0;
+    flat_vector_at(r, field, 5, 4, &child_count);
+    if (child_count > 0) {
+        return DE430_ERROR_PARSE_FAILED;    // Nested types are not supported
+    }
+
+    column->type = (int)flat_int(r, field, 2, 1, 0);
+    size_t type = flat_table(r, field, 3);
+    size_t dictionary = flat_table(r, field, 4);
+
+    if (dictionary) {
+        size_t index_type = flat_table(r, dictionary, 1);
+        int bit_width = index_type ? (int)flat_int(r, index_type, 0, 4, 32) : 32;
+        column->dictionary_id = flat_int(r, dictionary, 0, 8, 0);
+        column->index_bytes = bit_width / 8;
+        column->index_signed = index_type ? (int)flat_int(r, index_type, 1, 1, 0) : 1;
+        column->buffer_count = 2;
+        if (bit_width != 8 && bit_width != 16 && bit_width != 32 && bit_width != 64) {
+            return DE430_ERROR_PARSE_FAILED;
+        }
+    } else {
+        column->buffer_count = arrow_buffer_count(column->type);
+        if (column->buffer_count < 0) {
+            return DE430_ERROR_PARSE_FAILED;
+        }
+    }
+
+    if (column->type == ARROW_TYPE_FLOATING_POINT) {
+        int precision = (int)flat_int(r, type, 0, 2, 0);
+        column->value_bytes = precision == ARROW_PRECISION_DOUBLE ? 8 : precision == ARROW_PRECISION_SINGLE ? 4 : 0;
+    } else if (column->type == ARROW_TYPE_UTF8) {
+        column->value_bytes = 4;
+    } else if (column->type == ARROW_TYPE_LARGE_UTF8) {
+        column->value_bytes = 8;
+    }
+
+    uint32_t name_length = 0;
+    size_t name = flat_vector_at(r, field, 0, 1, &name_length);
+    if (!name) {
+        return DE430_ERROR_NONE;
+    }
+
+    const char *chars = (const char*)r->data + name;
+    int is_string = (column->type == ARROW_TYPE_UTF8 || column->type == ARROW_TYPE_LARGE_UTF8);
+
+    if (name_length == 11 && memcmp(chars, "object_name", 11) == 0) {
+        column->role = ARROW_ROLE_OBJECT;
+    } else if (name_length == 13 && memcmp(chars, "constellation", 13) == 0) {
+        column->role = ARROW_ROLE_CONSTELLATION;
+    } else {
+        for (int f = 0; f < DE430_FIELD_COUNT; f++) {
+            if (strlen(arrow_value_columns[f]) == name_length &&
+                memcmp(chars, arrow_value_columns[f], name_length) == 0) {
+                column->role = ARROW_ROLE_VALUE;
+                column->field = f;
+                break;
+            }
+        }
+    }
+
+    // Known columns must have the types this library writes
+    if ((column->role == ARROW_ROLE_OBJECT || column->role == ARROW_ROLE_CONSTELLATION) && !is_string) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+    if (column->role == ARROW_ROLE_VALUE &&
+        (column->type != ARROW_TYPE_FLOATING_POINT || column->value_bytes == 0 || column->dictionary_id >= 0)) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+static int arrow_parse_schema(ArrowReader *reader, FlatReader *r, size_t schema) {
+    if (!schema || flat_int(r, schema, 0, 2, 0) != 0) {
+        return DE430_ERROR_PARSE_FAILED;    // Missing, or big-endian
+    }
+
+    uint32_t field_count = 0;
+    size_t fields = flat_vector_at(r, schema, 1, 4, &field_count);
+    if (!fields || field_count == 0) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    reader->columns = de430_calloc(field_count, sizeof(ArrowColumn));
+    reader->arrays = de430_calloc(field_count, sizeof(ArrowArray));
+    if (!reader->columns || !reader->arrays) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+    reader->column_count = (int)field_count;
+    reader->object_column = -1;
+    reader->constellation_column = -1;
+
+    for (uint32_t i = 0; i < field_count; i++) {
+        int status = arrow_parse_field(r, flat_deref(r, fields + 4 * i), &reader->columns[i]);
+        if (status != DE430_ERROR_NONE || r->bad) {
+            return DE430_ERROR_PARSE_FAILED;
+        }
+
+        if (reader->columns[i].role == ARROW_ROLE_OBJECT && reader->object_column < 0) {
+            reader->object_column = (int)i;
+        } else if (reader->columns[i].role == ARROW_ROLE_CONSTELLATION && reader->constellation_column < 0) {
+            reader->constellation_column = (int)i;
+        }
+    }
+
+    return reader->object_column >= 0 ? DE430_ERROR_NONE : DE430_ERROR_PARSE_FAILED;
+}
+
+static int arrow_add_object(ArrowReader *reader, const char *name, size_t length) {
+    if (reader->object_count == reader->object_capacity) {
+        int capacity = reader->object_capacity > 0 ? reader->object_capacity * 2 : 16;
+        DE430EphemerisData *objects = de430_realloc(reader->objects, capacity * sizeof(DE430EphemerisData));
+        if (!objects) return -1;
+        reader->objects = objects;
+
+        int *point_capacities = de430_realloc(reader->point_capacities, capacity * sizeof(int));
+        if (!point_capacities) return -1;
+        reader->point_capacities = point_capacities;
+        reader->object_capacity = capacity;
+    }
+
+    DE430EphemerisData *obj = &reader->objects[reader->object_count];
+    memset(obj, 0, sizeof(DE430EphemerisData));
+    if (length > sizeof(obj->object_name) - 1) {
+        length = sizeof(obj->object_name) - 1;
+    }
+    memcpy(obj->object_name, name, length);
+    reader->point_capacities[reader->object_count] = 0;
+    return reader->object_count++;
+}
+
+// Object for a name stored as a plain string
+static int arrow_find_object(ArrowReader *reader, const char *name, size_t length) {
+    size_t max_length = sizeof(reader->objects->object_name) - 1;
+    size_t compared = length < max_length ? length : max_length;
+
+    for (int n = 0; n < reader->object_count; n++) {
+        int i = (reader->last_object + n) % reader->object_count;
+        const char *object_name = reader->objects[i].object_name;
+        if (strlen(object_name) == compared && memcmp(object_name, name, compared) == 0) {
+            reader->last_object = i;
+            return i;
+        }
+    }
+
+    int index = arrow_add_object(reader, name, length);
+    if (index >= 0) reader->last_object = index;
+    return index;
+}
+
+static ArrowReadDictionary* arrow_find_dictionary(ArrowReader *reader, int64_t id) {
+    for (int i = 0; i < reader->dictionary_count; i++) {
+        if (reader->dictionaries[i].id == id) {
+            return &reader->dictionaries[i];
+        }
+    }
+    return NULL;
+}
+
+// Read a block's message into reader->message and locate its header and body
+static int arrow_read_message(ArrowReader *reader, FlatReader *footer, size_t block, int header_type,
+                              FlatReader *meta, size_t *header, const unsigned char **body, uint64_t *body_length) {
+    int64_t offset = (int64_t)flat_read(footer, block, 8);
+    int32_t metadata_length = (int32_t)flat_read(footer, block + 8, 4);
+    int64_t length = (int64_t)flat_read(footer, block + 16, 8);
+
+    if (footer->bad || offset < 0 || metadata_length < 8 || length < 0 ||
+        (uint64_t)offset + (uint64_t)metadata_length + (uint64_t)length > reader->file_size) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    size_t total = (size_t)metadata_length + (size_t)length;
+    if (total > reader->message_capacity) {
+        unsigned char *message = de430_realloc(reader->message, total);
+        if (!message) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        reader->message = message;
+        reader->message_capacity = total;
+    }
+
+    int status = de430_pread_all(reader->fd, reader->message, total, (uint64_t)offset);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    // Files from before Arrow 0.15 have no continuation marker
+    uint32_t prefix[2];
+    memcpy(prefix, reader->message, sizeof(prefix));
+    size_t start = prefix[0] == ARROW_CONTINUATION ? 8 : 4;
+    size_t size = prefix[0] == ARROW_CONTINUATION ? prefix[1] : prefix[0];
+    if (size > (size_t)metadata_length - start) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    meta->data = reader->message + start;
+    meta->size = size;
+    meta->bad = 0;
+
+    size_t root = flat_root(meta);
+    if (meta->bad || flat_int(meta, root, 1, 1, 0) != header_type) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    *header = flat_table(meta, root, 2);
+    *body = reader->message + metadata_length;
+    *body_length = (uint64_t)length;
+    return *header && !meta->bad ? DE430_ERROR_NONE : DE430_ERROR_PARSE_FAILED;
+}
+
+// Slice the buffers of the first `column_count` columns of a record batch
+static int arrow_slice_batch(FlatReader *meta, size_t batch, const unsigned char *body, uint64_t body_length,
+                             const ArrowColumn *columns, int column_count, ArrowArray *arrays, int64_t *rows) {
+    if (flat_field(meta, batch, 3)) {
+        return DE430_ERROR_PARSE_FAILED;    // Compressed bodies are not supported
+    }
+
+    uint32_t node_count = 0;
+    uint32_t buffer_count = 0;
+    size_t nodes = flat_vector_at(meta, batch, 1, sizeof(ArrowFieldNode), &node_count);
+    size_t buffers = flat_vector_at(meta, batch, 2, sizeof(ArrowBuffer), &buffer_count);
+    *rows = flat_int(meta, batch, 0, 8, 0);
+
+    if (meta->bad || node_count < (uint32_t)column_count || *rows < 0) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    uint32_t next = 0;
+    for (int c = 0; c < column_count; c++) {
+        ArrowArray *array = &arrays[c];
+        memset(array, 0, sizeof(ArrowArray));
+
+        int64_t length = (int64_t)flat_read(meta, nodes + c * sizeof(ArrowFieldNode), 8);
+        array->null_count = (int64_t)flat_read(meta, nodes + c * sizeof(ArrowFieldNode) + 8, 8);
+        if (length != *rows || next + (uint32_t)columns[c].buffer_count > buffer_count) {
+            return DE430_ERROR_PARSE_FAILED;
+        }
+
+        for (int k = 0; k < columns[c].buffer_count; k++, next++) {
+            uint64_t offset = flat_read(meta, buffers + next * sizeof(ArrowBuffer), 8);
+            uint64_t size = flat_read(meta, buffers + next * sizeof(ArrowBuffer) + 8, 8);
+            if (offset > body_length || size > body_length - offset) {
+                return DE430_ERROR_PARSE_FAILED;
+            }
+            array->buffers[k] = body + offset;
+            array->lengths[k] = size;
+        }
+    }
+
+    return meta->bad ? DE430_ERROR_PARSE_FAILED : DE430_ERROR_NONE;
+}
+
+static int arrow_is_valid(const ArrowArray *array, int64_t row) {
+    if (array->null_count == 0 || array->lengths[0] == 0) return 1;
+    return (array->buffers[0][row / 8] >> (row % 8)) & 1;
+}
+
+static int64_t arrow_int_at(const unsigned char *data, int bytes, int is_signed, int64_t row) {
+    const unsigned char *p = data + row * bytes;
+    switch (bytes) {
+        case 1: { int8_t s; uint8_t u; memcpy(&s, p, 1); memcpy(&u, p, 1); return is_signed ? (int64_t)s : (int64_t)u; }
+        case 2: { int16_t s; uint16_t u; memcpy(&s, p, 2); memcpy(&u, p, 2); return is_signed ? (int64_t)s : (int64_t)u; }
+        case 4: { int32_t s; uint32_t u; memcpy(&s, p, 4); memcpy(&u, p, 4); return is_signed ? (int64_t)s : (int64_t)u; }
+        default: { int64_t s; memcpy(&s, p, 8); return s; }
+    }
+}
+
+// Check that a column's buffers are large enough for `rows` rows
+static int arrow_check_array(const ArrowColumn *column, const ArrowArray *array, int64_t rows) {
+    if (array->null_count > 0 && array->lengths[0] > 0 && array->lengths[0] < (uint64_t)(rows + 7) / 8) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    if (column->dictionary_id >= 0) {
+        return array->lengths[1] >= (uint64_t)rows * column->index_bytes ? DE430_ERROR_NONE : DE430_ERROR_PARSE_FAILED;
+    }
+    if (column->type == ARROW_TYPE_FLOATING_POINT) {
+        return array->lengths[1] >= (uint64_t)rows * column->value_bytes ? DE430_ERROR_NONE : DE430_ERROR_PARSE_FAILED;
+    }
+    if (column->type == ARROW_TYPE_UTF8 || column->type == ARROW_TYPE_LARGE_UTF8) {
+        return array->lengths[1] >= (uint64_t)(rows + 1) * column->value_bytes ? DE430_ERROR_NONE : DE430_ERROR_PARSE_FAILED;
+    }
+    return DE430_ERROR_NONE;
+}
+
+// String `row` of a plain string column
+static int arrow_string_at(const ArrowColumn *column, const ArrowArray *array, int64_t row,
+                           const char **value, size_t *length) {
+    int64_t start = arrow_int_at(array->buffers[1], column->value_bytes, 1, row);
+    int64_t end = arrow_int_at(array->buffers[1], column->value_bytes, 1, row + 1);
+    if (start < 0 || end < start || (uint64_t)end > array->lengths[2]) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    *value = (const char*)array->buffers[2] + start;
+    *length = (size_t)(end - start);
+    return DE430_ERROR_NONE;
+}
+
+// Dictionary entry `row` of an encoded column, or -1 for null
+static int arrow_dictionary_at(const ArrowColumn *column, const ArrowArray *array,
+                               const ArrowReadDictionary *dictionary, int64_t row, int64_t *index) {
+    if (!arrow_is_valid(array, row)) {
+        *index = -1;
+        return DE430_ERROR_NONE;
+    }
+
+    *index = arrow_int_at(array->buffers[1], column->index_bytes, column->index_signed, row);
+    return *index >= 0 && *index < dictionary->count ? DE430_ERROR_NONE : DE430_ERROR_PARSE_FAILED;
+}
+
+static int arrow_decode_dictionary(ArrowReader *reader, FlatReader *meta, size_t header,
+                                   const unsigned char *body, uint64_t body_length) {
+    int64_t id = flat_int(meta, header, 0, 8, 0);
+    size_t batch = flat_table(meta, header, 1);
+    int is_delta = (int)flat_int(meta, header, 2, 1, 0);
+
+    // Only the two string columns' dictionaries are needed
+    int column_index = -1;
+    if (reader->columns[reader->object_column].dictionary_id == id) {
+        column_index = reader->object_column;
+    } else if (reader->constellation_column >= 0 && reader->columns[reader->constellation_column].dictionary_id == id) {
+        column_index = reader->constellation_column;
+    }
+    if (column_index < 0) {
+        return DE430_ERROR_NONE;
+    }
+
+    // The dictionary's values use the field's type without the encoding
+    ArrowColumn values_column = reader->columns[column_index];
+    values_column.dictionary_id = -1;
+    values_column.buffer_count = 3;
+
+    ArrowArray array;
+    int64_t rows = 0;
+    int status = arrow_slice_batch(meta, batch, body, body_length, &values_column, 1, &array, &rows);
+    if (status == DE430_ERROR_NONE) status = arrow_check_array(&values_column, &array, rows);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    ArrowReadDictionary *dictionary = arrow_find_dictionary(reader, id);
+    if (!dictionary) {
+        ArrowReadDictionary *dictionaries = de430_realloc(reader->dictionaries,
+                                                    (reader->dictionary_count + 1) * sizeof(ArrowReadDictionary));
+        if (!dictionaries) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        reader->dictionaries = dictionaries;
+        dictionary = &reader->dictionaries[reader->dictionary_count++];
+        memset(dictionary, 0, sizeof(ArrowReadDictionary));
+        dictionary->id = id;
+    } else if (!is_delta) {
+        for (int i = 0; i < dictionary->count; i++) {
+            de430_free(dictionary->values[i]);
+        }
+        dictionary->count = 0;
+    }
+
+    if (rows > INT32_MAX - dictionary->count) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+    if (dictionary->count + rows > dictionary->capacity) {
+        int capacity = (int)(dictionary->count + rows);
+        char **values = de430_realloc(dictionary->values, capacity * sizeof(char*));
+        if (!values) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        dictionary->values = values;
+
+        int *objects = de430_realloc(dictionary->objects, capacity * sizeof(int));
+        if (!objects) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        dictionary->objects = objects;
+        dictionary->capacity = capacity;
+    }
+
+    for (int64_t i = 0; i < rows; i++) {
+        const char *value = "";
+        size_t length = 0;
+        if (arrow_is_valid(&array, i)) {
+            status = arrow_string_at(&values_column, &array, i, &value, &length);
+            if (status != DE430_ERROR_NONE) return status;
+        }
+
+        char *copy = de430_malloc(length + 1);
+        if (!copy) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        memcpy(copy, value, length);
+        copy[length] = '\0';
+        dictionary->values[dictionary->count] = copy;
+
+        // Every object_name entry becomes an object, so objects without
+        // points survive a round trip and keep their order
+        dictionary->objects[dictionary->count] = -1;
+        if (column_index == reader->object_column) {
+            dictionary->objects[dictionary->count] = arrow_add_object(reader, copy, length);
+            if (dictionary->objects[dictionary->count] < 0) {
+                de430_free(copy);
+                return DE430_ERROR_MEMORY_ALLOCATION;
+            }
+        }
+        dictionary->count++;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+static int arrow_decode_batch(ArrowReader *reader, FlatReader *meta, size_t header,
+                              const unsigned char *body, uint64_t body_length) {
+    int64_t rows = 0;
+    int status = arrow_slice_batch(meta, header, body, body_length, reader->columns, reader->column_count,
+                                   reader->arrays, &rows);
+    for (int c = 0; c < reader->column_count && status == DE430_ERROR_NONE; c++) {
+        if (reader->columns[c].role != ARROW_ROLE_IGNORED) {
+            status = arrow_check_array(&reader->columns[c], &reader->arrays[c], rows);
+        }
+    }
+    if (status != DE430_ERROR_NONE || rows == 0) {
+        return status;
+    }
+
+    if (rows > reader->row_capacity) {
+        int *row_objects = de430_realloc(reader->row_objects, rows * sizeof(int));
+        if (row_objects) reader->row_objects = row_objects;
+        DE430EphemerisPoint **row_points = de430_realloc(reader->rows, rows * sizeof(DE430EphemerisPoint*));
+        if (row_points) reader->rows = row_points;
+        if (!row_objects || !row_points) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        reader->row_capacity = rows;
+    }
+
+    // Object of every row; rows without one are dropped
+    const ArrowColumn *object_column = &reader->columns[reader->object_column];
+    const ArrowArray *object_array = &reader->arrays[reader->object_column];
+    const ArrowReadDictionary *object_dictionary = NULL;
+    if (object_column->dictionary_id >= 0) {
+        object_dictionary = arrow_find_dictionary(reader, object_column->dictionary_id);
+        if (!object_dictionary) {
+            return DE430_ERROR_PARSE_FAILED;
+        }
+    }
+
+    for (int64_t r = 0; r < rows; r++) {
+        if (object_dictionary) {
+            int64_t index;
+            status = arrow_dictionary_at(object_column, object_array, object_dictionary, r, &index);
+            if (status != DE430_ERROR_NONE) return status;
+            reader->row_objects[r] = index >= 0 ? object_dictionary->objects[index] : -1;
+        } else if (arrow_is_valid(object_array, r)) {
+            const char *name;
+            size_t length;
+            status = arrow_string_at(object_column, object_array, r, &name, &length);
+            if (status != DE430_ERROR_NONE) return status;
+            reader->row_objects[r] = arrow_find_object(reader, name, length);
+            if (reader->row_objects[r] < 0) return DE430_ERROR_MEMORY_ALLOCATION;
+        } else {
+            reader->row_objects[r] = -1;
+        }
+    }
+
+    // Grow each object once for all of its rows in the batch, then hand out
+    // row slots; points do not move after this
+    int *batch_counts = de430_calloc(reader->object_count > 0 ? reader->object_count : 1, sizeof(int));
+    if (!batch_counts) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+    for (int64_t r = 0; r < rows; r++) {
+        if (reader->row_objects[r] >= 0) batch_counts[reader->row_objects[r]]++;
+    }
+
+    for (int i = 0; i < reader->object_count && status == DE430_ERROR_NONE; i++) {
+        DE430EphemerisData *obj = &reader->objects[i];
+        int64_t needed = (int64_t)obj->count + batch_counts[i];
+        if (needed <= reader->point_capacities[i]) continue;
+        if (needed > INT32_MAX) {
+            status = DE430_ERROR_PARSE_FAILED;
+            break;
+        }
+
+        int64_t capacity = reader->point_capacities[i] > 0 ? reader->point_capacities[i] : INITIAL_RESULTS_SIZE;
+        while (capacity < needed) capacity *= 2;
+        if (capacity > INT32_MAX) capacity = needed;
+
+        DE430EphemerisPoint *points = de430_realloc(obj->points, (size_t)capacity * sizeof(DE430EphemerisPoint));
+        if (!points) {
+            status = DE430_ERROR_MEMORY_ALLOCATION;
+            break;
+        }
+        obj->points = points;
+        reader->point_capacities[i] = (int)capacity;
+    }
+    de430_free(batch_counts);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    for (int64_t r = 0; r < rows; r++) {
+        int object = reader->row_objects[r];
+        if (object < 0) {
+            reader->rows[r] = NULL;
+            continue;
+        }
+
+        DE430EphemerisData *obj = &reader->objects[object];
+        DE430EphemerisPoint *point = &obj->points[obj->count++];
+        memset(point, 0, sizeof(DE430EphemerisPoint));
+        reader->rows[r] = point;
+    }
+
+    for (int c = 0; c < reader->column_count; c++) {
+        const ArrowColumn *column = &reader->columns[c];
+        const ArrowArray *array = &reader->arrays[c];
+
+        if (column->role == ARROW_ROLE_VALUE) {
+            for (int64_t r = 0; r < rows; r++) {
+                DE430EphemerisPoint *point = reader->rows[r];
+                if (!point) continue;
+
+                double value = NAN;
+                if (arrow_is_valid(array, r)) {
+                    if (column->value_bytes == 8) {
+                        memcpy(&value, array->buffers[1] + r * 8, 8);
+                    } else {
+                        float single;
+                        memcpy(&single, array->buffers[1] + r * 4, 4);
+                        value = single;
+                    }
+                }
+                ((double*)point)[column->field] = value;
+            }
+        } else if (column->role == ARROW_ROLE_CONSTELLATION && c == reader->constellation_column) {
+            const ArrowReadDictionary *dictionary = NULL;
+            if (column->dictionary_id >= 0) {
+                dictionary = arrow_find_dictionary(reader, column->dictionary_id);
+                if (!dictionary) {
+                    return DE430_ERROR_PARSE_FAILED;
+                }
+            }
+
+            for (int64_t r = 0; r < rows; r++) {
+                DE430EphemerisPoint *point = reader->rows[r];
+                if (!point) continue;
+
+                const char *name = "";
+                size_t length = 0;
+                if (dictionary) {
+                    int64_t index;
+                    status = arrow_dictionary_at(column, array, dictionary, r, &index);
+                    if (status != DE430_ERROR_NONE) return status;
+                    if (index >= 0) {
+                        name = dictionary->values[index];
+                        length = strlen(name);
+                    }
+                } else if (arrow_is_valid(array, r)) {
+                    status = arrow_string_at(column, array, r, &name, &length);
+                    if (status != DE430_ERROR_NONE) return status;
+                }
+
+                if (length > sizeof(point->constellation) - 1) {
+                    length = sizeof(point->constellation) - 1;
+                }
+                memcpy(point->constellation, name, length);
+            }
+        }
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+static int arrow_read_file(ArrowReader *reader) {
+    struct stat st;
+    if (fstat(reader->fd, &st) != 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+    reader->file_size = (uint64_t)st.st_size;
+
+    // Leading magic, footer, footer length, trailing magic
+    unsigned char head[ARROW_MAGIC_SIZE];
+    unsigned char tail[4 + ARROW_MAGIC_SIZE];
+    if (reader->file_size < ARROW_MAGIC_SIZE + 2 + sizeof(tail) ||
+        de430_pread_all(reader->fd, head, sizeof(head), 0) != DE430_ERROR_NONE ||
+        de430_pread_all(reader->fd, tail, sizeof(tail), reader->file_size - sizeof(tail)) != DE430_ERROR_NONE ||
+        memcmp(head, ARROW_MAGIC, ARROW_MAGIC_SIZE) != 0 ||
+        memcmp(tail + 4, ARROW_MAGIC, ARROW_MAGIC_SIZE) != 0) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    int32_t footer_length;
+    memcpy(&footer_length, tail, 4);
+    if (footer_length <= 0 || (uint64_t)footer_length > reader->file_size - sizeof(tail) - ARROW_MAGIC_SIZE) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    unsigned char *footer_data = de430_malloc((size_t)footer_length);
+    if (!footer_data) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = de430_pread_all(reader->fd, footer_data, (size_t)footer_length,
+                                 reader->file_size - sizeof(tail) - (uint64_t)footer_length);
+
+    FlatReader footer = {footer_data, (size_t)footer_length, 0};
+    size_t root = status == DE430_ERROR_NONE ? flat_root(&footer) : 0;
+    if (status == DE430_ERROR_NONE) {
+        status = arrow_parse_schema(reader, &footer, flat_table(&footer, root, 1));
+    }
+
+    uint32_t dictionary_count = 0;
+    uint32_t batch_count = 0;
+    size_t dictionaries = 0;
+    size_t batches = 0;
+    if (status == DE430_ERROR_NONE) {
+        dictionaries = flat_vector_at(&footer, root, 2, sizeof(ArrowBlock), &dictionary_count);
+        batches = flat_vector_at(&footer, root, 3, sizeof(ArrowBlock), &batch_count);
+        if (footer.bad) status = DE430_ERROR_PARSE_FAILED;
+    }
+
+    // Dictionaries first, as the record batches refer to them
+    for (uint32_t i = 0; i < dictionary_count && status == DE430_ERROR_NONE; i++) {
+        FlatReader meta;
+        size_t header;
+        const unsigned char *body;
+        uint64_t body_length;
+        status = arrow_read_message(reader, &footer, dictionaries + i * sizeof(ArrowBlock),
+                                    ARROW_HEADER_DICTIONARY_BATCH, &meta, &header, &body, &body_length);
+        if (status == DE430_ERROR_NONE) {
+            status = arrow_decode_dictionary(reader, &meta, header, body, body_length);
+            if (meta.bad) status = DE430_ERROR_PARSE_FAILED;
+        }
+    }
+
+    for (uint32_t i = 0; i < batch_count && status == DE430_ERROR_NONE; i++) {
+        FlatReader meta;
+        size_t header;
+        const unsigned char *body;
+        uint64_t body_length;
+        status = arrow_read_message(reader, &footer, batches + i * sizeof(ArrowBlock),
+                                    ARROW_HEADER_RECORD_BATCH, &meta, &header, &body, &body_length);
+        if (status == DE430_ERROR_NONE) {
+            status = arrow_decode_batch(reader, &meta, header, body, body_length);
+            if (meta.bad) status = DE430_ERROR_PARSE_FAILED;
+        }
+    }
+
+    de430_free(footer_data);
+    return status;
+}
+
+int de430_load_from_arrow(const char *filename, DE430EphemerisData **result, int *count) {
+    if (!filename || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    ArrowReader reader;
+    memset(&reader, 0, sizeof(reader));
+
+    reader.fd = open(filename, O_RDONLY);
+    if (reader.fd < 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    int status = arrow_read_file(&reader);
+
+    close(reader.fd);
+    for (int i = 0; i < reader.dictionary_count; i++) {
+        for (int j = 0; j < reader.dictionaries[i].count; j++) {
+            de430_free(reader.dictionaries[i].values[j]);
+        }
+        de430_free(reader.dictionaries[i].values);
+        de430_free(reader.dictionaries[i].objects);
+    }
+    de430_free(reader.dictionaries);
+    de430_free(reader.columns);
+    de430_free(reader.arrays);
+    de430_free(reader.message);
+    de430_free(reader.row_objects);
+    de430_free(reader.rows);
+    de430_free(reader.point_capacities);
+
+    if (status != DE430_ERROR_NONE) {
+        for (int i = 0; i < reader.object_count; i++) {
+            de430_free(reader.objects[i].points);
+        }
+        de430_free(reader.objects);
+        return status;
+    }
+
+    *result = reader.objects;
+    *count = reader.object_count;
+    return DE430_ERROR_NONE;
+}
@@ -2,42 +2,766 @@
 // Created by Dmitry Popov on 18.05.2025.
 //
 #include "de430_parser.h"
+#include "de430_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
-// Binary format header (for versioning and validation)
+_Static_assert(offsetof(DE430EphemerisPoint, constellation) == DE430_BINARY_POINT_DOUBLES_SIZE,
+               "DE430EphemerisPoint layout must match the binary point record");
+
+// Size of the staging buffer used by the bulk writer
+#define BINARY_STAGING_BUFFER_SIZE (4 * 1024 * 1024)
+
+// Encode one version 1 point record (fixed part followed by the
+// constellation) into dst, which must hold DE430_BINARY_MAX_POINT_SIZE
+// bytes. Returns the number of bytes produced.
+static size_t binary_encode_point(unsigned char *dst, const DE430EphemerisPoint *point) {
+    DE430BinaryPointHeader point_header;
+    memset(&point_header, 0, sizeof(point_header)); // Keep padding bytes deterministic
+    memcpy(&point_header, point, DE430_BINARY_POINT_DOUBLES_SIZE);
+
+    uint32_t name_length = strnlen(point->constellation, sizeof(point->constellation) - 1);
+    point_header.constellation_length = name_length + 1; // Include null terminator
+
+    memcpy(dst, &point_header, sizeof(point_header));
+    memcpy(dst + sizeof(point_header), point->constellation, name_length);
+    dst[sizeof(point_header) + name_length] = '\0';
+
+    return sizeof(point_header) + point_header.constellation_length;
+}
+
+// Encode one version 2 point record: the point itself, with everything
+// after the constellation terminator zeroed
+static void binary_encode_point_v2(unsigned char *dst, const DE430EphemerisPoint *point) {
+    DE430EphemerisPoint *record = (DE430EphemerisPoint*)dst;
+    memcpy(record, point, DE430_BINARY_POINT_DOUBLES_SIZE);
+
+    size_t name_length = strnlen(point->constellation, sizeof(point->constellation) - 1);
+    memcpy(record->constellation, point->constellation, name_length);
+    memset(record->constellation + name_length, 0, sizeof(record->constellation) - name_length);
+}
+
+// Write one point record to a stream
+static int binary_write_point(FILE *fp, const DE430EphemerisPoint *point) {
+    unsigned char record[DE430_BINARY_MAX_POINT_SIZE];
+    size_t size = binary_encode_point(record, point);
+
+    return fwrite(record, 1, size, fp) == size ? DE430_ERROR_NONE : DE430_ERROR_FILE_IO;
+}
+
+// Write a whole buffer to a descriptor, retrying short writes
+static int binary_write_all(int fd, const unsigned char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return DE430_ERROR_FILE_IO;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+// Write a whole buffer at a file offset, retrying short writes
+static int binary_pwrite_all(int fd, const unsigned char *data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return DE430_ERROR_FILE_IO;
+        }
+        data += n;
+        size -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+// Staging buffer that collects encoded records and flushes them in large writes
 typedef struct {
-    char magic[4];         // "DE43" magic identifier
-    uint32_t version;      // Format version (currently 1)
-    uint32_t object_count; // Number of objects in the file
-    uint32_t reserved;     // Reserved for future use
-} DE430BinaryHeader;
+    int fd;
+    unsigned char *data;
+    size_t used;
+    size_t capacity;
+    int positioned;        // Flush with pwrite at offset instead of write
+    uint64_t offset;       // File offset of data[0] when positioned
+} BinaryWriter;
+
+static int binary_writer_flush(BinaryWriter *writer) {
+    int status = writer->positioned
+                 ? binary_pwrite_all(writer->fd, writer->data, writer->used, writer->offset)
+                 : binary_write_all(writer->fd, writer->data, writer->used);
+    writer->offset += writer->used;
+    writer->used = 0;
+    return status;
+}
+
+// Make room for at least `size` more bytes, flushing if needed
+static int binary_writer_reserve(BinaryWriter *writer, size_t size) {
+    if (writer->used + size <= writer->capacity) {
+        return DE430_ERROR_NONE;
+    }
+
+    return binary_writer_flush(writer);
+}
+
+static int binary_writer_put(BinaryWriter *writer, const void *data, size_t size) {
+    int status = binary_writer_reserve(writer, size);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    // Too large to stage (e.g. the directory of many objects): the buffer
+    // is empty after the flush, so write it straight through
+    if (size > writer->capacity) {
+        status = writer->positioned
+                 ? binary_pwrite_all(writer->fd, data, size, writer->offset)
+                 : binary_write_all(writer->fd, data, size);
+        writer->offset += size;
+        return status;
+    }
+
+    memcpy(writer->data + writer->used, data, size);
+    writer->used += size;
+    return DE430_ERROR_NONE;
+}
+
+int de430_binary_reader_open(DE430BinaryReader *reader, const char *filename) {
+    return de430_binary_reader_open_sized(reader, filename, DE430_BINARY_READ_BUFFER_SIZE);
+}
+
+int de430_binary_reader_open_sized(DE430BinaryReader *reader, const char *filename, size_t capacity) {
+    reader->fd = open(filename, O_RDONLY);
+    if (reader->fd < 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(reader->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    reader->pos = 0;
+    reader->len = 0;
+    reader->base = 0;
+    reader->capacity = capacity < DE430_BINARY_MAX_POINT_SIZE ? DE430_BINARY_MAX_POINT_SIZE : capacity;
+    reader->data = de430_malloc(reader->capacity);
+    if (!reader->data) {
+        close(reader->fd);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+void de430_binary_reader_close(DE430BinaryReader *reader) {
+    de430_free(reader->data);
+    close(reader->fd);
+}
+
+uint64_t de430_binary_reader_tell(const DE430BinaryReader *reader) {
+    return reader->base + reader->pos;
+}
+
+int de430_binary_reader_seek(DE430BinaryReader *reader, uint64_t offset) {
+    // Stay inside the buffer when the target is already there
+    if (offset >= reader->base && offset <= reader->base + reader->len) {
+        reader->pos = (size_t)(offset - reader->base);
+        return DE430_ERROR_NONE;
+    }
+
+    if (lseek(reader->fd, (off_t)offset, SEEK_SET) < 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    reader->base = offset;
+    reader->pos = 0;
+    reader->len = 0;
+    return DE430_ERROR_NONE;
+}
+
+const unsigned char* de430_binary_reader_peek(DE430BinaryReader *reader, size_t size) {
+    if (reader->len - reader->pos >= size) {
+        return reader->data + reader->pos;
+    }
+
+    // Move the unread tail to the front and refill behind it
+    size_t remaining = reader->len - reader->pos;
+    memmove(reader->data, reader->data + reader->pos, remaining);
+    reader->base += reader->pos;
+    reader->pos = 0;
+    reader->len = remaining;
+
+    while (reader->len < size) {
+        ssize_t n = read(reader->fd, reader->data + reader->len, reader->capacity - reader->len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return NULL;
+        }
+        if (n == 0) return NULL;
+        reader->len += (size_t)n;
+    }
+
+    return reader->data;
+}
+
+int de430_binary_reader_take(DE430BinaryReader *reader, void *dst, size_t size) {
+    if (size <= reader->capacity) {
+        const unsigned char *src = de430_binary_reader_peek(reader, size);
+        if (!src) {
+            return DE430_ERROR_PARSE_FAILED;
+        }
+
+        memcpy(dst, src, size);
+        reader->pos += size;
+        return DE430_ERROR_NONE;
+    }
+
+    // Drain what is buffered, then read the rest straight into dst
+    size_t buffered = reader->len - reader->pos;
+    memcpy(dst, reader->data + reader->pos, buffered);
+    unsigned char *out = (unsigned char*)dst + buffered;
+    size_t left = size - buffered;
+
+    reader->base += reader->len;
+    reader->pos = 0;
+    reader->len = 0;
+
+    while (left > 0) {
+        ssize_t n = read(reader->fd, out, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return DE430_ERROR_FILE_IO;
+        }
+        if (n == 0) return DE430_ERROR_PARSE_FAILED;
+        out += n;
+        left -= (size_t)n;
+        reader->base += (uint64_t)n;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+int de430_pread_all(int fd, void *dst, size_t size, uint64_t offset) {
+    unsigned char *out = (unsigned char*)dst;
+
+    while (size > 0) {
+        ssize_t n = pread(fd, out, size, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return DE430_ERROR_FILE_IO;
+        }
+        if (n == 0) return DE430_ERROR_PARSE_FAILED;
+        out += n;
+        size -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+int de430_binary_check_header(const DE430BinaryHeader *header) {
+    // Verify magic number and version
+    if (memcmp(header->magic, DE430_BINARY_MAGIC, 4) != 0 ||
+        (header->version != DE430_BINARY_VERSION_1 && header->version != DE430_BINARY_VERSION_2)) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+int de430_file_size(int fd, uint64_t *size) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    *size = (uint64_t)st.st_size;
+    return DE430_ERROR_NONE;
+}
+
+int de430_binary_check_entry(DE430BinaryDirectoryEntry *entry, uint64_t file_size) {
+    entry->name[sizeof(entry->name) - 1] = '\0';
+
+    if (entry->record_size != sizeof(DE430EphemerisPoint) || entry->point_count > INT_MAX) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    // Records and zone maps have to lie within the file; a corrupt entry
+    // must not turn into a huge allocation
+    uint64_t records = (uint64_t)entry->point_count * sizeof(DE430EphemerisPoint);
+    if (entry->offset > file_size || records > file_size - entry->offset) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+    uint64_t zones = (uint64_t)entry->zone_count * sizeof(DE430BinaryZoneMap);
+    if (entry->zone_count > 0 && (entry->zone_offset > file_size || zones > file_size - entry->zone_offset)) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    // Zone maps, when present, have to cover every point exactly
+    if (entry->zone_count > 0 &&
+        (entry->zone_block_size == 0 ||
+         entry->zone_count != (entry->point_count + (uint64_t)entry->zone_block_size - 1) / entry->zone_block_size)) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+// Every object takes at least a directory entry or an object header in the
+// file, which bounds what a corrupt object count can make readers allocate
+static int binary_check_object_count(int fd, const DE430BinaryHeader *header, uint64_t *file_size) {
+    int status = de430_file_size(fd, file_size);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    size_t min_object_size = header->version == DE430_BINARY_VERSION_2
+                             ? sizeof(DE430BinaryDirectoryEntry) : sizeof(DE430BinaryObjectHeader);
+    if ((uint64_t)header->object_count * min_object_size > *file_size) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+    return DE430_ERROR_NONE;
+}
+
+int de430_binary_read_header(DE430BinaryReader *reader, DE430BinaryHeader *header) {
+    if (de430_binary_reader_take(reader, header, sizeof(*header)) != DE430_ERROR_NONE) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    int status = de430_binary_check_header(header);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    uint64_t file_size;
+    return binary_check_object_count(reader->fd, header, &file_size);
+}
+
+int de430_binary_decode_points_v1(DE430BinaryReader *reader, DE430EphemerisPoint *points, uint32_t count) {
+    for (uint32_t j = 0; j < count; j++) {
+        // Fixed part and the longest possible constellation, or whatever
+        // is left of the file if the record is shorter than that
+        const unsigned char *record = de430_binary_reader_peek(reader, DE430_BINARY_MAX_POINT_SIZE);
+        size_t available = reader->len - reader->pos;
+        if (!record && available >= sizeof(DE430BinaryPointHeader)) {
+            record = reader->data + reader->pos;
+        }
+        if (!record) {
+            return DE430_ERROR_PARSE_FAILED;
+        }
+
+        uint32_t constellation_length;
+        memcpy(&constellation_length, record + DE430_BINARY_POINT_DOUBLES_SIZE, sizeof(constellation_length));
+
+        if (constellation_length > sizeof(points->constellation) ||
+            available < sizeof(DE430BinaryPointHeader) + constellation_length) {
+            return DE430_ERROR_PARSE_FAILED;
+        }
+
+        if (points) {
+            DE430EphemerisPoint *point = &points[j];
+            memcpy(point, record, DE430_BINARY_POINT_DOUBLES_SIZE);
+
+            // Read constellation
+            memset(point->constellation, 0, sizeof(point->constellation));
+            memcpy(point->constellation, record + sizeof(DE430BinaryPointHeader), constellation_length);
+            point->constellation[sizeof(point->constellation) - 1] = '\0';
+        }
+
+        reader->pos += sizeof(DE430BinaryPointHeader) + constellation_length;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+void de430_binary_terminate_points(DE430EphemerisPoint *points, size_t count) {
+    for (size_t j = 0; j < count; j++) {
+        points[j].constellation[sizeof(points[j].constellation) - 1] = '\0';
+    }
+}
+
+int de430_binary_read_directory(DE430BinaryReader *reader, const DE430BinaryHeader *header,
+                                DE430BinaryDirectoryEntry **entries) {
+    *entries = NULL;
+
+    uint64_t file_size = 0;
+    int status = binary_check_object_count(reader->fd, header, &file_size);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    *entries = de430_calloc(header->object_count > 0 ? header->object_count : 1, sizeof(DE430BinaryDirectoryEntry));
+    if (!*entries) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    if (header->version == DE430_BINARY_VERSION_2) {
+        status = de430_binary_reader_take(reader, *entries,
+                                          header->object_count * sizeof(DE430BinaryDirectoryEntry));
+        for (uint32_t i = 0; i < header->object_count && status == DE430_ERROR_NONE; i++) {
+            status = de430_binary_check_entry(&(*entries)[i], file_size);
+        }
+    } else {
+        // Version 1 has no directory: walk the object headers and skip
+        // over the point records to find where each object starts
+        for (uint32_t i = 0; i < header->object_count && status == DE430_ERROR_NONE; i++) {
+            DE430BinaryDirectoryEntry *entry = &(*entries)[i];
+
+            DE430BinaryObjectHeader obj_header;
+            status = de430_binary_reader_take(reader, &obj_header, sizeof(obj_header));
+            if (status != DE430_ERROR_NONE) break;
+
+            if (obj_header.name_length > sizeof(entry->name) || obj_header.point_count > INT_MAX) {
+                status = DE430_ERROR_PARSE_FAILED;
+                break;
+            }
+
+            status = de430_binary_reader_take(reader, entry->name, obj_header.name_length);
+            if (status != DE430_ERROR_NONE) break;
+            entry->name[sizeof(entry->name) - 1] = '\0';
+
+            entry->offset = de430_binary_reader_tell(reader);
+            entry->point_count = obj_header.point_count;
+            entry->record_size = 0;
+
+            status = de430_binary_decode_points_v1(reader, NULL, obj_header.point_count);
+        }
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free(*entries);
+        *entries = NULL;
+    }
+
+    return status;
+}
+
+int de430_binary_load_entry(DE430BinaryReader *reader, const DE430BinaryDirectoryEntry *entry,
+                            DE430EphemerisData *object) {
+    memset(object, 0, sizeof(DE430EphemerisData));
+    strncpy(object->object_name, entry->name, sizeof(object->object_name) - 1);
+
+    int status = de430_binary_reader_seek(reader, entry->offset);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    // Allocate memory for points
+    object->points = de430_malloc(entry->point_count > 0 ? entry->point_count * sizeof(DE430EphemerisPoint) : 1);
+    if (!object->points) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    if (entry->record_size == 0) {
+        status = de430_binary_decode_points_v1(reader, object->points, entry->point_count);
+    } else {
+        // Version 2 records are stored as points, so they are read in place
+        status = de430_binary_reader_take(reader, object->points,
+                                          (size_t)entry->point_count * sizeof(DE430EphemerisPoint));
+        if (status == DE430_ERROR_NONE) {
+            de430_binary_terminate_points(object->points, entry->point_count);
+        }
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free(object->points);
+        object->points = NULL;
+        return status;
+    }
+
+    object->count = entry->point_count;
+    return DE430_ERROR_NONE;
+}
+
+void de430_init_binary_options(DE430BinaryOptions *options) {
+    if (!options) return;
+
+    memset(options, 0, sizeof(DE430BinaryOptions));
+    options->version = DE430_BINARY_VERSION_1;
+    options->zone_block_size = DE430_ZONE_BLOCK_POINTS;
+}
+
+// Write points [first, first + count) of an object in the version 1
+// layout, preceded by the object header and name when first is 0
+static int binary_write_v1_points(BinaryWriter *writer, const DE430EphemerisData *obj, int first, int count) {
+    int status = DE430_ERROR_NONE;
+
+    if (first == 0) {
+        // Write object header and name
+        DE430BinaryObjectHeader obj_header;
+        obj_header.name_length = strlen(obj->object_name) + 1; // Include null terminator
+        obj_header.point_count = obj->count;
+
+        status = binary_writer_put(writer, &obj_header, sizeof(obj_header));
+        if (status == DE430_ERROR_NONE) {
+            status = binary_writer_put(writer, obj->object_name, obj_header.name_length);
+        }
+    }
+
+    // Encode each data point straight into the staging buffer
+    for (int j = first; j < first + count && status == DE430_ERROR_NONE; j++) {
+        status = binary_writer_reserve(writer, DE430_BINARY_MAX_POINT_SIZE);
+        if (status == DE430_ERROR_NONE) {
+            writer->used += binary_encode_point(writer->data + writer->used, &obj->points[j]);
+        }
+    }
+
+    return status;
+}
+
+// Encoded size of what binary_write_v1_points produces for the same range
+static uint64_t binary_v1_size(const DE430EphemerisData *obj, int first, int count) {
+    uint64_t size = 0;
+
+    if (first == 0) {
+        size += sizeof(DE430BinaryObjectHeader) + strlen(obj->object_name) + 1;
+    }
+
+    for (int j = first; j < first + count; j++) {
+        size += sizeof(DE430BinaryPointHeader) +
+                strnlen(obj->points[j].constellation, sizeof(obj->points[j].constellation) - 1) + 1;
+    }
+
+    return size;
+}
+
+// Write the version 1 layout: each object header and name followed by its records
+static int binary_write_v1(BinaryWriter *writer, const DE430EphemerisData *data, int count) {
+    int status = DE430_ERROR_NONE;
+
+    for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+        status = binary_write_v1_points(writer, &data[i], 0, data[i].count);
+    }
+
+    return status;
+}
+
+// Number of zone maps covering an object
+static uint32_t binary_zone_count(int point_count, int block_size) {
+    return block_size > 0 ? (uint32_t)((point_count + block_size - 1) / block_size) : 0;
+}
+
+// Lay out a version 2 file: fill in the directory and, when zone maps are
+// requested, collect the constellation dictionary
+static int binary_plan_v2(const DE430EphemerisData *data, int count, int block_size,
+                          DE430BinaryDirectoryEntry **entries, DE430ZoneDictionary **dictionary) {
+    *entries = de430_calloc(count, sizeof(DE430BinaryDirectoryEntry));
+    *dictionary = NULL;
+    if (!*entries) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    uint64_t zone_offset = sizeof(DE430BinaryHeader) + (uint64_t)count * sizeof(DE430BinaryDirectoryEntry);
+    uint64_t zone_section_size = 0;
+
+    if (block_size > 0) {
+        *dictionary = de430_calloc(1, sizeof(DE430ZoneDictionary));
+        if (!*dictionary) {
+            de430_free(*entries);
+            *entries = NULL;
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+
+        for (int i = 0; i < count; i++) {
+            for (int j = 0; j < data[i].count; j++) {
+                // Constellations change rarely from one point to the next
+                if (j > 0 && strcmp(data[i].points[j].constellation, data[i].points[j - 1].constellation) == 0) {
+                    continue;
+                }
+                de430_zone_dictionary_add(*dictionary, data[i].points[j].constellation);
+            }
+        }
+
+        // An untracked dictionary is stored as its marker count alone
+        uint32_t stored_names = (*dictionary)->count == DE430_ZONE_NO_CONSTELLATIONS ? 0 : (*dictionary)->count;
+        zone_offset += 2 * sizeof(uint32_t) + stored_names * sizeof((*dictionary)->names[0]);
+
+        for (int i = 0; i < count; i++) {
+            zone_section_size += binary_zone_count(data[i].count, block_size) * sizeof(DE430BinaryZoneMap);
+        }
+    }
+
+    // Every offset is known up front because records have a fixed size
+    uint64_t offset = zone_offset + zone_section_size;
+
+    for (int i = 0; i < count; i++) {
+        DE430BinaryDirectoryEntry *entry = &(*entries)[i];
+        strncpy(entry->name, data[i].object_name, sizeof(entry->name) - 1);
+        entry->offset = offset;
+        entry->point_count = data[i].count;
+        entry->record_size = sizeof(DE430EphemerisPoint);
+
+        if (*dictionary) {
+            entry->zone_offset = zone_offset;
+            entry->zone_block_size = (uint32_t)block_size;
+            entry->zone_count = binary_zone_count(data[i].count, block_size);
+            zone_offset += entry->zone_count * sizeof(DE430BinaryZoneMap);
+        }
+
+        offset += (uint64_t)data[i].count * sizeof(DE430EphemerisPoint);
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+// Write the directory and the zone dictionary that follow the file header
+static int binary_write_v2_head(BinaryWriter *writer, const DE430BinaryDirectoryEntry *entries, int count,
+                                const DE430ZoneDictionary *dictionary) {
+    int status = binary_writer_put(writer, entries, count * sizeof(DE430BinaryDirectoryEntry));
+
+    if (dictionary && status == DE430_ERROR_NONE) {
+        uint32_t counts[2] = {dictionary->count, 0};
+        uint32_t stored_names = dictionary->count == DE430_ZONE_NO_CONSTELLATIONS ? 0 : dictionary->count;
+
+        status = binary_writer_put(writer, counts, sizeof(counts));
+        if (status == DE430_ERROR_NONE) {
+            status = binary_writer_put(writer, dictionary->names, stored_names * sizeof(dictionary->names[0]));
+        }
+    }
+
+    return status;
+}
+
+// Write the zone maps of points [first, first + count); first is a multiple of block_size
+static int binary_write_v2_zones(BinaryWriter *writer, const DE430EphemerisData *obj, int first, int count,
+                                 int block_size, const DE430ZoneDictionary *dictionary) {
+    int status = DE430_ERROR_NONE;
+
+    for (int start = first; start < first + count && status == DE430_ERROR_NONE; start += block_size) {
+        int n = first + count - start < block_size ? first + count - start : block_size;
+
+        DE430BinaryZoneMap zone;
+        de430_zone_map_compute(&obj->points[start], n, dictionary, &zone);
+        status = binary_writer_put(writer, &zone, sizeof(zone));
+    }
+
+    return status;
+}
+
+// Write points [first, first + count) of an object as version 2 records
+static int binary_write_v2_points(BinaryWriter *writer, const DE430EphemerisData *obj, int first, int count) {
+    int status = DE430_ERROR_NONE;
+
+    for (int j = first; j < first + count && status == DE430_ERROR_NONE; j++) {
+        status = binary_writer_reserve(writer, sizeof(DE430EphemerisPoint));
+        if (status == DE430_ERROR_NONE) {
+            binary_encode_point_v2(writer->data + writer->used, &obj->points[j]);
+            writer->used += sizeof(DE430EphemerisPoint);
+        }
+    }
+
+    return status;
+}
+
+// Write the version 2 layout: the object directory, the optional zone
+// section, then fixed-size records
+static int binary_write_v2(BinaryWriter *writer, const DE430EphemerisData *data, int count, int block_size) {
+    DE430BinaryDirectoryEntry *entries;
+    DE430ZoneDictionary *dictionary;
+
+    int status = binary_plan_v2(data, count, block_size, &entries, &dictionary);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    status = binary_write_v2_head(writer, entries, count, dictionary);
+
+    for (int i = 0; dictionary && i < count && status == DE430_ERROR_NONE; i++) {
+        status = binary_write_v2_zones(writer, &data[i], 0, data[i].count, block_size, dictionary);
+    }
+
+    for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+        status = binary_write_v2_points(writer, &data[i], 0, data[i].count);
+    }
+
+    de430_free(entries);
+    de430_free(dictionary);
+    return status;
+}
+
+/**
+ * Save ephemeris data to a binary file using the given options
+ *
+ * @param data Array of ephemeris data to save
+ * @param count Number of objects in the array
+ * @param filename Name of the file to save to
+ * @param options Format options, or NULL for the defaults
+ * @return 0 on success, error code on failure
+ */
+int de430_save_to_binary_ex(const DE430EphemerisData *data, int count, const char *filename,
+                            const DE430BinaryOptions *options) {
+    DE430BinaryOptions defaults;
+    if (!options) {
+        de430_init_binary_options(&defaults);
+        options = &defaults;
+    }
+
+    if (!data || count <= 0 || !filename || options->zone_block_size < 0 ||
+        (options->version != DE430_BINARY_VERSION_1 && options->version != DE430_BINARY_VERSION_2)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    // Open the file
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return DE430_ERROR_FILE_IO;
+    }
 
-// Binary object header (precedes each object's data)
-typedef struct {
-    uint32_t name_length;  // Length of object name
-    uint32_t point_count;  // Number of data points for this object
-} DE430BinaryObjectHeader;
+    BinaryWriter writer;
+    writer.fd = fd;
+    writer.used = 0;
+    writer.capacity = BINARY_STAGING_BUFFER_SIZE;
+    writer.data = de430_malloc(writer.capacity);
+    writer.positioned = 0;
+    writer.offset = 0;
+    if (!writer.data) {
+        close(fd);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
 
-// Binary point header (fixed size part of each data point)
-typedef struct {
-    double jd;
-    double position[3];
-    double ra_dec[2];
-    double magnitude;
-    double phase;
-    double angular_size;
-    double physical_size;
-    double albedo;
-    double sun_dist;
-    double earth_dist;
-    double sun_ang_dist;
-    double theta_edo;
-    double ecliptic[3];
-    uint32_t constellation_length;
-} DE430BinaryPointHeader;
+    // Write file header
+    DE430BinaryHeader header;
+    memcpy(header.magic, DE430_BINARY_MAGIC, 4);
+    header.version = options->version;
+    header.object_count = count;
+    header.flags = 0;
+    if (options->version == DE430_BINARY_VERSION_2 && options->zone_block_size > 0) {
+        header.flags |= DE430_BINARY_FLAG_ZONE_MAPS;
+    }
+
+    int status = binary_writer_put(&writer, &header, sizeof(header));
+
+    // Write each object
+    if (status == DE430_ERROR_NONE) {
+        if (options->version == DE430_BINARY_VERSION_2) {
+            status = binary_write_v2(&writer, data, count, options->zone_block_size);
+        } else {
+            status = binary_write_v1(&writer, data, count);
+        }
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = binary_writer_flush(&writer);
+    }
+
+    de430_free(writer.data);
+    if (close(fd) != 0 && status == DE430_ERROR_NONE) {
+        status = DE430_ERROR_FILE_IO;
+    }
+
+    return status;
+}
 
 /**
  * Save ephemeris data to a binary file
@@ -48,84 +772,332 @@ typedef struct {
  * @return 0 on success, error code on failure
  */
 int de430_save_to_binary(const DE430EphemerisData *data, int count, const char *filename) {
-    if (!data || count <= 0 || !filename) {
+    return de430_save_to_binary_ex(data, count, filename, NULL);
+}
+
+// Points per task of the parallel writer and reader, so that one large
+// object is spread over several threads
+#define BINARY_PARALLEL_TASK_POINTS 65536
+
+// Staging buffer of each parallel writer task
+#define BINARY_PARALLEL_STAGING_SIZE (1024 * 1024)
+
+// A range of one object's points handled by a single task
+typedef struct {
+    int object;
+    int first;
+    int count;
+    uint64_t offset;       // File offset where the task's bytes start
+} BinaryTask;
+
+typedef struct {
+    int fd;
+    int version;
+    int block_size;
+    const DE430EphemerisData *data;
+    const DE430BinaryDirectoryEntry *entries;  // Version 2 only
+    const DE430ZoneDictionary *dictionary;     // Version 2 with zone maps only
+    BinaryTask *tasks;
+    DE430EphemerisData *result;                // Loading only
+    const char *filename;                      // Loading only
+} BinaryParallelJob;
+
+// Split every object into tasks of at most `step` points; objects without
+// points still get one task so that their header is written
+static BinaryTask* binary_split_tasks(const DE430EphemerisData *objects, int count, int step, int *task_count) {
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        total += objects[i].count > 0 ? (objects[i].count + step - 1) / step : 1;
+    }
+
+    BinaryTask *tasks = de430_calloc(total > 0 ? total : 1, sizeof(BinaryTask));
+    if (!tasks) {
+        return NULL;
+    }
+
+    int t = 0;
+    for (int i = 0; i < count; i++) {
+        int first = 0;
+        do {
+            tasks[t].object = i;
+            tasks[t].first = first;
+            tasks[t].count = objects[i].count - first < step ? objects[i].count - first : step;
+            first += step;
+            t++;
+        } while (first < objects[i].count);
+    }
+
+    *task_count = total;
+    return tasks;
+}
+
+// Store the encoded size of a version 1 task in its offset, to be summed later
+static int binary_size_task(void *context, int index) {
+    BinaryParallelJob *job = (BinaryParallelJob*)context;
+    BinaryTask *task = &job->tasks[index];
+
+    task->offset = binary_v1_size(&job->data[task->object], task->first, task->count);
+    return DE430_ERROR_NONE;
+}
+
+static int binary_save_task(void *context, int index) {
+    BinaryParallelJob *job = (BinaryParallelJob*)context;
+    const BinaryTask *task = &job->tasks[index];
+    const DE430EphemerisData *obj = &job->data[task->object];
+
+    BinaryWriter writer;
+    writer.fd = job->fd;
+    writer.used = 0;
+    writer.capacity = BINARY_PARALLEL_STAGING_SIZE;
+    writer.data = de430_malloc(writer.capacity);
+    writer.positioned = 1;
+    writer.offset = task->offset;
+    if (!writer.data) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status;
+    if (job->version == DE430_BINARY_VERSION_1) {
+        status = binary_write_v1_points(&writer, obj, task->first, task->count);
+    } else {
+        status = binary_write_v2_points(&writer, obj, task->first, task->count);
+
+        // Tasks start on block boundaries, so each owns whole zone maps
+        if (job->dictionary && status == DE430_ERROR_NONE) {
+            status = binary_writer_flush(&writer);
+            writer.offset = job->entries[task->object].zone_offset +
+                            (uint64_t)(task->first / job->block_size) * sizeof(DE430BinaryZoneMap);
+        }
+        if (job->dictionary && status == DE430_ERROR_NONE) {
+            status = binary_write_v2_zones(&writer, obj, task->first, task->count, job->block_size, job->dictionary);
+        }
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = binary_writer_flush(&writer);
+    }
+
+    de430_free(writer.data);
+    return status;
+}
+
+int de430_save_to_binary_parallel(const DE430EphemerisData *data, int count, const char *filename,
+                                  const DE430BinaryOptions *options, int threads) {
+    DE430BinaryOptions defaults;
+    if (!options) {
+        de430_init_binary_options(&defaults);
+        options = &defaults;
+    }
+
+    if (!data || count <= 0 || !filename || options->zone_block_size < 0 ||
+        (options->version != DE430_BINARY_VERSION_1 && options->version != DE430_BINARY_VERSION_2)) {
         return DE430_ERROR_INVALID_CONFIG;
     }
 
-    // Open the file
-    FILE *fp = fopen(filename, "wb");
-    if (!fp) {
-        return DE430_ERROR_FILE_IO;
+    BinaryParallelJob job;
+    memset(&job, 0, sizeof(job));
+    job.fd = -1;
+    job.version = options->version;
+    job.block_size = options->version == DE430_BINARY_VERSION_2 ? options->zone_block_size : 0;
+    job.data = data;
+
+    DE430BinaryDirectoryEntry *entries = NULL;
+    DE430ZoneDictionary *dictionary = NULL;
+    int status = DE430_ERROR_NONE;
+
+    if (job.version == DE430_BINARY_VERSION_2) {
+        status = binary_plan_v2(data, count, job.block_size, &entries, &dictionary);
+        job.entries = entries;
+        job.dictionary = dictionary;
     }
 
-    // Write file header
-    DE430BinaryHeader header;
-    memcpy(header.magic, "DE43", 4);
-    header.version = 1;
-    header.object_count = count;
-    header.reserved = 0;
+    // Zone maps must not straddle tasks, so tasks are whole blocks
+    int step = BINARY_PARALLEL_TASK_POINTS;
+    if (job.block_size > 0) {
+        step = (step + job.block_size - 1) / job.block_size * job.block_size;
+    }
 
-    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
-        fclose(fp);
-        return DE430_ERROR_FILE_IO;
+    int task_count = 0;
+    if (status == DE430_ERROR_NONE) {
+        job.tasks = binary_split_tasks(data, count, step, &task_count);
+        if (!job.tasks) status = DE430_ERROR_MEMORY_ALLOCATION;
     }
 
-    // Write each object
-    for (int i = 0; i < count; i++) {
-        const DE430EphemerisData *obj = &data[i];
+    // Work out where every task's bytes go before anything is written
+    if (status == DE430_ERROR_NONE && job.version == DE430_BINARY_VERSION_1) {
+        status = de430_parallel_for(task_count, threads, binary_size_task, &job);
 
-        // Write object header
-        DE430BinaryObjectHeader obj_header;
-        obj_header.name_length = strlen(obj->object_name) + 1; // Include null terminator
-        obj_header.point_count = obj->count;
+        uint64_t offset = sizeof(DE430BinaryHeader);
+        for (int t = 0; t < task_count && status == DE430_ERROR_NONE; t++) {
+            uint64_t size = job.tasks[t].offset;
+            job.tasks[t].offset = offset;
+            offset += size;
+        }
+    } else if (status == DE430_ERROR_NONE) {
+        for (int t = 0; t < task_count; t++) {
+            job.tasks[t].offset = entries[job.tasks[t].object].offset +
+                                  (uint64_t)job.tasks[t].first * sizeof(DE430EphemerisPoint);
+        }
+    }
 
-        if (fwrite(&obj_header, sizeof(obj_header), 1, fp) != 1) {
-            fclose(fp);
-            return DE430_ERROR_FILE_IO;
+    if (status == DE430_ERROR_NONE) {
+        job.fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (job.fd < 0) status = DE430_ERROR_FILE_IO;
+    }
+
+    // The header and directory are written here, the rest by the tasks
+    if (status == DE430_ERROR_NONE) {
+        BinaryWriter writer;
+        writer.fd = job.fd;
+        writer.used = 0;
+        writer.capacity = BINARY_PARALLEL_STAGING_SIZE;
+        writer.data = de430_malloc(writer.capacity);
+        writer.positioned = 1;
+        writer.offset = 0;
+
+        DE430BinaryHeader header;
+        memcpy(header.magic, DE430_BINARY_MAGIC, 4);
+        header.version = options->version;
+        header.object_count = count;
+        header.flags = dictionary ? DE430_BINARY_FLAG_ZONE_MAPS : 0;
+
+        status = writer.data ? binary_writer_put(&writer, &header, sizeof(header)) : DE430_ERROR_MEMORY_ALLOCATION;
+        if (status == DE430_ERROR_NONE && entries) {
+            status = binary_write_v2_head(&writer, entries, count, dictionary);
+        }
+        if (status == DE430_ERROR_NONE) {
+            status = binary_writer_flush(&writer);
         }
+        de430_free(writer.data);
+    }
 
-        // Write object name
-        if (fwrite(obj->object_name, 1, obj_header.name_length, fp) != obj_header.name_length) {
-            fclose(fp);
-            return DE430_ERROR_FILE_IO;
+    if (status == DE430_ERROR_NONE) {
+        status = de430_parallel_for(task_count, threads, binary_save_task, &job);
+    }
+
+    if (job.fd >= 0 && close(job.fd) != 0 && status == DE430_ERROR_NONE) {
+        status = DE430_ERROR_FILE_IO;
+    }
+
+    de430_free(job.tasks);
+    de430_free(entries);
+    de430_free(dictionary);
+    return status;
+}
+
+static int binary_load_task(void *context, int index) {
+    BinaryParallelJob *job = (BinaryParallelJob*)context;
+    const BinaryTask *task = &job->tasks[index];
+
+    if (job->version == DE430_BINARY_VERSION_2) {
+        // Records are points, so they land in place
+        DE430EphemerisPoint *points = job->result[task->object].points + task->first;
+        int status = de430_pread_all(job->fd, points, (size_t)task->count * sizeof(DE430EphemerisPoint),
+                                     task->offset);
+        if (status == DE430_ERROR_NONE) {
+            de430_binary_terminate_points(points, (size_t)task->count);
         }
+        return status;
+    }
 
-        // Write each data point
-        for (int j = 0; j < obj->count; j++) {
-            const DE430EphemerisPoint *point = &obj->points[j];
-
-            // Write fixed part of point
-            DE430BinaryPointHeader point_header;
-            point_header.jd = point->jd;
-            memcpy(point_header.position, point->position, sizeof(point_header.position));
-            memcpy(point_header.ra_dec, point->ra_dec, sizeof(point_header.ra_dec));
-            point_header.magnitude = point->magnitude;
-            point_header.phase = point->phase;
-            point_header.angular_size = point->angular_size;
-            point_header.physical_size = point->physical_size;
-            point_header.albedo = point->albedo;
-            point_header.sun_dist = point->sun_dist;
-            point_header.earth_dist = point->earth_dist;
-            point_header.sun_ang_dist = point->sun_ang_dist;
-            point_header.theta_edo = point->theta_edo;
-            memcpy(point_header.ecliptic, point->ecliptic, sizeof(point_header.ecliptic));
-            point_header.constellation_length = strlen(point->constellation) + 1; // Include null terminator
-
-            if (fwrite(&point_header, sizeof(point_header), 1, fp) != 1) {
-                fclose(fp);
-                return DE430_ERROR_FILE_IO;
-            }
+    // Version 1 records have to be decoded; each task reads its object
+    // through a reader of its own
+    DE430BinaryReader reader;
+    int status = de430_binary_reader_open_sized(&reader, job->filename, BINARY_PARALLEL_STAGING_SIZE);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
 
-            // Write constellation
-            if (fwrite(point->constellation, 1, point_header.constellation_length, fp) !=
-                point_header.constellation_length) {
-                fclose(fp);
-                return DE430_ERROR_FILE_IO;
-            }
+    status = de430_binary_load_entry(&reader, &job->entries[task->object], &job->result[task->object]);
+    de430_binary_reader_close(&reader);
+    return status;
+}
+
+int de430_load_from_binary_parallel(const char *filename, int threads, DE430EphemerisData **result, int *count) {
+    if (!filename || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430BinaryReader reader;
+    int status = de430_binary_reader_open(&reader, filename);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    DE430BinaryHeader header;
+    DE430BinaryDirectoryEntry *entries = NULL;
+    status = de430_binary_read_header(&reader, &header);
+    if (status == DE430_ERROR_NONE) {
+        // Version 1 files are scanned once to find where each object starts
+        status = de430_binary_read_directory(&reader, &header, &entries);
+    }
+    if (status == DE430_ERROR_NONE && header.object_count > INT_MAX) {
+        status = DE430_ERROR_PARSE_FAILED;
+    }
+    if (status != DE430_ERROR_NONE) {
+        de430_free(entries);
+        de430_binary_reader_close(&reader);
+        return status;
+    }
+
+    int object_count = (int)header.object_count;
+    *result = de430_calloc(object_count > 0 ? object_count : 1, sizeof(DE430EphemerisData));
+    if (!*result) status = DE430_ERROR_MEMORY_ALLOCATION;
+
+    BinaryParallelJob job;
+    memset(&job, 0, sizeof(job));
+    job.fd = reader.fd;
+    job.version = (int)header.version;
+    job.entries = entries;
+    job.result = *result;
+    job.filename = filename;
+
+    int task_count = 0;
+    if (status == DE430_ERROR_NONE && header.version == DE430_BINARY_VERSION_2) {
+        // Allocate every object up front, then fill them in parallel
+        for (int i = 0; i < object_count && status == DE430_ERROR_NONE; i++) {
+            DE430EphemerisData *obj = &(*result)[i];
+            strncpy(obj->object_name, entries[i].name, sizeof(obj->object_name) - 1);
+            obj->count = (int)entries[i].point_count;   // At most INT_MAX, checked with the directory
+            obj->points = de430_malloc(obj->count > 0 ? obj->count * sizeof(DE430EphemerisPoint) : 1);
+            if (!obj->points) status = DE430_ERROR_MEMORY_ALLOCATION;
+        }
+
+        if (status == DE430_ERROR_NONE) {
+            job.tasks = binary_split_tasks(*result, object_count, BINARY_PARALLEL_TASK_POINTS, &task_count);
+            if (!job.tasks) status = DE430_ERROR_MEMORY_ALLOCATION;
         }
+
+        for (int t = 0; t < task_count && status == DE430_ERROR_NONE; t++) {
+            job.tasks[t].offset = entries[job.tasks[t].object].offset +
+                                  (uint64_t)job.tasks[t].first * sizeof(DE430EphemerisPoint);
+        }
+    } else if (status == DE430_ERROR_NONE) {
+        // One task per object
+        task_count = object_count;
+        job.tasks = de430_calloc(task_count > 0 ? task_count : 1, sizeof(BinaryTask));
+        if (!job.tasks) status = DE430_ERROR_MEMORY_ALLOCATION;
+
+        for (int t = 0; t < task_count && status == DE430_ERROR_NONE; t++) {
+            job.tasks[t].object = t;
+        }
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = de430_parallel_for(task_count, threads, binary_load_task, &job);
+    }
+
+    de430_free(job.tasks);
+    de430_free(entries);
+    de430_binary_reader_close(&reader);
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free_data(*result, object_count);
+        *result = NULL;
+        return status;
     }
 
-    fclose(fp);
+    *count = object_count;
     return DE430_ERROR_NONE;
 }
 
@@ -142,154 +1114,375 @@ int de430_load_from_binary(const char *filename, DE430EphemerisData **result, in
         return DE430_ERROR_INVALID_CONFIG;
     }
 
-    // Open the file
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) {
-        return DE430_ERROR_FILE_IO;
+    // Read the file in large chunks and decode records from memory
+    DE430BinaryReader reader;
+    int status = de430_binary_reader_open(&reader, filename);
+    if (status != DE430_ERROR_NONE) {
+        return status;
     }
 
     // Read file header
     DE430BinaryHeader header;
-    if (fread(&header, sizeof(header), 1, fp) != 1) {
-        fclose(fp);
-        return DE430_ERROR_PARSE_FAILED;
-    }
-
-    // Verify magic number
-    if (memcmp(header.magic, "DE43", 4) != 0) {
-        fclose(fp);
-        return DE430_ERROR_PARSE_FAILED;
-    }
-
-    // Currently, we only support version 1
-    if (header.version != 1) {
-        fclose(fp);
-        return DE430_ERROR_PARSE_FAILED;
+    status = de430_binary_read_header(&reader, &header);
+    if (status != DE430_ERROR_NONE) {
+        de430_binary_reader_close(&reader);
+        return status;
     }
 
     // Allocate result array
-    *result = malloc(header.object_count * sizeof(DE430EphemerisData));
+    *result = de430_calloc(header.object_count > 0 ? header.object_count : 1, sizeof(DE430EphemerisData));
     if (!*result) {
-        fclose(fp);
+        de430_binary_reader_close(&reader);
         return DE430_ERROR_MEMORY_ALLOCATION;
     }
 
-    // Read each object
-    for (int i = 0; i < header.object_count; i++) {
-        // Initialize object fields
-        (*result)[i].points = NULL;
+    if (header.version == DE430_BINARY_VERSION_2) {
+        // Directory first, then each object's records in file order
+        DE430BinaryDirectoryEntry *entries = NULL;
+        status = de430_binary_read_directory(&reader, &header, &entries);
 
-        // Read object header
-        DE430BinaryObjectHeader obj_header;
-        if (fread(&obj_header, sizeof(obj_header), 1, fp) != 1) {
-            // Clean up on failure
-            for (int j = 0; j < i; j++) {
-                free((*result)[j].points);
-            }
-            free(*result);
-            *result = NULL;
-            fclose(fp);
-            return DE430_ERROR_PARSE_FAILED;
+        for (uint32_t i = 0; i < header.object_count && status == DE430_ERROR_NONE; i++) {
+            status = de430_binary_load_entry(&reader, &entries[i], &(*result)[i]);
         }
 
-        // Read object name
-        if (obj_header.name_length > sizeof((*result)[i].object_name)) {
-            // Clean up on failure
-            for (int j = 0; j < i; j++) {
-                free((*result)[j].points);
+        de430_free(entries);
+    } else {
+        // Read each object
+        for (uint32_t i = 0; i < header.object_count && status == DE430_ERROR_NONE; i++) {
+            DE430EphemerisData *obj = &(*result)[i];
+
+            // Read object header
+            DE430BinaryObjectHeader obj_header;
+            status = de430_binary_reader_take(&reader, &obj_header, sizeof(obj_header));
+            if (status != DE430_ERROR_NONE) break;
+
+            // Read object name
+            if (obj_header.name_length > sizeof(obj->object_name)) {
+                status = DE430_ERROR_PARSE_FAILED;
+                break;
             }
-            free(*result);
-            *result = NULL;
-            fclose(fp);
-            return DE430_ERROR_PARSE_FAILED;
-        }
+            status = de430_binary_reader_take(&reader, obj->object_name, obj_header.name_length);
+            if (status != DE430_ERROR_NONE) break;
+            obj->object_name[sizeof(obj->object_name) - 1] = '\0';
 
-        if (fread((*result)[i].object_name, 1, obj_header.name_length, fp) != obj_header.name_length) {
-            // Clean up on failure
-            for (int j = 0; j < i; j++) {
-                free((*result)[j].points);
+            // Allocate memory for points
+            obj->points = de430_malloc(obj_header.point_count > 0 ?
+                                 obj_header.point_count * sizeof(DE430EphemerisPoint) : 1);
+            if (!obj->points) {
+                status = DE430_ERROR_MEMORY_ALLOCATION;
+                break;
             }
-            free(*result);
-            *result = NULL;
-            fclose(fp);
-            return DE430_ERROR_PARSE_FAILED;
+            obj->count = obj_header.point_count;
+
+            // Decode each data point
+            status = de430_binary_decode_points_v1(&reader, obj->points, obj_header.point_count);
         }
+    }
+
+    de430_binary_reader_close(&reader);
+
+    if (status != DE430_ERROR_NONE) {
+        // Clean up on failure
+        de430_free_data(*result, header.object_count);
+        *result = NULL;
+        return status;
+    }
+
+    *count = header.object_count;
+    return DE430_ERROR_NONE;
+}
+
+// Decode the records of one object, keeping only the points that pass the filter
+static int binary_decode_filtered(DE430BinaryReader *reader, const DE430BinaryDirectoryEntry *entry,
+                                  const DE430Filter *filter, DE430EphemerisData *obj) {
+    int capacity = 0;
 
-        // Allocate memory for points
-        (*result)[i].count = obj_header.point_count;
-        (*result)[i].points = malloc(obj_header.point_count * sizeof(DE430EphemerisPoint));
+    for (uint32_t j = 0; j < entry->point_count; j++) {
+        DE430EphemerisPoint point;
+        int status = entry->record_size == 0
+                     ? de430_binary_decode_points_v1(reader, &point, 1)
+                     : de430_binary_reader_take(reader, &point, sizeof(point));
+        if (status != DE430_ERROR_NONE) {
+            return status;
+        }
+        de430_binary_terminate_points(&point, 1);
 
-        if (!(*result)[i].points) {
-            // Clean up on failure
-            for (int j = 0; j < i; j++) {
-                free((*result)[j].points);
+        if (de430_filter_match_point(filter, &point)) {
+            status = de430_data_append(obj, &capacity, &point);
+            if (status != DE430_ERROR_NONE) {
+                return status;
             }
-            free(*result);
-            *result = NULL;
-            fclose(fp);
-            return DE430_ERROR_MEMORY_ALLOCATION;
         }
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+// Read only the blocks whose zone maps admit the filter, each with one
+// positioned read of exactly its records
+static int binary_decode_zones(int fd, const DE430BinaryDirectoryEntry *entry,
+                               const DE430Filter *filter, const uint64_t *mask, DE430EphemerisData *obj) {
+    DE430BinaryZoneMap *zones = de430_malloc(entry->zone_count * sizeof(DE430BinaryZoneMap));
+    DE430EphemerisPoint *block = de430_malloc(entry->zone_block_size * sizeof(DE430EphemerisPoint));
+    if (!zones || !block) {
+        de430_free(zones);
+        de430_free(block);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
 
-        // Read each data point
-        for (int j = 0; j < obj_header.point_count; j++) {
-            DE430EphemerisPoint *point = &((*result)[i].points[j]);
+    int status = de430_pread_all(fd, zones, entry->zone_count * sizeof(DE430BinaryZoneMap), entry->zone_offset);
+    int capacity = 0;
 
-            // Read fixed part of point
-            DE430BinaryPointHeader point_header;
-            if (fread(&point_header, sizeof(point_header), 1, fp) != 1) {
-                // Clean up on failure
-                for (int k = 0; k <= i; k++) {
-                    free((*result)[k].points);
-                }
-                free(*result);
-                *result = NULL;
-                fclose(fp);
-                return DE430_ERROR_PARSE_FAILED;
+    for (uint32_t b = 0; b < entry->zone_count && status == DE430_ERROR_NONE; b++) {
+        if (!de430_zone_map_may_match(&zones[b], filter, mask)) continue;
+
+        uint32_t first = b * entry->zone_block_size;
+        uint32_t n = entry->point_count - first < entry->zone_block_size
+                     ? entry->point_count - first : entry->zone_block_size;
+
+        status = de430_pread_all(fd, block, n * sizeof(DE430EphemerisPoint),
+                                 entry->offset + (uint64_t)first * sizeof(DE430EphemerisPoint));
+        if (status == DE430_ERROR_NONE) {
+            de430_binary_terminate_points(block, n);
+        }
+
+        for (uint32_t j = 0; j < n && status == DE430_ERROR_NONE; j++) {
+            if (de430_filter_match_point(filter, &block[j])) {
+                status = de430_data_append(obj, &capacity, &block[j]);
             }
+        }
+    }
 
-            // Copy fixed data to point
-            point->jd = point_header.jd;
-            memcpy(point->position, point_header.position, sizeof(point->position));
-            memcpy(point->ra_dec, point_header.ra_dec, sizeof(point->ra_dec));
-            point->magnitude = point_header.magnitude;
-            point->phase = point_header.phase;
-            point->angular_size = point_header.angular_size;
-            point->physical_size = point_header.physical_size;
-            point->albedo = point_header.albedo;
-            point->sun_dist = point_header.sun_dist;
-            point->earth_dist = point_header.earth_dist;
-            point->sun_ang_dist = point_header.sun_ang_dist;
-            point->theta_edo = point_header.theta_edo;
-            memcpy(point->ecliptic, point_header.ecliptic, sizeof(point->ecliptic));
+    de430_free(zones);
+    de430_free(block);
+    return status;
+}
 
-            // Read constellation
-            if (point_header.constellation_length > sizeof(point->constellation)) {
-                // Clean up on failure
-                for (int k = 0; k <= i; k++) {
-                    free((*result)[k].points);
-                }
-                free(*result);
-                *result = NULL;
-                fclose(fp);
-                return DE430_ERROR_PARSE_FAILED;
+int de430_binary_load_entry_filtered(DE430BinaryReader *reader, const DE430BinaryDirectoryEntry *entry,
+                                     const DE430Filter *filter, const uint64_t *mask, DE430EphemerisData *object) {
+    memset(object, 0, sizeof(DE430EphemerisData));
+    strncpy(object->object_name, entry->name, sizeof(object->object_name) - 1);
+
+    if (entry->zone_count > 0) {
+        return binary_decode_zones(reader->fd, entry, filter, mask, object);
+    }
+
+    int status = de430_binary_reader_seek(reader, entry->offset);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    return binary_decode_filtered(reader, entry, filter, object);
+}
+
+int de430_load_from_binary_filtered(const char *filename, const DE430Filter *filter,
+                                    DE430EphemerisData **result, int *count) {
+    if (!filename || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430BinaryReader reader;
+    int status = de430_binary_reader_open(&reader, filename);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    DE430BinaryHeader header;
+    DE430BinaryDirectoryEntry *entries = NULL;
+    DE430ZoneDictionary dictionary;
+    uint64_t mask[2];
+    int use_mask = 0;
+
+    status = de430_binary_read_header(&reader, &header);
+    if (status == DE430_ERROR_NONE && header.version == DE430_BINARY_VERSION_2) {
+        status = de430_binary_read_directory(&reader, &header, &entries);
+        if (status == DE430_ERROR_NONE) {
+            status = de430_zone_dictionary_read(reader.fd, &header, &dictionary);
+            use_mask = status == DE430_ERROR_NONE && de430_zone_filter_mask(&dictionary, filter, mask);
+        }
+    }
+    if (status != DE430_ERROR_NONE) {
+        de430_binary_reader_close(&reader);
+        return status;
+    }
+
+    *result = de430_calloc(header.object_count > 0 ? header.object_count : 1, sizeof(DE430EphemerisData));
+    if (!*result) {
+        de430_free(entries);
+        de430_binary_reader_close(&reader);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int selected = 0;
+    for (uint32_t i = 0; i < header.object_count && status == DE430_ERROR_NONE; i++) {
+        DE430BinaryDirectoryEntry inline_entry;
+        const DE430BinaryDirectoryEntry *entry = entries ? &entries[i] : &inline_entry;
+
+        if (!entries) {
+            // Version 1: object headers are inline, so unselected records are stepped over
+            DE430BinaryObjectHeader obj_header;
+            status = de430_binary_reader_take(&reader, &obj_header, sizeof(obj_header));
+            if (status != DE430_ERROR_NONE) break;
+
+            memset(&inline_entry, 0, sizeof(inline_entry));
+            if (obj_header.name_length > sizeof(inline_entry.name)) {
+                status = DE430_ERROR_PARSE_FAILED;
+                break;
             }
+            status = de430_binary_reader_take(&reader, inline_entry.name, obj_header.name_length);
+            if (status != DE430_ERROR_NONE) break;
+            inline_entry.name[sizeof(inline_entry.name) - 1] = '\0';
+            inline_entry.offset = de430_binary_reader_tell(&reader);
+            inline_entry.point_count = obj_header.point_count;
 
-            if (fread(point->constellation, 1, point_header.constellation_length, fp) !=
-                point_header.constellation_length) {
-                // Clean up on failure
-                for (int k = 0; k <= i; k++) {
-                    free((*result)[k].points);
-                }
-                free(*result);
-                *result = NULL;
-                fclose(fp);
-                return DE430_ERROR_PARSE_FAILED;
+            if (!de430_filter_match_object(filter, inline_entry.name)) {
+                status = de430_binary_decode_points_v1(&reader, NULL, obj_header.point_count);
+                continue;
             }
+        } else if (!de430_filter_match_object(filter, entry->name)) {
+            // Version 2: unselected objects are never read
+            continue;
         }
+
+        status = de430_binary_load_entry_filtered(&reader, entry, filter, use_mask ? mask : NULL,
+                                                  &(*result)[selected++]);
     }
 
-    fclose(fp);
+    de430_free(entries);
+    de430_binary_reader_close(&reader);
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free_data(*result, header.object_count);
+        *result = NULL;
+        return status;
+    }
+
+    *count = selected;
+    return DE430_ERROR_NONE;
+}
+
+// Streaming binary writer state. Points are spooled per object and the
+// file is assembled on end, once every object's point count is known.
+typedef struct {
+    FILE *fp;
+    DE430Spool spool;
+    char (*names)[64];
+    uint32_t *counts;
+    int object_count;
+} BinarySinkState;
+
+static int binary_sink_begin(void *context, const char *const *object_names, int object_count) {
+    BinarySinkState *state = (BinarySinkState*)context;
+    if (object_count <= 0 || state->names) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    state->names = de430_calloc(object_count, sizeof(*state->names));
+    state->counts = de430_calloc(object_count, sizeof(*state->counts));
+    if (!state->names || !state->counts) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (int i = 0; i < object_count; i++) {
+        strncpy(state->names[i], object_names[i], sizeof(state->names[i]) - 1);
+    }
+    state->object_count = object_count;
+
+    return de430_spool_open(&state->spool, object_count);
+}
+
+static int binary_sink_write(void *context, int object_index, const DE430EphemerisPoint *points, int count) {
+    BinarySinkState *state = (BinarySinkState*)context;
+    if (object_index < 0 || object_index >= state->object_count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    FILE *fp = state->spool.files[object_index];
+    for (int j = 0; j < count; j++) {
+        if (binary_write_point(fp, &points[j]) != DE430_ERROR_NONE) {
+            return DE430_ERROR_FILE_IO;
+        }
+    }
+
+    state->counts[object_index] += count;
+    return DE430_ERROR_NONE;
+}
+
+static int binary_sink_end(void *context) {
+    BinarySinkState *state = (BinarySinkState*)context;
+
+    // Write file header
+    DE430BinaryHeader header;
+    memcpy(header.magic, DE430_BINARY_MAGIC, 4);
+    header.version = DE430_BINARY_VERSION_1;
+    header.object_count = state->object_count;
+    header.flags = 0;
+
+    if (fwrite(&header, sizeof(header), 1, state->fp) != 1) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    // Write each object header followed by its spooled points
+    for (int i = 0; i < state->object_count; i++) {
+        DE430BinaryObjectHeader obj_header;
+        obj_header.name_length = strlen(state->names[i]) + 1; // Include null terminator
+        obj_header.point_count = state->counts[i];
+
+        if (fwrite(&obj_header, sizeof(obj_header), 1, state->fp) != 1 ||
+            fwrite(state->names[i], 1, obj_header.name_length, state->fp) != obj_header.name_length) {
+            return DE430_ERROR_FILE_IO;
+        }
+
+        int status = de430_spool_copy(&state->spool, i, state->fp);
+        if (status != DE430_ERROR_NONE) {
+            return status;
+        }
+    }
+
+    int status = fclose(state->fp) == 0 ? DE430_ERROR_NONE : DE430_ERROR_FILE_IO;
+    state->fp = NULL;
+    return status;
+}
+
+static void binary_sink_destroy(void *context) {
+    BinarySinkState *state = (BinarySinkState*)context;
+    if (!state) return;
+
+    if (state->fp) fclose(state->fp);
+    de430_spool_close(&state->spool);
+    de430_free(state->names);
+    de430_free(state->counts);
+    de430_free(state);
+}
+
+/**
+ * Open a streaming sink that writes the binary format
+ *
+ * @param filename Name of the file to write
+ * @param sink Sink to initialize (must be released with de430_sink_close)
+ * @return 0 on success, error code on failure
+ */
+int de430_sink_open_binary(const char *filename, DE430Sink *sink) {
+    if (!filename || !sink) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    BinarySinkState *state = de430_calloc(1, sizeof(BinarySinkState));
+    if (!state) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    state->fp = fopen(filename, "wb");
+    if (!state->fp) {
+        de430_free(state);
+        return DE430_ERROR_FILE_IO;
+    }
+
+    sink->begin = binary_sink_begin;
+    sink->write = binary_sink_write;
+    sink->end = binary_sink_end;
+    sink->destroy = binary_sink_destroy;
+    sink->context = state;
 
-    *count = header.object_count;
     return DE430_ERROR_NONE;
 }
\ No newline at end of file
@@ -0,0 +1,426 @@
+//
+// Conjunction finder: closest approaches on the sky of every pair of
+// objects sampled on a shared time grid.
+//
+// The grid is cut into blocks searched in parallel. In each block, every
+// object gets its declination range and a bounding cap of its directions,
+// both widened by the largest step it makes between samples so that the
+// interpolated track stays inside them. A sweep over declination, then a
+// cap test, leaves only pairs that may come close. Their sampled
+// separations are scanned for minima, which are then refined on quadratic
+// interpolations of the two tracks.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONJUNCTION_DEFAULT_SEPARATION (M_PI / 180.0)
+#define CONJUNCTION_BISECTIONS 60
+#define CONJUNCTION_INITIAL_EVENTS 16
+
+typedef struct {
+    const DE430EphemerisData *data;
+    int count;
+    int points;                 // Samples per object
+    int block_points;
+    double max_separation;
+
+    DE430Conjunction **block_events;    // Events found in each block
+    int *block_counts;
+} ConjunctionSearch;
+
+// Per-object bounds within one block
+typedef struct {
+    double dec_min;
+    double dec_max;
+    double centre[3];           // Cap centre
+    double radius;              // Cap radius
+    double margin;              // Largest step between samples
+} ConjunctionBounds;
+
+typedef struct {
+    double lo;                  // Lowest declination the track may reach
+    int object;
+} ConjunctionSweep;
+
+static double conjunction_angle(const double a[3], const double b[3]) {
+    double cx = a[1] * b[2] - a[2] * b[1];
+    double cy = a[2] * b[0] - a[0] * b[2];
+    double cz = a[0] * b[1] - a[1] * b[0];
+    double dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    return atan2(sqrt(cx * cx + cy * cy + cz * cz), dot);
+}
+
+// Squared chord between two tracks, sample by sample. Plain arrays so the
+// compiler can vectorize the loop.
+static void conjunction_chord2(const double *restrict ax, const double *restrict ay, const double *restrict az,
+                               const double *restrict bx, const double *restrict by, const double *restrict bz,
+                               int n, double *restrict out) {
+    for (int k = 0; k < n; k++) {
+        double dx = ax[k] - bx[k];
+        double dy = ay[k] - by[k];
+        double dz = az[k] - bz[k];
+        out[k] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+static void conjunction_bounds(const double *x, const double *y, const double *z, int n, ConjunctionBounds *bounds) {
+    double sum[3] = {0.0, 0.0, 0.0};
+    bounds->dec_min = INFINITY;
+    bounds->dec_max = -INFINITY;
+    bounds->margin = 0.0;
+
+    double previous[3] = {NAN, NAN, NAN};
+    for (int k = 0; k < n; k++) {
+        double v[3] = {x[k], y[k], z[k]};
+        if (!isfinite(v[0])) continue;
+
+        double dec = asin(fmax(-1.0, fmin(1.0, v[2])));
+        if (dec < bounds->dec_min) bounds->dec_min = dec;
+        if (dec > bounds->dec_max) bounds->dec_max = dec;
+        sum[0] += v[0];
+        sum[1] += v[1];
+        sum[2] += v[2];
+
+        if (isfinite(previous[0])) {
+            double step = conjunction_angle(previous, v);
+            if (step > bounds->margin) bounds->margin = step;
+        }
+        memcpy(previous, v, sizeof(previous));
+    }
+
+    double norm = sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+    bounds->radius = 0.0;
+    if (norm == 0.0) {
+        // No samples, or directions that cancel out: the cap is the whole sky
+        bounds->centre[0] = 1.0;
+        bounds->centre[1] = bounds->centre[2] = 0.0;
+        bounds->radius = M_PI;
+        return;
+    }
+    for (int d = 0; d < 3; d++) {
+        bounds->centre[d] = sum[d] / norm;
+    }
+    for (int k = 0; k < n; k++) {
+        double v[3] = {x[k], y[k], z[k]};
+        if (!isfinite(v[0])) continue;
+        double angle = conjunction_angle(bounds->centre, v);
+        if (angle > bounds->radius) bounds->radius = angle;
+    }
+}
+
+static int conjunction_compare_sweep(const void *a, const void *b) {
+    double la = ((const ConjunctionSweep*)a)->lo;
+    double lb = ((const ConjunctionSweep*)b)->lo;
+    return (la > lb) - (la < lb);
+}
+
+// Quadratic through the samples before, at and after a sampled minimum,
+// in days from the middle sample
+typedef struct {
+    double tau[3];
+    double a[3][3];             // Direction samples of the first object
+    double b[3][3];             // Direction samples of the second object
+} ConjunctionTrack;
+
+static void conjunction_basis(const ConjunctionTrack *track, double t, double basis[3], double derivative[3]) {
+    for (int k = 0; k < 3; k++) {
+        int i = (k + 1) % 3, j = (k + 2) % 3;
+        double denominator = (track->tau[k] - track->tau[i]) * (track->tau[k] - track->tau[j]);
+        basis[k] = (t - track->tau[i]) * (t - track->tau[j]) / denominator;
+        derivative[k] = ((t - track->tau[i]) + (t - track->tau[j])) / denominator;
+    }
+}
+
+// Half the derivative of the squared distance between the interpolated tracks
+static double conjunction_slope(const ConjunctionTrack *track, double t) {
+    double basis[3], derivative[3];
+    conjunction_basis(track, t, basis, derivative);
+
+    double slope = 0.0;
+    for (int d = 0; d < 3; d++) {
+        double w = 0.0, dw = 0.0;
+        for (int k = 0; k < 3; k++) {
+            double diff = track->a[k][d] - track->b[k][d];
+            w += basis[k] * diff;
+            dw += derivative[k] * diff;
+        }
+        slope += w * dw;
+    }
+    return slope;
+}
+
+// Find where the separation stops falling by bisecting its derivative,
+// then measure it between the normalized interpolated directions
+static void conjunction_refine(const ConjunctionTrack *track, double *t_min, double *separation) {
+    double lo = 0.0, hi = 0.0;
+    double slope = conjunction_slope(track, 0.0);
+    if (slope > 0.0 && conjunction_slope(track, track->tau[0]) < 0.0) {
+        lo = track->tau[0];
+    } else if (slope < 0.0 && conjunction_slope(track, track->tau[2]) > 0.0) {
+        hi = track->tau[2];
+    }
+
+    for (int i = 0; i < CONJUNCTION_BISECTIONS && hi - lo > 1e-10; i++) {
+        double mid = 0.5 * (lo + hi);
+        if (conjunction_slope(track, mid) < 0.0) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    double t = 0.5 * (lo + hi);
+
+    double basis[3], derivative[3];
+    conjunction_basis(track, t, basis, derivative);
+    double a[3] = {0.0, 0.0, 0.0}, b[3] = {0.0, 0.0, 0.0};
+    for (int d = 0; d < 3; d++) {
+        for (int k = 0; k < 3; k++) {
+            a[d] += basis[k] * track->a[k][d];
+            b[d] += basis[k] * track->b[k][d];
+        }
+    }
+
+    *t_min = t;
+    *separation = conjunction_angle(a, b);
+}
+
+static int conjunction_add(ConjunctionSearch *search, int block, int *capacity, const DE430Conjunction *event) {
+    if (search->block_counts[block] == *capacity) {
+        int grown = *capacity ? *capacity * 2 : CONJUNCTION_INITIAL_EVENTS;
+        DE430Conjunction *events = de430_realloc(search->block_events[block], (size_t)grown * sizeof(DE430Conjunction));
+        if (!events) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        search->block_events[block] = events;
+        *capacity = grown;
+    }
+    search->block_events[block][search->block_counts[block]++] = *event;
+    return DE430_ERROR_NONE;
+}
+
+static int conjunction_block_task(void *context, int block) {
+    ConjunctionSearch *search = (ConjunctionSearch*)context;
+    const int count = search->count;
+
+    // Minima are looked for at the block's own samples, away from the ends
+    // of the grid, with one neighbour on each side
+    int first = block * search->block_points;
+    int last = first + search->block_points < search->points ? first + search->block_points : search->points;
+    if (first < 1) first = 1;
+    if (last > search->points - 1) last = search->points - 1;
+    if (first >= last) {
+        return DE430_ERROR_NONE;
+    }
+    int start = first - 1;
+    int n = last - first + 2;
+
+    double *vectors = de430_malloc((size_t)count * 3 * (size_t)n * sizeof(double));
+    double *chord2 = de430_malloc((size_t)n * sizeof(double));
+    ConjunctionBounds *bounds = de430_malloc((size_t)count * sizeof(ConjunctionBounds));
+    ConjunctionSweep *sweep = de430_malloc((size_t)count * sizeof(ConjunctionSweep));
+    int status = DE430_ERROR_NONE;
+    if (!vectors || !chord2 || !bounds || !sweep) {
+        status = DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    // Directions as x, y and z arrays per object
+    double max_margin = 0.0;
+    for (int i = 0; status == DE430_ERROR_NONE && i < count; i++) {
+        double *x = vectors + (size_t)i * 3 * n;
+        double *y = x + n;
+        double *z = y + n;
+        for (int k = 0; k < n; k++) {
+            const DE430EphemerisPoint *point = &search->data[i].points[start + k];
+            double ra = point->ra_dec[0], dec = point->ra_dec[1];
+            if (isfinite(ra) && isfinite(dec)) {
+                x[k] = cos(dec) * cos(ra);
+                y[k] = cos(dec) * sin(ra);
+                z[k] = sin(dec);
+            } else {
+                x[k] = y[k] = z[k] = NAN;
+            }
+        }
+        conjunction_bounds(x, y, z, n, &bounds[i]);
+        if (bounds[i].margin > max_margin) max_margin = bounds[i].margin;
+
+        sweep[i].lo = bounds[i].dec_min - bounds[i].margin;
+        sweep[i].object = i;
+    }
+    if (status == DE430_ERROR_NONE) {
+        qsort(sweep, (size_t)count, sizeof(ConjunctionSweep), conjunction_compare_sweep);
+    }
+
+    const double limit = search->max_separation;
+    int capacity = 0;
+
+    for (int s = 0; status == DE430_ERROR_NONE && s < count; s++) {
+        const ConjunctionBounds *bounds_a = &bounds[sweep[s].object];
+        double reach = bounds_a->dec_max + bounds_a->margin + max_margin + limit;
+
+        for (int t = s + 1; status == DE430_ERROR_NONE && t < count && sweep[t].lo <= reach; t++) {
+            int a = sweep[s].object < sweep[t].object ? sweep[s].object : sweep[t].object;
+            int b = sweep[s].object < sweep[t].object ? sweep[t].object : sweep[s].object;
+            const ConjunctionBounds *ba = &bounds[a];
+            const ConjunctionBounds *bb = &bounds[b];
+
+            // Declination ranges and caps both bound the separation from below
+            double margin = ba->margin + bb->margin;
+            if (bb->dec_min - ba->dec_max > limit + margin || ba->dec_min - bb->dec_max > limit + margin) continue;
+            if (conjunction_angle(ba->centre, bb->centre) - ba->radius - bb->radius > limit + margin) continue;
+
+            const double *ax = vectors + (size_t)a * 3 * n;
+            const double *bx = vectors + (size_t)b * 3 * n;
+            conjunction_chord2(ax, ax + n, ax + 2 * n, bx, bx + n, bx + 2 * n, n, chord2);
+
+            for (int k = 1; k < n - 1 && status == DE430_ERROR_NONE; k++) {
+                if (!(chord2[k] <= chord2[k - 1] && chord2[k] < chord2[k + 1])) continue;
+
+                // Interpolation cannot bring samples this far apart under the limit
+                double sampled = 2.0 * asin(fmin(sqrt(chord2[k]) / 2.0, 1.0));
+                if (sampled - margin > limit) continue;
+
+                const DE430EphemerisPoint *points = search->data[0].points;
+                double jd = points[start + k].jd;
+                ConjunctionTrack track;
+                for (int j = 0; j < 3; j++) {
+                    track.tau[j] = points[start + k - 1 + j].jd - jd;
+                    for (int d = 0; d < 3; d++) {
+                        track.a[j][d] = ax[(size_t)d * n + k - 1 + j];
+                        track.b[j][d] = bx[(size_t)d * n + k - 1 + j];
+                    }
+                }
+
+                double t, separation;
+                conjunction_refine(&track, &t, &separation);
+                if (separation <= limit) {
+                    DE430Conjunction event = {a, b, jd + t, separation};
+                    status = conjunction_add(search, block, &capacity, &event);
+                }
+            }
+        }
+    }
+
+    de430_free(vectors);
+    de430_free(chord2);
+    de430_free(bounds);
+    de430_free(sweep);
+    return status;
+}
+
+static int conjunction_compare_events(const void *a, const void *b) {
+    const DE430Conjunction *ea = (const DE430Conjunction*)a;
+    const DE430Conjunction *eb = (const DE430Conjunction*)b;
+    if (ea->jd != eb->jd) return ea->jd < eb->jd ? -1 : 1;
+    if (ea->object_a != eb->object_a) return ea->object_a < eb->object_a ? -1 : 1;
+    return (ea->object_b > eb->object_b) - (ea->object_b < eb->object_b);
+}
+
+void de430_init_conjunction_options(DE430ConjunctionOptions *options) {
+    if (!options) return;
+
+    memset(options, 0, sizeof(DE430ConjunctionOptions));
+    options->max_separation = CONJUNCTION_DEFAULT_SEPARATION;
+    options->block_points = DE430_CONJUNCTION_BLOCK_POINTS;
+    options->threads = 0;
+}
+
+int de430_find_conjunctions(const DE430EphemerisData *data, int count, const DE430ConjunctionOptions *options,
+                            DE430Conjunction **events, int *event_count) {
+    if ((!data && count > 0) || count < 0 || !events || !event_count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430ConjunctionOptions defaults;
+    if (!options) {
+        de430_init_conjunction_options(&defaults);
+        options = &defaults;
+    }
+    if (options->block_points <= 0 || !(options->max_separation >= 0.0)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    *events = NULL;
+    *event_count = 0;
+    if (count < 2 || data[0].count < 3) {
+        return DE430_ERROR_NONE;
+    }
+
+    // Every object must be sampled at the same, increasing dates
+    const int points = data[0].count;
+    for (int k = 1; k < points; k++) {
+        if (!(data[0].points[k].jd > data[0].points[k - 1].jd)) {
+            return DE430_ERROR_INVALID_CONFIG;
+        }
+    }
+    for (int i = 1; i < count; i++) {
+        if (data[i].count != points) {
+            return DE430_ERROR_INVALID_CONFIG;
+        }
+        for (int k = 0; k < points; k++) {
+            if (fabs(data[i].points[k].jd - data[0].points[k].jd) > 1e-7) {
+                return DE430_ERROR_INVALID_CONFIG;
+            }
+        }
+    }
+
+    ConjunctionSearch search;
+    search.data = data;
+    search.count = count;
+    search.points = points;
+    search.block_points = options->block_points;
+    search.max_separation = options->max_separation;
+
+    int block_count = (points + options->block_points - 1) / options->block_points;
+    search.block_events = de430_calloc((size_t)block_count, sizeof(DE430Conjunction*));
+    search.block_counts = de430_calloc((size_t)block_count, sizeof(int));
+    int status = DE430_ERROR_NONE;
+    if (!search.block_events || !search.block_counts) {
+        status = DE430_ERROR_MEMORY_ALLOCATION;
+    } else {
+        status = de430_parallel_for(block_count, options->threads, conjunction_block_task, &search);
+    }
+
+    // Gather the blocks' events into one list ordered by date
+    int total = 0;
+    for (int b = 0; status == DE430_ERROR_NONE && b < block_count; b++) {
+        total += search.block_counts[b];
+    }
+    DE430Conjunction *all = NULL;
+    if (status == DE430_ERROR_NONE && total > 0) {
+        all = de430_malloc((size_t)total * sizeof(DE430Conjunction));
+        if (!all) {
+            status = DE430_ERROR_MEMORY_ALLOCATION;
+        } else {
+            int offset = 0;
+            for (int b = 0; b < block_count; b++) {
+                if (search.block_counts[b] == 0) continue;
+                memcpy(all + offset, search.block_events[b], (size_t)search.block_counts[b] * sizeof(DE430Conjunction));
+                offset += search.block_counts[b];
+            }
+            qsort(all, (size_t)total, sizeof(DE430Conjunction), conjunction_compare_events);
+        }
+    }
+
+    for (int b = 0; search.block_events && b < block_count; b++) {
+        de430_free(search.block_events[b]);
+    }
+    de430_free(search.block_events);
+    de430_free(search.block_counts);
+
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    *events = all;
+    *event_count = total;
+    return DE430_ERROR_NONE;
+}
+
+void de430_conjunctions_free(DE430Conjunction *events) {
+    de430_free(events);
+}
@@ -12,11 +12,53 @@
  */
 
 #include "de430_parser.h"
+#include "de430_internal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+// Write one CSV row for a point of the named object
+static void csv_write_point(FILE *fp, const char *object_name, const DE430EphemerisPoint *point) {
+    // Format object name, replacing commas with spaces
+    char safe_name[65];
+    strncpy(safe_name, object_name, 64);
+    safe_name[64] = '\0';
+
+    for (char *p = safe_name; *p; p++) {
+        if (*p == ',') *p = ' ';
+    }
+
+    // Format constellation, replacing commas with spaces
+    char safe_const[33];
+    strncpy(safe_const, point->constellation, 32);
+    safe_const[32] = '\0';
+
+    for (char *p = safe_const; *p; p++) {
+        if (*p == ',') *p = ' ';
+    }
+
+    // Write the data point
+    fprintf(fp, "%s,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,",
+           safe_name, point->jd,
+           point->position[0], point->position[1], point->position[2],
+           point->ra_dec[0], point->ra_dec[1],
+           point->magnitude, point->phase, point->angular_size);
+
+    fprintf(fp, "%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%s\n",
+           point->physical_size, point->albedo,
+           point->sun_dist, point->earth_dist, point->sun_ang_dist, point->theta_edo,
+           point->ecliptic[0], point->ecliptic[1], point->ecliptic[2],
+           safe_const);
+}
+
+// Write the CSV column header line
+static void csv_write_header(FILE *fp) {
+    fprintf(fp, "object_name,jd,pos_x,pos_y,pos_z,ra,dec,magnitude,phase,angular_size,");
+    fprintf(fp, "physical_size,albedo,sun_dist,earth_dist,sun_ang_dist,theta_edo,");
+    fprintf(fp, "ecliptic_lng,ecliptic_dist,ecliptic_lat,constellation\n");
+}
+
 int de430_save_to_csv(const DE430EphemerisData *data, int count, const char *filename) {
     if (!data || count <= 0 || !filename) {
         return DE430_ERROR_INVALID_CONFIG;
@@ -29,9 +71,7 @@ int de430_save_to_csv(const DE430EphemerisData *data, int count, const char *fil
     }
 
     // Write the header
-    fprintf(fp, "object_name,jd,pos_x,pos_y,pos_z,ra,dec,magnitude,phase,angular_size,");
-    fprintf(fp, "physical_size,albedo,sun_dist,earth_dist,sun_ang_dist,theta_edo,");
-    fprintf(fp, "ecliptic_lng,ecliptic_dist,ecliptic_lat,constellation\n");
+    csv_write_header(fp);
 
     // Write each data point
     for (int i = 0; i < count; i++) {
@@ -40,41 +80,97 @@ int de430_save_to_csv(const DE430EphemerisData *data, int count, const char *fil
         for (int j = 0; j < obj->count; j++) {
             const DE430EphemerisPoint *point = &obj->points[j];
 
-            // Format object name, replacing commas with spaces
-            char safe_name[65];
-            strncpy(safe_name, obj->object_name, 64);
-            safe_name[64] = '\0';
+            csv_write_point(fp, obj->object_name, point);
+        }
+    }
 
-            for (char *p = safe_name; *p; p++) {
-                if (*p == ',') *p = ' ';
-            }
+    fclose(fp);
+    return DE430_ERROR_NONE;
+}
 
-            // Format constellation, replacing commas with spaces
-            char safe_const[33];
-            strncpy(safe_const, point->constellation, 32);
-            safe_const[32] = '\0';
+int de430_csv_parse_row(char *line, char *object_name, DE430EphemerisPoint *point) {
+    char *token;
+    char *saveptr = NULL;
 
-            for (char *p = safe_const; *p; p++) {
-                if (*p == ',') *p = ' ';
-            }
+    // Get object name
+    token = strtok_r(line, ",", &saveptr);
+    if (!token) {
+        return -1;
+    }
 
-            // Write the data point
-            fprintf(fp, "%s,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,",
-                   safe_name, point->jd,
-                   point->position[0], point->position[1], point->position[2],
-                   point->ra_dec[0], point->ra_dec[1],
-                   point->magnitude, point->phase, point->angular_size);
-
-            fprintf(fp, "%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%.15f,%s\n",
-                   point->physical_size, point->albedo,
-                   point->sun_dist, point->earth_dist, point->sun_ang_dist, point->theta_edo,
-                   point->ecliptic[0], point->ecliptic[1], point->ecliptic[2],
-                   safe_const);
-        }
+    strncpy(object_name, token, 63);
+    object_name[63] = '\0';
+
+    // Clear the point
+    memset(point, 0, sizeof(DE430EphemerisPoint));
+
+    // Parse remaining fields
+    // JD
+    token = strtok_r(NULL, ",", &saveptr);
+    if (token) point->jd = atof(token);
+
+    // Position
+    for (int i = 0; i < 3; i++) {
+        token = strtok_r(NULL, ",", &saveptr);
+        if (token) point->position[i] = atof(token);
     }
 
-    fclose(fp);
-    return DE430_ERROR_NONE;
+    // RA/Dec
+    for (int i = 0; i < 2; i++) {
+        token = strtok_r(NULL, ",", &saveptr);
+        if (token) point->ra_dec[i] = atof(token);
+    }
+
+    // Magnitude
+    token = strtok_r(NULL, ",", &saveptr);
+    if (token) point->magnitude = atof(token);
+
+    // Phase
+    token = strtok_r(NULL, ",", &saveptr);
+    if (token) point->phase = atof(token);
+
+    // Angular size
+    token = strtok_r(NULL, ",", &saveptr);
+    if (token) point->angular_size = atof(token);
+
+    // Physical size
+    token = strtok_r(NULL, ",", &saveptr);
+    if (token) point->physical_size = atof(token);
+
+    // Albedo
+    token = strtok_r(NULL, ",", &saveptr);
+    if (token) point->albedo = atof(token);
+
+    // Sun distance
+    token = strtok_r(NULL, ",", &saveptr);
+    if (token) point->sun_dist = atof(token);
+
+    // Earth distance
+    token = strtok_r(NULL, ",", &saveptr);
+    if (token) point->earth_dist = atof(token);
+
+    // Sun angular distance
+    token = strtok_r(NULL, ",", &saveptr);
+    if (token) point->sun_ang_dist = atof(token);
+
+    // Theta EDO
+    token = strtok_r(NULL, ",", &saveptr);
+    if (token) point->theta_edo = atof(token);
+
+    // Ecliptic
+    for (int i = 0; i < 3; i++) {
+        token = strtok_r(NULL, ",", &saveptr);
+        if (token) point->ecliptic[i] = atof(token);
+    }
+
+    // Constellation (last field)
+    token = strtok_r(NULL, "\n", &saveptr);
+    if (token) {
+        strncpy(point->constellation, token, sizeof(point->constellation) - 1);
+        point->constellation[sizeof(point->constellation) - 1] = '\0';
+    }
+
+    return 0;
 }
 
 /**
@@ -135,7 +231,7 @@ int de430_load_from_csv(const char *filename, DE430EphemerisData **result, int *
 
         if (!found) {
             // Add a new object
-            objects = realloc(objects, (object_count + 1) * sizeof(*objects));
+            objects = de430_realloc(objects, (object_count + 1) * sizeof(*objects));
             if (!objects) {
                 fclose(fp);
                 return DE430_ERROR_MEMORY_ALLOCATION;
@@ -150,9 +246,9 @@ int de430_load_from_csv(const char *filename, DE430EphemerisData **result, int *
     }
 
     // Allocate result array
-    *result = malloc(object_count * sizeof(DE430EphemerisData));
+    *result = de430_malloc(object_count * sizeof(DE430EphemerisData));
     if (!*result) {
-        free(objects);
+        de430_free(objects);
         fclose(fp);
         return DE430_ERROR_MEMORY_ALLOCATION;
     }
@@ -161,16 +257,16 @@ int de430_load_from_csv(const char *filename, DE430EphemerisData **result, int *
     for (int i = 0; i < object_count; i++) {
         strcpy((*result)[i].object_name, objects[i].name);
         (*result)[i].count = objects[i].count;
-        (*result)[i].points = malloc(objects[i].count * sizeof(DE430EphemerisPoint));
+        (*result)[i].points = de430_malloc(objects[i].count * sizeof(DE430EphemerisPoint));
 
         if (!(*result)[i].points) {
             // Clean up on failure
             for (int j = 0; j < i; j++) {
-                free((*result)[j].points);
+                de430_free((*result)[j].points);
             }
-            free(*result);
+            de430_free(*result);
             *result = NULL;
-            free(objects);
+            de430_free(objects);
             fclose(fp);
             return DE430_ERROR_MEMORY_ALLOCATION;
         }
@@ -189,36 +285,13 @@ int de430_load_from_csv(const char *filename, DE430EphemerisData **result, int *
         // Skip empty lines
         if (line[0] == '\n' || line[0] == '\0') continue;
 
-        // Make a copy of the line to tokenize
-        char *line_copy = strdup(line);
-        if (!line_copy) {
-            // Clean up on failure
-            for (int i = 0; i < object_count; i++) {
-                free((*result)[i].points);
-            }
-            free(*result);
-            *result = NULL;
-            free(objects);
-            fclose(fp);
-            return DE430_ERROR_MEMORY_ALLOCATION;
-        }
-
-        // Tokenize the line
-        char *token;
-        char *saveptr = NULL;
-        int field = 0;
-
-        // Get object name
-        token = strtok_r(line_copy, ",", &saveptr);
-        if (!token) {
-            free(line_copy);
+        // Parse the row in place
+        char object_name[64];
+        DE430EphemerisPoint parsed;
+        if (de430_csv_parse_row(line, object_name, &parsed) != 0) {
             continue;
         }
 
-        char object_name[64];
-        strncpy(object_name, token, 63);
-        object_name[63] = '\0';
-
         // Find the object index
         int obj_idx = -1;
         for (int i = 0; i < object_count; i++) {
@@ -230,89 +303,205 @@ int de430_load_from_csv(const char *filename, DE430EphemerisData **result, int *
 
         if (obj_idx == -1) {
             // This shouldn't happen if the two passes are consistent
-            free(line_copy);
             continue;
         }
 
         // Get the point index for this object
         int point_idx = objects[obj_idx].count++;
-        DE430EphemerisPoint *point = &((*result)[obj_idx].points[point_idx]);
-
-        // Clear the point
-        memset(point, 0, sizeof(DE430EphemerisPoint));
+        (*result)[obj_idx].points[point_idx] = parsed;
+    }
 
-        // Parse remaining fields
-        // JD
-        token = strtok_r(NULL, ",", &saveptr);
-        if (token) point->jd = atof(token);
+    de430_free(objects);
+    fclose(fp);
 
-        // Position
-        for (int i = 0; i < 3; i++) {
-            token = strtok_r(NULL, ",", &saveptr);
-            if (token) point->position[i] = atof(token);
-        }
+    *count = object_count;
+    return DE430_ERROR_NONE;
+}
 
-        // RA/Dec
-        for (int i = 0; i < 2; i++) {
-            token = strtok_r(NULL, ",", &saveptr);
-            if (token) point->ra_dec[i] = atof(token);
-        }
+int de430_load_from_csv_filtered(const char *filename, const DE430Filter *filter,
+                                 DE430EphemerisData **result, int *count) {
+    if (!filename || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
 
-        // Magnitude
-        token = strtok_r(NULL, ",", &saveptr);
-        if (token) point->magnitude = atof(token);
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        return DE430_ERROR_FILE_IO;
+    }
 
-        // Phase
-        token = strtok_r(NULL, ",", &saveptr);
-        if (token) point->phase = atof(token);
+    // Read and skip the header
+    char line[LINE_BUFFER_SIZE];
+    if (!fgets(line, sizeof(line), fp)) {
+        fclose(fp);
+        return DE430_ERROR_PARSE_FAILED;
+    }
 
-        // Angular size
-        token = strtok_r(NULL, ",", &saveptr);
-        if (token) point->angular_size = atof(token);
+    // Single pass: objects are added as they appear and grow as points pass
+    DE430EphemerisData *objects = NULL;
+    int *capacities = NULL;
+    int object_count = 0;
+    int object_capacity = 0;
+    int current = -1;
+    int status = DE430_ERROR_NONE;
 
-        // Physical size
-        token = strtok_r(NULL, ",", &saveptr);
-        if (token) point->physical_size = atof(token);
+    while (status == DE430_ERROR_NONE && fgets(line, sizeof(line), fp)) {
+        // Skip empty lines
+        if (line[0] == '\n' || line[0] == '\0') continue;
 
-        // Albedo
-        token = strtok_r(NULL, ",", &saveptr);
-        if (token) point->albedo = atof(token);
+        // Check the object name before parsing the rest of the row
+        char object_name[64] = {0};
+        char *comma = strchr(line, ',');
+        if (!comma) continue;
 
-        // Sun distance
-        token = strtok_r(NULL, ",", &saveptr);
-        if (token) point->sun_dist = atof(token);
+        strncpy(object_name, line, comma - line < 63 ? comma - line : 63);
+        if (!de430_filter_match_object(filter, object_name)) continue;
 
-        // Earth distance
-        token = strtok_r(NULL, ",", &saveptr);
-        if (token) point->earth_dist = atof(token);
+        DE430EphemerisPoint point;
+        if (de430_csv_parse_row(line, object_name, &point) != 0) continue;
 
-        // Sun angular distance
-        token = strtok_r(NULL, ",", &saveptr);
-        if (token) point->sun_ang_dist = atof(token);
+        // Rows of one object are usually contiguous, so try the last one first
+        if (current < 0 || strcmp(objects[current].object_name, object_name) != 0) {
+            current = -1;
+            for (int i = 0; i < object_count; i++) {
+                if (strcmp(objects[i].object_name, object_name) == 0) {
+                    current = i;
+                    break;
+                }
+            }
+        }
 
-        // Theta EDO
-        token = strtok_r(NULL, ",", &saveptr);
-        if (token) point->theta_edo = atof(token);
+        if (current < 0) {
+            if (object_count == object_capacity) {
+                int new_capacity = object_capacity > 0 ? object_capacity * 2 : 16;
+                DE430EphemerisData *grown = de430_realloc(objects, new_capacity * sizeof(DE430EphemerisData));
+                if (grown) objects = grown;
+                int *grown_capacities = de430_realloc(capacities, new_capacity * sizeof(int));
+                if (grown_capacities) capacities = grown_capacities;
+                if (!grown || !grown_capacities) {
+                    status = DE430_ERROR_MEMORY_ALLOCATION;
+                    break;
+                }
+                object_capacity = new_capacity;
+            }
 
-        // Ecliptic
-        for (int i = 0; i < 3; i++) {
-            token = strtok_r(NULL, ",", &saveptr);
-            if (token) point->ecliptic[i] = atof(token);
+            current = object_count++;
+            memset(&objects[current], 0, sizeof(DE430EphemerisData));
+            strcpy(objects[current].object_name, object_name);
+            capacities[current] = 0;
         }
 
-        // Constellation (last field)
-        token = strtok_r(NULL, "\n", &saveptr);
-        if (token) {
-            strncpy(point->constellation, token, sizeof(point->constellation) - 1);
-            point->constellation[sizeof(point->constellation) - 1] = '\0';
+        if (de430_filter_match_point(filter, &point)) {
+            status = de430_data_append(&objects[current], &capacities[current], &point);
         }
-
-        free(line_copy);
     }
 
-    free(objects);
+    de430_free(capacities);
     fclose(fp);
 
+    if (status != DE430_ERROR_NONE) {
+        de430_free_data(objects, object_count);
+        return status;
+    }
+
+    if (!objects) {
+        // Nothing selected; still hand back a freeable array
+        objects = de430_calloc(1, sizeof(DE430EphemerisData));
+        if (!objects) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    *result = objects;
     *count = object_count;
+    return DE430_ERROR_NONE;
+}
+
+// Streaming CSV writer state. Rows carry the object name, so they are
+// written straight through in whatever order the points arrive.
+typedef struct {
+    FILE *fp;
+    char (*names)[64];
+    int object_count;
+} CsvSinkState;
+
+static int csv_sink_begin(void *context, const char *const *object_names, int object_count) {
+    CsvSinkState *state = (CsvSinkState*)context;
+    if (object_count <= 0 || state->names) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    state->names = de430_calloc(object_count, sizeof(*state->names));
+    if (!state->names) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (int i = 0; i < object_count; i++) {
+        strncpy(state->names[i], object_names[i], sizeof(state->names[i]) - 1);
+    }
+    state->object_count = object_count;
+
+    csv_write_header(state->fp);
+    return ferror(state->fp) ? DE430_ERROR_FILE_IO : DE430_ERROR_NONE;
+}
+
+static int csv_sink_write(void *context, int object_index, const DE430EphemerisPoint *points, int count) {
+    CsvSinkState *state = (CsvSinkState*)context;
+    if (object_index < 0 || object_index >= state->object_count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    for (int j = 0; j < count; j++) {
+        csv_write_point(state->fp, state->names[object_index], &points[j]);
+    }
+
+    return ferror(state->fp) ? DE430_ERROR_FILE_IO : DE430_ERROR_NONE;
+}
+
+static int csv_sink_end(void *context) {
+    CsvSinkState *state = (CsvSinkState*)context;
+
+    int status = fclose(state->fp) == 0 ? DE430_ERROR_NONE : DE430_ERROR_FILE_IO;
+    state->fp = NULL;
+    return status;
+}
+
+static void csv_sink_destroy(void *context) {
+    CsvSinkState *state = (CsvSinkState*)context;
+    if (!state) return;
+
+    if (state->fp) fclose(state->fp);
+    de430_free(state->names);
+    de430_free(state);
+}
+
+/**
+ * Open a streaming sink that writes the CSV format
+ *
+ * @param filename Name of the file to write
+ * @param sink Sink to initialize (must be released with de430_sink_close)
+ * @return 0 on success, error code on failure
+ */
+int de430_sink_open_csv(const char *filename, DE430Sink *sink) {
+    if (!filename || !sink) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    CsvSinkState *state = de430_calloc(1, sizeof(CsvSinkState));
+    if (!state) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    state->fp = fopen(filename, "w");
+    if (!state->fp) {
+        de430_free(state);
+        return DE430_ERROR_FILE_IO;
+    }
+
+    sink->begin = csv_sink_begin;
+    sink->write = csv_sink_write;
+    sink->end = csv_sink_end;
+    sink->destroy = csv_sink_destroy;
+    sink->context = state;
+
     return DE430_ERROR_NONE;
 }
\ No newline at end of file
@@ -0,0 +1,563 @@
+//
+// Internal helpers shared between the format writers. Not part of the public API.
+//
+
+#ifndef DE430_INTERNAL_H
+#define DE430_INTERNAL_H
+
+#include "de430_parser.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * A set of anonymous temporary files, one per object, used by streaming
+ * writers whose formats store each object's points contiguously
+ */
+typedef struct {
+    FILE **files;
+    int count;
+} DE430Spool;
+
+/**
+ * Create one temporary file per object
+ *
+ * @param spool Spool to initialize
+ * @param count Number of objects
+ * @return 0 on success, error code on failure
+ */
+int de430_spool_open(DE430Spool *spool, int count);
+
+/**
+ * Append the contents of one object's spool file to an output file
+ *
+ * @param spool Spool to read from
+ * @param index Object index
+ * @param out File to append to
+ * @return 0 on success, error code on failure
+ */
+int de430_spool_copy(DE430Spool *spool, int index, FILE *out);
+
+/**
+ * Close and delete all temporary files of the spool
+ *
+ * @param spool Spool to close
+ */
+void de430_spool_close(DE430Spool *spool);
+
+/**
+ * Map one object's spool file into memory. The mapping outlives the spool
+ * and is released by de430_spool_unmap, which de430_free_data calls.
+ *
+ * @param spool Spool holding the file
+ * @param index Object index
+ * @param size Bytes to map, at most the size of the file
+ * @param address Receives the start of the mapping
+ * @return 0 on success, error code on failure
+ */
+int de430_spool_map(DE430Spool *spool, int index, size_t size, void **address);
+
+/**
+ * Release a mapping made by de430_spool_map
+ *
+ * @param address Start of the mapping, or any other pointer
+ * @return 1 if address was a mapping and has been released, 0 otherwise
+ */
+int de430_spool_unmap(void *address);
+
+/**
+ * Parse one CSV data row in place
+ *
+ * @param line Row text, modified by tokenization
+ * @param object_name Buffer of 64 bytes receiving the object name
+ * @param point Point to fill
+ * @return 0 on success, -1 if the row has no object name
+ */
+int de430_csv_parse_row(char *line, char *object_name, DE430EphemerisPoint *point);
+
+/**
+ * Append a point to an object whose array grows geometrically
+ *
+ * @param object Object to append to
+ * @param capacity Allocated number of points, updated on growth
+ * @param point Point to append
+ * @return 0 on success, error code on failure
+ */
+int de430_data_append(DE430EphemerisData *object, int *capacity, const DE430EphemerisPoint *point);
+
+// Allocation
+
+/**
+ * Allocate through the allocator set with de430_set_allocator, counting
+ * the allocation against the calling thread. de430_calloc, de430_realloc,
+ * de430_free and de430_strdup mirror their standard counterparts.
+ *
+ * @param size Bytes to allocate
+ * @return Block, or NULL on failure
+ */
+void* de430_malloc(size_t size);
+void* de430_calloc(size_t count, size_t size);
+void* de430_realloc(void *ptr, size_t size);
+void de430_free(void *ptr);
+char* de430_strdup(const char *s);
+
+/**
+ * Make cJSON allocate through de430_malloc and de430_free. Called by the
+ * cJSON-based readers and writers before they build a document.
+ */
+void de430_alloc_use_for_cjson(void);
+
+/**
+ * Add counters gathered on a helper thread to those of the calling thread
+ *
+ * @param stats Counters to add
+ */
+void de430_alloc_stats_add(const DE430AllocStats *stats);
+
+// Backend admission
+
+/**
+ * A granted backend process slot
+ */
+typedef struct {
+    DE430Priority priority;
+    int lock_slot;              // Index of the held slot lock file, or -1
+} DE430BackendSlot;
+
+/**
+ * Wait until a backend process may start under the limit set with
+ * de430_set_backend_limit. Every successful call must be followed by
+ * de430_backend_release once the process has exited.
+ *
+ * @param priority Priority class of the request
+ * @param slot Receives the granted slot
+ * @return 0 on success, error code on failure
+ */
+int de430_backend_acquire(DE430Priority priority, DE430BackendSlot *slot);
+
+/**
+ * Give back a slot granted by de430_backend_acquire
+ *
+ * @param slot Slot to release
+ */
+void de430_backend_release(DE430BackendSlot *slot);
+
+// Parallel execution
+
+/**
+ * Task run by de430_parallel_for
+ *
+ * @param context Shared context
+ * @param index Task index
+ * @return 0 on success, error code on failure
+ */
+typedef int (*DE430TaskFn)(void *context, int index);
+
+/**
+ * Get the number of online processors
+ *
+ * @return Processor count, at least 1
+ */
+int de430_default_thread_count(void);
+
+/**
+ * Run tasks 0 to count - 1 on up to `threads` threads, including the
+ * caller. Tasks are balanced by work stealing, so a few expensive tasks do
+ * not hold up the rest. Once a task fails, no further tasks are started.
+ *
+ * Called from inside a task, the new tasks join the running workers
+ * (`threads` is ignored) and the calling task helps until they are done.
+ *
+ * @param count Number of tasks
+ * @param threads Number of threads, 0 for one per processor
+ * @param fn Task function
+ * @param context Context passed to every task
+ * @return 0 if every task succeeded, otherwise the first error reported
+ */
+int de430_parallel_for(int count, int threads, DE430TaskFn fn, void *context);
+
+// Incremental JSON tokenizer
+
+typedef enum {
+    DE430_JSON_ERROR = -1,
+    DE430_JSON_EOF = 0,
+    DE430_JSON_OBJECT_BEGIN,
+    DE430_JSON_OBJECT_END,
+    DE430_JSON_ARRAY_BEGIN,
+    DE430_JSON_ARRAY_END,
+    DE430_JSON_STRING,
+    DE430_JSON_NUMBER,
+    DE430_JSON_LITERAL      // true, false or null, reported as 1, 0 or NaN
+} DE430JsonToken;
+
+/**
+ * Pull tokenizer over a JSON stream. Commas and colons are treated as
+ * whitespace, which is enough for reading documents of a known shape.
+ */
+typedef struct {
+    FILE *fp;
+    char string[256];       // Text of the last string token, truncated
+    double number;          // Value of the last number or literal token
+} DE430JsonStream;
+
+/**
+ * Initialize a tokenizer reading from the current position of a file
+ *
+ * @param stream Tokenizer to initialize
+ * @param fp File to read
+ */
+void de430_json_stream_init(DE430JsonStream *stream, FILE *fp);
+
+/**
+ * Read the next token
+ *
+ * @param stream Tokenizer to read from
+ * @return Token type
+ */
+DE430JsonToken de430_json_stream_next(DE430JsonStream *stream);
+
+/**
+ * Skip the rest of a value whose first token has been read
+ *
+ * @param stream Tokenizer to read from
+ * @param token First token of the value
+ * @return 0 on success, error code on failure
+ */
+int de430_json_stream_skip(DE430JsonStream *stream, DE430JsonToken token);
+
+/**
+ * Look up a numeric point member by its JSON key
+ *
+ * @param key Member name, e.g. "jd" or "position"
+ * @param offset Byte offset of the member's first double in DE430EphemerisPoint
+ * @param count Number of doubles the member holds
+ * @return 1 if the key names a numeric member, 0 otherwise
+ */
+int de430_json_point_member(const char *key, size_t *offset, int *count);
+
+/**
+ * Read the members of a point object whose opening brace has been read
+ *
+ * @param stream Tokenizer to read from
+ * @param point Point to fill
+ * @return 0 on success, error code on failure
+ */
+int de430_json_stream_read_point(DE430JsonStream *stream, DE430EphemerisPoint *point);
+
+// Binary format
+
+#define DE430_BINARY_MAGIC "DE43"
+#define DE430_BINARY_VERSION_1 1   // Sequential objects, variable-length point records
+#define DE430_BINARY_VERSION_2 2   // Object directory, fixed-size point records
+
+// Binary format header (for versioning and validation)
+typedef struct {
+    char magic[4];         // "DE43" magic identifier
+    uint32_t version;      // Format version (1 or 2)
+    uint32_t object_count; // Number of objects in the file
+    uint32_t flags;        // DE430_BINARY_FLAG_* bits, always 0 in version 1
+} DE430BinaryHeader;
+
+// A zone section (constellation dictionary, then per-block statistics)
+// sits between the directory and the point records of a version 2 file
+#define DE430_BINARY_FLAG_ZONE_MAPS 0x1u
+
+// Binary object header (precedes each object's data in version 1)
+typedef struct {
+    uint32_t name_length;  // Length of object name
+    uint32_t point_count;  // Number of data points for this object
+} DE430BinaryObjectHeader;
+
+// Binary point header (fixed size part of each data point in version 1)
+typedef struct {
+    double jd;
+    double position[3];
+    double ra_dec[2];
+    double magnitude;
+    double phase;
+    double angular_size;
+    double physical_size;
+    double albedo;
+    double sun_dist;
+    double earth_dist;
+    double sun_ang_dist;
+    double theta_edo;
+    double ecliptic[3];
+    uint32_t constellation_length;
+} DE430BinaryPointHeader;
+
+// Object directory entry. Version 2 files store one per object right
+// after the file header; for version 1 files the directory is built by
+// scanning. Version 2 point records are DE430EphemerisPoint verbatim,
+// with the constellation zero-padded.
+typedef struct {
+    char name[64];         // Object name, null-terminated
+    uint64_t offset;       // File offset of the first point record
+    uint32_t point_count;  // Number of data points for this object
+    uint32_t record_size;  // Size of each point record, 0 for variable-length records
+    uint64_t zone_offset;  // File offset of the object's zone maps, 0 if none
+    uint32_t zone_block_size; // Points covered by each zone map
+    uint32_t zone_count;   // Number of zone maps
+} DE430BinaryDirectoryEntry;
+
+// Zone maps
+
+#define DE430_ZONE_MAX_CONSTELLATIONS 128
+#define DE430_ZONE_NO_CONSTELLATIONS UINT32_MAX   // Too many distinct names to track
+
+/**
+ * Constellation names referenced by the zone map bit sets. On disk it is
+ * stored as a uint32 count and a uint32 pad, then count names of 32 bytes.
+ */
+typedef struct {
+    uint32_t count;        // Number of names, or DE430_ZONE_NO_CONSTELLATIONS
+    char names[DE430_ZONE_MAX_CONSTELLATIONS][32];
+} DE430ZoneDictionary;
+
+// Statistics of one block of consecutive point records
+typedef struct {
+    double min[DE430_FIELD_COUNT];  // Smallest non-NaN value, INFINITY if there is none
+    double max[DE430_FIELD_COUNT];  // Largest non-NaN value, -INFINITY if there is none
+    uint64_t constellations[2];     // Bit i set if dictionary name i occurs in the block
+} DE430BinaryZoneMap;
+
+/**
+ * Add a name to a zone dictionary, switching it to untracked on overflow
+ *
+ * @param dictionary Dictionary to extend
+ * @param name Constellation name
+ */
+void de430_zone_dictionary_add(DE430ZoneDictionary *dictionary, const char *name);
+
+/**
+ * Compute the statistics of a block of points
+ *
+ * @param points First point of the block
+ * @param count Number of points in the block
+ * @param dictionary Dictionary holding every constellation of the block
+ * @param zone Zone map to fill
+ */
+void de430_zone_map_compute(const DE430EphemerisPoint *points, int count,
+                            const DE430ZoneDictionary *dictionary, DE430BinaryZoneMap *zone);
+
+/**
+ * Translate the constellation set of a filter into dictionary bits
+ *
+ * @param dictionary Dictionary of the file
+ * @param filter Filter to translate
+ * @param mask Bits of the filter's constellations
+ * @return 1 if the mask can be used to rule out blocks, 0 otherwise
+ */
+int de430_zone_filter_mask(const DE430ZoneDictionary *dictionary, const DE430Filter *filter, uint64_t mask[2]);
+
+/**
+ * Test whether a block can contain points that pass a filter
+ *
+ * @param zone Zone map of the block
+ * @param filter Filter to apply, or NULL
+ * @param mask Constellation bits from de430_zone_filter_mask, or NULL
+ * @return 1 if the block has to be read, 0 if it can be skipped
+ */
+int de430_zone_map_may_match(const DE430BinaryZoneMap *zone, const DE430Filter *filter, const uint64_t mask[2]);
+
+/**
+ * Read the zone dictionary of a version 2 file
+ *
+ * @param fd File descriptor
+ * @param header File header
+ * @param dictionary Dictionary to fill; empty when the file has no zone maps
+ * @return 0 on success, error code on failure
+ */
+int de430_zone_dictionary_read(int fd, const DE430BinaryHeader *header, DE430ZoneDictionary *dictionary);
+
+// The fixed part of a version 1 point record mirrors the leading doubles
+// of DE430EphemerisPoint, so it can be copied as one block either way
+#define DE430_BINARY_POINT_DOUBLES_SIZE offsetof(DE430BinaryPointHeader, constellation_length)
+
+// Largest encoded version 1 point record: fixed part plus a full constellation
+#define DE430_BINARY_MAX_POINT_SIZE \
+    (sizeof(DE430BinaryPointHeader) + sizeof(((DE430EphemerisPoint*)0)->constellation))
+
+// Size of the read-ahead window used by the bulk reader
+#define DE430_BINARY_READ_BUFFER_SIZE (4 * 1024 * 1024)
+
+/**
+ * Sequential reader that pulls a file in large chunks so records can be
+ * decoded from memory
+ */
+typedef struct {
+    int fd;
+    unsigned char *data;
+    size_t pos;            // Offset of the next unread byte in data
+    size_t len;            // Number of valid bytes in data
+    size_t capacity;
+    uint64_t base;         // File offset of data[0]
+} DE430BinaryReader;
+
+/**
+ * Open a file for bulk sequential reading
+ *
+ * @param reader Reader to initialize
+ * @param filename Name of the file to read
+ * @return 0 on success, error code on failure
+ */
+int de430_binary_reader_open(DE430BinaryReader *reader, const char *filename);
+
+/**
+ * Open a file for sequential reading with a read-ahead window of a given size
+ *
+ * @param reader Reader to initialize
+ * @param filename Name of the file to read
+ * @param capacity Read-ahead window in bytes, raised to fit at least one record
+ * @return 0 on success, error code on failure
+ */
+int de430_binary_reader_open_sized(DE430BinaryReader *reader, const char *filename, size_t capacity);
+
+/**
+ * Close the reader and its file
+ *
+ * @param reader Reader to close
+ */
+void de430_binary_reader_close(DE430BinaryReader *reader);
+
+/**
+ * Get the file offset of the next unread byte
+ *
+ * @param reader Reader to query
+ * @return File offset
+ */
+uint64_t de430_binary_reader_tell(const DE430BinaryReader *reader);
+
+/**
+ * Reposition the reader, discarding buffered data
+ *
+ * @param reader Reader to reposition
+ * @param offset File offset to continue from
+ * @return 0 on success, error code on failure
+ */
+int de430_binary_reader_seek(DE430BinaryReader *reader, uint64_t offset);
+
+/**
+ * Make sure at least `size` unread bytes are buffered
+ *
+ * @param reader Reader to fill
+ * @param size Number of bytes needed, at most the buffer capacity
+ * @return Pointer to the unread bytes, or NULL if the file ends first
+ */
+const unsigned char* de430_binary_reader_peek(DE430BinaryReader *reader, size_t size);
+
+/**
+ * Copy the next `size` bytes out of the reader; large reads bypass the buffer
+ *
+ * @param reader Reader to read from
+ * @param dst Destination buffer
+ * @param size Number of bytes to read
+ * @return 0 on success, error code if the file ends first
+ */
+int de430_binary_reader_take(DE430BinaryReader *reader, void *dst, size_t size);
+
+/**
+ * Read exactly `size` bytes at a file offset, retrying short reads
+ *
+ * @param fd File descriptor
+ * @param dst Destination buffer
+ * @param size Number of bytes to read
+ * @param offset File offset to read from
+ * @return 0 on success, error code on failure
+ */
+int de430_pread_all(int fd, void *dst, size_t size, uint64_t offset);
+
+/**
+ * Verify the magic number and version of a file header
+ *
+ * @param header Header to check
+ * @return 0 if the header is valid, error code otherwise
+ */
+int de430_binary_check_header(const DE430BinaryHeader *header);
+
+/**
+ * Validate a version 2 directory entry and terminate its name. The point
+ * count must fit an int and the records and zone maps must lie within the
+ * file.
+ *
+ * @param entry Entry as read from the file
+ * @param file_size Size of the file in bytes
+ * @return 0 if the entry is valid, error code otherwise
+ */
+int de430_binary_check_entry(DE430BinaryDirectoryEntry *entry, uint64_t file_size);
+
+/**
+ * Get the size of an open file
+ *
+ * @param fd File descriptor
+ * @param size Receives the size in bytes
+ * @return 0 on success, DE430_ERROR_FILE_IO on failure
+ */
+int de430_file_size(int fd, uint64_t *size);
+
+/**
+ * Read the file header and verify the magic number and version
+ *
+ * @param reader Reader positioned at the start of the file
+ * @param header Header to fill
+ * @return 0 on success, error code on failure
+ */
+int de430_binary_read_header(DE430BinaryReader *reader, DE430BinaryHeader *header);
+
+/**
+ * Read the object directory, scanning the file for version 1
+ *
+ * @param reader Reader positioned just after the file header
+ * @param header File header
+ * @param entries Pointer to store the directory (must be freed with de430_free)
+ * @return 0 on success, error code on failure
+ */
+int de430_binary_read_directory(DE430BinaryReader *reader, const DE430BinaryHeader *header,
+                                DE430BinaryDirectoryEntry **entries);
+
+/**
+ * Decode version 1 point records
+ *
+ * @param reader Reader positioned at the first record
+ * @param points Destination array, or NULL to skip the records
+ * @param count Number of records
+ * @return 0 on success, error code on failure
+ */
+int de430_binary_decode_points_v1(DE430BinaryReader *reader, DE430EphemerisPoint *points, uint32_t count);
+
+/**
+ * Terminate the constellation of points read as raw version 2 records,
+ * which come straight from the file and may hold no NUL
+ *
+ * @param points Points read
+ * @param count Number of points
+ */
+void de430_binary_terminate_points(DE430EphemerisPoint *points, size_t count);
+
+/**
+ * Load the points of one directory entry
+ *
+ * @param reader Reader over the file
+ * @param entry Directory entry of the object
+ * @param object Object to fill (points must be freed with de430_free)
+ * @return 0 on success, error code on failure
+ */
+int de430_binary_load_entry(DE430BinaryReader *reader, const DE430BinaryDirectoryEntry *entry,
+                            DE430EphemerisData *object);
+
+/**
+ * Load the points of one directory entry that pass a filter, reading only
+ * the blocks admitted by the entry's zone maps when it has any
+ *
+ * @param reader Reader over the file
+ * @param entry Directory entry of the object
+ * @param filter Filter to apply, or NULL
+ * @param mask Constellation bits from de430_zone_filter_mask, or NULL
+ * @param object Object to fill (points must be freed with de430_free)
+ * @return 0 on success, error code on failure
+ */
+int de430_binary_load_entry_filtered(DE430BinaryReader *reader, const DE430BinaryDirectoryEntry *entry,
+                                     const DE430Filter *filter, const uint64_t *mask, DE430EphemerisData *object);
+
+#endif //DE430_INTERNAL_H
@@ -3,6 +3,7 @@
 //
 
 #include "de430_parser.h"
+#include "de430_internal.h"
 
 #include <cJSON.h>
 #include <stdio.h>
@@ -16,15 +17,20 @@ static const char *error_messages[] = {
     "Docker command execution failed",
     "Memory allocation failed",
     "Failed to parse output data",
-    "Invalid configuration"
+    "Invalid configuration",
+    "File I/O error",
+    "JSON parse error",
+    "Invalid configuration",
+    "Requested time is outside the available data"
 };
 
 // Internal functions
 
 static FILE* execute_docker_command(const char *command);
-static int parse_ephemeris_output(FILE *fp, const DE430Config *config,
-                                 DE430EphemerisData **result, int *count);
-static void split_objects_string(const char *objects, char ***object_names, int *object_count);
+static int parse_ephemeris_output(FILE *fp, const DE430Config *config, DE430ResultBuffer *buffer);
+static int split_object_names(const char *objects, DE430EphemerisData *data, int capacity);
+static int parse_ephemeris_line(char *line, const DE430Config *config,
+                                DE430EphemerisData *data, int object_count, int row);
 
 void de430_init_config(DE430Config *config) {
     if (!config) return;
@@ -44,68 +50,82 @@ void de430_init_config(DE430Config *config) {
     config->output_format = 0;        // XYZ ICRS coordinates
     config->use_orbital_elements = 0;
     config->output_constellations = 0;
+    config->memory_budget = 0;        // No limit
+    config->priority = DE430_PRIORITY_NORMAL;
 }
 
 // Error codes and buffer sizes remain the same
 
-// Modified to build a command to be executed inside the container
-static char* build_ephemeris_command(const DE430Config *config) {
-    // Allocate a buffer for the command
-    char *command = (char*)malloc(COMMAND_BUFFER_SIZE);
-    if (!command) return NULL;
+// Append text to a command, keeping it within COMMAND_BUFFER_SIZE.
+// Returns 0 when the text does not fit.
+static int command_append(char *command, size_t *length, const char *text) {
+    size_t text_length = strlen(text);
+    if (*length + text_length >= COMMAND_BUFFER_SIZE) {
+        return 0;
+    }
+    memcpy(command + *length, text, text_length + 1);
+    *length += text_length;
+    return 1;
+}
+
+// Modified to build a command to be executed inside the container.
+// command must hold COMMAND_BUFFER_SIZE bytes; a configuration whose
+// arguments do not fit (e.g. a very long jd_list) is rejected.
+static int format_ephemeris_command(const DE430Config *config, char *command) {
+    size_t length = 0;
+    int fits = 1;
+    command[0] = '\0';
 
     // Start with the base ephemeris command (no docker part)
   //  strcpy(command, "/bin/ephem.bin ");
 
     // Add arguments based on configuration
-    char buffer[256];
+    char buffer[512];
 
     // JD min/max/step
     if (config->jd_list == NULL || config->jd_list_count == 0) {
-        sprintf(buffer, "--jd_min %.15f --jd_max %.15f --jd_step %.15f ",
-                config->jd_min, config->jd_max, config->jd_step);
-        strcat(command, buffer);
+        snprintf(buffer, sizeof(buffer), "--jd_min %.15f --jd_max %.15f --jd_step %.15f ",
+                 config->jd_min, config->jd_max, config->jd_step);
+        fits &= command_append(command, &length, buffer);
     } else {
         // Format the jd_list
-        strcat(command, "--jd_list \"");
-        for (int i = 0; i < config->jd_list_count; i++) {
-            sprintf(buffer, "%.15f", config->jd_list[i]);
-            strcat(command, buffer);
-            if (i < config->jd_list_count - 1) {
-                strcat(command, ",");
-            }
+        fits &= command_append(command, &length, "--jd_list \"");
+        for (int i = 0; i < config->jd_list_count && fits; i++) {
+            snprintf(buffer, sizeof(buffer), "%.15f%s", config->jd_list[i],
+                     i < config->jd_list_count - 1 ? "," : "");
+            fits &= command_append(command, &length, buffer);
         }
-        strcat(command, "\" ");
+        fits &= command_append(command, &length, "\" ");
     }
 
     // Topocentric correction
     if (config->enable_topocentric) {
-        sprintf(buffer, "--latitude %.6f --longitude %.6f --enable_topocentric_correction 1 ",
-                config->latitude, config->longitude);
-        strcat(command, buffer);
+        snprintf(buffer, sizeof(buffer), "--latitude %.6f --longitude %.6f --enable_topocentric_correction 1 ",
+                 config->latitude, config->longitude);
+        fits &= command_append(command, &length, buffer);
     }
 
     // Epoch
-    sprintf(buffer, "--epoch %.15f ", config->epoch);
-    strcat(command, buffer);
+    snprintf(buffer, sizeof(buffer), "--epoch %.15f ", config->epoch);
+    fits &= command_append(command, &length, buffer);
 
     // Objects
-    sprintf(buffer, "--objects \"%s\" ", config->objects);
-    strcat(command, buffer);
+    snprintf(buffer, sizeof(buffer), "--objects \"%s\" ", config->objects);
+    fits &= command_append(command, &length, buffer);
 
     // Output format
-    sprintf(buffer, "--output_format %d ", config->output_format);
-    strcat(command, buffer);
+    snprintf(buffer, sizeof(buffer), "--output_format %d ", config->output_format);
+    fits &= command_append(command, &length, buffer);
 
     // Use orbital elements
-    sprintf(buffer, "--use_orbital_elements %d ", config->use_orbital_elements);
-    strcat(command, buffer);
+    snprintf(buffer, sizeof(buffer), "--use_orbital_elements %d ", config->use_orbital_elements);
+    fits &= command_append(command, &length, buffer);
 
     // Output constellations
-    sprintf(buffer, "--output_constellations %d", config->output_constellations);
-    strcat(command, buffer);
+    snprintf(buffer, sizeof(buffer), "--output_constellations %d", config->output_constellations);
+    fits &= command_append(command, &length, buffer);
 
-    return command;
+    return fits ? DE430_ERROR_NONE : DE430_ERROR_INVALID_CONFIG;
 }
 
 static FILE* execute_docker_command(const char *ephemeris_command) {
@@ -128,7 +148,7 @@ static FILE* execute_docker_command(const char *ephemeris_command) {
 
 static char* build_docker_command(const DE430Config *config) {
     // Allocate a buffer for the command
-    char *command = (char*)malloc(COMMAND_BUFFER_SIZE);
+    char *command = (char*)de430_malloc(COMMAND_BUFFER_SIZE);
     if (!command) return NULL;
 
     // Start with the base docker command
@@ -186,329 +206,608 @@ static char* build_docker_command(const DE430Config *config) {
 }
 
 
-static void split_objects_string(const char *objects, char ***object_names, int *object_count) {
-    // Count the number of objects (comma-separated)
+// Upper bound on the number of names in a comma-separated object list
+static int count_object_names(const char *objects) {
     int count = 1;
     for (const char *p = objects; *p; p++) {
         if (*p == ',') count++;
     }
+    return count;
+}
+
+// Split a comma-separated object list into the object_name fields of `data`.
+// Leading spaces are skipped, empty names dropped and long names truncated.
+// Returns the number of names stored, at most `capacity`.
+static int split_object_names(const char *objects, DE430EphemerisData *data, int capacity) {
+    int i = 0;
+    for (const char *p = objects; *p && i < capacity; ) {
+        size_t length = strcspn(p, ",");
+        const char *token = p;
+        p += length;
+        if (*p == ',') p++;
+
+        // Empty names are dropped, as strtok would
+        if (length == 0) continue;
+
+        while (*token == ' ' && length > 0) {
+            token++;
+            length--;
+        }
 
-    // Allocate memory for the array of object names
-    *object_names = (char**)malloc(count * sizeof(char*));
-    if (!*object_names) {
-        *object_count = 0;
-        return;
+        DE430EphemerisData *object = &data[i++];
+        if (length > sizeof(object->object_name) - 1) {
+            length = sizeof(object->object_name) - 1;
+        }
+        memcpy(object->object_name, token, length);
+        object->object_name[length] = '\0';
     }
+    return i;
+}
 
-    // Make a copy of the objects string so we can modify it
-    char *objects_copy = strdup(objects);
-    if (!objects_copy) {
-        free(*object_names);
-        *object_names = NULL;
-        *object_count = 0;
-        return;
+// Parse one line of backend output into row `row` of every object.
+// The line is tokenized in place. Returns -1 if the line has no Julian date.
+static int parse_ephemeris_line(char *line, const DE430Config *config,
+                                DE430EphemerisData *data, int object_count, int row) {
+    char *token;
+    char *saveptr = NULL;
+
+    // Get Julian date (first token)
+    token = strtok_r(line, " \t", &saveptr);
+    if (!token) {
+        return -1;
     }
 
-    // Split the string by commas
-    int i = 0;
-    char *token = strtok(objects_copy, ",");
-    while (token != NULL && i < count) {
-        // Skip leading whitespace
-        while (*token == ' ') token++;
+    double julian_date = atof(token);
 
-        // Allocate memory for the object name
-        (*object_names)[i] = strdup(token);
-        i++;
+    // Parse the remaining tokens for each object
+    for (int i = 0; i < object_count; i++) {
+        DE430EphemerisPoint *point = &data[i].points[row];
+        memset(point, 0, sizeof(DE430EphemerisPoint));
+
+        // Set the Julian date
+        point->jd = julian_date;
 
-        token = strtok(NULL, ",");
+        // Position (XYZ)
+        for (int j = 0; j < 3; j++) {
+            token = strtok_r(NULL, " \t", &saveptr);
+            if (!token) {
+                fprintf(stderr, "Warning: Not enough tokens for position[%d] in object %d\n", j, i);
+                break;
+            }
+            point->position[j] = atof(token);
+        }
+
+        // RA/Dec
+        for (int j = 0; j < 2; j++) {
+            token = strtok_r(NULL, " \t", &saveptr);
+            if (!token) {
+                fprintf(stderr, "Warning: Not enough tokens for ra_dec[%d] in object %d\n", j, i);
+                break;
+            }
+            point->ra_dec[j] = atof(token);
+        }
+
+        // Magnitude
+        token = strtok_r(NULL, " \t", &saveptr);
+        if (!token) break;
+        point->magnitude = atof(token);
+
+        // Phase
+        token = strtok_r(NULL, " \t", &saveptr);
+        if (!token) break;
+        point->phase = atof(token);
+
+        // Angular size
+        token = strtok_r(NULL, " \t", &saveptr);
+        if (!token) break;
+        point->angular_size = atof(token);
+
+        // Physical size
+        token = strtok_r(NULL, " \t", &saveptr);
+        if (!token) break;
+        point->physical_size = atof(token);
+
+        // Albedo
+        token = strtok_r(NULL, " \t", &saveptr);
+        if (!token) break;
+        point->albedo = atof(token);
+
+        // Sun distance
+        token = strtok_r(NULL, " \t", &saveptr);
+        if (!token) break;
+        point->sun_dist = atof(token);
+
+        // Earth distance
+        token = strtok_r(NULL, " \t", &saveptr);
+        if (!token) break;
+        point->earth_dist = atof(token);
+
+        // Sun angular distance
+        token = strtok_r(NULL, " \t", &saveptr);
+        if (!token) break;
+        point->sun_ang_dist = atof(token);
+
+        // Theta EDO
+        token = strtok_r(NULL, " \t", &saveptr);
+        if (!token) break;
+        point->theta_edo = atof(token);
+
+        // Ecliptic coordinates
+        for (int j = 0; j < 3; j++) {
+            token = strtok_r(NULL, " \t", &saveptr);
+            if (!token) break;
+            point->ecliptic[j] = atof(token);
+        }
+
+        // Constellation (if enabled)
+        if (config->output_constellations) {
+            token = strtok_r(NULL, " \t", &saveptr);
+            if (token) {
+                strncpy(point->constellation, token, sizeof(point->constellation) - 1);
+                point->constellation[sizeof(point->constellation) - 1] = '\0';
+            }
+        }
     }
 
-    *object_count = i;
-    free(objects_copy);
+    return 0;
 }
 
-// Parse data using JSON intermediary
-static int parse_ephemeris_output(FILE *fp, const DE430Config *config,
-                                 DE430EphemerisData **result, int *count) {
-    if (!fp || !config || !result || !count) {
-        return DE430_ERROR_INVALID_CONFIG;
+void de430_result_buffer_init(DE430ResultBuffer *buffer) {
+    if (!buffer) return;
+    memset(buffer, 0, sizeof(DE430ResultBuffer));
+}
+
+// Make room for `count` objects, keeping the arrays of the ones already there
+static int result_buffer_reserve_objects(DE430ResultBuffer *buffer, int count) {
+    if (count <= buffer->capacity) {
+        return DE430_ERROR_NONE;
+    }
+
+    DE430EphemerisData *data = (DE430EphemerisData*)de430_realloc(
+        buffer->data, count * sizeof(DE430EphemerisData));
+    if (!data) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
     }
+    buffer->data = data;
 
+    int *point_capacity = (int*)de430_realloc(buffer->point_capacity, count * sizeof(int));
+    if (!point_capacity) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+    buffer->point_capacity = point_capacity;
 
-    // Reset file pointer
-    rewind(fp);
+    memset(&data[buffer->capacity], 0, (count - buffer->capacity) * sizeof(DE430EphemerisData));
+    memset(&point_capacity[buffer->capacity], 0, (count - buffer->capacity) * sizeof(int));
+    buffer->capacity = count;
 
-    // Split the objects string to get individual object names
-    char **object_names = NULL;
-    int object_count = 0;
-    split_objects_string(config->objects, &object_names, &object_count);
+    return DE430_ERROR_NONE;
+}
 
-    if (object_count == 0) {
-        return DE430_ERROR_INVALID_CONFIG;
+// Capacity an array of `capacity` points grows to when it must hold `points`
+static int result_buffer_grown_capacity(int capacity, int points) {
+    if (points <= capacity) {
+        return capacity;
     }
 
-    // Allocate memory for the result
-    *result = (DE430EphemerisData*)malloc(object_count * sizeof(DE430EphemerisData));
-    if (!*result) {
-        for (int i = 0; i < object_count; i++) {
-            free(object_names[i]);
-        }
-        free(object_names);
+    capacity = capacity > 0 ? capacity : INITIAL_RESULTS_SIZE;
+    while (capacity < points) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+// Make room for `points` points in object `index`, growing geometrically
+static int result_buffer_reserve_points(DE430ResultBuffer *buffer, int index, int points) {
+    int capacity = buffer->point_capacity[index];
+    if (points <= capacity) {
+        return DE430_ERROR_NONE;
+    }
+
+    capacity = result_buffer_grown_capacity(capacity, points);
+
+    DE430EphemerisPoint *grown = (DE430EphemerisPoint*)de430_realloc(
+        buffer->data[index].points, (size_t)capacity * sizeof(DE430EphemerisPoint));
+    if (!grown) {
         return DE430_ERROR_MEMORY_ALLOCATION;
     }
 
-    // Initialize result structures
-    for (int i = 0; i < object_count; i++) {
-        (*result)[i].points = NULL;
-        (*result)[i].count = 0;
-        strncpy((*result)[i].object_name, object_names[i], sizeof((*result)[i].object_name) - 1);
-        (*result)[i].object_name[sizeof((*result)[i].object_name) - 1] = '\0';
+    buffer->data[index].points = grown;
+    buffer->point_capacity[index] = capacity;
+    return DE430_ERROR_NONE;
+}
+
+// Split the comma-separated object list straight into the buffer's names
+static int result_buffer_set_objects(DE430ResultBuffer *buffer, const char *objects) {
+    int count = count_object_names(objects);
+
+    int status = result_buffer_reserve_objects(buffer, count);
+    if (status != DE430_ERROR_NONE) {
+        return status;
     }
 
-    // Create arrays to store point data for each object
-    int capacity = INITIAL_RESULTS_SIZE;
-    for (int i = 0; i < object_count; i++) {
-        (*result)[i].points = (DE430EphemerisPoint*)malloc(
-            capacity * sizeof(DE430EphemerisPoint));
+    buffer->count = split_object_names(objects, buffer->data, count);
+    for (int i = 0; i < buffer->count; i++) {
+        buffer->data[i].count = 0;
+    }
+    return buffer->count > 0 ? DE430_ERROR_NONE : DE430_ERROR_INVALID_CONFIG;
+}
 
-        if (!(*result)[i].points) {
-            // Clean up on failure
-            for (int j = 0; j < i; j++) {
-                free((*result)[j].points);
-            }
-            free(*result);
-            *result = NULL;
+// Whether every object can hold `points` points within the memory budget
+static int result_buffer_fits_budget(const DE430ResultBuffer *buffer, int points, size_t budget) {
+    size_t bytes = 0;
+    for (int i = 0; i < buffer->count; i++) {
+        bytes += (size_t)result_buffer_grown_capacity(buffer->point_capacity[i], points) * sizeof(DE430EphemerisPoint);
+    }
+    return budget == 0 || bytes <= budget;
+}
 
-            for (int j = 0; j < object_count; j++) {
-                free(object_names[j]);
-            }
-            free(object_names);
+// Append the first `rows` points of every object to its spool file
+static int result_buffer_spill(DE430ResultBuffer *buffer, DE430Spool *spool, int rows) {
+    for (int i = 0; i < buffer->count; i++) {
+        if (fwrite(buffer->data[i].points, sizeof(DE430EphemerisPoint), rows, spool->files[i]) != (size_t)rows) {
+            return DE430_ERROR_FILE_IO;
+        }
+    }
+    return DE430_ERROR_NONE;
+}
 
-            return DE430_ERROR_MEMORY_ALLOCATION;
+// Replace every object's array with a mapping of its `rows` spilled points
+static int result_buffer_map_spool(DE430ResultBuffer *buffer, DE430Spool *spool, int rows) {
+    for (int i = 0; i < buffer->count; i++) {
+        void *mapped;
+        int status = de430_spool_map(spool, i, (size_t)rows * sizeof(DE430EphemerisPoint), &mapped);
+        if (status != DE430_ERROR_NONE) {
+            return status;
         }
+
+        de430_free(buffer->data[i].points);
+        buffer->data[i].points = (DE430EphemerisPoint*)mapped;
+        buffer->point_capacity[i] = 0;
     }
+    return DE430_ERROR_NONE;
+}
 
-    // Read the file line by line
+// Backend output is read a line at a time. Rows of many objects can be
+// longer than LINE_BUFFER_SIZE; those continue in a heap buffer that grows
+// as needed and is kept for the rest of the output.
+typedef struct {
     char line[LINE_BUFFER_SIZE];
-    int line_count = 0;
+    char *long_line;
+    size_t long_capacity;
+} OutputLine;
+
+// Read the next line without its newline. Returns NULL at the end of the
+// output or, with *status set, when memory runs out.
+static char* output_line_read(OutputLine *reader, FILE *fp, int *status) {
+    if (!fgets(reader->line, sizeof(reader->line), fp)) {
+        return NULL;
+    }
 
-    while (fgets(line, sizeof(line), fp)) {
-        // Skip empty lines
-        if (line[0] == '\n' || line[0] == '\0') continue;
+    size_t len = strlen(reader->line);
+    char *text = reader->line;
+
+    if (len == sizeof(reader->line) - 1 && reader->line[len-1] != '\n') {
+        // Truncated: gather the rest of the line in the heap buffer
+        size_t used = 0;
+        const char *part = reader->line;
+        for (;;) {
+            size_t part_len = strlen(part);
+            if (used + part_len + 1 > reader->long_capacity) {
+                size_t capacity = reader->long_capacity ? reader->long_capacity * 2 : 4 * LINE_BUFFER_SIZE;
+                while (capacity < used + part_len + 1) capacity *= 2;
+                char *grown = (char*)de430_realloc(reader->long_line, capacity);
+                if (!grown) {
+                    *status = DE430_ERROR_MEMORY_ALLOCATION;
+                    return NULL;
+                }
+                reader->long_line = grown;
+                reader->long_capacity = capacity;
+            }
+            memcpy(reader->long_line + used, part, part_len + 1);
+            used += part_len;
 
-        // Remove trailing newline
-        size_t len = strlen(line);
-        if (len > 0 && line[len-1] == '\n') {
-            line[len-1] = '\0';
+            if (reader->long_line[used-1] == '\n' || !fgets(reader->line, sizeof(reader->line), fp)) break;
+            part = reader->line;
         }
+        text = reader->long_line;
+        len = used;
+    }
 
-        // Check if we need to resize the arrays
-        if (line_count >= capacity) {
-            capacity *= 2;
-            for (int i = 0; i < object_count; i++) {
-                DE430EphemerisPoint *new_points = (DE430EphemerisPoint*)realloc(
-                    (*result)[i].points, capacity * sizeof(DE430EphemerisPoint));
-
-                if (!new_points) {
-                    // Clean up on failure
-                    for (int j = 0; j < object_count; j++) {
-                        free((*result)[j].points);
-                    }
-                    free(*result);
-                    *result = NULL;
-
-                    for (int j = 0; j < object_count; j++) {
-                        free(object_names[j]);
-                    }
-                    free(object_names);
-
-                    return DE430_ERROR_MEMORY_ALLOCATION;
-                }
+    // Remove trailing newline
+    if (len > 0 && text[len-1] == '\n') {
+        text[len-1] = '\0';
+    }
+    return text;
+}
 
-                (*result)[i].points = new_points;
-            }
+// Parse backend output into the buffer's objects, one row per line. Once
+// the arrays would outgrow config->memory_budget they are used as a
+// fixed-size chunk that is spilled to disk whenever it fills up.
+static int parse_ephemeris_output(FILE *fp, const DE430Config *config, DE430ResultBuffer *buffer) {
+    OutputLine reader = {0};
+    char *line;
+    int rows = 0;               // Rows held in the arrays
+    int spilled = 0;            // Rows already written to the spool
+    DE430Spool spool = {0};     // Opened on the first spill
+    int status = DE430_ERROR_NONE;
+
+    while (status == DE430_ERROR_NONE && (line = output_line_read(&reader, fp, &status))) {
+        // Skip empty lines
+        if (line[0] == '\0') continue;
+
+        int full = 0;
+        for (int i = 0; i < buffer->count; i++) {
+            if (rows >= buffer->point_capacity[i]) full = 1;
         }
 
-        // Use JSON to parse the line
-        cJSON *line_json = cJSON_CreateObject();
-        if (!line_json) {
-            // Clean up on failure
-            for (int j = 0; j < object_count; j++) {
-                free((*result)[j].points);
+        if (full && rows > 0 && (spool.files || !result_buffer_fits_budget(buffer, rows + 1, config->memory_budget))) {
+            // Over budget: move the rows parsed so far to disk and reuse the arrays
+            if (!spool.files) {
+                status = de430_spool_open(&spool, buffer->count);
             }
-            free(*result);
-            *result = NULL;
-
-            for (int j = 0; j < object_count; j++) {
-                free(object_names[j]);
+            if (status == DE430_ERROR_NONE) {
+                status = result_buffer_spill(buffer, &spool, rows);
+            }
+            spilled += rows;
+            rows = 0;
+        } else {
+            // Grow only objects whose arrays are full
+            for (int i = 0; i < buffer->count && status == DE430_ERROR_NONE; i++) {
+                status = result_buffer_reserve_points(buffer, i, rows + 1);
             }
-            free(object_names);
-
-            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        if (status != DE430_ERROR_NONE) {
+            break;
         }
 
-        // Split the line into tokens
-        char *token;
-        char *line_copy = strdup(line);
-        char *saveptr = NULL;
-
-        // Get Julian date (first token)
-        token = strtok_r(line_copy, " \t", &saveptr);
-        if (!token) {
-            free(line_copy);
-            cJSON_Delete(line_json);
+        // Parse the line directly into this row of every object
+        if (parse_ephemeris_line(line, config, buffer->data, buffer->count, rows) != 0) {
             continue; // Skip malformed lines
         }
 
-        double julian_date = atof(token);
+        rows++;
+    }
 
-        // Parse the remaining tokens for each object
-        for (int i = 0; i < object_count; i++) {
-            DE430EphemerisPoint *point = &((*result)[i].points[line_count]);
-            memset(point, 0, sizeof(DE430EphemerisPoint));
+    if (spool.files) {
+        if (status == DE430_ERROR_NONE) {
+            status = result_buffer_spill(buffer, &spool, rows);
+        }
+        if (status == DE430_ERROR_NONE) {
+            status = result_buffer_map_spool(buffer, &spool, spilled + rows);
+        }
+        // The arrays no longer match any prefix of the output after a failed spill
+        rows = status == DE430_ERROR_NONE ? spilled + rows : 0;
+        de430_spool_close(&spool);
+    }
+    de430_free(reader.long_line);
 
-            // Set the Julian date
-            point->jd = julian_date;
+    // Update the count for each object
+    for (int i = 0; i < buffer->count; i++) {
+        buffer->data[i].count = rows;
+    }
 
-            // Position (XYZ)
-            for (int j = 0; j < 3; j++) {
-                token = strtok_r(NULL, " \t", &saveptr);
-                if (!token) {
-                    fprintf(stderr, "Warning: Not enough tokens for position[%d] in object %d\n", j, i);
-                    break;
-                }
-                point->position[j] = atof(token);
-            }
+    return status;
+}
 
-            // RA/Dec
-            for (int j = 0; j < 2; j++) {
-                token = strtok_r(NULL, " \t", &saveptr);
-                if (!token) {
-                    fprintf(stderr, "Warning: Not enough tokens for ra_dec[%d] in object %d\n", j, i);
-                    break;
-                }
-                point->ra_dec[j] = atof(token);
-            }
+int de430_get_ephemeris_into(const DE430Config *config, DE430ResultBuffer *buffer) {
+    if (!config || !buffer) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
 
-            // Magnitude
-            token = strtok_r(NULL, " \t", &saveptr);
-            if (!token) break;
-            point->magnitude = atof(token);
+    // Arrays mapped by an earlier spill cannot be grown; start those afresh
+    for (int i = 0; i < buffer->capacity; i++) {
+        if (de430_spool_unmap(buffer->data[i].points)) {
+            buffer->data[i].points = NULL;
+            buffer->point_capacity[i] = 0;
+        }
+    }
 
-            // Phase
-            token = strtok_r(NULL, " \t", &saveptr);
-            if (!token) break;
-            point->phase = atof(token);
+    int status = result_buffer_set_objects(buffer, config->objects);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
 
-            // Angular size
-            token = strtok_r(NULL, " \t", &saveptr);
-            if (!token) break;
-            point->angular_size = atof(token);
+    // Build the ephemeris command
+    char ephemeris_command[COMMAND_BUFFER_SIZE];
+    status = format_ephemeris_command(config, ephemeris_command);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
 
-            // Physical size
-            token = strtok_r(NULL, " \t", &saveptr);
-            if (!token) break;
-            point->physical_size = atof(token);
+    // Wait for a backend slot, then execute the Docker command
+    DE430BackendSlot slot;
+    status = de430_backend_acquire(config->priority, &slot);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
 
-            // Albedo
-            token = strtok_r(NULL, " \t", &saveptr);
-            if (!token) break;
-            point->albedo = atof(token);
+    FILE *fp = execute_docker_command(ephemeris_command);
+    if (!fp) {
+        de430_backend_release(&slot);
+        return DE430_ERROR_COMMAND_FAILED;
+    }
 
-            // Sun distance
-            token = strtok_r(NULL, " \t", &saveptr);
-            if (!token) break;
-            point->sun_dist = atof(token);
+    // Parse the output and fill the buffer
+    status = parse_ephemeris_output(fp, config, buffer);
 
-            // Earth distance
-            token = strtok_r(NULL, " \t", &saveptr);
-            if (!token) break;
-            point->earth_dist = atof(token);
+    // Close the pipe
+    pclose(fp);
+    de430_backend_release(&slot);
 
-            // Sun angular distance
-            token = strtok_r(NULL, " \t", &saveptr);
-            if (!token) break;
-            point->sun_ang_dist = atof(token);
+    return status;
+}
 
-            // Theta EDO
-            token = strtok_r(NULL, " \t", &saveptr);
-            if (!token) break;
-            point->theta_edo = atof(token);
+void de430_result_buffer_reset(DE430ResultBuffer *buffer) {
+    if (!buffer) return;
 
-            // Ecliptic coordinates
-            for (int j = 0; j < 3; j++) {
-                token = strtok_r(NULL, " \t", &saveptr);
-                if (!token) break;
-                point->ecliptic[j] = atof(token);
-            }
+    for (int i = 0; i < buffer->capacity; i++) {
+        buffer->data[i].count = 0;
+    }
+    buffer->count = 0;
+}
 
-            // Constellation (if enabled)
-            if (config->output_constellations) {
-                token = strtok_r(NULL, " \t", &saveptr);
-                if (token) {
-                    strncpy(point->constellation, token, sizeof(point->constellation) - 1);
-                    point->constellation[sizeof(point->constellation) - 1] = '\0';
-                }
-            }
-        }
+void de430_result_buffer_free(DE430ResultBuffer *buffer) {
+    if (!buffer) return;
+
+    de430_free_data(buffer->data, buffer->capacity);
+    de430_free(buffer->point_capacity);
+    memset(buffer, 0, sizeof(DE430ResultBuffer));
+}
 
-        free(line_copy);
-        cJSON_Delete(line_json);
-        line_count++;
+int de430_get_ephemeris(const DE430Config *config, DE430EphemerisData **result, int *count) {
+    if (!config || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
     }
 
-    // Update the count for each object
-    for (int i = 0; i < object_count; i++) {
-        (*result)[i].count = line_count;
+    // A one-off buffer whose data array is handed to the caller
+    DE430ResultBuffer buffer;
+    de430_result_buffer_init(&buffer);
+
+    int status = de430_get_ephemeris_into(config, &buffer);
+    if (status != DE430_ERROR_NONE) {
+        de430_result_buffer_free(&buffer);
+        return status;
     }
 
-    // Clean up object names
+    *result = buffer.data;
+    *count = buffer.count;
+    de430_free(buffer.point_capacity);
+
+    return DE430_ERROR_NONE;
+}
+
+// Hand one buffered chunk of every object to the sink
+static int flush_sink_chunk(DE430Sink *sink, const DE430EphemerisData *chunk, int object_count, int rows) {
+    if (rows == 0) return DE430_ERROR_NONE;
+
     for (int i = 0; i < object_count; i++) {
-        free(object_names[i]);
+        int status = sink->write(sink->context, i, chunk[i].points, rows);
+        if (status != DE430_ERROR_NONE) {
+            return status;
+        }
     }
-    free(object_names);
 
-    *count = object_count;
     return DE430_ERROR_NONE;
 }
 
-
-int de430_get_ephemeris(const DE430Config *config, DE430EphemerisData **result, int *count) {
-    if (!config || !result || !count) {
+int de430_get_ephemeris_to_sink(const DE430Config *config, DE430Sink *sink) {
+    if (!config || !sink || !sink->begin || !sink->write || !sink->end) {
         return DE430_ERROR_INVALID_CONFIG;
     }
 
-    // Build the ephemeris command
-    char *ephemeris_command = build_ephemeris_command(config);
-    if (!ephemeris_command) {
+    // One fixed-size chunk per object; this is all the point memory the stream uses
+    int capacity = count_object_names(config->objects);
+    DE430EphemerisData *chunk = (DE430EphemerisData*)de430_calloc(capacity, sizeof(DE430EphemerisData));
+    const char **object_names = (const char**)de430_malloc((size_t)capacity * sizeof(char*));
+    DE430EphemerisPoint *block = (DE430EphemerisPoint*)de430_malloc(
+        (size_t)capacity * STREAM_CHUNK_POINTS * sizeof(DE430EphemerisPoint));
+
+    if (!chunk || !object_names || !block) {
+        de430_free(chunk);
+        de430_free(object_names);
+        de430_free(block);
         return DE430_ERROR_MEMORY_ALLOCATION;
     }
 
-    // Execute the Docker command
-    FILE *fp = execute_docker_command(ephemeris_command);
-    free(ephemeris_command);
+    // Split the objects string to get individual object names
+    int object_count = split_object_names(config->objects, chunk, capacity);
+    if (object_count == 0) {
+        de430_free(chunk);
+        de430_free(object_names);
+        de430_free(block);
+        return DE430_ERROR_INVALID_CONFIG;
+    }
 
-    if (!fp) {
-        return DE430_ERROR_COMMAND_FAILED;
+    for (int i = 0; i < object_count; i++) {
+        chunk[i].points = block + (size_t)i * STREAM_CHUNK_POINTS;
+        object_names[i] = chunk[i].object_name;
     }
 
-    // Parse the output and fill the result structure
-    int status = parse_ephemeris_output(fp, config, result, count);
+    int status = sink->begin(sink->context, object_names, object_count);
+
+    FILE *fp = NULL;
+    DE430BackendSlot slot;
+    if (status == DE430_ERROR_NONE) {
+        char *ephemeris_command = (char*)de430_malloc(COMMAND_BUFFER_SIZE);
+        if (!ephemeris_command) {
+            status = DE430_ERROR_MEMORY_ALLOCATION;
+        } else {
+            status = format_ephemeris_command(config, ephemeris_command);
+            if (status == DE430_ERROR_NONE) {
+                status = de430_backend_acquire(config->priority, &slot);
+            }
+            if (status == DE430_ERROR_NONE) {
+                fp = execute_docker_command(ephemeris_command);
+                if (!fp) {
+                    de430_backend_release(&slot);
+                    status = DE430_ERROR_COMMAND_FAILED;
+                }
+            }
+            de430_free(ephemeris_command);
+        }
+    }
 
-    // Close the pipe
-    pclose(fp);
+    if (fp) {
+        // Parse rows into the chunk and flush it whenever it fills up
+        OutputLine reader = {0};
+        char *line;
+        int rows = 0;
+
+        while (status == DE430_ERROR_NONE && (line = output_line_read(&reader, fp, &status))) {
+            // Skip empty lines
+            if (line[0] == '\0') continue;
+
+            if (parse_ephemeris_line(line, config, chunk, object_count, rows) != 0) {
+                continue; // Skip malformed lines
+            }
+
+            if (++rows == STREAM_CHUNK_POINTS) {
+                status = flush_sink_chunk(sink, chunk, object_count, rows);
+                rows = 0;
+            }
+        }
+
+        if (status == DE430_ERROR_NONE) {
+            status = flush_sink_chunk(sink, chunk, object_count, rows);
+        }
+
+        de430_free(reader.long_line);
+        pclose(fp);
+        de430_backend_release(&slot);
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = sink->end(sink->context);
+    }
+
+    de430_free(block);
+    de430_free(chunk);
+    de430_free(object_names);
 
     return status;
 }
 
+void de430_sink_close(DE430Sink *sink) {
+    if (!sink) return;
+
+    if (sink->destroy) {
+        sink->destroy(sink->context);
+    }
+
+    memset(sink, 0, sizeof(DE430Sink));
+}
+
 void de430_free_data(DE430EphemerisData *data, int count) {
     if (!data) return;
 
     for (int i = 0; i < count; i++) {
-        free(data[i].points);
+        // Arrays spilled to disk are mappings rather than heap blocks
+        if (!de430_spool_unmap(data[i].points)) {
+            de430_free(data[i].points);
+        }
     }
 
-    free(data);
+    de430_free(data);
 }
 
 const char* de430_get_error(int error_code) {
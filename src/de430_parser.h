@@ -5,6 +5,8 @@
 #ifndef DE430_DOCKER_H
 #define DE430_DOCKER_H
 
+#include <stddef.h>
+
 // Error codes
 #define DE430_ERROR_NONE 0
 #define DE430_ERROR_COMMAND_FAILED -1
@@ -15,11 +17,16 @@
 #define DE430_ERROR_FILE_IO -5
 #define DE430_ERROR_JSON_PARSE -6
 #define DE430_ERROR_INVALID_CONFIG -7
+#define DE430_ERROR_OUT_OF_RANGE -8
 
 // Buffer sizes
 #define COMMAND_BUFFER_SIZE 4096
 #define LINE_BUFFER_SIZE 2048
 #define INITIAL_RESULTS_SIZE 1000
+#define STREAM_CHUNK_POINTS 256
+#define DE430_ZONE_BLOCK_POINTS 1024
+#define DE430_JOB_CHUNK_POINTS 8192
+#define DE430_CONJUNCTION_BLOCK_POINTS 256
 
 /**
  * Data structure representing an astronomical body's ephemeris data
@@ -50,6 +57,17 @@ typedef struct {
     char object_name[64];         // Name of the astronomical object
 } DE430EphemerisData;
 
+/**
+ * Scheduling classes for backend processes. When the number of processes
+ * is capped, waiting requests of a lower class start first.
+ */
+typedef enum {
+    DE430_PRIORITY_INTERACTIVE,     // Requests someone is waiting on
+    DE430_PRIORITY_NORMAL,
+    DE430_PRIORITY_BATCH,           // Bulk work that can wait
+    DE430_PRIORITY_COUNT
+} DE430Priority;
+
 /**
  * Configuration for the DE430 request
  */
@@ -67,11 +85,58 @@ typedef struct {
     int output_format;          // Output format (-1 to 3)
     int use_orbital_elements;   // Whether to use orbital elements
     int output_constellations;  // Whether to include constellations
+    size_t memory_budget;       // Bytes of points kept in memory before spilling to disk, 0 for no limit
+    DE430Priority priority;     // Queue class when backend processes are capped
 } DE430Config;
 
+/**
+ * Destination for streamed ephemeris points
+ *
+ * A sink receives begin() once with the object names, then any number of
+ * write() calls carrying consecutive points of one object (objects may be
+ * interleaved), then end() once. destroy() releases the sink whether or not
+ * end() was reached. Custom formats can be plugged in by filling in the
+ * callbacks; the built-in writers are created with de430_sink_open_*().
+ */
+typedef struct {
+    int (*begin)(void *context, const char *const *object_names, int object_count);
+    int (*write)(void *context, int object_index, const DE430EphemerisPoint *points, int count);
+    int (*end)(void *context);
+    void (*destroy)(void *context);
+    void *context;
+} DE430Sink;
+
 int de430_save_to_json(const DE430EphemerisData *data, int count, const char *filename);
 int de430_load_from_json(const char *filename, DE430EphemerisData **result, int *count);
 
+/**
+ * Save ephemeris data as columnar JSON
+ *
+ * Each object holds object_name, count and one array per field, named as
+ * in the CSV header, plus a constellation array of strings. NaN is written
+ * as null.
+ *
+ * @param data Array of ephemeris data to save
+ * @param count Number of objects in the array
+ * @param filename Name of the file to save to
+ * @return 0 on success, error code on failure
+ */
+int de430_save_to_json_columnar(const DE430EphemerisData *data, int count, const char *filename);
+
+/**
+ * Load ephemeris data from a columnar JSON file
+ *
+ * Each object's points are allocated once from its count, which is trusted
+ * only as far as the file size allows, and every column is parsed straight
+ * into them. Missing columns are left zero.
+ *
+ * @param filename Name of the file to load from
+ * @param result Pointer to store the resulting data (must be freed with de430_free_data)
+ * @param count Number of objects loaded
+ * @return 0 on success, error code on failure
+ */
+int de430_load_from_json_columnar(const char *filename, DE430EphemerisData **result, int *count);
+
 /**
  * Save ephemeris data to a CSV file
  *
@@ -102,6 +167,38 @@ int de430_load_from_csv(const char *filename, DE430EphemerisData **result, int *
  */
 int de430_save_to_binary(const DE430EphemerisData *data, int count, const char *filename);
 
+/**
+ * Options for the binary writer
+ */
+typedef struct {
+    int version;                // Format version: 1 (compact, sequential) or 2 (indexed, fixed-size records)
+    int zone_block_size;        // Points per zone map in version 2 files, 0 to store none
+} DE430BinaryOptions;
+
+/**
+ * Initialize binary writer options with default values (version 1,
+ * zone maps of DE430_ZONE_BLOCK_POINTS points)
+ *
+ * @param options Pointer to options structure to initialize
+ */
+void de430_init_binary_options(DE430BinaryOptions *options);
+
+/**
+ * Save ephemeris data to a binary file using the given options
+ *
+ * Version 2 files start with an object directory and store points as
+ * fixed-size records, so single objects can be located and read without
+ * touching the rest of the file.
+ *
+ * @param data Array of ephemeris data to save
+ * @param count Number of objects in the array
+ * @param filename Name of the file to save to
+ * @param options Format options, or NULL for the defaults
+ * @return 0 on success, error code on failure
+ */
+int de430_save_to_binary_ex(const DE430EphemerisData *data, int count, const char *filename,
+                            const DE430BinaryOptions *options);
+
 /**
  * Load ephemeris data from a binary file
  *
@@ -111,38 +208,1388 @@ int de430_save_to_binary(const DE430EphemerisData *data, int count, const char *
  * @return 0 on success, error code on failure
  */
 int de430_load_from_binary(const char *filename, DE430EphemerisData **result, int *count);
+
 /**
- * Initialize the DE430 configuration with default values
+ * Save ephemeris data to a binary file, encoding objects on several threads
  *
- * @param config Pointer to configuration structure to initialize
+ * Every object's position in the file is computed first, so threads write
+ * their parts with positioned writes in any order. The file is identical
+ * to the one de430_save_to_binary_ex produces.
+ *
+ * @param data Array of ephemeris data to save
+ * @param count Number of objects in the array
+ * @param filename Name of the file to save to
+ * @param options Format options, or NULL for the defaults
+ * @param threads Number of threads, 0 for one per processor
+ * @return 0 on success, error code on failure
  */
+int de430_save_to_binary_parallel(const DE430EphemerisData *data, int count, const char *filename,
+                                  const DE430BinaryOptions *options, int threads);
 
-void de430_init_config(DE430Config *config);
+/**
+ * Load ephemeris data from a binary file, decoding objects on several threads
+ *
+ * Version 2 records are read in place with positioned reads; version 1
+ * files are scanned once for object offsets and then decoded per object.
+ *
+ * @param filename Name of the file to load from
+ * @param threads Number of threads, 0 for one per processor
+ * @param result Pointer to store the resulting data (must be freed with de430_free_data)
+ * @param count Number of objects loaded
+ * @return 0 on success, error code on failure
+ */
+int de430_load_from_binary_parallel(const char *filename, int threads, DE430EphemerisData **result, int *count);
 
 /**
- * Request ephemeris data from the Docker container
+ * Save ephemeris data as newline-delimited JSON
  *
- * @param config Configuration for the request
+ * Every line is a compact record holding object_name plus the members of
+ * a JSON point, so files can be appended to and split at any newline.
+ *
+ * @param data Array of ephemeris data to save
+ * @param count Number of objects in the array
+ * @param filename Name of the file to save to
+ * @return 0 on success, error code on failure
+ */
+int de430_save_to_ndjson(const DE430EphemerisData *data, int count, const char *filename);
+
+/**
+ * Load ephemeris data from a newline-delimited JSON file
+ *
+ * Objects appear in the order of their first record, and each object's
+ * points keep the order of their lines.
+ *
+ * @param filename Name of the file to load from
  * @param result Pointer to store the resulting data (must be freed with de430_free_data)
- * @param count Number of objects returned
+ * @param count Number of objects loaded
  * @return 0 on success, error code on failure
  */
-int de430_get_ephemeris(const DE430Config *config, DE430EphemerisData **result, int *count);
+int de430_load_from_ndjson(const char *filename, DE430EphemerisData **result, int *count);
 
 /**
- * Free memory allocated for ephemeris data
+ * Load ephemeris data from a newline-delimited JSON file, parsing chunks of
+ * the file on several threads
  *
- * @param data Array of ephemeris data to free
+ * The file is cut into fixed-size byte ranges, and each range parses the
+ * lines that start inside it. The result is the same as de430_load_from_ndjson.
+ *
+ * @param filename Name of the file to load from
+ * @param threads Number of threads, 0 for one per processor
+ * @param result Pointer to store the resulting data (must be freed with de430_free_data)
+ * @param count Number of objects loaded
+ * @return 0 on success, error code on failure
+ */
+int de430_load_from_ndjson_parallel(const char *filename, int threads, DE430EphemerisData **result, int *count);
+
+/**
+ * Open a streaming sink that writes the JSON format
+ *
+ * @param filename Name of the file to write
+ * @param sink Sink to initialize (must be released with de430_sink_close)
+ * @return 0 on success, error code on failure
+ */
+int de430_sink_open_json(const char *filename, DE430Sink *sink);
+
+/**
+ * Open a streaming sink that writes columnar JSON
+ *
+ * Points are spooled per object, and the columns are written on end().
+ *
+ * @param filename Name of the file to write
+ * @param sink Sink to initialize (must be released with de430_sink_close)
+ * @return 0 on success, error code on failure
+ */
+int de430_sink_open_json_columnar(const char *filename, DE430Sink *sink);
+
+/**
+ * Open a streaming sink that writes the CSV format
+ *
+ * @param filename Name of the file to write
+ * @param sink Sink to initialize (must be released with de430_sink_close)
+ * @return 0 on success, error code on failure
+ */
+int de430_sink_open_csv(const char *filename, DE430Sink *sink);
+
+/**
+ * Open a streaming sink that writes the binary format
+ *
+ * @param filename Name of the file to write
+ * @param sink Sink to initialize (must be released with de430_sink_close)
+ * @return 0 on success, error code on failure
+ */
+int de430_sink_open_binary(const char *filename, DE430Sink *sink);
+
+/**
+ * Open a streaming sink that writes newline-delimited JSON
+ *
+ * Each point is written as soon as it arrives, so objects may be
+ * interleaved freely.
+ *
+ * @param filename Name of the file to write
+ * @param append Non-zero to add records to the end of an existing file
+ * @param sink Sink to initialize (must be released with de430_sink_close)
+ * @return 0 on success, error code on failure
+ */
+int de430_sink_open_ndjson(const char *filename, int append, DE430Sink *sink);
+
+/**
+ * Open a sink that forwards everything it receives to several target sinks
+ *
+ * Each target encodes on a thread of its own. Chunks are copied into one
+ * of two shared buffers, so the producer fills the next chunk while the
+ * targets are still encoding the previous one, and a slow target holds the
+ * others back by at most one chunk. The targets' end() calls also run on
+ * their threads. Targets are not closed with the tee and must outlive it.
+ *
+ * @param targets Sinks to forward to
+ * @param target_count Number of targets
+ * @param sink Sink to initialize (must be released with de430_sink_close)
+ * @return 0 on success, error code on failure
+ */
+int de430_sink_open_tee(DE430Sink *targets, int target_count, DE430Sink *sink);
+
+/**
+ * Write the same data to several sinks in a single pass
+ *
+ * The sinks run begin(), write() and end() through a tee (see
+ * de430_sink_open_tee), so exporting to several formats takes about as long
+ * as the slowest one. The sinks are not closed by this call.
+ *
+ * @param data Array of ephemeris data to export
  * @param count Number of objects in the array
+ * @param sinks Sinks to write
+ * @param sink_count Number of sinks
+ * @return 0 on success, error code on failure
  */
-void de430_free_data(DE430EphemerisData *data, int count);
+int de430_export_to_sinks(const DE430EphemerisData *data, int count, DE430Sink *sinks, int sink_count);
 
 /**
- * Get error message for a given error code
+ * Release a sink and any resources it still holds
  *
- * @param error_code Error code returned by de430_get_ephemeris
- * @return String describing the error
+ * @param sink Sink to close
  */
-const char* de430_get_error(int error_code);
+void de430_sink_close(DE430Sink *sink);
+
+/**
+ * Handle to a binary archive opened for selective loading
+ *
+ * Opening reads only the file header and object directory (version 1
+ * files have no directory and are scanned once). Objects are then loaded
+ * and released individually. An archive handle is not thread-safe.
+ */
+typedef struct DE430Archive DE430Archive;
+
+/**
+ * Open a binary archive and read its object directory
+ *
+ * @param filename Name of the binary file
+ * @param archive Pointer to store the handle (must be freed with de430_archive_close)
+ * @return 0 on success, error code on failure
+ */
+int de430_archive_open(const char *filename, DE430Archive **archive);
+
+/**
+ * Get the number of objects in an archive
+ *
+ * @param archive Archive to query
+ * @return Number of objects
+ */
+int de430_archive_object_count(const DE430Archive *archive);
+
+/**
+ * Get the name of an archived object
+ *
+ * @param archive Archive to query
+ * @param index Object index, 0 to de430_archive_object_count() - 1
+ * @return Object name, or NULL if the index is out of range
+ */
+const char* de430_archive_object_name(const DE430Archive *archive, int index);
+
+/**
+ * Get the number of points stored for an archived object
+ *
+ * @param archive Archive to query
+ * @param index Object index, 0 to de430_archive_object_count() - 1
+ * @return Number of points, or -1 if the index is out of range
+ */
+int de430_archive_point_count(const DE430Archive *archive, int index);
+
+/**
+ * Find an archived object by name
+ *
+ * @param archive Archive to search
+ * @param name Object name
+ * @return Object index, or -1 if the object is not in the archive
+ */
+int de430_archive_find_object(const DE430Archive *archive, const char *name);
+
+/**
+ * Load one object, reading only its own records
+ *
+ * The data stays owned by the archive until it is released or the
+ * archive is closed; loading a resident object again returns it as is.
+ *
+ * @param archive Archive to load from
+ * @param name Object name
+ * @param object Pointer to store the loaded object
+ * @return 0 on success, error code on failure
+ */
+int de430_archive_load_object(DE430Archive *archive, const char *name, const DE430EphemerisData **object);
+
+/**
+ * Load a set of objects into a caller-owned result
+ *
+ * @param archive Archive to load from
+ * @param names Names of the objects to load
+ * @param name_count Number of names
+ * @param result Pointer to store the resulting data (must be freed with de430_free_data)
+ * @param count Number of objects loaded
+ * @return 0 on success, error code on failure
+ */
+int de430_archive_load_objects(DE430Archive *archive, const char *const *names, int name_count,
+                               DE430EphemerisData **result, int *count);
+
+/**
+ * Free the data of a loaded object
+ *
+ * @param archive Archive the object was loaded from
+ * @param name Object name
+ * @return 0 on success, error code on failure
+ */
+int de430_archive_release_object(DE430Archive *archive, const char *name);
+
+/**
+ * Close an archive and free every object still loaded from it
+ *
+ * @param archive Archive to close
+ */
+void de430_archive_close(DE430Archive *archive);
+
+/**
+ * File formats understood by the readers
+ */
+typedef enum {
+    DE430_FORMAT_JSON,
+    DE430_FORMAT_CSV,
+    DE430_FORMAT_BINARY
+} DE430Format;
+
+/**
+ * Order in which a chunk reader hands out points
+ */
+typedef enum {
+    DE430_ORDER_BY_OBJECT,      // One object after another, a chunk never mixes objects
+    DE430_ORDER_BY_TIME         // All objects merged by Julian date
+} DE430ChunkOrder;
+
+/**
+ * A batch of points returned by a chunk reader. The arrays belong to the
+ * reader and are overwritten by the next call.
+ */
+typedef struct {
+    const DE430EphemerisPoint *points;  // Points of the chunk
+    const int *object_indices;          // Object index of each point
+    int count;                          // Number of points, 0 once the file is exhausted
+} DE430Chunk;
+
+/**
+ * Handle to a file being read chunk by chunk
+ *
+ * Opening indexes the objects of the file (one streaming pass for CSV,
+ * JSON and version 1 binary files); after that memory use depends on the
+ * chunk size and the number of objects, never on the size of the file.
+ * Reading in time order keeps one open file per object. A chunk reader
+ * is not thread-safe.
+ */
+typedef struct DE430ChunkReader DE430ChunkReader;
+
+/**
+ * Open a file for chunked reading
+ *
+ * @param filename Name of the file to read
+ * @param format Format of the file
+ * @param order Order of the points across chunks
+ * @param chunk_size Maximum number of points per chunk, 0 for STREAM_CHUNK_POINTS
+ * @param reader Pointer to store the handle (must be freed with de430_chunk_reader_close)
+ * @return 0 on success, error code on failure
+ */
+int de430_chunk_reader_open(const char *filename, DE430Format format, DE430ChunkOrder order,
+                            int chunk_size, DE430ChunkReader **reader);
+
+/**
+ * Get the number of objects in the file
+ *
+ * @param reader Reader to query
+ * @return Number of objects
+ */
+int de430_chunk_reader_object_count(const DE430ChunkReader *reader);
+
+/**
+ * Get the name of an object in the file
+ *
+ * @param reader Reader to query
+ * @param index Object index, as reported in DE430Chunk.object_indices
+ * @return Object name, or NULL if the index is out of range
+ */
+const char* de430_chunk_reader_object_name(const DE430ChunkReader *reader, int index);
+
+/**
+ * Read the next chunk of points
+ *
+ * @param reader Reader to read from
+ * @param chunk Chunk to fill; its count is 0 at the end of the file
+ * @return 0 on success, error code on failure
+ */
+int de430_chunk_reader_next(DE430ChunkReader *reader, DE430Chunk *chunk);
+
+/**
+ * Close a chunk reader and free its buffers
+ *
+ * @param reader Reader to close
+ */
+void de430_chunk_reader_close(DE430ChunkReader *reader);
+
+/**
+ * Numeric columns of a point, in storage order. A field indexes the
+ * doubles at the start of DE430EphemerisPoint.
+ */
+typedef enum {
+    DE430_FIELD_JD,
+    DE430_FIELD_POS_X,
+    DE430_FIELD_POS_Y,
+    DE430_FIELD_POS_Z,
+    DE430_FIELD_RA,
+    DE430_FIELD_DEC,
+    DE430_FIELD_MAGNITUDE,
+    DE430_FIELD_PHASE,
+    DE430_FIELD_ANGULAR_SIZE,
+    DE430_FIELD_PHYSICAL_SIZE,
+    DE430_FIELD_ALBEDO,
+    DE430_FIELD_SUN_DIST,
+    DE430_FIELD_EARTH_DIST,
+    DE430_FIELD_SUN_ANG_DIST,
+    DE430_FIELD_THETA_EDO,
+    DE430_FIELD_ECLIPTIC_LNG,
+    DE430_FIELD_ECLIPTIC_DIST,
+    DE430_FIELD_ECLIPTIC_LAT,
+    DE430_FIELD_COUNT
+} DE430Field;
+
+#define DE430_FILTER_MAX_RANGES 8
+
+/**
+ * Inclusive bounds on one field
+ */
+typedef struct {
+    DE430Field field;
+    double min;
+    double max;
+} DE430FieldRange;
+
+/**
+ * Row filter applied by the filtered loaders while decoding. A point is
+ * kept when every condition holds; NaN values never satisfy a range.
+ */
+typedef struct {
+    double jd_min;                          // Start Julian date, inclusive
+    double jd_max;                          // End Julian date, inclusive
+    DE430FieldRange ranges[DE430_FILTER_MAX_RANGES];
+    int range_count;
+    const char *const *objects;             // Objects to keep, NULL for all
+    int object_count;
+    const char *const *constellations;      // Constellations to keep, NULL for all
+    int constellation_count;
+} DE430Filter;
+
+/**
+ * Get the value of a numeric field of a point
+ *
+ * @param point Point to read
+ * @param field Field to read
+ * @return Field value
+ */
+double de430_point_field(const DE430EphemerisPoint *point, DE430Field field);
+
+/**
+ * Initialize a filter that accepts everything
+ *
+ * @param filter Filter to initialize
+ */
+void de430_init_filter(DE430Filter *filter);
+
+/**
+ * Add a range condition to a filter
+ *
+ * @param filter Filter to extend
+ * @param field Field to test
+ * @param min Smallest accepted value (-INFINITY for no lower bound)
+ * @param max Largest accepted value (INFINITY for no upper bound)
+ * @return 0 on success, error code if the filter is full or the field is invalid
+ */
+int de430_filter_add_range(DE430Filter *filter, DE430Field field, double min, double max);
+
+/**
+ * Test whether an object is selected by a filter
+ *
+ * @param filter Filter to apply
+ * @param object_name Object name
+ * @return 1 if the object is selected, 0 otherwise
+ */
+int de430_filter_match_object(const DE430Filter *filter, const char *object_name);
+
+/**
+ * Test whether a point passes a filter's row conditions
+ *
+ * @param filter Filter to apply
+ * @param point Point to test
+ * @return 1 if the point passes, 0 otherwise
+ */
+int de430_filter_match_point(const DE430Filter *filter, const DE430EphemerisPoint *point);
+
+/**
+ * Load the points of a JSON file that pass a filter
+ *
+ * The file is read incrementally and rejected points are never stored.
+ * Every selected object is returned, possibly with no points.
+ *
+ * @param filename Name of the file to load from
+ * @param filter Filter to apply, or NULL to keep everything
+ * @param result Pointer to store the resulting data (must be freed with de430_free_data)
+ * @param count Number of objects loaded
+ * @return 0 on success, error code on failure
+ */
+int de430_load_from_json_filtered(const char *filename, const DE430Filter *filter,
+                                  DE430EphemerisData **result, int *count);
+
+/**
+ * Load the points of a CSV file that pass a filter
+ *
+ * Every selected object that has rows in the file is returned, possibly
+ * with no points.
+ *
+ * @param filename Name of the file to load from
+ * @param filter Filter to apply, or NULL to keep everything
+ * @param result Pointer to store the resulting data (must be freed with de430_free_data)
+ * @param count Number of objects loaded
+ * @return 0 on success, error code on failure
+ */
+int de430_load_from_csv_filtered(const char *filename, const DE430Filter *filter,
+                                 DE430EphemerisData **result, int *count);
+
+/**
+ * Load the points of a binary file that pass a filter
+ *
+ * Unselected objects are skipped without decoding their records. Every
+ * selected object is returned, possibly with no points.
+ *
+ * @param filename Name of the file to load from
+ * @param filter Filter to apply, or NULL to keep everything
+ * @param result Pointer to store the resulting data (must be freed with de430_free_data)
+ * @param count Number of objects loaded
+ * @return 0 on success, error code on failure
+ */
+int de430_load_from_binary_filtered(const char *filename, const DE430Filter *filter,
+                                    DE430EphemerisData **result, int *count);
+
+/**
+ * Statistics of one block of an object's points in a version 2 archive
+ */
+typedef struct {
+    int first_point;                    // Index of the block's first point within the object
+    int point_count;                    // Number of points in the block
+    double min[DE430_FIELD_COUNT];      // Smallest value of each field, ignoring NaN
+    double max[DE430_FIELD_COUNT];      // Largest value of each field, ignoring NaN
+} DE430ZoneMap;
+
+/**
+ * Get the number of zone maps stored for an archived object
+ *
+ * @param archive Archive to query
+ * @param index Object index
+ * @return Number of blocks (0 if the file has no zone maps), or -1 if the index is out of range
+ */
+int de430_archive_zone_count(const DE430Archive *archive, int index);
+
+/**
+ * Get the zone map of one block
+ *
+ * @param archive Archive to query
+ * @param index Object index
+ * @param block Block index, 0 to de430_archive_zone_count() - 1
+ * @param zone Zone map to fill
+ * @return 0 on success, error code on failure
+ */
+int de430_archive_zone_map(DE430Archive *archive, int index, int block, DE430ZoneMap *zone);
+
+/**
+ * Test a block's zone map against a filter, including its constellation set
+ *
+ * @param archive Archive to query
+ * @param index Object index
+ * @param block Block index
+ * @param filter Filter to test
+ * @return 1 if the block may hold matching points, 0 if it holds none, negative error code on failure
+ */
+int de430_archive_zone_may_match(DE430Archive *archive, int index, int block, const DE430Filter *filter);
+
+/**
+ * Load the points of an archive that pass a filter into a caller-owned result
+ *
+ * Blocks ruled out by their zone maps are not read at all; the others
+ * are read with one positioned read each.
+ *
+ * @param archive Archive to load from
+ * @param filter Filter to apply, or NULL to keep everything
+ * @param result Pointer to store the resulting data (must be freed with de430_free_data)
+ * @param count Number of objects loaded
+ * @return 0 on success, error code on failure
+ */
+int de430_archive_load_filtered(DE430Archive *archive, const DE430Filter *filter,
+                                DE430EphemerisData **result, int *count);
+
+/**
+ * Options for the Arrow IPC writer
+ */
+typedef struct {
+    int batch_points;           // Most rows per record batch, 0 for one batch per object
+} DE430ArrowOptions;
+
+/**
+ * Initialize Arrow writer options with default values (one record batch per object)
+ *
+ * @param options Pointer to options structure to initialize
+ */
+void de430_init_arrow_options(DE430ArrowOptions *options);
+
+/**
+ * Save ephemeris data to an Apache Arrow IPC file (Feather v2)
+ *
+ * The table has an object_name column, one float64 column per DE430Field
+ * (named as in the CSV header) and a constellation column. Both string
+ * columns are dictionary-encoded, and every buffer is 64-byte aligned, so
+ * pyarrow, polars or DuckDB can memory-map the file without copying.
+ *
+ * @param data Array of ephemeris data to save
+ * @param count Number of objects in the array
+ * @param filename Name of the file to save to
+ * @return 0 on success, error code on failure
+ */
+int de430_save_to_arrow(const DE430EphemerisData *data, int count, const char *filename);
+
+/**
+ * Save ephemeris data to an Arrow IPC file using the given options
+ *
+ * @param data Array of ephemeris data to save
+ * @param count Number of objects in the array
+ * @param filename Name of the file to save to
+ * @param options Writer options, or NULL for the defaults
+ * @return 0 on success, error code on failure
+ */
+int de430_save_to_arrow_ex(const DE430EphemerisData *data, int count, const char *filename,
+                           const DE430ArrowOptions *options);
+
+/**
+ * Load ephemeris data from an Arrow IPC file
+ *
+ * Columns are matched by name, so files written by other tools load as long
+ * as they have an object_name string column; missing numeric columns are
+ * left at 0, null values become NaN, and unknown columns are ignored.
+ * Compressed files and nested column types are not supported.
+ *
+ * @param filename Name of the file to load from
+ * @param result Pointer to store the resulting data (must be freed with de430_free_data)
+ * @param count Number of objects loaded
+ * @return 0 on success, error code on failure
+ */
+int de430_load_from_arrow(const char *filename, DE430EphemerisData **result, int *count);
+
+/**
+ * Options for the NumPy writers
+ */
+typedef struct {
+    int structured;             // Write one points array of records mirroring DE430EphemerisPoint instead of one array per field
+} DE430NpyOptions;
+
+/**
+ * Initialize NumPy writer options with default values (one array per field)
+ *
+ * @param options Pointer to options structure to initialize
+ */
+void de430_init_npy_options(DE430NpyOptions *options);
+
+/**
+ * Save ephemeris data as NumPy .npy files in a directory
+ *
+ * The points of all objects are concatenated. object_names.npy (S64) and
+ * object_offsets.npy (int64, count + 1 entries) give the row range
+ * [offsets[i], offsets[i + 1]) of each object. The rows are either one
+ * float64 file per DE430Field (named as in the CSV header) plus
+ * constellation.npy (S32), or a single structured points.npy. Data starts
+ * on a 64-byte boundary, so np.load(..., mmap_mode='r') maps it directly.
+ *
+ * @param data Array of ephemeris data to save
+ * @param count Number of objects in the array
+ * @param directory Directory to write to, created if it does not exist
+ * @param options Writer options, or NULL for the defaults
+ * @return 0 on success, error code on failure
+ */
+int de430_save_to_npy(const DE430EphemerisData *data, int count, const char *directory,
+                      const DE430NpyOptions *options);
+
+/**
+ * Save ephemeris data as a NumPy .npz archive
+ *
+ * Holds the same arrays as de430_save_to_npy, as uncompressed zip entries
+ * whose data is 64-byte aligned within the file.
+ *
+ * @param data Array of ephemeris data to save
+ * @param count Number of objects in the array
+ * @param filename Name of the file to save to
+ * @param options Writer options, or NULL for the defaults
+ * @return 0 on success, error code on failure
+ */
+int de430_save_to_npz(const DE430EphemerisData *data, int count, const char *filename,
+                      const DE430NpyOptions *options);
+
+/**
+ * Initialize the DE430 configuration with default values
+ *
+ * @param config Pointer to configuration structure to initialize
+ */
+
+void de430_init_config(DE430Config *config);
+
+/**
+ * Request ephemeris data from the Docker container
+ *
+ * When config->memory_budget is set and the points would outgrow it, rows
+ * are written to temporary files as they are parsed. Each object's array
+ * is then a read-write memory mapping of its file rather than heap memory.
+ * It is accessed the same way and is still released with de430_free_data.
+ *
+ * @param config Configuration for the request
+ * @param result Pointer to store the resulting data (must be freed with de430_free_data)
+ * @param count Number of objects returned
+ * @return 0 on success, error code on failure
+ */
+int de430_get_ephemeris(const DE430Config *config, DE430EphemerisData **result, int *count);
+
+/**
+ * Request ephemeris data for a list of objects of any length
+ *
+ * The names are packed into backend requests that each fit the objects
+ * field of DE430Config, using at least one request per thread, and the
+ * requests run in parallel. config->objects is ignored.
+ *
+ * @param config Configuration for the dates, location and output options
+ * @param objects Object names (without commas or quotes)
+ * @param object_count Number of names
+ * @param threads Number of requests run at once, 0 for one per processor
+ * @param result Pointer to store the resulting data array, in the order of objects
+ * @param count Pointer to store the number of objects in the result
+ * @return 0 on success, error code on failure
+ */
+int de430_get_ephemeris_objects(const DE430Config *config, const char *const *objects, int object_count,
+                                int threads, DE430EphemerisData **result, int *count);
+
+/**
+ * Result arrays kept across requests. Objects and points are only
+ * reallocated when a request needs more room than an earlier one did, so
+ * repeated requests of the same shape do not touch the heap.
+ */
+typedef struct {
+    DE430EphemerisData *data;   // One entry per object of the last request
+    int count;                  // Number of objects in data
+    int capacity;               // Allocated entries of data
+    int *point_capacity;        // Allocated points of each entry
+} DE430ResultBuffer;
+
+/**
+ * Initialize an empty result buffer
+ *
+ * @param buffer Buffer to initialize
+ */
+void de430_result_buffer_init(DE430ResultBuffer *buffer);
+
+/**
+ * Request ephemeris data into a result buffer, reusing its memory
+ *
+ * The buffer's previous contents are replaced. Pointers into it stay valid
+ * unless the request needed more room.
+ *
+ * @param config Configuration for the request
+ * @param buffer Buffer receiving the objects and their points
+ * @return 0 on success, error code on failure
+ */
+int de430_get_ephemeris_into(const DE430Config *config, DE430ResultBuffer *buffer);
+
+/**
+ * Empty a result buffer without releasing its memory
+ *
+ * @param buffer Buffer to reset
+ */
+void de430_result_buffer_reset(DE430ResultBuffer *buffer);
+
+/**
+ * Release the memory of a result buffer and leave it empty
+ *
+ * @param buffer Buffer to free
+ */
+void de430_result_buffer_free(DE430ResultBuffer *buffer);
+
+/**
+ * Options for bulk generation jobs
+ */
+typedef struct {
+    int chunk_points;           // Dates per chunk, DE430_JOB_CHUNK_POINTS by default (at most 128 for jd_list jobs)
+    int threads;                // Chunks requested at once, 0 for one per processor
+} DE430JobOptions;
+
+/**
+ * Initialize job options with default values
+ *
+ * @param options Pointer to options structure to initialize
+ */
+void de430_init_job_options(DE430JobOptions *options);
+
+/**
+ * Generate a large request as a resumable job
+ *
+ * The dates of the request are split into chunks that are fetched in
+ * parallel. Each finished chunk is saved in the job directory as a binary
+ * file and recorded in a journal, and both are synced to disk. If the job
+ * is interrupted, running it again with the same configuration and
+ * directory fetches only the chunks that are missing. A directory that
+ * holds a job with a different configuration is rejected.
+ *
+ * @param config Configuration for the whole request
+ * @param directory Job directory, created if missing
+ * @param options Job options, or NULL for the defaults
+ * @return 0 once every chunk is complete, otherwise the first error (run again to resume)
+ */
+int de430_job_run(const DE430Config *config, const char *directory, const DE430JobOptions *options);
+
+/**
+ * Report how many chunks of a job are complete
+ *
+ * @param directory Job directory
+ * @param completed Receives the number of completed chunks
+ * @param total Receives the number of chunks in the job
+ * @return 0 on success, error code on failure
+ */
+int de430_job_progress(const char *directory, int *completed, int *total);
+
+/**
+ * Stream the points of a finished job to a sink, chunk by chunk in date order
+ *
+ * @param directory Job directory
+ * @param sink Sink receiving the points
+ * @return 0 on success, DE430_ERROR_INVALID_CONFIG if the job is not complete
+ */
+int de430_job_export(const char *directory, DE430Sink *sink);
+
+/**
+ * Cap the number of backend processes running at once
+ *
+ * Requests over the cap wait in one FIFO queue per priority class, and the
+ * head of the most urgent non-empty queue starts first. With a lock path
+ * the cap is shared by every process using the same path: slot i is held
+ * as an exclusive lock on "<lock_path>.<i>", which the system releases if
+ * the holder exits. Priorities order the waiting requests of this process.
+ * The cap can only be changed while no request is running or waiting.
+ *
+ * @param max_processes Maximum number of backend processes, 0 for no limit
+ * @param lock_path Prefix of the slot lock files, or NULL to limit this process only
+ * @return 0 on success, error code on failure
+ */
+int de430_set_backend_limit(int max_processes, const char *lock_path);
+
+/**
+ * Queue statistics of one priority class
+ */
+typedef struct {
+    unsigned long long admitted;    // Requests that have started a backend process
+    int waiting;                    // Requests queued right now
+    int running;                    // Backend processes running right now
+    double total_wait;              // Seconds spent queued by the admitted requests
+    double max_wait;                // Longest time queued, in seconds
+    double p50_wait;                // Median time queued, in seconds (within a factor of 2)
+    double p99_wait;                // 99th percentile time queued, in seconds (within a factor of 2)
+} DE430QueueStats;
+
+/**
+ * Get the queue statistics of a priority class since the last reset
+ *
+ * @param priority Priority class
+ * @param stats Receives the statistics
+ * @return 0 on success, DE430_ERROR_INVALID_CONFIG for an unknown class
+ */
+int de430_get_queue_stats(DE430Priority priority, DE430QueueStats *stats);
+
+/**
+ * Reset the admitted counts and wait times of every priority class
+ */
+void de430_reset_queue_stats(void);
+
+/**
+ * Request ephemeris data and stream it into a sink as it is parsed
+ *
+ * Points are handed to the sink in chunks of STREAM_CHUNK_POINTS while the
+ * backend is still running, so memory use does not depend on the size of
+ * the request. The sink is not closed by this call.
+ *
+ * @param config Configuration for the request
+ * @param sink Sink receiving the points
+ * @return 0 on success, error code on failure
+ */
+int de430_get_ephemeris_to_sink(const DE430Config *config, DE430Sink *sink);
+
+/**
+ * Free memory allocated for ephemeris data
+ *
+ * @param data Array of ephemeris data to free
+ * @param count Number of objects in the array
+ */
+void de430_free_data(DE430EphemerisData *data, int count);
+
+/**
+ * Get error message for a given error code
+ *
+ * @param error_code Error code returned by de430_get_ephemeris
+ * @return String describing the error
+ */
+const char* de430_get_error(int error_code);
+
+/**
+ * Allocation functions the library can be pointed at. The context given to
+ * de430_set_allocator is passed back on every call.
+ */
+typedef void* (*DE430MallocFn)(size_t size, void *context);
+typedef void* (*DE430ReallocFn)(void *ptr, size_t size, void *context);
+typedef void (*DE430FreeFn)(void *ptr, void *context);
+
+/**
+ * Route every allocation the library makes, including those of cJSON,
+ * through the given functions
+ *
+ * Must be called while the library holds no memory: before the first call,
+ * or after everything it returned has been freed. Memory returned by the
+ * library is released with the free function in effect at that time.
+ *
+ * @param malloc_fn Allocates a block, NULL for all three to restore malloc/realloc/free
+ * @param realloc_fn Resizes a block
+ * @param free_fn Releases a block
+ * @param context Passed to every call
+ * @return 0 on success, DE430_ERROR_INVALID_CONFIG if only some functions are given
+ */
+int de430_set_allocator(DE430MallocFn malloc_fn, DE430ReallocFn realloc_fn, DE430FreeFn free_fn, void *context);
+
+/**
+ * Allocation counters of the calling thread. Work the library hands to
+ * helper threads of a call is added to the caller's counters when the call
+ * returns, so resetting before a request and reading afterwards measures
+ * that request alone.
+ */
+typedef struct {
+    unsigned long long allocations;  // Successful malloc, calloc, realloc and strdup calls
+    unsigned long long frees;        // Blocks released
+    unsigned long long bytes;        // Bytes requested by those allocations
+} DE430AllocStats;
+
+/**
+ * Read the allocation counters of the calling thread
+ *
+ * @param stats Receives the counters
+ */
+void de430_get_alloc_stats(DE430AllocStats *stats);
+
+/**
+ * Zero the allocation counters of the calling thread
+ */
+void de430_reset_alloc_stats(void);
+
+/**
+ * Real-time position tracker.
+ *
+ * Keeps a short window of samples per object in ring buffers and refreshes
+ * it from the backend on a background thread, so current positions can be
+ * answered by interpolation without a backend call. Position queries are
+ * lock-free and may be issued from any number of threads.
+ */
+typedef struct DE430Tracker DE430Tracker;
+
+/**
+ * Get the current UTC time as a Julian date
+ *
+ * @return Julian date of the system clock
+ */
+double de430_jd_now(void);
+
+/**
+ * Create a tracker and perform the initial synchronous fill
+ *
+ * The objects, output format, observer site and sampling step (jd_step) are
+ * taken from the configuration; the time range is managed by the tracker.
+ *
+ * @param config Backend configuration for the tracked objects
+ * @param window_days Span of the sampled window, centred on the current time
+ * @param refresh_interval Seconds between background refreshes
+ * @param tracker Pointer to store the tracker (must be freed with de430_tracker_destroy)
+ * @return 0 on success, error code on failure
+ */
+int de430_tracker_create(const DE430Config *config, double window_days, double refresh_interval,
+                         DE430Tracker **tracker);
+
+/**
+ * Find the index of a tracked object
+ *
+ * @param tracker Tracker to search
+ * @param name Object name as given in the configuration
+ * @return Object index, or -1 if the object is not tracked
+ */
+int de430_tracker_find_object(const DE430Tracker *tracker, const char *name);
+
+/**
+ * Interpolate the position of a tracked object
+ *
+ * @param tracker Tracker to query
+ * @param object_index Index returned by de430_tracker_find_object
+ * @param jd Julian date, which must fall inside the sampled window
+ * @param position Output X, Y, Z position (AU)
+ * @return 0 on success, DE430_ERROR_OUT_OF_RANGE if jd is outside the window
+ */
+int de430_tracker_position_at(const DE430Tracker *tracker, int object_index, double jd,
+                              double position[3]);
+
+/**
+ * Interpolate the position of a tracked object at the current time
+ *
+ * @param tracker Tracker to query
+ * @param object_index Index returned by de430_tracker_find_object
+ * @param position Output X, Y, Z position (AU)
+ * @return 0 on success, error code on failure
+ */
+int de430_tracker_position_now(const DE430Tracker *tracker, int object_index, double position[3]);
+
+/**
+ * Get the result of the most recent background refresh
+ *
+ * @param tracker Tracker to query
+ * @return 0 if the last refresh succeeded, error code otherwise
+ */
+int de430_tracker_status(const DE430Tracker *tracker);
+
+/**
+ * Stop the refresh thread and free the tracker
+ *
+ * @param tracker Tracker to destroy
+ */
+void de430_tracker_destroy(DE430Tracker *tracker);
+
+/**
+ * Spatial index over loaded ephemerides for cone searches.
+ *
+ * Points are grouped into time buckets, and each bucket holds a k-d tree
+ * of the points' directions as unit vectors. A search only visits the
+ * buckets overlapping its time window, and only the tree nodes that can
+ * lie inside its cone. The index keeps object and point indices, not the
+ * points, so the data it was built from should stay around for lookups.
+ */
+typedef struct DE430SkyIndex DE430SkyIndex;
+
+/**
+ * A cone in the sky during a time window
+ */
+typedef struct {
+    double ra;                  // Cone centre right ascension (radians)
+    double dec;                 // Cone centre declination (radians)
+    double radius;              // Cone radius (radians)
+    double jd_min;              // First Julian date of the window
+    double jd_max;              // Last Julian date of the window
+} DE430ConeQuery;
+
+/**
+ * A point found by a cone search
+ */
+typedef struct {
+    int object_index;           // Index into the data the index was built from
+    int point_index;            // Index into that object's points
+    double separation;          // Distance from the cone centre (radians)
+} DE430SkyMatch;
+
+/**
+ * The points found by one cone search, ordered by object and point index
+ */
+typedef struct {
+    DE430SkyMatch *matches;
+    int count;
+} DE430SkyMatches;
+
+/**
+ * Build a sky index over every point with a valid RA/Dec
+ *
+ * @param data Objects to index
+ * @param count Number of objects
+ * @param bucket_days Width of the time buckets in days, 0 for 1 day
+ * @param threads Number of threads building buckets, 0 for one per processor
+ * @param index Receives the index (must be freed with de430_sky_index_free)
+ * @return 0 on success, error code on failure
+ */
+int de430_sky_index_build(const DE430EphemerisData *data, int count, double bucket_days, int threads,
+                          DE430SkyIndex **index);
+
+/**
+ * Get the number of points held by a sky index
+ *
+ * @param index Index to query
+ * @return Number of indexed points
+ */
+int de430_sky_index_point_count(const DE430SkyIndex *index);
+
+/**
+ * Find the points inside a cone during a time window
+ *
+ * @param index Index to search
+ * @param query Cone and time window
+ * @param result Receives the matches (must be freed with de430_sky_matches_free)
+ * @return 0 on success, error code on failure
+ */
+int de430_sky_index_search(const DE430SkyIndex *index, const DE430ConeQuery *query, DE430SkyMatches *result);
+
+/**
+ * Run many cone searches in parallel
+ *
+ * @param index Index to search
+ * @param queries Queries to run
+ * @param query_count Number of queries
+ * @param threads Number of threads, 0 for one per processor
+ * @param results Array of query_count entries receiving the matches of each query
+ *                (must be freed with de430_sky_matches_free)
+ * @return 0 on success, error code on failure
+ */
+int de430_sky_index_search_batch(const DE430SkyIndex *index, const DE430ConeQuery *queries, int query_count,
+                                 int threads, DE430SkyMatches *results);
+
+/**
+ * Free the matches of one or more searches
+ *
+ * @param results Search results
+ * @param count Number of results
+ */
+void de430_sky_matches_free(DE430SkyMatches *results, int count);
+
+/**
+ * Free a sky index
+ *
+ * @param index Index to free
+ */
+void de430_sky_index_free(DE430SkyIndex *index);
+
+/**
+ * Options for the conjunction finder
+ */
+typedef struct {
+    double max_separation;      // Report closest approaches below this separation (radians), 1 degree by default
+    int block_points;           // Samples per time block, DE430_CONJUNCTION_BLOCK_POINTS by default
+    int threads;                // Number of threads, 0 for one per processor
+} DE430ConjunctionOptions;
+
+/**
+ * A closest approach of two objects on the sky
+ */
+typedef struct {
+    int object_a;               // Index of the first object (object_a < object_b)
+    int object_b;               // Index of the second object
+    double jd;                  // Julian date of the closest approach
+    double separation;          // Angular separation at that time (radians)
+} DE430Conjunction;
+
+/**
+ * Initialize conjunction options with default values
+ *
+ * @param options Pointer to options structure to initialize
+ */
+void de430_init_conjunction_options(DE430ConjunctionOptions *options);
+
+/**
+ * Find the closest approaches of every pair of objects on the sky
+ *
+ * The objects must share the same dates, as the objects of one request
+ * do. The dates are split into blocks searched in parallel. Within a
+ * block, pairs whose declination ranges and bounding caps are too far
+ * apart are pruned. For the remaining pairs, each sampled minimum of the
+ * separation is refined on quadratic interpolations of the two tracks.
+ * Minima at the first or last date cannot be told apart from trends and
+ * are not reported.
+ *
+ * @param data Objects to search
+ * @param count Number of objects
+ * @param options Search options, or NULL for the defaults
+ * @param events Receives the closest approaches ordered by date (must be freed with de430_conjunctions_free)
+ * @param event_count Receives the number of closest approaches
+ * @return 0 on success, DE430_ERROR_INVALID_CONFIG if the objects have different dates
+ */
+int de430_find_conjunctions(const DE430EphemerisData *data, int count, const DE430ConjunctionOptions *options,
+                            DE430Conjunction **events, int *event_count);
+
+/**
+ * Free the closest approaches returned by de430_find_conjunctions
+ *
+ * @param events Events to free
+ */
+void de430_conjunctions_free(DE430Conjunction *events);
+
+/**
+ * Events found by de430_find_events. Angles are in radians, like RA/Dec.
+ */
+typedef enum {
+    DE430_EVENT_OPPOSITION,             // Elongation maximum beyond 90 degrees
+    DE430_EVENT_GREATEST_ELONGATION,    // Elongation maximum within 90 degrees
+    DE430_EVENT_CONJUNCTION,            // Elongation minimum (conjunction with the Sun)
+    DE430_EVENT_STATION,                // Ecliptic longitude stops moving (retrograde begins or ends)
+    DE430_EVENT_TYPE_COUNT
+} DE430EventType;
+
+#define DE430_EVENT_MASK(type) (1u << (type))
+#define DE430_EVENTS_ALL ((1u << DE430_EVENT_TYPE_COUNT) - 1)
+
+/**
+ * An event of one object
+ */
+typedef struct {
+    int object_index;           // Index of the object in the searched data
+    DE430EventType type;
+    double jd;                  // Julian date of the event
+    double value;               // Elongation (sun_ang_dist), or ecliptic longitude for stations
+    double jd_min;              // The event lies between jd_min and jd_max
+    double jd_max;
+} DE430Event;
+
+/**
+ * Find oppositions, conjunctions, greatest elongations and stations
+ *
+ * Events are bracketed by the extrema of sun_ang_dist and of the ecliptic
+ * longitude over the samples, then located by Brent's method on a cubic
+ * interpolation of the samples around each bracket. The samples must be
+ * dense enough that no two events of one kind fall between neighbouring
+ * samples; events at the first or last sample are not found.
+ *
+ * @param data Objects to search, with points in date order
+ * @param count Number of objects
+ * @param types Event types to report, a combination of DE430_EVENT_MASK values
+ * @param events Receives the events ordered by date (must be freed with de430_events_free)
+ * @param event_count Receives the number of events
+ * @return 0 on success, error code on failure
+ */
+int de430_find_events(const DE430EphemerisData *data, int count, unsigned types,
+                      DE430Event **events, int *event_count);
+
+/**
+ * Locate events precisely with backend requests around their brackets
+ *
+ * All brackets are narrowed together: each round halves every bracket
+ * with two new dates, requested for all events at once through jd_list.
+ * The number of backend requests grows with the precision wanted and the
+ * number of events, not with the density of the grid used to find them.
+ *
+ * @param config Configuration the events' data was requested with
+ * @param events Events from de430_find_events, updated in place
+ * @param event_count Number of events
+ * @param tolerance Bracket width in days at which to stop, e.g. 1e-5 (about a second)
+ * @return 0 on success, error code on failure
+ */
+int de430_refine_events(const DE430Config *config, DE430Event *events, int event_count, double tolerance);
+
+/**
+ * Free the events returned by de430_find_events
+ *
+ * @param events Events to free
+ */
+void de430_events_free(DE430Event *events);
+
+/**
+ * An observer site for rise, transit and set tables
+ */
+typedef struct {
+    char name[64];              // Site name, written to the table
+    double latitude;            // Latitude (degrees, north positive)
+    double longitude;           // Longitude (degrees, east positive)
+} DE430Site;
+
+/**
+ * Options for rise, transit and set tables
+ */
+typedef struct {
+    double horizon;             // Altitude of rising and setting (radians), -34 arcminutes by default
+    const double *horizons;     // Per-object altitudes overriding horizon (e.g. for the Sun or Moon), or NULL
+    double scan_step;           // Spacing of the altitude scan in days, one hour by default
+    int threads;                // Number of threads, 0 for one per processor
+} DE430RiseSetOptions;
+
+typedef enum {
+    DE430_RISE,
+    DE430_TRANSIT,              // Upper culmination, whether or not above the horizon
+    DE430_SET
+} DE430RiseSetType;
+
+/**
+ * One rise, transit or set
+ */
+typedef struct {
+    DE430RiseSetType type;
+    double jd;                  // Julian date of the event
+    double value;               // Azimuth for rise and set (from north through east), altitude for transit (radians)
+} DE430RiseSetEvent;
+
+/**
+ * Events of one object at one site, in date order
+ */
+typedef struct {
+    int site_index;
+    int object_index;
+    DE430RiseSetEvent *events;
+    int count;
+} DE430RiseSetTable;
+
+/**
+ * Initialize rise/set options with default values
+ *
+ * @param options Pointer to options structure to initialize
+ */
+void de430_init_rise_set_options(DE430RiseSetOptions *options);
+
+/**
+ * Compute rise, transit and set times of every object at every site
+ *
+ * Works from one geocentric dataset: RA/Dec are interpolated onto a scan
+ * grid once per object, then each site evaluates the altitude and hour
+ * angle of the whole grid and refines every sign change on the interpolated
+ * track. Sites are processed in parallel. Julian dates are taken as UT for
+ * sidereal time, and neither parallax nor refraction beyond the horizon
+ * altitude is applied, so the Moon needs its own horizon.
+ *
+ * @param data Objects with geocentric RA/Dec, points in date order
+ * @param count Number of objects
+ * @param sites Observer sites
+ * @param site_count Number of sites
+ * @param options Options, or NULL for the defaults
+ * @param tables Receives site_count * count tables, the table of object o at site s at s * count + o
+ *               (must be freed with de430_rise_set_tables_free)
+ * @return 0 on success, error code on failure
+ */
+int de430_rise_set_tables(const DE430EphemerisData *data, int count, const DE430Site *sites, int site_count,
+                          const DE430RiseSetOptions *options, DE430RiseSetTable **tables);
+
+/**
+ * Save rise/set tables as CSV
+ *
+ * One row per event: site, object, event (rise, transit or set), jd and
+ * value, in the units of DE430RiseSetEvent.
+ *
+ * @param tables Tables from de430_rise_set_tables
+ * @param table_count Number of tables
+ * @param data Objects the tables were computed from, for their names
+ * @param sites Sites the tables were computed for
+ * @param filename Name of the file to save to
+ * @return 0 on success, error code on failure
+ */
+int de430_save_rise_set_csv(const DE430RiseSetTable *tables, int table_count, const DE430EphemerisData *data,
+                            const DE430Site *sites, const char *filename);
+
+/**
+ * Free the tables returned by de430_rise_set_tables
+ *
+ * @param tables Tables to free
+ * @param table_count Number of tables
+ */
+void de430_rise_set_tables_free(DE430RiseSetTable *tables, int table_count);
+
+/**
+ * Direction used for angular separations
+ */
+typedef enum {
+    DE430_SEPARATION_RA_DEC,        // Directions from ra_dec
+    DE430_SEPARATION_POSITION       // Directions of the position vectors, as seen from their origin
+} DE430SeparationSource;
+
+/**
+ * Index of the pair (a, b), a < b, among the count * (count - 1) / 2 pairs
+ * of a packed upper-triangular separation matrix
+ */
+#define DE430_PAIR_INDEX(a, b, count) ((a) * (2 * (count) - (a) - 1) / 2 + (b) - (a) - 1)
+
+/**
+ * Reductions of the pairwise separations over all epochs, one entry per
+ * pair in DE430_PAIR_INDEX order. Angles are in radians.
+ */
+typedef struct {
+    int pair_count;
+    double *min_separation;     // Smallest sampled separation
+    double *min_jd;             // Epoch of the smallest separation
+    double *max_separation;     // Largest sampled separation
+    double *max_jd;             // Epoch of the largest separation
+    int *close_epochs;          // Epochs at which the pair is within the threshold
+} DE430SeparationSummary;
+
+/**
+ * Compute the separation matrix of one epoch
+ *
+ * @param data Objects sharing the same dates
+ * @param count Number of objects
+ * @param epoch Index of the date
+ * @param source Directions to compare
+ * @param matrix Receives count * (count - 1) / 2 separations in DE430_PAIR_INDEX order
+ * @return 0 on success, DE430_ERROR_INVALID_CONFIG if the objects have no such epoch
+ */
+int de430_separation_matrix(const DE430EphemerisData *data, int count, int epoch,
+                            DE430SeparationSource source, double *matrix);
+
+/**
+ * Compute the separation matrices of all epochs
+ *
+ * The result holds one packed matrix per epoch, the separation of pair p
+ * at epoch e at e * pair_count + p. It grows with epochs times pairs; use
+ * de430_separation_summary when only reductions are needed.
+ *
+ * @param data Objects sharing the same dates
+ * @param count Number of objects
+ * @param source Directions to compare
+ * @param threads Number of threads, 0 for one per processor
+ * @param tensor Receives the matrices (must be freed with de430_separation_tensor_free)
+ * @return 0 on success, DE430_ERROR_INVALID_CONFIG if the objects have different dates
+ */
+int de430_separation_tensor(const DE430EphemerisData *data, int count, DE430SeparationSource source,
+                            int threads, double **tensor);
+
+/**
+ * Reduce the pairwise separations over all epochs without storing them
+ *
+ * Rows of the matrix are processed in parallel, each running through every
+ * epoch. Epochs where a direction is undefined are skipped for that pair.
+ *
+ * @param data Objects sharing the same dates
+ * @param count Number of objects
+ * @param source Directions to compare
+ * @param threshold Separation counted in close_epochs (radians)
+ * @param threads Number of threads, 0 for one per processor
+ * @param summary Receives the reductions (must be freed with de430_separation_summary_free)
+ * @return 0 on success, DE430_ERROR_INVALID_CONFIG if the objects have different dates
+ */
+int de430_separation_summary(const DE430EphemerisData *data, int count, DE430SeparationSource source,
+                             double threshold, int threads, DE430SeparationSummary *summary);
+
+/**
+ * Free the matrices returned by de430_separation_tensor
+ *
+ * @param tensor Matrices to free
+ */
+void de430_separation_tensor_free(double *tensor);
+
+/**
+ * Free the arrays of a separation summary
+ *
+ * @param summary Summary to free; its fields are reset
+ */
+void de430_separation_summary_free(DE430SeparationSummary *summary);
 
 #endif //DE430_DOCKER_H
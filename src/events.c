@@ -0,0 +1,420 @@
+//
+// Event finder: oppositions, conjunctions with the Sun, greatest
+// elongations and stations, bracketed on a coarse grid and refined either
+// on interpolated samples or with a few targeted backend requests.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EVENT_INITIAL_CAPACITY 16
+#define EVENT_BRENT_ITERATIONS 100
+#define EVENT_BRENT_TOLERANCE 1e-9      // Days
+#define EVENT_LIST_CHUNK 128            // Dates per backend request, as for bulk jobs
+#define EVENT_MAX_ROUNDS 64
+#define EVENT_GOLDEN 0.3819660112501051
+
+// Difference of two angles, folded into (-pi, pi]
+static double event_wrap(double angle) {
+    angle = fmod(angle, 2.0 * M_PI);
+    if (angle > M_PI) angle -= 2.0 * M_PI;
+    if (angle <= -M_PI) angle += 2.0 * M_PI;
+    return angle;
+}
+
+static double event_sample(const DE430EphemerisPoint *point, int station) {
+    return station ? point->ecliptic[0] : point->sun_ang_dist;
+}
+
+// Cubic (or quadratic) through up to four samples, in days from the first
+typedef struct {
+    int nodes;
+    double tau[4];
+    double value[4];
+    double sign;                // +1 to find a minimum, -1 for a maximum
+} EventInterpolant;
+
+static double event_interpolate(const EventInterpolant *curve, double t) {
+    double sum = 0.0;
+    for (int k = 0; k < curve->nodes; k++) {
+        double basis = 1.0;
+        for (int j = 0; j < curve->nodes; j++) {
+            if (j != k) basis *= (t - curve->tau[j]) / (curve->tau[k] - curve->tau[j]);
+        }
+        sum += basis * curve->value[k];
+    }
+    return sum;
+}
+
+// Brent's minimization of the signed interpolant on [a, b]
+static double event_brent(const EventInterpolant *curve, double a, double b) {
+    double x = a + EVENT_GOLDEN * (b - a);
+    double w = x, v = x;
+    double fx = curve->sign * event_interpolate(curve, x);
+    double fw = fx, fv = fx;
+    double d = 0.0, e = 0.0;
+
+    for (int iteration = 0; iteration < EVENT_BRENT_ITERATIONS; iteration++) {
+        double m = 0.5 * (a + b);
+        double tol1 = EVENT_BRENT_TOLERANCE;
+        double tol2 = 2.0 * tol1;
+        if (fabs(x - m) <= tol2 - 0.5 * (b - a)) break;
+
+        int golden = 1;
+        if (fabs(e) > tol1) {
+            // Try a parabola through x, w and v
+            double r = (x - w) * (fx - fv);
+            double q = (x - v) * (fx - fw);
+            double p = (x - v) * q - (x - w) * r;
+            q = 2.0 * (q - r);
+            if (q > 0.0) p = -p;
+            q = fabs(q);
+            double previous = e;
+            e = d;
+            if (fabs(p) < fabs(0.5 * q * previous) && p > q * (a - x) && p < q * (b - x)) {
+                d = p / q;
+                double u = x + d;
+                if (u - a < tol2 || b - u < tol2) d = x < m ? tol1 : -tol1;
+                golden = 0;
+            }
+        }
+        if (golden) {
+            e = x < m ? b - x : a - x;
+            d = EVENT_GOLDEN * e;
+        }
+
+        double u = x + (fabs(d) >= tol1 ? d : (d > 0.0 ? tol1 : -tol1));
+        double fu = curve->sign * event_interpolate(curve, u);
+        if (fu <= fx) {
+            if (u < x) b = x; else a = x;
+            v = w; fv = fw;
+            w = x; fw = fx;
+            x = u; fx = fu;
+        } else {
+            if (u < x) a = u; else b = u;
+            if (fu <= fw || w == x) {
+                v = w; fv = fw;
+                w = u; fw = fu;
+            } else if (fu <= fv || v == x || v == w) {
+                v = u; fv = fu;
+            }
+        }
+    }
+
+    return x;
+}
+
+static int event_add(DE430Event **events, int *count, int *capacity, const DE430Event *event) {
+    if (*count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : EVENT_INITIAL_CAPACITY;
+        DE430Event *larger = de430_realloc(*events, (size_t)grown * sizeof(DE430Event));
+        if (!larger) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        *events = larger;
+        *capacity = grown;
+    }
+    (*events)[(*count)++] = *event;
+    return DE430_ERROR_NONE;
+}
+
+// Refine the extremum at sample k of one object's series
+static void event_locate(const DE430EphemerisData *object, int k, int station, double sign, DE430Event *event) {
+    // Samples k - 1 to k + 1 and one more on whichever side exists
+    int first = k - 1;
+    int nodes = 3;
+    if (k + 2 < object->count) {
+        nodes = 4;
+    } else if (k - 2 >= 0) {
+        first = k - 2;
+        nodes = 4;
+    }
+
+    EventInterpolant curve;
+    curve.nodes = nodes;
+    curve.sign = sign;
+    double origin = object->points[k].jd;
+    double centre = event_sample(&object->points[k], station);
+    for (int j = 0; j < nodes; j++) {
+        const DE430EphemerisPoint *point = &object->points[first + j];
+        double value = event_sample(point, station);
+        curve.tau[j] = point->jd - origin;
+        curve.value[j] = station ? centre + event_wrap(value - centre) : value;
+    }
+
+    double t = event_brent(&curve, object->points[k - 1].jd - origin, object->points[k + 1].jd - origin);
+    double value = event_interpolate(&curve, t);
+
+    event->jd = origin + t;
+    event->value = station ? fmod(value + 2.0 * M_PI, 2.0 * M_PI) : value;
+    event->jd_min = object->points[k - 1].jd;
+    event->jd_max = object->points[k + 1].jd;
+}
+
+static int event_compare(const void *a, const void *b) {
+    const DE430Event *ea = (const DE430Event*)a;
+    const DE430Event *eb = (const DE430Event*)b;
+    if (ea->jd != eb->jd) return ea->jd < eb->jd ? -1 : 1;
+    return (ea->object_index > eb->object_index) - (ea->object_index < eb->object_index);
+}
+
+int de430_find_events(const DE430EphemerisData *data, int count, unsigned types,
+                      DE430Event **events, int *event_count) {
+    if ((!data && count > 0) || count < 0 || !events || !event_count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430Event *found = NULL;
+    int found_count = 0;
+    int capacity = 0;
+    int status = DE430_ERROR_NONE;
+
+    const unsigned elongation_types = DE430_EVENT_MASK(DE430_EVENT_OPPOSITION) |
+                                      DE430_EVENT_MASK(DE430_EVENT_GREATEST_ELONGATION) |
+                                      DE430_EVENT_MASK(DE430_EVENT_CONJUNCTION);
+
+    for (int i = 0; status == DE430_ERROR_NONE && i < count; i++) {
+        const DE430EphemerisData *object = &data[i];
+
+        for (int k = 1; status == DE430_ERROR_NONE && k < object->count - 1; k++) {
+            const DE430EphemerisPoint *points = object->points;
+
+            if (types & elongation_types) {
+                double before = points[k - 1].sun_ang_dist;
+                double here = points[k].sun_ang_dist;
+                double after = points[k + 1].sun_ang_dist;
+
+                DE430EventType type = DE430_EVENT_TYPE_COUNT;
+                double sign = 0.0;
+                if (here >= before && here > after) {
+                    type = here > M_PI / 2.0 ? DE430_EVENT_OPPOSITION : DE430_EVENT_GREATEST_ELONGATION;
+                    sign = -1.0;
+                } else if (here <= before && here < after) {
+                    type = DE430_EVENT_CONJUNCTION;
+                    sign = 1.0;
+                }
+
+                if (type != DE430_EVENT_TYPE_COUNT && (types & DE430_EVENT_MASK(type))) {
+                    DE430Event event = {i, type, 0.0, 0.0, 0.0, 0.0};
+                    event_locate(object, k, 0, sign, &event);
+                    status = event_add(&found, &found_count, &capacity, &event);
+                }
+            }
+
+            if (status == DE430_ERROR_NONE && (types & DE430_EVENT_MASK(DE430_EVENT_STATION))) {
+                // The longitude turns around where its steps change sign
+                double step_in = event_wrap(points[k].ecliptic[0] - points[k - 1].ecliptic[0]);
+                double step_out = event_wrap(points[k + 1].ecliptic[0] - points[k].ecliptic[0]);
+
+                double sign = 0.0;
+                if (step_in > 0.0 && step_out <= 0.0) {
+                    sign = -1.0;
+                } else if (step_in < 0.0 && step_out >= 0.0) {
+                    sign = 1.0;
+                }
+
+                if (sign != 0.0) {
+                    DE430Event event = {i, DE430_EVENT_STATION, 0.0, 0.0, 0.0, 0.0};
+                    event_locate(object, k, 1, sign, &event);
+                    status = event_add(&found, &found_count, &capacity, &event);
+                }
+            }
+        }
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free(found);
+        return status;
+    }
+
+    if (found_count > 1) {
+        qsort(found, (size_t)found_count, sizeof(DE430Event), event_compare);
+    }
+    *events = found;
+    *event_count = found_count;
+    return DE430_ERROR_NONE;
+}
+
+// Backend refinement. Each open event keeps its bracket and the values at
+// its ends and middle; a round asks for the two quarter points.
+typedef struct {
+    double lo, hi;
+    double f_lo, f_mid, f_hi;   // Station longitudes are unwrapped around the event's value
+    double sign;                // +1 for a minimum, -1 for a maximum
+    int open;
+} EventBracket;
+
+typedef struct {
+    int event;
+    double jd;
+    double value;
+} EventProbe;
+
+typedef struct {
+    const DE430Config *config;
+    const DE430Event *events;
+    EventProbe *probes;
+    int probe_count;
+    double *dates;
+} EventRound;
+
+static int event_round_task(void *context, int index) {
+    EventRound *round = (EventRound*)context;
+    int first = index * EVENT_LIST_CHUNK;
+    int count = round->probe_count - first < EVENT_LIST_CHUNK ? round->probe_count - first : EVENT_LIST_CHUNK;
+
+    DE430Config config = *round->config;
+    config.jd_list = round->dates + first;
+    config.jd_list_count = count;
+
+    DE430EphemerisData *data = NULL;
+    int object_count = 0;
+    int status = de430_get_ephemeris(&config, &data, &object_count);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    for (int p = first; status == DE430_ERROR_NONE && p < first + count; p++) {
+        EventProbe *probe = &round->probes[p];
+        const DE430Event *event = &round->events[probe->event];
+        if (event->object_index >= object_count || data[event->object_index].count != count) {
+            status = DE430_ERROR_PARSE_FAILED;
+            break;
+        }
+
+        const DE430EphemerisPoint *point = &data[event->object_index].points[p - first];
+        if (event->type == DE430_EVENT_STATION) {
+            probe->value = event->value + event_wrap(point->ecliptic[0] - event->value);
+        } else {
+            probe->value = point->sun_ang_dist;
+        }
+    }
+
+    de430_free_data(data, object_count);
+    return status;
+}
+
+// Request every probe of a round, in chunks that fit one backend command
+static int event_run_round(const DE430Config *config, const DE430Event *events, EventProbe *probes,
+                           int probe_count, double *dates) {
+    for (int p = 0; p < probe_count; p++) {
+        dates[p] = probes[p].jd;
+    }
+
+    EventRound round = {config, events, probes, probe_count, dates};
+    int chunk_count = (probe_count + EVENT_LIST_CHUNK - 1) / EVENT_LIST_CHUNK;
+    return de430_parallel_for(chunk_count, 0, event_round_task, &round);
+}
+
+int de430_refine_events(const DE430Config *config, DE430Event *events, int event_count, double tolerance) {
+    if (!config || (!events && event_count > 0) || event_count < 0 || !(tolerance > 0.0)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+    if (event_count == 0) {
+        return DE430_ERROR_NONE;
+    }
+
+    EventBracket *brackets = de430_calloc((size_t)event_count, sizeof(EventBracket));
+    EventProbe *probes = de430_malloc((size_t)event_count * 3 * sizeof(EventProbe));
+    double *dates = de430_malloc((size_t)event_count * 3 * sizeof(double));
+    int status = DE430_ERROR_NONE;
+    if (!brackets || !probes || !dates) {
+        status = DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    // First round: the ends and middle of every bracket
+    int probe_count = 0;
+    for (int e = 0; status == DE430_ERROR_NONE && e < event_count; e++) {
+        if (!(events[e].jd_max > events[e].jd_min)) {
+            status = DE430_ERROR_INVALID_CONFIG;
+            break;
+        }
+        brackets[e].lo = events[e].jd_min;
+        brackets[e].hi = events[e].jd_max;
+        brackets[e].open = 1;
+        for (int j = 0; j < 3; j++) {
+            probes[probe_count++] = (EventProbe){e, brackets[e].lo + 0.5 * j * (brackets[e].hi - brackets[e].lo), 0.0};
+        }
+    }
+    if (status == DE430_ERROR_NONE) {
+        status = event_run_round(config, events, probes, probe_count, dates);
+    }
+    for (int e = 0; status == DE430_ERROR_NONE && e < event_count; e++) {
+        EventBracket *bracket = &brackets[e];
+        bracket->f_lo = probes[3 * e].value;
+        bracket->f_mid = probes[3 * e + 1].value;
+        bracket->f_hi = probes[3 * e + 2].value;
+        if (events[e].type == DE430_EVENT_STATION) {
+            // A station can be either a maximum or a minimum of the longitude
+            bracket->sign = bracket->f_mid > 0.5 * (bracket->f_lo + bracket->f_hi) ? -1.0 : 1.0;
+        } else {
+            bracket->sign = events[e].type == DE430_EVENT_CONJUNCTION ? 1.0 : -1.0;
+        }
+    }
+
+    // Then halve every open bracket around its best sample
+    for (int round = 0; status == DE430_ERROR_NONE && round < EVENT_MAX_ROUNDS; round++) {
+        probe_count = 0;
+        for (int e = 0; e < event_count; e++) {
+            EventBracket *bracket = &brackets[e];
+            if (bracket->open && bracket->hi - bracket->lo <= tolerance) bracket->open = 0;
+            if (!bracket->open) continue;
+
+            double width = bracket->hi - bracket->lo;
+            probes[probe_count++] = (EventProbe){e, bracket->lo + 0.25 * width, 0.0};
+            probes[probe_count++] = (EventProbe){e, bracket->lo + 0.75 * width, 0.0};
+        }
+        if (probe_count == 0) break;
+
+        status = event_run_round(config, events, probes, probe_count, dates);
+
+        for (int p = 0; status == DE430_ERROR_NONE && p < probe_count; p += 2) {
+            EventBracket *bracket = &brackets[probes[p].event];
+            double t[5] = {bracket->lo, probes[p].jd, 0.5 * (bracket->lo + bracket->hi), probes[p + 1].jd, bracket->hi};
+            double f[5] = {bracket->f_lo, probes[p].value, bracket->f_mid, probes[p + 1].value, bracket->f_hi};
+
+            int best = 1;
+            for (int j = 2; j <= 3; j++) {
+                if (bracket->sign * f[j] < bracket->sign * f[best]) best = j;
+            }
+
+            bracket->lo = t[best - 1];
+            bracket->hi = t[best + 1];
+            bracket->f_lo = f[best - 1];
+            bracket->f_mid = f[best];
+            bracket->f_hi = f[best + 1];
+        }
+    }
+
+    // Finish with the vertex of the parabola through the last three samples
+    for (int e = 0; status == DE430_ERROR_NONE && e < event_count; e++) {
+        const EventBracket *bracket = &brackets[e];
+        double h = 0.5 * (bracket->hi - bracket->lo);
+        double curvature = bracket->f_lo - 2.0 * bracket->f_mid + bracket->f_hi;
+        double offset = 0.0, value = bracket->f_mid;
+        if (curvature != 0.0) {
+            offset = h * (bracket->f_lo - bracket->f_hi) / (2.0 * curvature);
+            if (offset > h) offset = h;
+            if (offset < -h) offset = -h;
+            value = bracket->f_mid - (bracket->f_hi - bracket->f_lo) * (bracket->f_hi - bracket->f_lo) / (8.0 * curvature);
+        }
+
+        events[e].jd = bracket->lo + h + offset;
+        events[e].value = events[e].type == DE430_EVENT_STATION ? fmod(value + 2.0 * M_PI, 2.0 * M_PI) : value;
+        events[e].jd_min = bracket->lo;
+        events[e].jd_max = bracket->hi;
+    }
+
+    de430_free(brackets);
+    de430_free(probes);
+    de430_free(dates);
+    return status;
+}
+
+void de430_events_free(DE430Event *events) {
+    de430_free(events);
+}
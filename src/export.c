@@ -0,0 +1,299 @@
+//
+// Fan-out of one point stream to several sinks, each encoding on its own thread.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Points per chunk handed out by de430_export_to_sinks
+#define EXPORT_CHUNK_POINTS 4096
+
+// The producer fills one slot while the targets drain the other
+#define TEE_SLOT_COUNT 2
+
+typedef struct {
+    int object_index;
+    int count;
+    int capacity;
+    DE430EphemerisPoint *points;
+    int pending;                // Targets that have not consumed the slot yet
+} TeeSlot;
+
+typedef struct TeeState TeeState;
+
+typedef struct {
+    TeeState *tee;
+    DE430Sink *sink;
+    pthread_t thread;
+    long consumed;              // Chunks this target has finished
+    int status;                 // First error of this target
+    DE430AllocStats alloc_stats;  // Allocations of the worker, added to the joining thread
+} TeeTarget;
+
+struct TeeState {
+    TeeTarget *targets;
+    int target_count;
+    int started;                // Worker threads started and not yet joined
+
+    pthread_mutex_t lock;
+    pthread_cond_t filled;      // A chunk was published or the stream ended
+    pthread_cond_t drained;     // A slot was released by every target
+    TeeSlot slots[TEE_SLOT_COUNT];
+    long produced;              // Chunks published so far
+    int finished;               // No more chunks will be published
+};
+
+static void* tee_worker(void *arg) {
+    TeeTarget *target = (TeeTarget*)arg;
+    TeeState *tee = target->tee;
+
+    for (;;) {
+        pthread_mutex_lock(&tee->lock);
+        while (target->consumed == tee->produced && !tee->finished) {
+            pthread_cond_wait(&tee->filled, &tee->lock);
+        }
+        if (target->consumed == tee->produced) {
+            pthread_mutex_unlock(&tee->lock);
+            break;
+        }
+        TeeSlot *slot = &tee->slots[target->consumed % TEE_SLOT_COUNT];
+        pthread_mutex_unlock(&tee->lock);
+
+        // Encode outside the lock; a failed target keeps draining so the
+        // others are not held up
+        int status = DE430_ERROR_NONE;
+        if (target->status == DE430_ERROR_NONE) {
+            status = target->sink->write(target->sink->context, slot->object_index, slot->points, slot->count);
+        }
+
+        pthread_mutex_lock(&tee->lock);
+        if (status != DE430_ERROR_NONE) {
+            target->status = status;
+        }
+        target->consumed++;
+        if (--slot->pending == 0) {
+            pthread_cond_signal(&tee->drained);
+        }
+        pthread_mutex_unlock(&tee->lock);
+    }
+
+    // Finishing a format (assembling spooled objects) also runs here
+    if (target->status == DE430_ERROR_NONE && target->sink->end) {
+        target->status = target->sink->end(target->sink->context);
+    }
+
+    de430_get_alloc_stats(&target->alloc_stats);
+    return NULL;
+}
+
+// Stop accepting chunks, wait for every target and report the first error
+static int tee_join(TeeState *tee) {
+    if (!tee->started) return DE430_ERROR_NONE;
+
+    pthread_mutex_lock(&tee->lock);
+    tee->finished = 1;
+    pthread_cond_broadcast(&tee->filled);
+    pthread_mutex_unlock(&tee->lock);
+
+    int status = DE430_ERROR_NONE;
+    for (int i = 0; i < tee->started; i++) {
+        pthread_join(tee->targets[i].thread, NULL);
+        de430_alloc_stats_add(&tee->targets[i].alloc_stats);
+        if (status == DE430_ERROR_NONE) {
+            status = tee->targets[i].status;
+        }
+    }
+
+    tee->started = 0;
+    return status;
+}
+
+// Close targets that began but will never see a worker, so no output is
+// left half written
+static void tee_end_targets(TeeState *tee, int first, int last) {
+    for (int i = first; i < last; i++) {
+        DE430Sink *sink = tee->targets[i].sink;
+        if (sink->end) {
+            sink->end(sink->context);
+        }
+    }
+}
+
+static int tee_begin(void *context, const char *const *object_names, int object_count) {
+    TeeState *tee = (TeeState*)context;
+
+    for (int i = 0; i < tee->target_count; i++) {
+        DE430Sink *sink = tee->targets[i].sink;
+        int status = sink->begin ? sink->begin(sink->context, object_names, object_count) : DE430_ERROR_NONE;
+        if (status != DE430_ERROR_NONE) {
+            tee_end_targets(tee, 0, i);
+            return status;
+        }
+    }
+
+    tee->produced = 0;
+    tee->finished = 0;
+
+    for (int i = 0; i < tee->target_count; i++) {
+        tee->targets[i].consumed = 0;
+        tee->targets[i].status = DE430_ERROR_NONE;
+        if (pthread_create(&tee->targets[i].thread, NULL, tee_worker, &tee->targets[i]) != 0) {
+            // Let the threads already started run to completion and close
+            // the targets left without one
+            tee_join(tee);
+            tee_end_targets(tee, i, tee->target_count);
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        tee->started++;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+static int tee_write(void *context, int object_index, const DE430EphemerisPoint *points, int count) {
+    TeeState *tee = (TeeState*)context;
+    if (tee->started < tee->target_count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    pthread_mutex_lock(&tee->lock);
+    TeeSlot *slot = &tee->slots[tee->produced % TEE_SLOT_COUNT];
+    while (slot->pending > 0) {
+        pthread_cond_wait(&tee->drained, &tee->lock);
+    }
+
+    // A target that failed stops the stream at the next chunk
+    int status = DE430_ERROR_NONE;
+    for (int i = 0; i < tee->target_count && status == DE430_ERROR_NONE; i++) {
+        status = tee->targets[i].status;
+    }
+    pthread_mutex_unlock(&tee->lock);
+
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    // The slot is free, so it can be filled without holding the lock
+    if (slot->capacity < count) {
+        DE430EphemerisPoint *grown = de430_realloc(slot->points, count * sizeof(DE430EphemerisPoint));
+        if (!grown) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        slot->points = grown;
+        slot->capacity = count;
+    }
+    memcpy(slot->points, points, count * sizeof(DE430EphemerisPoint));
+    slot->object_index = object_index;
+    slot->count = count;
+
+    pthread_mutex_lock(&tee->lock);
+    slot->pending = tee->target_count;
+    tee->produced++;
+    pthread_cond_broadcast(&tee->filled);
+    pthread_mutex_unlock(&tee->lock);
+
+    return DE430_ERROR_NONE;
+}
+
+static int tee_end(void *context) {
+    return tee_join((TeeState*)context);
+}
+
+static void tee_destroy(void *context) {
+    TeeState *tee = (TeeState*)context;
+
+    tee_join(tee);
+
+    for (int i = 0; i < TEE_SLOT_COUNT; i++) {
+        de430_free(tee->slots[i].points);
+    }
+
+    pthread_mutex_destroy(&tee->lock);
+    pthread_cond_destroy(&tee->filled);
+    pthread_cond_destroy(&tee->drained);
+    de430_free(tee->targets);
+    de430_free(tee);
+}
+
+int de430_sink_open_tee(DE430Sink *targets, int target_count, DE430Sink *sink) {
+    if (!targets || target_count <= 0 || !sink) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    for (int i = 0; i < target_count; i++) {
+        if (!targets[i].write) {
+            return DE430_ERROR_INVALID_CONFIG;
+        }
+    }
+
+    TeeState *tee = de430_calloc(1, sizeof(TeeState));
+    if (!tee) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    tee->targets = de430_calloc(target_count, sizeof(TeeTarget));
+    if (!tee->targets) {
+        de430_free(tee);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    tee->target_count = target_count;
+    for (int i = 0; i < target_count; i++) {
+        tee->targets[i].tee = tee;
+        tee->targets[i].sink = &targets[i];
+    }
+
+    pthread_mutex_init(&tee->lock, NULL);
+    pthread_cond_init(&tee->filled, NULL);
+    pthread_cond_init(&tee->drained, NULL);
+
+    sink->begin = tee_begin;
+    sink->write = tee_write;
+    sink->end = tee_end;
+    sink->destroy = tee_destroy;
+    sink->context = tee;
+    return DE430_ERROR_NONE;
+}
+
+int de430_export_to_sinks(const DE430EphemerisData *data, int count, DE430Sink *sinks, int sink_count) {
+    if (!data || count <= 0 || !sinks || sink_count <= 0) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    const char **names = de430_malloc(count * sizeof(const char*));
+    if (!names) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+    for (int i = 0; i < count; i++) {
+        names[i] = data[i].object_name;
+    }
+
+    DE430Sink tee;
+    int status = de430_sink_open_tee(sinks, sink_count, &tee);
+    if (status == DE430_ERROR_NONE) {
+        status = tee.begin(tee.context, names, count);
+
+        // One pass over the data; every format encodes the same chunk
+        for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+            for (int first = 0; first < data[i].count && status == DE430_ERROR_NONE; first += EXPORT_CHUNK_POINTS) {
+                int n = data[i].count - first < EXPORT_CHUNK_POINTS ? data[i].count - first : EXPORT_CHUNK_POINTS;
+                status = tee.write(tee.context, i, &data[i].points[first], n);
+            }
+        }
+
+        // Always wait for the targets, even after a failure
+        int end_status = tee.end(tee.context);
+        if (status == DE430_ERROR_NONE) {
+            status = end_status;
+        }
+
+        de430_sink_close(&tee);
+    }
+
+    de430_free(names);
+    return status;
+}
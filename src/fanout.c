@@ -0,0 +1,123 @@
+//
+// Requests for object lists longer than DE430Config.objects can hold: the
+// names are packed into several backend requests that run in parallel.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Objects first to first + count - 1 of the list, requested together
+typedef struct {
+    int first;
+    int count;
+} ObjectBatch;
+
+typedef struct {
+    const DE430Config *config;
+    const char *const *objects;
+    const ObjectBatch *batches;
+    DE430EphemerisData *result;     // One entry per object, in list order
+} FanOut;
+
+static int fanout_batch_task(void *context, int index) {
+    FanOut *fanout = (FanOut*)context;
+    const ObjectBatch *batch = &fanout->batches[index];
+
+    DE430Config config = *fanout->config;
+    size_t length = 0;
+    for (int i = 0; i < batch->count; i++) {
+        const char *name = fanout->objects[batch->first + i];
+        size_t name_length = strlen(name);
+        if (i > 0) config.objects[length++] = ',';
+        memcpy(config.objects + length, name, name_length);
+        length += name_length;
+    }
+    config.objects[length] = '\0';
+
+    DE430EphemerisData *data = NULL;
+    int count = 0;
+    int status = de430_get_ephemeris(&config, &data, &count);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+    if (count != batch->count) {
+        de430_free_data(data, count);
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    // The points move over as they are; only the batch's own array is freed
+    memcpy(&fanout->result[batch->first], data, (size_t)count * sizeof(DE430EphemerisData));
+    de430_free(data);
+
+    return DE430_ERROR_NONE;
+}
+
+// Split the list into as few requests as the objects field allows, but no
+// fewer than there are threads to run them
+static int fanout_plan(const char *const *objects, int object_count, int threads, ObjectBatch *batches) {
+    const size_t field_size = sizeof(((DE430Config*)0)->objects);
+    int target = (object_count + threads - 1) / threads;
+    int batch_count = 0;
+    size_t length = 0;
+
+    for (int i = 0; i < object_count; i++) {
+        size_t name_length = strlen(objects[i]);
+        if (name_length == 0 || name_length >= field_size || strchr(objects[i], ',') || strchr(objects[i], '"')) {
+            return -1;
+        }
+
+        ObjectBatch *batch = batch_count > 0 ? &batches[batch_count - 1] : NULL;
+        if (!batch || batch->count == target || length + 1 + name_length >= field_size) {
+            batch = &batches[batch_count++];
+            batch->first = i;
+            batch->count = 0;
+            length = name_length;
+        } else {
+            length += 1 + name_length;
+        }
+        batch->count++;
+    }
+
+    return batch_count;
+}
+
+int de430_get_ephemeris_objects(const DE430Config *config, const char *const *objects, int object_count,
+                                int threads, DE430EphemerisData **result, int *count) {
+    if (!config || !objects || object_count <= 0 || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    if (threads <= 0) threads = de430_default_thread_count();
+    if (threads > object_count) threads = object_count;
+
+    ObjectBatch *batches = de430_malloc((size_t)object_count * sizeof(ObjectBatch));
+    DE430EphemerisData *data = de430_calloc((size_t)object_count, sizeof(DE430EphemerisData));
+    if (!batches || !data) {
+        de430_free(batches);
+        de430_free(data);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = DE430_ERROR_NONE;
+    int batch_count = fanout_plan(objects, object_count, threads, batches);
+    if (batch_count < 0) {
+        status = DE430_ERROR_INVALID_CONFIG;
+    } else {
+        FanOut fanout = {config, objects, batches, data};
+        status = de430_parallel_for(batch_count, threads, fanout_batch_task, &fanout);
+    }
+    de430_free(batches);
+
+    if (status != DE430_ERROR_NONE) {
+        // Entries of batches that never finished are still zeroed
+        de430_free_data(data, object_count);
+        return status;
+    }
+
+    *result = data;
+    *count = object_count;
+    return DE430_ERROR_NONE;
+}
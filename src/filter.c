@@ -0,0 +1,91 @@
+//
+// Row filters evaluated by the loaders while decoding.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+double de430_point_field(const DE430EphemerisPoint *point, DE430Field field) {
+    // The numeric members are laid out as consecutive doubles in field order
+    const double *values = (const double*)point;
+    return values[field];
+}
+
+void de430_init_filter(DE430Filter *filter) {
+    if (!filter) return;
+
+    memset(filter, 0, sizeof(DE430Filter));
+    filter->jd_min = -INFINITY;
+    filter->jd_max = INFINITY;
+}
+
+int de430_filter_add_range(DE430Filter *filter, DE430Field field, double min, double max) {
+    if (!filter || field < 0 || field >= DE430_FIELD_COUNT ||
+        filter->range_count >= DE430_FILTER_MAX_RANGES) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430FieldRange *range = &filter->ranges[filter->range_count++];
+    range->field = field;
+    range->min = min;
+    range->max = max;
+    return DE430_ERROR_NONE;
+}
+
+int de430_filter_match_object(const DE430Filter *filter, const char *object_name) {
+    if (!filter || !filter->objects) return 1;
+
+    for (int i = 0; i < filter->object_count; i++) {
+        if (strcmp(filter->objects[i], object_name) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int de430_filter_match_point(const DE430Filter *filter, const DE430EphemerisPoint *point) {
+    if (!filter) return 1;
+
+    // Written so that NaN fails every comparison
+    if (!(point->jd >= filter->jd_min && point->jd <= filter->jd_max)) {
+        return 0;
+    }
+
+    for (int i = 0; i < filter->range_count; i++) {
+        double value = de430_point_field(point, filter->ranges[i].field);
+        if (!(value >= filter->ranges[i].min && value <= filter->ranges[i].max)) {
+            return 0;
+        }
+    }
+
+    if (filter->constellations) {
+        for (int i = 0; i < filter->constellation_count; i++) {
+            if (strcmp(filter->constellations[i], point->constellation) == 0) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    return 1;
+}
+
+int de430_data_append(DE430EphemerisData *object, int *capacity, const DE430EphemerisPoint *point) {
+    if (object->count == *capacity) {
+        int new_capacity = *capacity > 0 ? *capacity * 2 : INITIAL_RESULTS_SIZE;
+        DE430EphemerisPoint *points = de430_realloc(object->points, new_capacity * sizeof(DE430EphemerisPoint));
+        if (!points) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        object->points = points;
+        *capacity = new_capacity;
+    }
+
+    object->points[object->count++] = *point;
+    return DE430_ERROR_NONE;
+}
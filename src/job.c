@@ -0,0 +1,451 @@
+//
+// Resumable bulk generation: a request split into chunks that are saved
+// and journaled one by one, so an interrupted job picks up where it stopped.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define JOB_HEADER_FILE "job.txt"
+#define JOB_JOURNAL_FILE "journal.log"
+#define JOB_HEADER_SIZE 2048
+#define JOB_PATH_SIZE 4096
+
+// Date lists travel on the backend command line at about 25 bytes per date,
+// so list jobs use chunks small enough to fit one command
+#define JOB_LIST_CHUNK_POINTS 128
+
+typedef struct {
+    DE430Config config;         // The whole request
+    const char *directory;
+    int chunk_points;
+    int total_points;
+    int chunk_count;
+
+    const int *pending;         // Chunk indices still to run
+    FILE *journal;
+    pthread_mutex_t journal_lock;
+} Job;
+
+void de430_init_job_options(DE430JobOptions *options) {
+    if (!options) return;
+
+    memset(options, 0, sizeof(DE430JobOptions));
+    options->chunk_points = DE430_JOB_CHUNK_POINTS;
+    options->threads = 0;
+}
+
+static int job_path(char *path, const char *directory, const char *name) {
+    if (snprintf(path, JOB_PATH_SIZE, "%s/%s", directory, name) >= JOB_PATH_SIZE) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+    return DE430_ERROR_NONE;
+}
+
+static int job_chunk_path(char *path, const char *directory, int chunk, const char *suffix) {
+    if (snprintf(path, JOB_PATH_SIZE, "%s/chunk-%06d.bin%s", directory, chunk, suffix) >= JOB_PATH_SIZE) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+    return DE430_ERROR_NONE;
+}
+
+// Flush a file, or a directory entry after a rename, to stable storage
+static int job_sync_path(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    int status = fsync(fd) == 0 ? DE430_ERROR_NONE : DE430_ERROR_FILE_IO;
+    close(fd);
+    return status;
+}
+
+// Number of dates in the request
+static int job_total_points(const DE430Config *config) {
+    if (config->jd_list && config->jd_list_count > 0) {
+        return config->jd_list_count;
+    }
+
+    double steps = floor((config->jd_max - config->jd_min) / config->jd_step + 1e-9);
+    return steps + 1.0 > INT32_MAX ? -1 : (int)steps + 1;
+}
+
+// Everything that determines the output, so a resumed run can check it is
+// continuing the same job
+static int job_format_header(const Job *job, char *header) {
+    const DE430Config *config = &job->config;
+
+    // Explicit date lists are identified by their length and an FNV-1a hash
+    uint64_t list_hash = 14695981039346656037ull;
+    if (config->jd_list) {
+        const unsigned char *bytes = (const unsigned char*)config->jd_list;
+        for (size_t i = 0; i < (size_t)config->jd_list_count * sizeof(double); i++) {
+            list_hash = (list_hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    int length = snprintf(header, JOB_HEADER_SIZE,
+                          "de430-job 1\n"
+                          "objects=%s\n"
+                          "jd_min=%.17g\njd_max=%.17g\njd_step=%.17g\n"
+                          "jd_list=%d:%016llx\n"
+                          "topocentric=%d %.17g %.17g\n"
+                          "epoch=%.17g\n"
+                          "output=%d %d %d\n"
+                          "chunk_points=%d\n"
+                          "chunks=%d\n",
+                          config->objects,
+                          config->jd_min, config->jd_max, config->jd_step,
+                          config->jd_list ? config->jd_list_count : 0, (unsigned long long)list_hash,
+                          config->enable_topocentric, config->latitude, config->longitude,
+                          config->epoch,
+                          config->output_format, config->use_orbital_elements, config->output_constellations,
+                          job->chunk_points,
+                          job->chunk_count);
+    return length > 0 && length < JOB_HEADER_SIZE ? DE430_ERROR_NONE : DE430_ERROR_INVALID_CONFIG;
+}
+
+// Read a job's header file into header, NUL-terminated
+static int job_read_header(const char *directory, char *header) {
+    char path[JOB_PATH_SIZE];
+    int status = job_path(path, directory, JOB_HEADER_FILE);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    size_t n = fread(header, 1, JOB_HEADER_SIZE - 1, fp);
+    status = ferror(fp) ? DE430_ERROR_FILE_IO : DE430_ERROR_NONE;
+    fclose(fp);
+    header[n] = '\0';
+    return status;
+}
+
+// Write the header file for a new job, or check it matches an existing one
+static int job_open_header(const Job *job) {
+    char header[JOB_HEADER_SIZE];
+    int status = job_format_header(job, header);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    char existing[JOB_HEADER_SIZE];
+    status = job_read_header(job->directory, existing);
+    if (status == DE430_ERROR_NONE) {
+        return strcmp(existing, header) == 0 ? DE430_ERROR_NONE : DE430_ERROR_INVALID_CONFIG;
+    }
+
+    char path[JOB_PATH_SIZE];
+    char temp[JOB_PATH_SIZE];
+    if (job_path(path, job->directory, JOB_HEADER_FILE) != DE430_ERROR_NONE ||
+        job_path(temp, job->directory, JOB_HEADER_FILE ".tmp") != DE430_ERROR_NONE) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    FILE *fp = fopen(temp, "w");
+    if (!fp) {
+        return DE430_ERROR_FILE_IO;
+    }
+    fputs(header, fp);
+    status = ferror(fp) || fflush(fp) != 0 || fsync(fileno(fp)) != 0 ? DE430_ERROR_FILE_IO : DE430_ERROR_NONE;
+    if (fclose(fp) != 0) {
+        status = DE430_ERROR_FILE_IO;
+    }
+
+    if (status == DE430_ERROR_NONE && rename(temp, path) != 0) {
+        status = DE430_ERROR_FILE_IO;
+    }
+    if (status == DE430_ERROR_NONE) {
+        status = job_sync_path(job->directory);
+    }
+    return status;
+}
+
+// Mark the chunks listed in the journal. A line cut short by a crash is ignored.
+static int job_read_journal(const char *directory, int chunk_count, unsigned char *done, int *completed) {
+    char path[JOB_PATH_SIZE];
+    int status = job_path(path, directory, JOB_JOURNAL_FILE);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    memset(done, 0, chunk_count);
+    *completed = 0;
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return errno == ENOENT ? DE430_ERROR_NONE : DE430_ERROR_FILE_IO;
+    }
+
+    char line[64];
+    while (fgets(line, sizeof(line), fp)) {
+        char *end;
+        long chunk = strtol(line, &end, 10);
+        if (end == line || *end != '\n' || chunk < 0 || chunk >= chunk_count) {
+            continue;
+        }
+        if (!done[chunk]) {
+            done[chunk] = 1;
+            (*completed)++;
+        }
+    }
+
+    fclose(fp);
+    return DE430_ERROR_NONE;
+}
+
+// Chunk count recorded in a job's header
+static int job_header_chunks(const char *header) {
+    const char *line = strstr(header, "\nchunks=");
+    return line ? atoi(line + strlen("\nchunks=")) : -1;
+}
+
+// Fetch one chunk, save it under a temporary name, move it into place and
+// only then journal it
+static int job_run_chunk(void *context, int index) {
+    Job *job = (Job*)context;
+    int chunk = job->pending[index];
+    int first = chunk * job->chunk_points;
+    int points = job->total_points - first < job->chunk_points ? job->total_points - first : job->chunk_points;
+
+    DE430Config request = job->config;
+    if (request.jd_list && request.jd_list_count > 0) {
+        request.jd_list = job->config.jd_list + first;
+        request.jd_list_count = points;
+    } else {
+        // Half a step past the last date, so rounding cannot add or drop one
+        request.jd_min = job->config.jd_min + first * job->config.jd_step;
+        request.jd_max = request.jd_min + (points - 0.5) * job->config.jd_step;
+    }
+
+    DE430EphemerisData *data = NULL;
+    int count = 0;
+    int status = de430_get_ephemeris(&request, &data, &count);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    // A backend that died part way produces short output rather than an error
+    for (int i = 0; i < count; i++) {
+        if (data[i].count != points) {
+            status = DE430_ERROR_PARSE_FAILED;
+        }
+    }
+
+    char temp[JOB_PATH_SIZE];
+    char path[JOB_PATH_SIZE];
+    if (status == DE430_ERROR_NONE &&
+        (job_chunk_path(temp, job->directory, chunk, ".tmp") != DE430_ERROR_NONE ||
+         job_chunk_path(path, job->directory, chunk, "") != DE430_ERROR_NONE)) {
+        status = DE430_ERROR_INVALID_CONFIG;
+    }
+    if (status == DE430_ERROR_NONE) {
+        status = de430_save_to_binary(data, count, temp);
+    }
+    de430_free_data(data, count);
+
+    if (status == DE430_ERROR_NONE) {
+        status = job_sync_path(temp);
+    }
+    if (status == DE430_ERROR_NONE && rename(temp, path) != 0) {
+        status = DE430_ERROR_FILE_IO;
+    }
+    if (status == DE430_ERROR_NONE) {
+        status = job_sync_path(job->directory);
+    }
+    if (status != DE430_ERROR_NONE) {
+        unlink(temp);
+        return status;
+    }
+
+    pthread_mutex_lock(&job->journal_lock);
+    fprintf(job->journal, "%d\n", chunk);
+    if (fflush(job->journal) != 0 || fsync(fileno(job->journal)) != 0) {
+        status = DE430_ERROR_FILE_IO;
+    }
+    pthread_mutex_unlock(&job->journal_lock);
+
+    return status;
+}
+
+int de430_job_run(const DE430Config *config, const char *directory, const DE430JobOptions *options) {
+    if (!config || !directory) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430JobOptions defaults;
+    if (!options) {
+        de430_init_job_options(&defaults);
+        options = &defaults;
+    }
+
+    int has_list = config->jd_list && config->jd_list_count > 0;
+    if (options->chunk_points <= 0 ||
+        (!has_list && (config->jd_step <= 0.0 || config->jd_max < config->jd_min))) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    Job job;
+    memset(&job, 0, sizeof(job));
+    job.config = *config;
+    job.directory = directory;
+    job.chunk_points = options->chunk_points;
+    if (has_list && job.chunk_points > JOB_LIST_CHUNK_POINTS) {
+        job.chunk_points = JOB_LIST_CHUNK_POINTS;
+    }
+    job.total_points = job_total_points(config);
+    if (job.total_points <= 0) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+    job.chunk_count = (int)(((int64_t)job.total_points + job.chunk_points - 1) / job.chunk_points);
+
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    int status = job_open_header(&job);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    unsigned char *done = de430_malloc(job.chunk_count);
+    int *pending = de430_malloc(job.chunk_count * sizeof(int));
+    if (!done || !pending) {
+        de430_free(done);
+        de430_free(pending);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int completed = 0;
+    status = job_read_journal(directory, job.chunk_count, done, &completed);
+
+    int pending_count = 0;
+    for (int k = 0; k < job.chunk_count; k++) {
+        if (!done[k]) pending[pending_count++] = k;
+    }
+    job.pending = pending;
+
+    char path[JOB_PATH_SIZE];
+    if (status == DE430_ERROR_NONE && pending_count > 0) {
+        status = job_path(path, directory, JOB_JOURNAL_FILE);
+        if (status == DE430_ERROR_NONE) {
+            job.journal = fopen(path, "a");
+            if (!job.journal) status = DE430_ERROR_FILE_IO;
+        }
+    }
+
+    if (status == DE430_ERROR_NONE && pending_count > 0) {
+        pthread_mutex_init(&job.journal_lock, NULL);
+        status = de430_parallel_for(pending_count, options->threads, job_run_chunk, &job);
+        pthread_mutex_destroy(&job.journal_lock);
+    }
+
+    if (job.journal && fclose(job.journal) != 0 && status == DE430_ERROR_NONE) {
+        status = DE430_ERROR_FILE_IO;
+    }
+    de430_free(done);
+    de430_free(pending);
+    return status;
+}
+
+int de430_job_progress(const char *directory, int *completed, int *total) {
+    if (!directory || !completed || !total) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    char header[JOB_HEADER_SIZE];
+    int status = job_read_header(directory, header);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    int chunk_count = job_header_chunks(header);
+    if (chunk_count <= 0) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    unsigned char *done = de430_malloc(chunk_count);
+    if (!done) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    status = job_read_journal(directory, chunk_count, done, completed);
+    de430_free(done);
+    if (status == DE430_ERROR_NONE) {
+        *total = chunk_count;
+    }
+    return status;
+}
+
+int de430_job_export(const char *directory, DE430Sink *sink) {
+    if (!directory || !sink || !sink->begin || !sink->write || !sink->end) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    int completed, total;
+    int status = de430_job_progress(directory, &completed, &total);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+    if (completed != total) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    // Chunks hold the same objects in the same order; the first names them
+    int object_count = 0;
+    for (int k = 0; k < total && status == DE430_ERROR_NONE; k++) {
+        char path[JOB_PATH_SIZE];
+        DE430EphemerisData *data = NULL;
+        int count = 0;
+
+        status = job_chunk_path(path, directory, k, "");
+        if (status == DE430_ERROR_NONE) {
+            status = de430_load_from_binary(path, &data, &count);
+        }
+        if (status != DE430_ERROR_NONE) {
+            break;
+        }
+
+        if (k == 0) {
+            const char **names = de430_malloc(count * sizeof(const char*));
+            if (!names) {
+                status = DE430_ERROR_MEMORY_ALLOCATION;
+            } else {
+                for (int i = 0; i < count; i++) {
+                    names[i] = data[i].object_name;
+                }
+                status = sink->begin(sink->context, names, count);
+                de430_free(names);
+            }
+            object_count = count;
+        } else if (count != object_count) {
+            status = DE430_ERROR_PARSE_FAILED;
+        }
+
+        for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+            status = sink->write(sink->context, i, data[i].points, data[i].count);
+        }
+        de430_free_data(data, count);
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = sink->end(sink->context);
+    }
+    return status;
+}
@@ -2,9 +2,11 @@
 // Created by Dmitry Popov on 18.05.2025.
 //
 #include "de430_parser.h"
+#include "de430_internal.h"
 #include "cJSON.h"
 #include "string.h"
 #include <stdio.h>
+#include <math.h>
 #include <stdlib.h>
 
 static cJSON* ephemeris_point_to_json(const DE430EphemerisPoint *point);
@@ -17,6 +19,8 @@ int de430_save_to_json(const DE430EphemerisData *data, int count, const char *fi
         return DE430_ERROR_INVALID_CONFIG;
     }
 
+    de430_alloc_use_for_cjson();
+
     // Create a root JSON object
     cJSON *root = cJSON_CreateObject();
     if (!root) {
@@ -56,7 +60,7 @@ int de430_save_to_json(const DE430EphemerisData *data, int count, const char *fi
     // Write to file
     FILE *fp = fopen(filename, "w");
     if (!fp) {
-        free(json_str);
+        de430_free(json_str);
         cJSON_Delete(root);
         return DE430_ERROR_FILE_IO;
     }
@@ -64,7 +68,7 @@ int de430_save_to_json(const DE430EphemerisData *data, int count, const char *fi
     fprintf(fp, "%s", json_str);
 
     fclose(fp);
-    free(json_str);
+    de430_free(json_str);
     cJSON_Delete(root);
 
     return DE430_ERROR_NONE;
@@ -87,7 +91,7 @@ int de430_load_from_json(const char *filename, DE430EphemerisData **result, int
     fseek(fp, 0, SEEK_SET);
 
     // Allocate memory for the file contents
-    char *json_str = (char*)malloc(file_size + 1);
+    char *json_str = (char*)de430_malloc(file_size + 1);
     if (!json_str) {
         fclose(fp);
         return DE430_ERROR_MEMORY_ALLOCATION;
@@ -98,7 +102,7 @@ int de430_load_from_json(const char *filename, DE430EphemerisData **result, int
     fclose(fp);
 
     if (read_size != (size_t)file_size) {
-        free(json_str);
+        de430_free(json_str);
         return DE430_ERROR_FILE_IO;
     }
 
@@ -106,8 +110,9 @@ int de430_load_from_json(const char *filename, DE430EphemerisData **result, int
     json_str[file_size] = '\0';
 
     // Parse the JSON
+    de430_alloc_use_for_cjson();
     cJSON *root = cJSON_Parse(json_str);
-    free(json_str);
+    de430_free(json_str);
 
     if (!root) {
         return DE430_ERROR_JSON_PARSE;
@@ -130,7 +135,7 @@ int de430_load_from_json(const char *filename, DE430EphemerisData **result, int
     }
 
     // Allocate memory for the result
-    *result = (DE430EphemerisData*)malloc(*count * sizeof(DE430EphemerisData));
+    *result = (DE430EphemerisData*)de430_malloc(*count * sizeof(DE430EphemerisData));
     if (!*result) {
         cJSON_Delete(root);
         return DE430_ERROR_MEMORY_ALLOCATION;
@@ -142,9 +147,9 @@ int de430_load_from_json(const char *filename, DE430EphemerisData **result, int
         if (!object) {
             // Clean up on failure
             for (int j = 0; j < i; j++) {
-                free((*result)[j].points);
+                de430_free((*result)[j].points);
             }
-            free(*result);
+            de430_free(*result);
             *result = NULL;
             cJSON_Delete(root);
             return DE430_ERROR_JSON_PARSE;
@@ -154,9 +159,9 @@ int de430_load_from_json(const char *filename, DE430EphemerisData **result, int
         if (status != DE430_ERROR_NONE) {
             // Clean up on failure
             for (int j = 0; j < i; j++) {
-                free((*result)[j].points);
+                de430_free((*result)[j].points);
             }
-            free(*result);
+            de430_free(*result);
             *result = NULL;
             cJSON_Delete(root);
             return status;
@@ -168,6 +173,130 @@ int de430_load_from_json(const char *filename, DE430EphemerisData **result, int
     return DE430_ERROR_NONE;
 }
 
+// Read one element of the "objects" array, whose opening brace has been read
+static int json_stream_read_object(DE430JsonStream *json, const DE430Filter *filter,
+                                   DE430EphemerisData *object, int *selected) {
+    int capacity = 0;
+    int named = 0;
+    DE430JsonToken token;
+
+    memset(object, 0, sizeof(DE430EphemerisData));
+    *selected = 1;
+
+    while ((token = de430_json_stream_next(json)) == DE430_JSON_STRING) {
+        if (strcmp(json->string, "object_name") == 0) {
+            if (de430_json_stream_next(json) != DE430_JSON_STRING) return DE430_ERROR_JSON_PARSE;
+            strncpy(object->object_name, json->string, sizeof(object->object_name) - 1);
+            *selected = de430_filter_match_object(filter, object->object_name);
+            named = 1;
+        } else if (strcmp(json->string, "points") == 0) {
+            if (de430_json_stream_next(json) != DE430_JSON_ARRAY_BEGIN) return DE430_ERROR_JSON_PARSE;
+
+            while ((token = de430_json_stream_next(json)) == DE430_JSON_OBJECT_BEGIN) {
+                // Points of an object already known to be unselected are only skipped
+                if (named && !*selected) {
+                    if (de430_json_stream_skip(json, token) != DE430_ERROR_NONE) return DE430_ERROR_JSON_PARSE;
+                    continue;
+                }
+
+                DE430EphemerisPoint point;
+                int status = de430_json_stream_read_point(json, &point);
+                if (status == DE430_ERROR_NONE && de430_filter_match_point(filter, &point)) {
+                    status = de430_data_append(object, &capacity, &point);
+                }
+                if (status != DE430_ERROR_NONE) return status;
+            }
+            if (token != DE430_JSON_ARRAY_END) return DE430_ERROR_JSON_PARSE;
+        } else if (de430_json_stream_skip(json, de430_json_stream_next(json)) != DE430_ERROR_NONE) {
+            return DE430_ERROR_JSON_PARSE;
+        }
+    }
+
+    return token == DE430_JSON_OBJECT_END ? DE430_ERROR_NONE : DE430_ERROR_JSON_PARSE;
+}
+
+int de430_load_from_json_filtered(const char *filename, const DE430Filter *filter,
+                                  DE430EphemerisData **result, int *count) {
+    if (!filename || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    DE430JsonStream json;
+    de430_json_stream_init(&json, fp);
+
+    DE430EphemerisData *objects = NULL;
+    int object_count = 0;
+    int object_capacity = 0;
+    int status = DE430_ERROR_JSON_PARSE;
+    DE430JsonToken token;
+
+    if (de430_json_stream_next(&json) != DE430_JSON_OBJECT_BEGIN) {
+        fclose(fp);
+        return DE430_ERROR_JSON_PARSE;
+    }
+
+    // Find the "objects" array, skipping everything else at the top level
+    while ((token = de430_json_stream_next(&json)) == DE430_JSON_STRING) {
+        int is_objects = strcmp(json.string, "objects") == 0;
+        token = de430_json_stream_next(&json);
+
+        if (!is_objects) {
+            if (de430_json_stream_skip(&json, token) != DE430_ERROR_NONE) break;
+            continue;
+        }
+        if (token != DE430_JSON_ARRAY_BEGIN) break;
+
+        status = DE430_ERROR_NONE;
+        while (status == DE430_ERROR_NONE && (token = de430_json_stream_next(&json)) == DE430_JSON_OBJECT_BEGIN) {
+            if (object_count == object_capacity) {
+                int new_capacity = object_capacity > 0 ? object_capacity * 2 : 16;
+                DE430EphemerisData *grown = de430_realloc(objects, new_capacity * sizeof(DE430EphemerisData));
+                if (!grown) {
+                    status = DE430_ERROR_MEMORY_ALLOCATION;
+                    break;
+                }
+                objects = grown;
+                object_capacity = new_capacity;
+            }
+
+            int selected;
+            status = json_stream_read_object(&json, filter, &objects[object_count], &selected);
+            if (status == DE430_ERROR_NONE && !selected) {
+                de430_free(objects[object_count].points);
+            } else {
+                object_count++;
+            }
+        }
+
+        if (status == DE430_ERROR_NONE && token != DE430_JSON_ARRAY_END) {
+            status = DE430_ERROR_JSON_PARSE;
+        }
+        break;
+    }
+
+    fclose(fp);
+
+    if (status == DE430_ERROR_NONE && !objects) {
+        // Nothing selected; still hand back a freeable array
+        objects = de430_calloc(1, sizeof(DE430EphemerisData));
+        if (!objects) status = DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free_data(objects, object_count);
+        return status;
+    }
+
+    *result = objects;
+    *count = object_count;
+    return DE430_ERROR_NONE;
+}
+
 // JSON conversion functions
 
 static cJSON* ephemeris_point_to_json(const DE430EphemerisPoint *point) {
@@ -380,7 +509,7 @@ static int json_to_ephemeris_data(cJSON *json, DE430EphemerisData *data) {
 
     // Allocate memory for points
     int point_count = cJSON_GetArraySize(points);
-    data->points = (DE430EphemerisPoint*)malloc(point_count * sizeof(DE430EphemerisPoint));
+    data->points = (DE430EphemerisPoint*)de430_malloc(point_count * sizeof(DE430EphemerisPoint));
     if (!data->points) {
         return DE430_ERROR_MEMORY_ALLOCATION;
     }
@@ -389,14 +518,14 @@ static int json_to_ephemeris_data(cJSON *json, DE430EphemerisData *data) {
     for (int i = 0; i < point_count; i++) {
         cJSON *point = cJSON_GetArrayItem(points, i);
         if (!point) {
-            free(data->points);
+            de430_free(data->points);
             data->points = NULL;
             return DE430_ERROR_JSON_PARSE;
         }
 
         int status = json_to_ephemeris_point(point, &data->points[i]);
         if (status != DE430_ERROR_NONE) {
-            free(data->points);
+            de430_free(data->points);
             data->points = NULL;
             return status;
         }
@@ -407,3 +536,186 @@ static int json_to_ephemeris_data(cJSON *json, DE430EphemerisData *data) {
     return DE430_ERROR_NONE;
 }
 
+
+
+// Streaming JSON output helpers
+
+// Write a number the way cJSON would read it back exactly
+static void json_write_number(FILE *fp, double value) {
+    if (isnan(value) || isinf(value)) {
+        fputs("null", fp);
+    } else {
+        fprintf(fp, "%.17g", value);
+    }
+}
+
+// Write a quoted, escaped JSON string
+static void json_write_string(FILE *fp, const char *value) {
+    fputc('"', fp);
+    for (const unsigned char *p = (const unsigned char*)value; *p; p++) {
+        switch (*p) {
+            case '"':  fputs("\\\"", fp); break;
+            case '\\': fputs("\\\\", fp); break;
+            case '\n': fputs("\\n", fp); break;
+            case '\r': fputs("\\r", fp); break;
+            case '\t': fputs("\\t", fp); break;
+            default:
+                if (*p < 0x20) {
+                    fprintf(fp, "\\u%04x", *p);
+                } else {
+                    fputc(*p, fp);
+                }
+        }
+    }
+    fputc('"', fp);
+}
+
+// Write "key":value for a number member, preceded by a comma unless first
+static void json_write_member(FILE *fp, const char *key, double value, int first) {
+    fprintf(fp, first ? "\"%s\":" : ",\"%s\":", key);
+    json_write_number(fp, value);
+}
+
+// Write a number array member
+static void json_write_array_member(FILE *fp, const char *key, const double *values, int count) {
+    fprintf(fp, ",\"%s\":[", key);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) fputc(',', fp);
+        json_write_number(fp, values[i]);
+    }
+    fputc(']', fp);
+}
+
+// Write a point with the same members as ephemeris_point_to_json
+static void json_write_point(FILE *fp, const DE430EphemerisPoint *point) {
+    fputc('{', fp);
+    json_write_member(fp, "jd", point->jd, 1);
+    json_write_member(fp, "magnitude", point->magnitude, 0);
+    json_write_member(fp, "phase", point->phase, 0);
+    json_write_member(fp, "angular_size", point->angular_size, 0);
+    json_write_member(fp, "physical_size", point->physical_size, 0);
+    json_write_member(fp, "albedo", point->albedo, 0);
+    json_write_member(fp, "sun_dist", point->sun_dist, 0);
+    json_write_member(fp, "earth_dist", point->earth_dist, 0);
+    json_write_member(fp, "sun_ang_dist", point->sun_ang_dist, 0);
+    json_write_member(fp, "theta_edo", point->theta_edo, 0);
+    fputs(",\"constellation\":", fp);
+    json_write_string(fp, point->constellation);
+    json_write_array_member(fp, "position", point->position, 3);
+    json_write_array_member(fp, "ra_dec", point->ra_dec, 2);
+    json_write_array_member(fp, "ecliptic", point->ecliptic, 3);
+    fputc('}', fp);
+}
+
+// Streaming JSON writer state. Each object's points are spooled as
+// JSON text and the document is assembled on end.
+typedef struct {
+    FILE *fp;
+    DE430Spool spool;
+    char (*names)[64];
+    int *counts;
+    int object_count;
+} JsonSinkState;
+
+static int json_sink_begin(void *context, const char *const *object_names, int object_count) {
+    JsonSinkState *state = (JsonSinkState*)context;
+    if (object_count <= 0 || state->names) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    state->names = de430_calloc(object_count, sizeof(*state->names));
+    state->counts = de430_calloc(object_count, sizeof(*state->counts));
+    if (!state->names || !state->counts) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (int i = 0; i < object_count; i++) {
+        strncpy(state->names[i], object_names[i], sizeof(state->names[i]) - 1);
+    }
+    state->object_count = object_count;
+
+    return de430_spool_open(&state->spool, object_count);
+}
+
+static int json_sink_write(void *context, int object_index, const DE430EphemerisPoint *points, int count) {
+    JsonSinkState *state = (JsonSinkState*)context;
+    if (object_index < 0 || object_index >= state->object_count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    FILE *fp = state->spool.files[object_index];
+    for (int j = 0; j < count; j++) {
+        if (state->counts[object_index] + j > 0) {
+            fputs(",\n", fp);
+        }
+        json_write_point(fp, &points[j]);
+    }
+
+    state->counts[object_index] += count;
+    return ferror(fp) ? DE430_ERROR_FILE_IO : DE430_ERROR_NONE;
+}
+
+static int json_sink_end(void *context) {
+    JsonSinkState *state = (JsonSinkState*)context;
+    FILE *fp = state->fp;
+
+    fprintf(fp, "{\"object_count\":%d,\"objects\":[\n", state->object_count);
+
+    for (int i = 0; i < state->object_count; i++) {
+        fputs(i > 0 ? ",\n{\"object_name\":" : "{\"object_name\":", fp);
+        json_write_string(fp, state->names[i]);
+        fprintf(fp, ",\"count\":%d,\"points\":[\n", state->counts[i]);
+
+        int status = de430_spool_copy(&state->spool, i, fp);
+        if (status != DE430_ERROR_NONE) {
+            return status;
+        }
+
+        fputs("]}", fp);
+    }
+
+    fputs("]}\n", fp);
+
+    int status = ferror(fp) ? DE430_ERROR_FILE_IO : DE430_ERROR_NONE;
+    if (fclose(fp) != 0) {
+        status = DE430_ERROR_FILE_IO;
+    }
+    state->fp = NULL;
+    return status;
+}
+
+static void json_sink_destroy(void *context) {
+    JsonSinkState *state = (JsonSinkState*)context;
+    if (!state) return;
+
+    if (state->fp) fclose(state->fp);
+    de430_spool_close(&state->spool);
+    de430_free(state->names);
+    de430_free(state->counts);
+    de430_free(state);
+}
+
+int de430_sink_open_json(const char *filename, DE430Sink *sink) {
+    if (!filename || !sink) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    JsonSinkState *state = de430_calloc(1, sizeof(JsonSinkState));
+    if (!state) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    state->fp = fopen(filename, "w");
+    if (!state->fp) {
+        de430_free(state);
+        return DE430_ERROR_FILE_IO;
+    }
+
+    sink->begin = json_sink_begin;
+    sink->write = json_sink_write;
+    sink->end = json_sink_end;
+    sink->destroy = json_sink_destroy;
+    sink->context = state;
+
+    return DE430_ERROR_NONE;
+}
\ No newline at end of file
@@ -0,0 +1,427 @@
+//
+// Columnar JSON: one array per field per object instead of one object per point.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Points read back from a spool file per pass when writing a column
+#define COLUMNAR_SPOOL_BATCH 4096
+
+// Fewest bytes one point can take in a file: a digit and a comma per field,
+// plus an empty constellation string
+#define COLUMNAR_MIN_POINT_BYTES (DE430_FIELD_COUNT * 2 + 3)
+
+// Column names, the same as the CSV header
+static const char *const columnar_field_names[DE430_FIELD_COUNT] = {
+    "jd", "pos_x", "pos_y", "pos_z", "ra", "dec", "magnitude", "phase", "angular_size",
+    "physical_size", "albedo", "sun_dist", "earth_dist", "sun_ang_dist", "theta_edo",
+    "ecliptic_lng", "ecliptic_dist", "ecliptic_lat"
+};
+
+// Write a number the way it reads back exactly, NaN as null
+static void columnar_write_number(FILE *fp, double value) {
+    if (isnan(value) || isinf(value)) {
+        fputs("null", fp);
+    } else {
+        fprintf(fp, "%.17g", value);
+    }
+}
+
+// Write a quoted, escaped JSON string
+static void columnar_write_string(FILE *fp, const char *value) {
+    fputc('"', fp);
+    for (const unsigned char *p = (const unsigned char*)value; *p; p++) {
+        switch (*p) {
+            case '"':  fputs("\\\"", fp); break;
+            case '\\': fputs("\\\\", fp); break;
+            case '\n': fputs("\\n", fp); break;
+            case '\r': fputs("\\r", fp); break;
+            case '\t': fputs("\\t", fp); break;
+            default:
+                if (*p < 0x20) {
+                    fprintf(fp, "\\u%04x", *p);
+                } else {
+                    fputc(*p, fp);
+                }
+        }
+    }
+    fputc('"', fp);
+}
+
+// Write the values of one column for a run of points. Column index
+// DE430_FIELD_COUNT is the constellation. first says whether the run starts
+// the array.
+static void columnar_write_values(FILE *fp, const DE430EphemerisPoint *points, int count,
+                                  int column, int first) {
+    for (int j = 0; j < count; j++) {
+        if (!first || j > 0) fputc(',', fp);
+        if (column == DE430_FIELD_COUNT) {
+            columnar_write_string(fp, points[j].constellation);
+        } else {
+            columnar_write_number(fp, de430_point_field(&points[j], (DE430Field)column));
+        }
+    }
+}
+
+static void columnar_write_column_begin(FILE *fp, int column) {
+    fputs(",\n\"", fp);
+    fputs(column == DE430_FIELD_COUNT ? "constellation" : columnar_field_names[column], fp);
+    fputs("\":[", fp);
+}
+
+static void columnar_write_object_begin(FILE *fp, int index, const char *name, int count) {
+    fputs(index > 0 ? ",\n{\"object_name\":" : "{\"object_name\":", fp);
+    columnar_write_string(fp, name);
+    fprintf(fp, ",\"count\":%d", count);
+}
+
+static void columnar_write_document_begin(FILE *fp, int object_count) {
+    fprintf(fp, "{\"layout\":\"columnar\",\"object_count\":%d,\"objects\":[\n", object_count);
+}
+
+int de430_save_to_json_columnar(const DE430EphemerisData *data, int count, const char *filename) {
+    if (!data || count <= 0 || !filename) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    columnar_write_document_begin(fp, count);
+    for (int i = 0; i < count; i++) {
+        columnar_write_object_begin(fp, i, data[i].object_name, data[i].count);
+        for (int column = 0; column <= DE430_FIELD_COUNT; column++) {
+            columnar_write_column_begin(fp, column);
+            columnar_write_values(fp, data[i].points, data[i].count, column, 1);
+            fputc(']', fp);
+        }
+        fputc('}', fp);
+    }
+    fputs("]}\n", fp);
+
+    int status = ferror(fp) ? DE430_ERROR_FILE_IO : DE430_ERROR_NONE;
+    if (fclose(fp) != 0) {
+        status = DE430_ERROR_FILE_IO;
+    }
+    return status;
+}
+
+// Streaming writer state. Points are spooled in binary per object, and each
+// column is produced on end by one pass over the object's spool file.
+typedef struct {
+    FILE *fp;
+    DE430Spool spool;
+    char (*names)[64];
+    int *counts;
+    int object_count;
+} ColumnarSinkState;
+
+static int columnar_sink_begin(void *context, const char *const *object_names, int object_count) {
+    ColumnarSinkState *state = (ColumnarSinkState*)context;
+    if (object_count <= 0 || state->names) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    state->names = de430_calloc(object_count, sizeof(*state->names));
+    state->counts = de430_calloc(object_count, sizeof(*state->counts));
+    if (!state->names || !state->counts) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (int i = 0; i < object_count; i++) {
+        strncpy(state->names[i], object_names[i], sizeof(state->names[i]) - 1);
+    }
+    state->object_count = object_count;
+
+    return de430_spool_open(&state->spool, object_count);
+}
+
+static int columnar_sink_write(void *context, int object_index, const DE430EphemerisPoint *points, int count) {
+    ColumnarSinkState *state = (ColumnarSinkState*)context;
+    if (object_index < 0 || object_index >= state->object_count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    FILE *fp = state->spool.files[object_index];
+    if (count > 0 && fwrite(points, sizeof(DE430EphemerisPoint), count, fp) != (size_t)count) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    state->counts[object_index] += count;
+    return DE430_ERROR_NONE;
+}
+
+// Write one column of an object from its spool file
+static int columnar_sink_copy_column(ColumnarSinkState *state, int index, int column,
+                                     DE430EphemerisPoint *batch) {
+    FILE *spool = state->spool.files[index];
+    if (fflush(spool) != 0 || fseek(spool, 0, SEEK_SET) != 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    columnar_write_column_begin(state->fp, column);
+    int remaining = state->counts[index];
+    while (remaining > 0) {
+        int n = remaining < COLUMNAR_SPOOL_BATCH ? remaining : COLUMNAR_SPOOL_BATCH;
+        if (fread(batch, sizeof(DE430EphemerisPoint), n, spool) != (size_t)n) {
+            return DE430_ERROR_FILE_IO;
+        }
+        columnar_write_values(state->fp, batch, n, column, remaining == state->counts[index]);
+        remaining -= n;
+    }
+    fputc(']', state->fp);
+
+    return DE430_ERROR_NONE;
+}
+
+static int columnar_sink_end(void *context) {
+    ColumnarSinkState *state = (ColumnarSinkState*)context;
+    FILE *fp = state->fp;
+
+    DE430EphemerisPoint *batch = de430_malloc(COLUMNAR_SPOOL_BATCH * sizeof(DE430EphemerisPoint));
+    if (!batch) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = DE430_ERROR_NONE;
+    columnar_write_document_begin(fp, state->object_count);
+    for (int i = 0; i < state->object_count && status == DE430_ERROR_NONE; i++) {
+        columnar_write_object_begin(fp, i, state->names[i], state->counts[i]);
+        for (int column = 0; column <= DE430_FIELD_COUNT && status == DE430_ERROR_NONE; column++) {
+            status = columnar_sink_copy_column(state, i, column, batch);
+        }
+        fputc('}', fp);
+    }
+    fputs("]}\n", fp);
+    de430_free(batch);
+
+    if (status == DE430_ERROR_NONE && ferror(fp)) {
+        status = DE430_ERROR_FILE_IO;
+    }
+    if (fclose(fp) != 0 && status == DE430_ERROR_NONE) {
+        status = DE430_ERROR_FILE_IO;
+    }
+    state->fp = NULL;
+    return status;
+}
+
+static void columnar_sink_destroy(void *context) {
+    ColumnarSinkState *state = (ColumnarSinkState*)context;
+    if (!state) return;
+
+    if (state->fp) fclose(state->fp);
+    de430_spool_close(&state->spool);
+    de430_free(state->names);
+    de430_free(state->counts);
+    de430_free(state);
+}
+
+int de430_sink_open_json_columnar(const char *filename, DE430Sink *sink) {
+    if (!filename || !sink) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    ColumnarSinkState *state = de430_calloc(1, sizeof(ColumnarSinkState));
+    if (!state) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    state->fp = fopen(filename, "w");
+    if (!state->fp) {
+        de430_free(state);
+        return DE430_ERROR_FILE_IO;
+    }
+
+    sink->begin = columnar_sink_begin;
+    sink->write = columnar_sink_write;
+    sink->end = columnar_sink_end;
+    sink->destroy = columnar_sink_destroy;
+    sink->context = state;
+
+    return DE430_ERROR_NONE;
+}
+
+// Map a member name to a column index, DE430_FIELD_COUNT for the
+// constellation, -1 if it is not a column
+static int columnar_column_index(const char *key) {
+    for (int f = 0; f < DE430_FIELD_COUNT; f++) {
+        if (strcmp(columnar_field_names[f], key) == 0) return f;
+    }
+    return strcmp(key, "constellation") == 0 ? DE430_FIELD_COUNT : -1;
+}
+
+// Resize an object's points to new_capacity, zeroing the new ones
+static int columnar_reserve(DE430EphemerisData *object, int *capacity, int new_capacity) {
+    if (new_capacity <= *capacity) {
+        return DE430_ERROR_NONE;
+    }
+
+    DE430EphemerisPoint *grown = de430_realloc(object->points, (size_t)new_capacity * sizeof(DE430EphemerisPoint));
+    if (!grown) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+    memset(grown + *capacity, 0, (size_t)(new_capacity - *capacity) * sizeof(DE430EphemerisPoint));
+
+    object->points = grown;
+    *capacity = new_capacity;
+    return DE430_ERROR_NONE;
+}
+
+// Read one column array straight into the points of an object
+static int columnar_read_column(DE430JsonStream *json, DE430EphemerisData *object, int *capacity,
+                                int column, int *length) {
+    size_t offset = column == DE430_FIELD_COUNT
+                    ? offsetof(DE430EphemerisPoint, constellation)
+                    : offsetof(DE430EphemerisPoint, jd) + (size_t)column * sizeof(double);
+    DE430JsonToken token;
+    int i = 0;
+
+    while ((token = de430_json_stream_next(json)) != DE430_JSON_ARRAY_END) {
+        if (i == *capacity) {
+            // Only when the object had no count, or a column is longer than it
+            if (*capacity > INT32_MAX / 2) return DE430_ERROR_MEMORY_ALLOCATION;
+            int status = columnar_reserve(object, capacity, *capacity > 0 ? *capacity * 2 : 1024);
+            if (status != DE430_ERROR_NONE) return status;
+        }
+
+        char *slot = (char*)&object->points[i] + offset;
+        if (column == DE430_FIELD_COUNT) {
+            if (token != DE430_JSON_STRING) return DE430_ERROR_JSON_PARSE;
+            strncpy(slot, json->string, sizeof(object->points[i].constellation) - 1);
+        } else {
+            if (token != DE430_JSON_NUMBER && token != DE430_JSON_LITERAL) return DE430_ERROR_JSON_PARSE;
+            memcpy(slot, &json->number, sizeof(double));
+        }
+        i++;
+    }
+
+    if (i > *length) *length = i;
+    return DE430_ERROR_NONE;
+}
+
+// Read one element of the "objects" array, whose opening brace has been read.
+// max_points bounds what the "count" hint may reserve up front.
+static int columnar_read_object(DE430JsonStream *json, DE430EphemerisData *object, int max_points) {
+    int capacity = 0;
+    int length = 0;
+    DE430JsonToken token;
+
+    memset(object, 0, sizeof(DE430EphemerisData));
+
+    while ((token = de430_json_stream_next(json)) == DE430_JSON_STRING) {
+        int column = columnar_column_index(json->string);
+
+        if (strcmp(json->string, "object_name") == 0) {
+            if (de430_json_stream_next(json) != DE430_JSON_STRING) return DE430_ERROR_JSON_PARSE;
+            strncpy(object->object_name, json->string, sizeof(object->object_name) - 1);
+        } else if (strcmp(json->string, "count") == 0) {
+            // Written ahead of the columns so they can be filled without growing.
+            // Only a hint: no more is reserved than the file could hold, and
+            // the columns still grow past it if they are longer.
+            if (de430_json_stream_next(json) != DE430_JSON_NUMBER) return DE430_ERROR_JSON_PARSE;
+            if (json->number < 0 || json->number > INT32_MAX) return DE430_ERROR_JSON_PARSE;
+            int hint = (int)json->number < max_points ? (int)json->number : max_points;
+            int status = columnar_reserve(object, &capacity, hint);
+            if (status != DE430_ERROR_NONE) return status;
+        } else if (column >= 0) {
+            if (de430_json_stream_next(json) != DE430_JSON_ARRAY_BEGIN) return DE430_ERROR_JSON_PARSE;
+            int status = columnar_read_column(json, object, &capacity, column, &length);
+            if (status != DE430_ERROR_NONE) return status;
+        } else if (de430_json_stream_skip(json, de430_json_stream_next(json)) != DE430_ERROR_NONE) {
+            return DE430_ERROR_JSON_PARSE;
+        }
+    }
+
+    object->count = length;
+    return token == DE430_JSON_OBJECT_END ? DE430_ERROR_NONE : DE430_ERROR_JSON_PARSE;
+}
+
+int de430_load_from_json_columnar(const char *filename, DE430EphemerisData **result, int *count) {
+    if (!filename || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    uint64_t file_size;
+    if (de430_file_size(fileno(fp), &file_size) != DE430_ERROR_NONE) {
+        fclose(fp);
+        return DE430_ERROR_FILE_IO;
+    }
+    uint64_t max_points = file_size / COLUMNAR_MIN_POINT_BYTES;
+    if (max_points > INT32_MAX) max_points = INT32_MAX;
+
+    DE430JsonStream json;
+    de430_json_stream_init(&json, fp);
+
+    DE430EphemerisData *objects = NULL;
+    int object_count = 0;
+    int object_capacity = 0;
+    int status = DE430_ERROR_JSON_PARSE;
+    DE430JsonToken token;
+
+    if (de430_json_stream_next(&json) != DE430_JSON_OBJECT_BEGIN) {
+        fclose(fp);
+        return DE430_ERROR_JSON_PARSE;
+    }
+
+    while ((token = de430_json_stream_next(&json)) == DE430_JSON_STRING) {
+        int is_objects = strcmp(json.string, "objects") == 0;
+        token = de430_json_stream_next(&json);
+
+        if (!is_objects) {
+            if (de430_json_stream_skip(&json, token) != DE430_ERROR_NONE) break;
+            continue;
+        }
+        if (token != DE430_JSON_ARRAY_BEGIN) break;
+
+        status = DE430_ERROR_NONE;
+        while (status == DE430_ERROR_NONE && (token = de430_json_stream_next(&json)) == DE430_JSON_OBJECT_BEGIN) {
+            if (object_count == object_capacity) {
+                int new_capacity = object_capacity > 0 ? object_capacity * 2 : 16;
+                DE430EphemerisData *grown = de430_realloc(objects, new_capacity * sizeof(DE430EphemerisData));
+                if (!grown) {
+                    status = DE430_ERROR_MEMORY_ALLOCATION;
+                    break;
+                }
+                objects = grown;
+                object_capacity = new_capacity;
+            }
+
+            // Counted even on failure so its points are freed below
+            status = columnar_read_object(&json, &objects[object_count], (int)max_points);
+            object_count++;
+        }
+
+        if (status == DE430_ERROR_NONE && token != DE430_JSON_ARRAY_END) {
+            status = DE430_ERROR_JSON_PARSE;
+        }
+        break;
+    }
+
+    fclose(fp);
+
+    if (status == DE430_ERROR_NONE && !objects) {
+        objects = de430_calloc(1, sizeof(DE430EphemerisData));
+        if (!objects) status = DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free_data(objects, object_count);
+        return status;
+    }
+
+    *result = objects;
+    *count = object_count;
+    return DE430_ERROR_NONE;
+}
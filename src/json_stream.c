@@ -0,0 +1,217 @@
+//
+// Incremental JSON tokenizer for reading documents that do not fit in memory.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+void de430_json_stream_init(DE430JsonStream *stream, FILE *fp) {
+    memset(stream, 0, sizeof(DE430JsonStream));
+    stream->fp = fp;
+}
+
+// Read a string body; the opening quote has been consumed
+static DE430JsonToken json_stream_string(DE430JsonStream *stream) {
+    size_t length = 0;
+    int c;
+
+    while ((c = getc(stream->fp)) != EOF && c != '"') {
+        if (c == '\\') {
+            c = getc(stream->fp);
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u': {
+                    char hex[5] = {0};
+                    if (fread(hex, 1, 4, stream->fp) != 4) return DE430_JSON_ERROR;
+                    long code = strtol(hex, NULL, 16);
+                    c = code < 0x80 ? (int)code : '?';
+                    break;
+                }
+                case EOF: return DE430_JSON_ERROR;
+                default: break; // '"', '\\' and '/' stand for themselves
+            }
+        }
+
+        if (length < sizeof(stream->string) - 1) {
+            stream->string[length++] = (char)c;
+        }
+    }
+
+    stream->string[length] = '\0';
+    return c == '"' ? DE430_JSON_STRING : DE430_JSON_ERROR;
+}
+
+DE430JsonToken de430_json_stream_next(DE430JsonStream *stream) {
+    int c;
+
+    // Separators carry no information for the readers built on this
+    do {
+        c = getc(stream->fp);
+    } while (c != EOF && (isspace(c) || c == ',' || c == ':'));
+
+    switch (c) {
+        case EOF: return DE430_JSON_EOF;
+        case '{': return DE430_JSON_OBJECT_BEGIN;
+        case '}': return DE430_JSON_OBJECT_END;
+        case '[': return DE430_JSON_ARRAY_BEGIN;
+        case ']': return DE430_JSON_ARRAY_END;
+        case '"': return json_stream_string(stream);
+        default: break;
+    }
+
+    if (c == '-' || c == '+' || c == '.' || isdigit(c)) {
+        char buffer[64];
+        size_t length = 0;
+        do {
+            if (length < sizeof(buffer) - 1) buffer[length++] = (char)c;
+            c = getc(stream->fp);
+        } while (c != EOF && (isdigit(c) || c == '.' || c == 'e' || c == 'E' || c == '-' || c == '+'));
+        if (c != EOF) ungetc(c, stream->fp);
+
+        buffer[length] = '\0';
+        stream->number = strtod(buffer, NULL);
+        return DE430_JSON_NUMBER;
+    }
+
+    if (isalpha(c)) {
+        char word[8];
+        size_t length = 0;
+        do {
+            if (length < sizeof(word) - 1) word[length++] = (char)c;
+            c = getc(stream->fp);
+        } while (c != EOF && isalpha(c));
+        if (c != EOF) ungetc(c, stream->fp);
+
+        word[length] = '\0';
+        if (strcmp(word, "true") == 0) {
+            stream->number = 1.0;
+        } else if (strcmp(word, "false") == 0) {
+            stream->number = 0.0;
+        } else if (strcmp(word, "null") == 0) {
+            stream->number = NAN;
+        } else {
+            return DE430_JSON_ERROR;
+        }
+        return DE430_JSON_LITERAL;
+    }
+
+    return DE430_JSON_ERROR;
+}
+
+int de430_json_stream_skip(DE430JsonStream *stream, DE430JsonToken token) {
+    if (token != DE430_JSON_OBJECT_BEGIN && token != DE430_JSON_ARRAY_BEGIN) {
+        return token > DE430_JSON_EOF ? DE430_ERROR_NONE : DE430_ERROR_JSON_PARSE;
+    }
+
+    // Skip until the matching close, counting nesting depth
+    int depth = 1;
+    while (depth > 0) {
+        token = de430_json_stream_next(stream);
+        if (token == DE430_JSON_OBJECT_BEGIN || token == DE430_JSON_ARRAY_BEGIN) {
+            depth++;
+        } else if (token == DE430_JSON_OBJECT_END || token == DE430_JSON_ARRAY_END) {
+            depth--;
+        } else if (token <= DE430_JSON_EOF) {
+            return DE430_ERROR_JSON_PARSE;
+        }
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+// Numeric point members and where they live in DE430EphemerisPoint
+static const struct {
+    const char *key;
+    size_t offset;
+    int count;
+} json_point_members[] = {
+    {"jd", offsetof(DE430EphemerisPoint, jd), 1},
+    {"position", offsetof(DE430EphemerisPoint, position), 3},
+    {"ra_dec", offsetof(DE430EphemerisPoint, ra_dec), 2},
+    {"magnitude", offsetof(DE430EphemerisPoint, magnitude), 1},
+    {"phase", offsetof(DE430EphemerisPoint, phase), 1},
+    {"angular_size", offsetof(DE430EphemerisPoint, angular_size), 1},
+    {"physical_size", offsetof(DE430EphemerisPoint, physical_size), 1},
+    {"albedo", offsetof(DE430EphemerisPoint, albedo), 1},
+    {"sun_dist", offsetof(DE430EphemerisPoint, sun_dist), 1},
+    {"earth_dist", offsetof(DE430EphemerisPoint, earth_dist), 1},
+    {"sun_ang_dist", offsetof(DE430EphemerisPoint, sun_ang_dist), 1},
+    {"theta_edo", offsetof(DE430EphemerisPoint, theta_edo), 1},
+    {"ecliptic", offsetof(DE430EphemerisPoint, ecliptic), 3},
+};
+
+int de430_json_point_member(const char *key, size_t *offset, int *count) {
+    const size_t member_count = sizeof(json_point_members) / sizeof(json_point_members[0]);
+    for (size_t m = 0; m < member_count; m++) {
+        if (strcmp(json_point_members[m].key, key) == 0) {
+            *offset = json_point_members[m].offset;
+            *count = json_point_members[m].count;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int de430_json_stream_read_point(DE430JsonStream *stream, DE430EphemerisPoint *point) {
+    memset(point, 0, sizeof(DE430EphemerisPoint));
+
+    for (;;) {
+        DE430JsonToken token = de430_json_stream_next(stream);
+        if (token == DE430_JSON_OBJECT_END) {
+            return DE430_ERROR_NONE;
+        }
+        if (token != DE430_JSON_STRING) {
+            return DE430_ERROR_JSON_PARSE;
+        }
+
+        char key[32];
+        strncpy(key, stream->string, sizeof(key) - 1);
+        key[sizeof(key) - 1] = '\0';
+
+        token = de430_json_stream_next(stream);
+
+        if (strcmp(key, "constellation") == 0 && token == DE430_JSON_STRING) {
+            strncpy(point->constellation, stream->string, sizeof(point->constellation) - 1);
+            continue;
+        }
+
+        size_t offset;
+        int value_count;
+        if (!de430_json_point_member(key, &offset, &value_count)) {
+            // Unknown member
+            if (de430_json_stream_skip(stream, token) != DE430_ERROR_NONE) {
+                return DE430_ERROR_JSON_PARSE;
+            }
+            continue;
+        }
+
+        double *values = (double*)((char*)point + offset);
+
+        if (token == DE430_JSON_NUMBER || token == DE430_JSON_LITERAL) {
+            values[0] = stream->number;
+        } else if (token == DE430_JSON_ARRAY_BEGIN) {
+            int i = 0;
+            while ((token = de430_json_stream_next(stream)) != DE430_JSON_ARRAY_END) {
+                if (token != DE430_JSON_NUMBER && token != DE430_JSON_LITERAL) {
+                    return DE430_ERROR_JSON_PARSE;
+                }
+                if (i < value_count) {
+                    values[i] = stream->number;
+                }
+                i++;
+            }
+        } else if (de430_json_stream_skip(stream, token) != DE430_ERROR_NONE) {
+            return DE430_ERROR_JSON_PARSE;
+        }
+    }
+}
@@ -48,20 +48,23 @@ int main() {
 
     printf("Received data for %d objects\n", object_count);
 
-    // Save in different formats
-    status = de430_save_to_json(data, object_count, "ephemeris.json");
-    if (status == 0) {
-        printf("Saved to JSON successfully\n");
-    }
+    // Save in different formats, all from one pass over the data
+    DE430Sink sinks[3];
+    memset(sinks, 0, sizeof(sinks));
+
+    status = de430_sink_open_json("ephemeris.json", &sinks[0]);
+    if (status == 0) status = de430_sink_open_csv("ephemeris.csv", &sinks[1]);
+    if (status == 0) status = de430_sink_open_binary("ephemeris.bin", &sinks[2]);
+    if (status == 0) status = de430_export_to_sinks(data, object_count, sinks, 3);
 
-    status = de430_save_to_csv(data, object_count, "ephemeris.csv");
     if (status == 0) {
-        printf("Saved to CSV successfully\n");
+        printf("Saved to JSON, CSV and binary successfully\n");
+    } else {
+        printf("Error saving: %s\n", de430_get_error(status));
     }
 
-    status = de430_save_to_binary(data, object_count, "ephemeris.bin");
-    if (status == 0) {
-        printf("Saved to binary successfully\n");
+    for (int i = 0; i < 3; i++) {
+        de430_sink_close(&sinks[i]);
     }
 
     // Free the original data
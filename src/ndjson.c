@@ -0,0 +1,622 @@
+//
+// Newline-delimited JSON: one compact record per point.
+//
+// Records are self-contained, so files can be appended to, split at any
+// newline and parsed in independent pieces.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bytes of the file handed to each parallel parsing task
+#define NDJSON_CHUNK_SIZE (4 * 1024 * 1024)
+
+// Longest record the writer produces is well under this
+#define NDJSON_LINE_SIZE 4096
+
+// ---------------------------------------------------------------------------
+// Writer
+// ---------------------------------------------------------------------------
+
+// Append a quoted, escaped JSON string of at most max_length bytes
+static char* ndjson_put_string(char *p, const char *value, size_t max_length) {
+    *p++ = '"';
+    for (size_t i = 0; i < max_length && value[i]; i++) {
+        unsigned char c = (unsigned char)value[i];
+        switch (c) {
+            case '"':  *p++ = '\\'; *p++ = '"'; break;
+            case '\\': *p++ = '\\'; *p++ = '\\'; break;
+            case '\n': *p++ = '\\'; *p++ = 'n'; break;
+            case '\r': *p++ = '\\'; *p++ = 'r'; break;
+            case '\t': *p++ = '\\'; *p++ = 't'; break;
+            default:
+                if (c < 0x20) {
+                    p += sprintf(p, "\\u%04x", c);
+                } else {
+                    *p++ = (char)c;
+                }
+        }
+    }
+    *p++ = '"';
+    return p;
+}
+
+// Append a number the way the loaders read it back exactly
+static char* ndjson_put_number(char *p, double value) {
+    if (isnan(value) || isinf(value)) {
+        memcpy(p, "null", 4);
+        return p + 4;
+    }
+    return p + sprintf(p, "%.17g", value);
+}
+
+static char* ndjson_put_member(char *p, const char *key, double value) {
+    p += sprintf(p, ",\"%s\":", key);
+    return ndjson_put_number(p, value);
+}
+
+static char* ndjson_put_array_member(char *p, const char *key, const double *values, int count) {
+    p += sprintf(p, ",\"%s\":[", key);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) *p++ = ',';
+        p = ndjson_put_number(p, values[i]);
+    }
+    *p++ = ']';
+    return p;
+}
+
+// Format one record, starting from the object's pre-encoded prefix.
+// Members match the points of the JSON format. Returns the line length.
+static size_t ndjson_format_point(char *line, const char *prefix, const DE430EphemerisPoint *point) {
+    char *p = line;
+    size_t prefix_length = strlen(prefix);
+    memcpy(p, prefix, prefix_length);
+    p += prefix_length;
+
+    p += sprintf(p, "\"jd\":");
+    p = ndjson_put_number(p, point->jd);
+    p = ndjson_put_array_member(p, "position", point->position, 3);
+    p = ndjson_put_array_member(p, "ra_dec", point->ra_dec, 2);
+    p = ndjson_put_member(p, "magnitude", point->magnitude);
+    p = ndjson_put_member(p, "phase", point->phase);
+    p = ndjson_put_member(p, "angular_size", point->angular_size);
+    p = ndjson_put_member(p, "physical_size", point->physical_size);
+    p = ndjson_put_member(p, "albedo", point->albedo);
+    p = ndjson_put_member(p, "sun_dist", point->sun_dist);
+    p = ndjson_put_member(p, "earth_dist", point->earth_dist);
+    p = ndjson_put_member(p, "sun_ang_dist", point->sun_ang_dist);
+    p = ndjson_put_member(p, "theta_edo", point->theta_edo);
+    p = ndjson_put_array_member(p, "ecliptic", point->ecliptic, 3);
+    memcpy(p, ",\"constellation\":", 17);
+    p = ndjson_put_string(p + 17, point->constellation, sizeof(point->constellation) - 1);
+    *p++ = '}';
+    *p++ = '\n';
+
+    return (size_t)(p - line);
+}
+
+// Streaming NDJSON writer state. Nothing is buffered per object, so points
+// of different objects may arrive in any order.
+typedef struct {
+    FILE *fp;
+    char (*prefixes)[NDJSON_LINE_SIZE / 4];     // {"object_name":"...", for each object
+    int object_count;
+    char line[NDJSON_LINE_SIZE];
+} NdjsonSinkState;
+
+static int ndjson_sink_begin(void *context, const char *const *object_names, int object_count) {
+    NdjsonSinkState *state = (NdjsonSinkState*)context;
+    if (object_count <= 0 || state->prefixes) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    state->prefixes = de430_calloc(object_count, sizeof(*state->prefixes));
+    if (!state->prefixes) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    // Names are limited to 63 bytes, which fit escaped
+    for (int i = 0; i < object_count; i++) {
+        char *p = state->prefixes[i];
+        memcpy(p, "{\"object_name\":", 15);
+        p = ndjson_put_string(p + 15, object_names[i], 63);
+        *p++ = ',';
+        *p = '\0';
+    }
+    state->object_count = object_count;
+
+    return DE430_ERROR_NONE;
+}
+
+static int ndjson_sink_write(void *context, int object_index, const DE430EphemerisPoint *points, int count) {
+    NdjsonSinkState *state = (NdjsonSinkState*)context;
+    if (object_index < 0 || object_index >= state->object_count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    for (int j = 0; j < count; j++) {
+        size_t length = ndjson_format_point(state->line, state->prefixes[object_index], &points[j]);
+        if (fwrite(state->line, 1, length, state->fp) != length) {
+            return DE430_ERROR_FILE_IO;
+        }
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+static int ndjson_sink_end(void *context) {
+    NdjsonSinkState *state = (NdjsonSinkState*)context;
+
+    int status = ferror(state->fp) ? DE430_ERROR_FILE_IO : DE430_ERROR_NONE;
+    if (fclose(state->fp) != 0) {
+        status = DE430_ERROR_FILE_IO;
+    }
+    state->fp = NULL;
+    return status;
+}
+
+static void ndjson_sink_destroy(void *context) {
+    NdjsonSinkState *state = (NdjsonSinkState*)context;
+    if (!state) return;
+
+    if (state->fp) fclose(state->fp);
+    de430_free(state->prefixes);
+    de430_free(state);
+}
+
+int de430_sink_open_ndjson(const char *filename, int append, DE430Sink *sink) {
+    if (!filename || !sink) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    NdjsonSinkState *state = de430_calloc(1, sizeof(NdjsonSinkState));
+    if (!state) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    state->fp = fopen(filename, append ? "a" : "w");
+    if (!state->fp) {
+        de430_free(state);
+        return DE430_ERROR_FILE_IO;
+    }
+
+    sink->begin = ndjson_sink_begin;
+    sink->write = ndjson_sink_write;
+    sink->end = ndjson_sink_end;
+    sink->destroy = ndjson_sink_destroy;
+    sink->context = state;
+
+    return DE430_ERROR_NONE;
+}
+
+int de430_save_to_ndjson(const DE430EphemerisData *data, int count, const char *filename) {
+    if (!data || count <= 0 || !filename) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    const char **names = de430_malloc(count * sizeof(const char*));
+    if (!names) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+    for (int i = 0; i < count; i++) {
+        names[i] = data[i].object_name;
+    }
+
+    DE430Sink sink;
+    int status = de430_sink_open_ndjson(filename, 0, &sink);
+    if (status == DE430_ERROR_NONE) {
+        status = sink.begin(sink.context, names, count);
+        for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+            status = sink.write(sink.context, i, data[i].points, data[i].count);
+        }
+        if (status == DE430_ERROR_NONE) {
+            status = sink.end(sink.context);
+        }
+        de430_sink_close(&sink);
+    }
+
+    de430_free(names);
+    return status;
+}
+
+// ---------------------------------------------------------------------------
+// Loader
+// ---------------------------------------------------------------------------
+
+// Objects found in one chunk of the file, in order of first appearance
+typedef struct {
+    DE430EphemerisData *objects;
+    int *capacities;
+    int object_count;
+    int object_capacity;
+    int last;                   // Object of the previous record
+} NdjsonPart;
+
+typedef struct {
+    int fd;
+    uint64_t file_size;
+    int chunk_count;
+    NdjsonPart *parts;
+} NdjsonLoad;
+
+static const char* ndjson_skip_space(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+    return p;
+}
+
+// Parse a string token into out (truncated to capacity - 1 bytes)
+static const char* ndjson_parse_string(const char *p, char *out, size_t capacity) {
+    if (*p != '"') return NULL;
+    p++;
+
+    size_t length = 0;
+    while (*p != '"') {
+        char c = *p++;
+        if (c == '\0' || c == '\n') return NULL;
+        if (c == '\\') {
+            c = *p++;
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u': {
+                    char hex[5] = {0};
+                    for (int i = 0; i < 4; i++) {
+                        if (*p == '\0' || *p == '\n') return NULL;
+                        hex[i] = *p++;
+                    }
+                    long code = strtol(hex, NULL, 16);
+                    c = code < 0x80 ? (char)code : '?';
+                    break;
+                }
+                case '\0':
+                case '\n':
+                    return NULL;
+                default: break; // '"', '\\' and '/' stand for themselves
+            }
+        }
+        if (length < capacity - 1) out[length++] = c;
+    }
+
+    out[length] = '\0';
+    return p + 1;
+}
+
+// Parse a number or literal; null reads as NaN
+static const char* ndjson_parse_number(const char *p, double *value) {
+    if (strncmp(p, "null", 4) == 0) {
+        *value = NAN;
+        return p + 4;
+    }
+    if (strncmp(p, "true", 4) == 0) {
+        *value = 1.0;
+        return p + 4;
+    }
+    if (strncmp(p, "false", 5) == 0) {
+        *value = 0.0;
+        return p + 5;
+    }
+
+    char *end;
+    *value = strtod(p, &end);
+    return end == p ? NULL : end;
+}
+
+// Skip a value of a member this library does not use
+static const char* ndjson_skip_value(const char *p) {
+    int depth = 0;
+    char scratch[2];
+
+    do {
+        p = ndjson_skip_space(p);
+        if (*p == '"') {
+            p = ndjson_parse_string(p, scratch, sizeof(scratch));
+            if (!p) return NULL;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+            p++;
+        } else if (*p == '}' || *p == ']') {
+            if (--depth < 0) return NULL;
+            p++;
+        } else if (*p == ',' || *p == ':') {
+            if (depth == 0) return NULL;
+            p++;
+        } else {
+            double value;
+            p = ndjson_parse_number(p, &value);
+            if (!p) return NULL;
+        }
+    } while (depth > 0);
+
+    return p;
+}
+
+// Parse one record; *name receives its object_name
+static const char* ndjson_parse_record(const char *p, char *name, size_t name_size, DE430EphemerisPoint *point) {
+    memset(point, 0, sizeof(DE430EphemerisPoint));
+    name[0] = '\0';
+    int has_name = 0;
+
+    p = ndjson_skip_space(p);
+    if (*p++ != '{') return NULL;
+
+    p = ndjson_skip_space(p);
+    if (*p == '}') return NULL;
+
+    for (;;) {
+        char key[32];
+        p = ndjson_parse_string(ndjson_skip_space(p), key, sizeof(key));
+        if (!p) return NULL;
+        p = ndjson_skip_space(p);
+        if (*p++ != ':') return NULL;
+        p = ndjson_skip_space(p);
+
+        size_t offset;
+        int count;
+        if (strcmp(key, "object_name") == 0) {
+            p = ndjson_parse_string(p, name, name_size);
+            has_name = 1;
+        } else if (strcmp(key, "constellation") == 0 && *p == '"') {
+            p = ndjson_parse_string(p, point->constellation, sizeof(point->constellation));
+        } else if (de430_json_point_member(key, &offset, &count)) {
+            double *values = (double*)((char*)point + offset);
+            if (*p == '[') {
+                p++;
+                for (int i = 0; p; i++) {
+                    p = ndjson_skip_space(p);
+                    if (*p == ']') {
+                        p++;
+                        break;
+                    }
+                    if (i > 0) {
+                        if (*p++ != ',') return NULL;
+                        p = ndjson_skip_space(p);
+                    }
+                    double value;
+                    p = ndjson_parse_number(p, &value);
+                    if (p && i < count) values[i] = value;
+                }
+            } else {
+                p = ndjson_parse_number(p, &values[0]);
+            }
+        } else {
+            p = ndjson_skip_value(p);
+        }
+        if (!p) return NULL;
+
+        p = ndjson_skip_space(p);
+        if (*p == '}') break;
+        if (*p++ != ',') return NULL;
+    }
+
+    return has_name ? p + 1 : NULL;
+}
+
+static int ndjson_part_object(NdjsonPart *part, const char *name) {
+    if (part->object_count > 0 && strcmp(part->objects[part->last].object_name, name) == 0) {
+        return part->last;
+    }
+
+    for (int i = 0; i < part->object_count; i++) {
+        if (strcmp(part->objects[i].object_name, name) == 0) {
+            part->last = i;
+            return i;
+        }
+    }
+
+    if (part->object_count == part->object_capacity) {
+        int capacity = part->object_capacity > 0 ? part->object_capacity * 2 : 16;
+        DE430EphemerisData *objects = de430_realloc(part->objects, capacity * sizeof(DE430EphemerisData));
+        if (!objects) return -1;
+        part->objects = objects;
+
+        int *capacities = de430_realloc(part->capacities, capacity * sizeof(int));
+        if (!capacities) return -1;
+        part->capacities = capacities;
+        part->object_capacity = capacity;
+    }
+
+    DE430EphemerisData *obj = &part->objects[part->object_count];
+    memset(obj, 0, sizeof(DE430EphemerisData));
+    strncpy(obj->object_name, name, sizeof(obj->object_name) - 1);
+    part->capacities[part->object_count] = 0;
+    part->last = part->object_count;
+    return part->object_count++;
+}
+
+// Read bytes [start, end) of the file plus the rest of the line that
+// crosses end, NUL-terminated
+static int ndjson_read_range(NdjsonLoad *load, uint64_t start, uint64_t end, char **text, size_t *length) {
+    size_t capacity = (size_t)(end - start) + 1024;
+    char *buffer = de430_malloc(capacity + 1);
+    if (!buffer) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    size_t used = (size_t)(end - start);
+    int status = de430_pread_all(load->fd, buffer, used, start);
+
+    // Extend until the last line is complete
+    while (status == DE430_ERROR_NONE && start + used < load->file_size &&
+           (used == 0 || buffer[used - 1] != '\n')) {
+        if (used == capacity) {
+            capacity *= 2;
+            char *grown = de430_realloc(buffer, capacity + 1);
+            if (!grown) {
+                status = DE430_ERROR_MEMORY_ALLOCATION;
+                break;
+            }
+            buffer = grown;
+        }
+
+        uint64_t remaining = load->file_size - (start + used);
+        size_t step = capacity - used < remaining ? capacity - used : (size_t)remaining;
+        status = de430_pread_all(load->fd, buffer + used, step, start + used);
+        if (status != DE430_ERROR_NONE) break;
+
+        char *newline = memchr(buffer + used, '\n', step);
+        used = newline ? (size_t)(newline - buffer) + 1 : used + step;
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free(buffer);
+        return status;
+    }
+
+    buffer[used] = '\0';
+    *text = buffer;
+    *length = used;
+    return DE430_ERROR_NONE;
+}
+
+// Parse the lines that start inside one chunk of the file
+static int ndjson_load_task(void *context, int index) {
+    NdjsonLoad *load = (NdjsonLoad*)context;
+    NdjsonPart *part = &load->parts[index];
+
+    uint64_t start = (uint64_t)index * NDJSON_CHUNK_SIZE;
+    uint64_t end = start + NDJSON_CHUNK_SIZE < load->file_size ? start + NDJSON_CHUNK_SIZE : load->file_size;
+
+    // Look one byte back: a line starts at `start` only if a newline precedes it
+    uint64_t read_start = start > 0 ? start - 1 : 0;
+    char *text;
+    size_t length;
+    int status = ndjson_read_range(load, read_start, end, &text, &length);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    const char *p = text;
+    const char *chunk_end = text + (end - read_start);
+    if (start > 0) {
+        const char *newline = memchr(p, '\n', length);
+        p = newline ? newline + 1 : text + length;
+    }
+
+    while (p < chunk_end && status == DE430_ERROR_NONE) {
+        const char *line_end = memchr(p, '\n', (size_t)(text + length - p));
+        if (!line_end) line_end = text + length;
+
+        if (ndjson_skip_space(p) < line_end) {
+            char name[64];
+            DE430EphemerisPoint point;
+            const char *parsed = ndjson_parse_record(p, name, sizeof(name), &point);
+            if (!parsed || ndjson_skip_space(parsed) < line_end) {
+                status = DE430_ERROR_JSON_PARSE;
+                break;
+            }
+
+            int object = ndjson_part_object(part, name);
+            status = object >= 0
+                     ? de430_data_append(&part->objects[object], &part->capacities[object], &point)
+                     : DE430_ERROR_MEMORY_ALLOCATION;
+        }
+
+        p = line_end + 1;
+    }
+
+    de430_free(text);
+    return status;
+}
+
+// Concatenate the parts in file order, keeping objects in order of first appearance
+static int ndjson_merge(NdjsonLoad *load, DE430EphemerisData **result, int *count) {
+    NdjsonPart merged;
+    memset(&merged, 0, sizeof(merged));
+    int status = DE430_ERROR_NONE;
+
+    // Names and totals first, so every object is allocated once
+    for (int c = 0; c < load->chunk_count && status == DE430_ERROR_NONE; c++) {
+        NdjsonPart *part = &load->parts[c];
+        for (int i = 0; i < part->object_count; i++) {
+            int object = ndjson_part_object(&merged, part->objects[i].object_name);
+            if (object < 0) {
+                status = DE430_ERROR_MEMORY_ALLOCATION;
+                break;
+            }
+            merged.capacities[object] += part->objects[i].count;
+        }
+    }
+
+    for (int i = 0; i < merged.object_count && status == DE430_ERROR_NONE; i++) {
+        merged.objects[i].points = de430_malloc((size_t)(merged.capacities[i] > 0 ? merged.capacities[i] : 1) *
+                                          sizeof(DE430EphemerisPoint));
+        if (!merged.objects[i].points) {
+            status = DE430_ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    for (int c = 0; c < load->chunk_count && status == DE430_ERROR_NONE; c++) {
+        NdjsonPart *part = &load->parts[c];
+        for (int i = 0; i < part->object_count; i++) {
+            DE430EphemerisData *obj = &merged.objects[ndjson_part_object(&merged, part->objects[i].object_name)];
+            memcpy(obj->points + obj->count, part->objects[i].points,
+                   part->objects[i].count * sizeof(DE430EphemerisPoint));
+            obj->count += part->objects[i].count;
+        }
+    }
+
+    de430_free(merged.capacities);
+    if (status != DE430_ERROR_NONE) {
+        de430_free_data(merged.objects, merged.object_count);
+        return status;
+    }
+
+    *result = merged.objects;
+    *count = merged.object_count;
+    return DE430_ERROR_NONE;
+}
+
+int de430_load_from_ndjson_parallel(const char *filename, int threads, DE430EphemerisData **result, int *count) {
+    if (!filename || !result || !count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    NdjsonLoad load;
+    memset(&load, 0, sizeof(load));
+
+    load.fd = open(filename, O_RDONLY);
+    if (load.fd < 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    struct stat st;
+    int status = fstat(load.fd, &st) == 0 ? DE430_ERROR_NONE : DE430_ERROR_FILE_IO;
+    if (status == DE430_ERROR_NONE) {
+        load.file_size = (uint64_t)st.st_size;
+        load.chunk_count = (int)((load.file_size + NDJSON_CHUNK_SIZE - 1) / NDJSON_CHUNK_SIZE);
+        load.parts = de430_calloc(load.chunk_count > 0 ? load.chunk_count : 1, sizeof(NdjsonPart));
+        if (!load.parts) {
+            status = DE430_ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = de430_parallel_for(load.chunk_count, threads, ndjson_load_task, &load);
+    }
+    if (status == DE430_ERROR_NONE) {
+        status = ndjson_merge(&load, result, count);
+    }
+
+    close(load.fd);
+    for (int c = 0; load.parts && c < load.chunk_count; c++) {
+        de430_free_data(load.parts[c].objects, load.parts[c].object_count);
+        de430_free(load.parts[c].capacities);
+    }
+    de430_free(load.parts);
+    return status;
+}
+
+int de430_load_from_ndjson(const char *filename, DE430EphemerisData **result, int *count) {
+    return de430_load_from_ndjson_parallel(filename, 1, result, count);
+}
@@ -0,0 +1,486 @@
+//
+// NumPy .npy and .npz (stored zip) writers.
+//
+// Every array is preceded by a header padded to 64 bytes, and .npz members
+// are placed so their data also starts on a 64-byte boundary, so arrays can
+// be memory-mapped in place. Like the binary format, data is written in
+// host byte order, which must be little-endian.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+_Static_assert(sizeof(DE430EphemerisPoint) == DE430_BINARY_POINT_DOUBLES_SIZE + 32,
+               "DE430EphemerisPoint must have no padding to match the structured dtype");
+
+#define NPY_ALIGNMENT 64
+#define NPY_HEADER_SIZE 4096
+
+// Rows gathered into the staging buffer at a time
+#define NPY_GATHER_ROWS 8192
+
+#define ZIP_LOCAL_SIGNATURE 0x04034b50u
+#define ZIP_CENTRAL_SIGNATURE 0x02014b50u
+#define ZIP_END_SIGNATURE 0x06054b50u
+#define ZIP64_END_SIGNATURE 0x06064b50u
+#define ZIP64_LOCATOR_SIGNATURE 0x07064b50u
+#define ZIP64_EXTRA_ID 0x0001
+#define ZIP_PADDING_EXTRA_ID 0xD935        // Alignment padding, as written by zipalign
+#define ZIP_VERSION 20
+#define ZIP64_VERSION 45
+#define ZIP_DOS_DATE 0x0021                // 1980-01-01, keeps archives reproducible
+#define ZIP32_LIMIT 0xFFFFFFFFull          // Sizes and offsets from here on need zip64
+#define ZIP64_MARKER 0xFFFFFFFFu           // Stored in place of a value kept in the zip64 extra field
+
+// Column names, the same as the CSV header
+static const char *const npy_field_names[DE430_FIELD_COUNT] = {
+    "jd", "pos_x", "pos_y", "pos_z", "ra", "dec", "magnitude", "phase", "angular_size",
+    "physical_size", "albedo", "sun_dist", "earth_dist", "sun_ang_dist", "theta_edo",
+    "ecliptic_lng", "ecliptic_dist", "ecliptic_lat"
+};
+
+// Structured dtype matching DE430EphemerisPoint member for member
+static const char npy_point_descr[] =
+    "[('jd', '<f8'), ('position', '<f8', (3,)), ('ra_dec', '<f8', (2,)), ('magnitude', '<f8'), "
+    "('phase', '<f8'), ('angular_size', '<f8'), ('physical_size', '<f8'), ('albedo', '<f8'), "
+    "('sun_dist', '<f8'), ('earth_dist', '<f8'), ('sun_ang_dist', '<f8'), ('theta_edo', '<f8'), "
+    "('ecliptic', '<f8', (3,)), ('constellation', 'S32')]";
+
+typedef struct {
+    char name[32];
+    uint32_t crc;
+    uint64_t size;
+    uint64_t offset;            // Local header offset
+} NpzEntry;
+
+typedef struct {
+    const char *path;           // Directory, or the archive file
+    int archive;
+    FILE *fp;                   // Archive, or the .npy file being written
+
+    uint32_t crc_table[256];
+    uint32_t crc;               // Running CRC of the current member
+    uint64_t offset;            // Archive bytes written so far
+
+    NpzEntry entries[DE430_FIELD_COUNT + 3];
+    int entry_count;
+
+    unsigned char *staging;     // NPY_GATHER_ROWS rows of the widest member
+} NpyWriter;
+
+static void npy_crc_init(NpyWriter *writer) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        writer->crc_table[i] = c;
+    }
+}
+
+static int npy_put(NpyWriter *writer, const void *data, size_t size) {
+    if (size == 0) return DE430_ERROR_NONE;
+
+    if (writer->archive) {
+        const unsigned char *bytes = data;
+        uint32_t crc = writer->crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = writer->crc_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+        }
+        writer->crc = crc;
+        writer->offset += size;
+    }
+
+    return fwrite(data, 1, size, writer->fp) == size ? DE430_ERROR_NONE : DE430_ERROR_FILE_IO;
+}
+
+// Zip records are little-endian, written field by field
+static void npy_le(unsigned char **p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *(*p)++ = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static int npy_put_raw(NpyWriter *writer, const void *data, size_t size) {
+    writer->offset += size;
+    return fwrite(data, 1, size, writer->fp) == size ? DE430_ERROR_NONE : DE430_ERROR_FILE_IO;
+}
+
+// Build the .npy header for a 1-D array, padded so the data starts on an
+// NPY_ALIGNMENT boundary. Returns its size, or 0 if it does not fit.
+static size_t npy_format_header(char *header, const char *descr, int64_t rows) {
+    char dict[NPY_HEADER_SIZE];
+    int length = snprintf(dict, sizeof(dict), "{'descr': %s%s%s, 'fortran_order': False, 'shape': (%lld,), }",
+                          descr[0] == '[' ? "" : "'", descr, descr[0] == '[' ? "" : "'", (long long)rows);
+    if (length < 0 || (size_t)length + 11 + NPY_ALIGNMENT > NPY_HEADER_SIZE) {
+        return 0;
+    }
+
+    size_t total = ((size_t)length + 11 + NPY_ALIGNMENT - 1) & ~(size_t)(NPY_ALIGNMENT - 1);
+    uint16_t header_length = (uint16_t)(total - 10);
+
+    memcpy(header, "\x93NUMPY\x01\x00", 8);
+    memcpy(header + 8, &header_length, 2);
+    memcpy(header + 10, dict, (size_t)length);
+    memset(header + 10 + length, ' ', total - 11 - (size_t)length);
+    header[total - 1] = '\n';
+    return total;
+}
+
+// Start a member: a file in the directory, or a stored entry of the archive
+static int npy_begin_member(NpyWriter *writer, const char *name, const char *descr, int64_t rows, size_t item_size) {
+    char header[NPY_HEADER_SIZE];
+    size_t header_size = npy_format_header(header, descr, rows);
+    if (header_size == 0) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    if (!writer->archive) {
+        char filename[4096];
+        if (snprintf(filename, sizeof(filename), "%s/%s.npy", writer->path, name) >= (int)sizeof(filename)) {
+            return DE430_ERROR_INVALID_CONFIG;
+        }
+        writer->fp = fopen(filename, "wb");
+        if (!writer->fp) {
+            return DE430_ERROR_FILE_IO;
+        }
+        return npy_put(writer, header, header_size);
+    }
+
+    NpzEntry *entry = &writer->entries[writer->entry_count++];
+    snprintf(entry->name, sizeof(entry->name), "%s.npy", name);
+    entry->offset = writer->offset;
+    entry->size = header_size + (uint64_t)rows * item_size;
+
+    int zip64 = entry->size >= ZIP32_LIMIT;
+    size_t name_length = strlen(entry->name);
+    size_t extra_length = zip64 ? 20 : 0;
+
+    // Pad with an extra field so the member's data lands on a boundary
+    size_t data_offset = (size_t)(entry->offset % NPY_ALIGNMENT) + 30 + name_length + extra_length;
+    size_t pad = (NPY_ALIGNMENT - (data_offset + 4) % NPY_ALIGNMENT) % NPY_ALIGNMENT;
+    extra_length += 4 + pad;
+
+    unsigned char local[30 + 32 + 20 + 4 + NPY_ALIGNMENT];
+    unsigned char *p = local;
+    npy_le(&p, ZIP_LOCAL_SIGNATURE, 4);
+    npy_le(&p, zip64 ? ZIP64_VERSION : ZIP_VERSION, 2);
+    npy_le(&p, 0, 2);                       // Flags
+    npy_le(&p, 0, 2);                       // Stored
+    npy_le(&p, 0, 2);                       // Time
+    npy_le(&p, ZIP_DOS_DATE, 2);
+    npy_le(&p, 0, 4);                       // CRC, patched when the member ends
+    npy_le(&p, zip64 ? ZIP64_MARKER : entry->size, 4);
+    npy_le(&p, zip64 ? ZIP64_MARKER : entry->size, 4);
+    npy_le(&p, name_length, 2);
+    npy_le(&p, extra_length, 2);
+    memcpy(p, entry->name, name_length);
+    p += name_length;
+    if (zip64) {
+        npy_le(&p, ZIP64_EXTRA_ID, 2);
+        npy_le(&p, 16, 2);
+        npy_le(&p, entry->size, 8);
+        npy_le(&p, entry->size, 8);
+    }
+    npy_le(&p, ZIP_PADDING_EXTRA_ID, 2);
+    npy_le(&p, pad, 2);
+    memset(p, 0, pad);
+    p += pad;
+
+    int status = npy_put_raw(writer, local, (size_t)(p - local));
+    writer->crc = 0xFFFFFFFFu;
+    if (status == DE430_ERROR_NONE) {
+        status = npy_put(writer, header, header_size);
+    }
+    return status;
+}
+
+static int npy_end_member(NpyWriter *writer) {
+    if (!writer->archive) {
+        int status = fclose(writer->fp) == 0 ? DE430_ERROR_NONE : DE430_ERROR_FILE_IO;
+        writer->fp = NULL;
+        return status;
+    }
+
+    NpzEntry *entry = &writer->entries[writer->entry_count - 1];
+    entry->crc = writer->crc ^ 0xFFFFFFFFu;
+    if (writer->offset - entry->offset < entry->size) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    // Patch the CRC into the local header, then return to the end
+    unsigned char crc[4];
+    unsigned char *p = crc;
+    npy_le(&p, entry->crc, 4);
+    if (fseeko(writer->fp, (off_t)(entry->offset + 14), SEEK_SET) != 0 ||
+        fwrite(crc, 1, sizeof(crc), writer->fp) != sizeof(crc) ||
+        fseeko(writer->fp, 0, SEEK_END) != 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+// Central directory and end records, switching to zip64 where needed
+static int npy_write_directory(NpyWriter *writer) {
+    uint64_t directory_offset = writer->offset;
+
+    for (int i = 0; i < writer->entry_count; i++) {
+        const NpzEntry *entry = &writer->entries[i];
+        int zip64 = entry->size >= ZIP32_LIMIT || entry->offset >= ZIP32_LIMIT;
+        size_t name_length = strlen(entry->name);
+
+        unsigned char central[46 + 32 + 28];
+        unsigned char *p = central;
+        npy_le(&p, ZIP_CENTRAL_SIGNATURE, 4);
+        npy_le(&p, zip64 ? ZIP64_VERSION : ZIP_VERSION, 2);
+        npy_le(&p, zip64 ? ZIP64_VERSION : ZIP_VERSION, 2);
+        npy_le(&p, 0, 2);
+        npy_le(&p, 0, 2);
+        npy_le(&p, 0, 2);
+        npy_le(&p, ZIP_DOS_DATE, 2);
+        npy_le(&p, entry->crc, 4);
+        npy_le(&p, zip64 ? ZIP64_MARKER : entry->size, 4);
+        npy_le(&p, zip64 ? ZIP64_MARKER : entry->size, 4);
+        npy_le(&p, name_length, 2);
+        npy_le(&p, zip64 ? 28 : 0, 2);
+        npy_le(&p, 0, 2);                   // Comment
+        npy_le(&p, 0, 2);                   // Disk
+        npy_le(&p, 0, 2);                   // Internal attributes
+        npy_le(&p, 0, 4);                   // External attributes
+        npy_le(&p, zip64 ? ZIP64_MARKER : entry->offset, 4);
+        memcpy(p, entry->name, name_length);
+        p += name_length;
+        if (zip64) {
+            npy_le(&p, ZIP64_EXTRA_ID, 2);
+            npy_le(&p, 24, 2);
+            npy_le(&p, entry->size, 8);
+            npy_le(&p, entry->size, 8);
+            npy_le(&p, entry->offset, 8);
+        }
+
+        int status = npy_put_raw(writer, central, (size_t)(p - central));
+        if (status != DE430_ERROR_NONE) return status;
+    }
+
+    uint64_t directory_size = writer->offset - directory_offset;
+    int zip64 = directory_offset >= ZIP32_LIMIT || directory_size >= ZIP32_LIMIT;
+
+    unsigned char end[56 + 20 + 22];
+    unsigned char *p = end;
+    if (zip64) {
+        uint64_t record_offset = writer->offset;
+        npy_le(&p, ZIP64_END_SIGNATURE, 4);
+        npy_le(&p, 44, 8);
+        npy_le(&p, ZIP64_VERSION, 2);
+        npy_le(&p, ZIP64_VERSION, 2);
+        npy_le(&p, 0, 4);
+        npy_le(&p, 0, 4);
+        npy_le(&p, writer->entry_count, 8);
+        npy_le(&p, writer->entry_count, 8);
+        npy_le(&p, directory_size, 8);
+        npy_le(&p, directory_offset, 8);
+
+        npy_le(&p, ZIP64_LOCATOR_SIGNATURE, 4);
+        npy_le(&p, 0, 4);
+        npy_le(&p, record_offset, 8);
+        npy_le(&p, 1, 4);
+    }
+    npy_le(&p, ZIP_END_SIGNATURE, 4);
+    npy_le(&p, 0, 2);
+    npy_le(&p, 0, 2);
+    npy_le(&p, writer->entry_count, 2);
+    npy_le(&p, writer->entry_count, 2);
+    npy_le(&p, zip64 ? ZIP64_MARKER : directory_size, 4);
+    npy_le(&p, zip64 ? ZIP64_MARKER : directory_offset, 4);
+    npy_le(&p, 0, 2);
+
+    return npy_put_raw(writer, end, (size_t)(p - end));
+}
+
+// object_names (S64) and object_offsets (int64, count + 1 row starts)
+static int npy_write_objects(NpyWriter *writer, const DE430EphemerisData *data, int count) {
+    int status = npy_begin_member(writer, "object_names", "|S64", count, sizeof(data->object_name));
+    for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+        char name[sizeof(data->object_name)];
+        memset(name, 0, sizeof(name));
+        memcpy(name, data[i].object_name, strnlen(data[i].object_name, sizeof(name) - 1));
+        status = npy_put(writer, name, sizeof(name));
+    }
+    if (status == DE430_ERROR_NONE) status = npy_end_member(writer);
+
+    if (status == DE430_ERROR_NONE) {
+        status = npy_begin_member(writer, "object_offsets", "<i8", (int64_t)count + 1, sizeof(int64_t));
+    }
+    int64_t offset = 0;
+    for (int i = 0; i <= count && status == DE430_ERROR_NONE; i++) {
+        status = npy_put(writer, &offset, sizeof(offset));
+        if (i < count && data[i].count > 0) offset += data[i].count;
+    }
+    if (status == DE430_ERROR_NONE) status = npy_end_member(writer);
+
+    return status;
+}
+
+// One float64 member per field and an S32 constellation member
+static int npy_write_columns(NpyWriter *writer, const DE430EphemerisData *data, int count, int64_t rows) {
+    int status = DE430_ERROR_NONE;
+
+    for (int f = 0; f < DE430_FIELD_COUNT && status == DE430_ERROR_NONE; f++) {
+        status = npy_begin_member(writer, npy_field_names[f], "<f8", rows, sizeof(double));
+        double *values = (double*)writer->staging;
+
+        for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+            for (int done = 0; done < data[i].count && status == DE430_ERROR_NONE; done += NPY_GATHER_ROWS) {
+                int n = data[i].count - done < NPY_GATHER_ROWS ? data[i].count - done : NPY_GATHER_ROWS;
+                for (int j = 0; j < n; j++) {
+                    values[j] = de430_point_field(&data[i].points[done + j], (DE430Field)f);
+                }
+                status = npy_put(writer, values, n * sizeof(double));
+            }
+        }
+        if (status == DE430_ERROR_NONE) status = npy_end_member(writer);
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = npy_begin_member(writer, "constellation", "|S32", rows, sizeof(data->points->constellation));
+    }
+    char (*names)[sizeof(data->points->constellation)] = (void*)writer->staging;
+    for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+        for (int done = 0; done < data[i].count && status == DE430_ERROR_NONE; done += NPY_GATHER_ROWS) {
+            int n = data[i].count - done < NPY_GATHER_ROWS ? data[i].count - done : NPY_GATHER_ROWS;
+            for (int j = 0; j < n; j++) {
+                const char *name = data[i].points[done + j].constellation;
+                size_t length = strnlen(name, sizeof(names[j]) - 1);
+                memcpy(names[j], name, length);
+                memset(names[j] + length, 0, sizeof(names[j]) - length);
+            }
+            status = npy_put(writer, names, n * sizeof(names[0]));
+        }
+    }
+    if (status == DE430_ERROR_NONE) status = npy_end_member(writer);
+
+    return status;
+}
+
+// A single points member whose records are DE430EphemerisPoint itself
+static int npy_write_structured(NpyWriter *writer, const DE430EphemerisData *data, int count, int64_t rows) {
+    int status = npy_begin_member(writer, "points", npy_point_descr, rows, sizeof(DE430EphemerisPoint));
+    DE430EphemerisPoint *records = (DE430EphemerisPoint*)writer->staging;
+
+    for (int i = 0; i < count && status == DE430_ERROR_NONE; i++) {
+        for (int done = 0; done < data[i].count && status == DE430_ERROR_NONE; done += NPY_GATHER_ROWS) {
+            int n = data[i].count - done < NPY_GATHER_ROWS ? data[i].count - done : NPY_GATHER_ROWS;
+            memcpy(records, &data[i].points[done], n * sizeof(DE430EphemerisPoint));
+
+            // Bytes after the terminator would show up in NumPy's fixed-width strings
+            for (int j = 0; j < n; j++) {
+                size_t length = strnlen(records[j].constellation, sizeof(records[j].constellation) - 1);
+                memset(records[j].constellation + length, 0, sizeof(records[j].constellation) - length);
+            }
+            status = npy_put(writer, records, n * sizeof(DE430EphemerisPoint));
+        }
+    }
+    if (status == DE430_ERROR_NONE) status = npy_end_member(writer);
+
+    return status;
+}
+
+static int npy_write(NpyWriter *writer, const DE430EphemerisData *data, int count, const DE430NpyOptions *options) {
+    int64_t rows = 0;
+    for (int i = 0; i < count; i++) {
+        if (data[i].count > 0) rows += data[i].count;
+    }
+
+    writer->staging = de430_malloc(NPY_GATHER_ROWS * sizeof(DE430EphemerisPoint));
+    if (!writer->staging) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = npy_write_objects(writer, data, count);
+    if (status == DE430_ERROR_NONE) {
+        status = options->structured ? npy_write_structured(writer, data, count, rows)
+                                     : npy_write_columns(writer, data, count, rows);
+    }
+
+    de430_free(writer->staging);
+    return status;
+}
+
+void de430_init_npy_options(DE430NpyOptions *options) {
+    if (!options) return;
+
+    memset(options, 0, sizeof(DE430NpyOptions));
+    options->structured = 0;
+}
+
+int de430_save_to_npy(const DE430EphemerisData *data, int count, const char *directory,
+                      const DE430NpyOptions *options) {
+    if (!data || count <= 0 || !directory) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430NpyOptions defaults;
+    if (!options) {
+        de430_init_npy_options(&defaults);
+        options = &defaults;
+    }
+
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    NpyWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.path = directory;
+
+    int status = npy_write(&writer, data, count, options);
+
+    // A member left open by a failure
+    if (writer.fp) {
+        fclose(writer.fp);
+    }
+    return status;
+}
+
+int de430_save_to_npz(const DE430EphemerisData *data, int count, const char *filename,
+                      const DE430NpyOptions *options) {
+    if (!data || count <= 0 || !filename) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430NpyOptions defaults;
+    if (!options) {
+        de430_init_npy_options(&defaults);
+        options = &defaults;
+    }
+
+    NpyWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.path = filename;
+    writer.archive = 1;
+    npy_crc_init(&writer);
+
+    writer.fp = fopen(filename, "wb");
+    if (!writer.fp) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    int status = npy_write(&writer, data, count, options);
+    if (status == DE430_ERROR_NONE) {
+        status = npy_write_directory(&writer);
+    }
+
+    if (fclose(writer.fp) != 0 && status == DE430_ERROR_NONE) {
+        status = DE430_ERROR_FILE_IO;
+    }
+    return status;
+}
@@ -0,0 +1,304 @@
+//
+// Work-stealing task scheduler used by the parallel readers, writers and
+// bulk jobs.
+//
+// Every worker owns a deque of task ranges. A worker splits the range it is
+// running in halves, keeps the lower half and pushes the upper one onto the
+// bottom of its deque; idle workers steal from the top, where the largest
+// ranges are. Expensive tasks therefore never strand work behind them, and
+// cores stay busy until the last task finishes.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SCHEDULER_INITIAL_DEQUE 16
+
+// The tasks of one de430_parallel_for call
+typedef struct {
+    atomic_int pending;     // Task indices not yet finished or skipped
+    atomic_int status;      // First error reported by a task
+} SchedulerGroup;
+
+// Tasks first to last - 1 of a group
+typedef struct {
+    DE430TaskFn fn;
+    void *context;
+    int first;
+    int last;
+    SchedulerGroup *group;
+} SchedulerTask;
+
+typedef struct Scheduler Scheduler;
+
+typedef struct {
+    Scheduler *scheduler;
+    unsigned int seed;      // Victim selection
+
+    pthread_mutex_t lock;   // Guards the deque
+    SchedulerTask *tasks;
+    int top;                // Oldest task, taken by thieves
+    int bottom;             // One past the newest task, taken by the owner
+    int capacity;
+
+    pthread_t thread;
+    int started;
+    DE430AllocStats alloc_stats;
+} SchedulerWorker;
+
+struct Scheduler {
+    SchedulerWorker *workers;
+    int worker_count;
+    SchedulerGroup *root;
+
+    atomic_int queued;      // Tasks sitting in deques
+    atomic_int sleepers;    // Workers waiting for tasks
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+};
+
+// The worker running on this thread, if any
+static _Thread_local SchedulerWorker *current_worker = NULL;
+
+static void scheduler_wake(Scheduler *scheduler) {
+    if (atomic_load(&scheduler->sleepers) > 0) {
+        pthread_mutex_lock(&scheduler->lock);
+        pthread_cond_broadcast(&scheduler->wake);
+        pthread_mutex_unlock(&scheduler->lock);
+    }
+}
+
+static int scheduler_push(SchedulerWorker *worker, const SchedulerTask *task) {
+    pthread_mutex_lock(&worker->lock);
+
+    if (worker->bottom == worker->capacity) {
+        if (worker->top > 0) {
+            // Reuse the space left by stolen tasks
+            memmove(worker->tasks, worker->tasks + worker->top,
+                    (size_t)(worker->bottom - worker->top) * sizeof(SchedulerTask));
+            worker->bottom -= worker->top;
+            worker->top = 0;
+        } else {
+            int capacity = worker->capacity ? worker->capacity * 2 : SCHEDULER_INITIAL_DEQUE;
+            SchedulerTask *tasks = de430_realloc(worker->tasks, (size_t)capacity * sizeof(SchedulerTask));
+            if (!tasks) {
+                pthread_mutex_unlock(&worker->lock);
+                return DE430_ERROR_MEMORY_ALLOCATION;
+            }
+            worker->tasks = tasks;
+            worker->capacity = capacity;
+        }
+    }
+    worker->tasks[worker->bottom++] = *task;
+    atomic_fetch_add(&worker->scheduler->queued, 1);
+
+    pthread_mutex_unlock(&worker->lock);
+
+    scheduler_wake(worker->scheduler);
+    return DE430_ERROR_NONE;
+}
+
+// Take the newest task of the worker's own deque
+static int scheduler_pop(SchedulerWorker *worker, SchedulerTask *task) {
+    int found = 0;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->bottom > worker->top) {
+        *task = worker->tasks[--worker->bottom];
+        if (worker->bottom == worker->top) worker->top = worker->bottom = 0;
+        atomic_fetch_sub(&worker->scheduler->queued, 1);
+        found = 1;
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return found;
+}
+
+// Take the oldest task of another worker, starting at a random victim
+static int scheduler_steal(SchedulerWorker *worker, SchedulerTask *task) {
+    Scheduler *scheduler = worker->scheduler;
+    if (scheduler->worker_count < 2 || atomic_load(&scheduler->queued) == 0) return 0;
+
+    worker->seed = worker->seed * 1103515245u + 12345u;
+    int start = (int)((worker->seed >> 16) % (unsigned int)scheduler->worker_count);
+
+    for (int i = 0; i < scheduler->worker_count; i++) {
+        SchedulerWorker *victim = &scheduler->workers[(start + i) % scheduler->worker_count];
+        if (victim == worker) continue;
+
+        int found = 0;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->bottom > victim->top) {
+            *task = victim->tasks[victim->top++];
+            if (victim->bottom == victim->top) victim->top = victim->bottom = 0;
+            atomic_fetch_sub(&scheduler->queued, 1);
+            found = 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (found) return 1;
+    }
+
+    return 0;
+}
+
+static void scheduler_finish(Scheduler *scheduler, SchedulerGroup *group, int done) {
+    if (atomic_fetch_sub(&group->pending, done) == done) {
+        scheduler_wake(scheduler);
+    }
+}
+
+static void scheduler_execute(SchedulerWorker *worker, SchedulerTask task) {
+    SchedulerGroup *group = task.group;
+
+    // Leave the upper halves for thieves; if a push fails the rest of the
+    // range simply runs here
+    while (task.last - task.first > 1 && atomic_load(&group->status) == DE430_ERROR_NONE) {
+        SchedulerTask upper = task;
+        upper.first = task.first + (task.last - task.first) / 2;
+        if (scheduler_push(worker, &upper) != DE430_ERROR_NONE) break;
+        task.last = upper.first;
+    }
+
+    // Once a task of the group has failed, the others are skipped
+    for (int index = task.first; index < task.last; index++) {
+        if (atomic_load(&group->status) != DE430_ERROR_NONE) break;
+
+        int status = task.fn(task.context, index);
+        if (status != DE430_ERROR_NONE) {
+            int expected = DE430_ERROR_NONE;
+            atomic_compare_exchange_strong(&group->status, &expected, status);
+        }
+    }
+
+    scheduler_finish(worker->scheduler, group, task.last - task.first);
+}
+
+// Run tasks, own ones first, until the group has finished
+static void scheduler_work(SchedulerWorker *worker, SchedulerGroup *group) {
+    Scheduler *scheduler = worker->scheduler;
+
+    while (atomic_load(&group->pending) > 0) {
+        SchedulerTask task;
+        if (scheduler_pop(worker, &task) || scheduler_steal(worker, &task)) {
+            scheduler_execute(worker, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&scheduler->lock);
+        atomic_fetch_add(&scheduler->sleepers, 1);
+        while (atomic_load(&scheduler->queued) == 0 && atomic_load(&group->pending) > 0) {
+            pthread_cond_wait(&scheduler->wake, &scheduler->lock);
+        }
+        atomic_fetch_sub(&scheduler->sleepers, 1);
+        pthread_mutex_unlock(&scheduler->lock);
+    }
+}
+
+static void* scheduler_thread(void *arg) {
+    SchedulerWorker *worker = (SchedulerWorker*)arg;
+
+    current_worker = worker;
+    scheduler_work(worker, worker->scheduler->root);
+    current_worker = NULL;
+
+    de430_get_alloc_stats(&worker->alloc_stats);
+    return NULL;
+}
+
+int de430_default_thread_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+// A task that calls de430_parallel_for again: queue the new tasks with the
+// running workers and help with any work until they are done
+static int parallel_for_nested(SchedulerWorker *worker, int count, DE430TaskFn fn, void *context) {
+    SchedulerGroup group;
+    atomic_init(&group.pending, count);
+    atomic_init(&group.status, DE430_ERROR_NONE);
+
+    SchedulerTask task = {fn, context, 0, count, &group};
+    scheduler_execute(worker, task);
+    scheduler_work(worker, &group);
+
+    return atomic_load(&group.status);
+}
+
+int de430_parallel_for(int count, int threads, DE430TaskFn fn, void *context) {
+    if (count <= 0) return DE430_ERROR_NONE;
+
+    if (current_worker) {
+        return parallel_for_nested(current_worker, count, fn, context);
+    }
+
+    if (threads <= 0) threads = de430_default_thread_count();
+    if (threads > count) threads = count;
+
+    Scheduler scheduler;
+    SchedulerGroup root;
+    atomic_init(&root.pending, count);
+    atomic_init(&root.status, DE430_ERROR_NONE);
+
+    // Without memory for the workers the caller runs everything alone
+    SchedulerWorker single;
+    scheduler.workers = de430_calloc((size_t)threads, sizeof(SchedulerWorker));
+    if (!scheduler.workers) {
+        memset(&single, 0, sizeof(single));
+        scheduler.workers = &single;
+        threads = 1;
+    }
+    scheduler.worker_count = threads;
+    scheduler.root = &root;
+    atomic_init(&scheduler.queued, 0);
+    atomic_init(&scheduler.sleepers, 0);
+    pthread_mutex_init(&scheduler.lock, NULL);
+    pthread_cond_init(&scheduler.wake, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        SchedulerWorker *worker = &scheduler.workers[i];
+        worker->scheduler = &scheduler;
+        worker->seed = (unsigned int)i * 2654435761u + 1u;
+        pthread_mutex_init(&worker->lock, NULL);
+    }
+
+    // The calling thread is worker 0; the others start with empty deques
+    // and steal their first tasks
+    for (int i = 1; i < threads; i++) {
+        SchedulerWorker *worker = &scheduler.workers[i];
+        worker->started = pthread_create(&worker->thread, NULL, scheduler_thread, worker) == 0;
+    }
+
+    current_worker = &scheduler.workers[0];
+    SchedulerTask task = {fn, context, 0, count, &root};
+    scheduler_execute(current_worker, task);
+    scheduler_work(current_worker, &root);
+    current_worker = NULL;
+
+    // Allocations of the workers count towards the call that started them
+    for (int i = 0; i < threads; i++) {
+        SchedulerWorker *worker = &scheduler.workers[i];
+        if (worker->started) {
+            pthread_join(worker->thread, NULL);
+            de430_alloc_stats_add(&worker->alloc_stats);
+        }
+    }
+
+    // Workers look at each other's deques until the last one has stopped
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_destroy(&scheduler.workers[i].lock);
+        de430_free(scheduler.workers[i].tasks);
+    }
+    if (scheduler.workers != &single) de430_free(scheduler.workers);
+
+    pthread_mutex_destroy(&scheduler.lock);
+    pthread_cond_destroy(&scheduler.wake);
+
+    return atomic_load(&root.status);
+}
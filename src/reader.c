@@ -0,0 +1,534 @@
+//
+// Chunked reading of JSON, CSV and binary files in bounded memory.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Read-ahead window of each per-object cursor in time order
+#define CHUNK_CURSOR_BUFFER_SIZE (64 * 1024)
+
+/**
+ * Position in the file. A cursor walks the objects in [object, end_object)
+ * one after another; time order uses one cursor per object.
+ */
+typedef struct {
+    int object;                 // Object being read, -1 before the first one
+    int end_object;             // One past the last object of the cursor
+    uint32_t remaining;         // Points left in the current object
+    DE430BinaryReader binary;
+    FILE *fp;
+    char *file_buffer;
+    DE430JsonStream json;
+    int open;
+} ChunkCursor;
+
+struct DE430ChunkReader {
+    char *filename;
+    DE430Format format;
+    DE430ChunkOrder order;
+    uint32_t version;                       // Binary format version
+    DE430BinaryDirectoryEntry *entries;     // Per object: name, first point offset, point count
+    int object_count;
+
+    ChunkCursor *cursors;
+    int cursor_count;
+
+    // Time order: next point of each cursor and a min-heap of cursors by jd
+    DE430EphemerisPoint *lookahead;
+    int *heap;
+    int heap_size;
+
+    DE430EphemerisPoint *points;
+    int *object_indices;
+    int chunk_size;
+};
+
+// Object index
+
+static DE430BinaryDirectoryEntry* reader_add_object(DE430ChunkReader *reader, int *capacity) {
+    if (reader->object_count == *capacity) {
+        int new_capacity = *capacity > 0 ? *capacity * 2 : 16;
+        DE430BinaryDirectoryEntry *entries = de430_realloc(reader->entries, new_capacity * sizeof(DE430BinaryDirectoryEntry));
+        if (!entries) {
+            return NULL;
+        }
+        reader->entries = entries;
+        *capacity = new_capacity;
+    }
+
+    DE430BinaryDirectoryEntry *entry = &reader->entries[reader->object_count++];
+    memset(entry, 0, sizeof(DE430BinaryDirectoryEntry));
+    return entry;
+}
+
+static int reader_index_binary(DE430ChunkReader *reader) {
+    DE430BinaryReader binary;
+    int status = de430_binary_reader_open(&binary, reader->filename);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    DE430BinaryHeader header;
+    status = de430_binary_read_header(&binary, &header);
+    if (status == DE430_ERROR_NONE) {
+        status = de430_binary_read_directory(&binary, &header, &reader->entries);
+    }
+    if (status == DE430_ERROR_NONE) {
+        reader->version = header.version;
+        reader->object_count = (int)header.object_count;
+    }
+
+    de430_binary_reader_close(&binary);
+    return status;
+}
+
+static int reader_index_csv(DE430ChunkReader *reader) {
+    FILE *fp = fopen(reader->filename, "r");
+    if (!fp) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    // Skip the header
+    char line[LINE_BUFFER_SIZE];
+    if (!fgets(line, sizeof(line), fp)) {
+        fclose(fp);
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    int capacity = 0;
+    int current = -1;
+    int status = DE430_ERROR_NONE;
+    long offset = ftell(fp);
+
+    while (fgets(line, sizeof(line), fp)) {
+        char object_name[64];
+        DE430EphemerisPoint point;
+        long next_offset = offset + (long)strlen(line);
+
+        if (de430_csv_parse_row(line, object_name, &point) != 0) {
+            offset = next_offset;
+            continue;
+        }
+
+        // Rows of one object are usually contiguous, so try the last one first
+        if (current < 0 || strcmp(reader->entries[current].name, object_name) != 0) {
+            current = -1;
+            for (int i = 0; i < reader->object_count; i++) {
+                if (strcmp(reader->entries[i].name, object_name) == 0) {
+                    current = i;
+                    break;
+                }
+            }
+        }
+
+        if (current < 0) {
+            DE430BinaryDirectoryEntry *entry = reader_add_object(reader, &capacity);
+            if (!entry) {
+                status = DE430_ERROR_MEMORY_ALLOCATION;
+                break;
+            }
+            strncpy(entry->name, object_name, sizeof(entry->name) - 1);
+            entry->offset = (uint64_t)offset;
+            current = reader->object_count - 1;
+        }
+
+        reader->entries[current].point_count++;
+        offset = next_offset;
+    }
+
+    fclose(fp);
+    return status;
+}
+
+static int reader_index_json(DE430ChunkReader *reader) {
+    FILE *fp = fopen(reader->filename, "r");
+    if (!fp) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    DE430JsonStream json;
+    de430_json_stream_init(&json, fp);
+
+    int capacity = 0;
+    int status = DE430_ERROR_JSON_PARSE;
+
+    if (de430_json_stream_next(&json) != DE430_JSON_OBJECT_BEGIN) {
+        fclose(fp);
+        return DE430_ERROR_JSON_PARSE;
+    }
+
+    // Find the "objects" array, skipping everything else at the top level
+    DE430JsonToken token;
+    while ((token = de430_json_stream_next(&json)) == DE430_JSON_STRING) {
+        int is_objects = strcmp(json.string, "objects") == 0;
+        token = de430_json_stream_next(&json);
+
+        if (!is_objects) {
+            if (de430_json_stream_skip(&json, token) != DE430_ERROR_NONE) break;
+            continue;
+        }
+        if (token != DE430_JSON_ARRAY_BEGIN) break;
+
+        status = DE430_ERROR_NONE;
+        while (status == DE430_ERROR_NONE && (token = de430_json_stream_next(&json)) == DE430_JSON_OBJECT_BEGIN) {
+            DE430BinaryDirectoryEntry *entry = reader_add_object(reader, &capacity);
+            if (!entry) {
+                status = DE430_ERROR_MEMORY_ALLOCATION;
+                break;
+            }
+
+            while ((token = de430_json_stream_next(&json)) == DE430_JSON_STRING) {
+                if (strcmp(json.string, "object_name") == 0) {
+                    if (de430_json_stream_next(&json) != DE430_JSON_STRING) break;
+                    strncpy(entry->name, json.string, sizeof(entry->name) - 1);
+                } else if (strcmp(json.string, "points") == 0) {
+                    if (de430_json_stream_next(&json) != DE430_JSON_ARRAY_BEGIN) break;
+
+                    // Remember where the points start and count them
+                    entry->offset = (uint64_t)ftell(fp);
+                    while ((token = de430_json_stream_next(&json)) == DE430_JSON_OBJECT_BEGIN) {
+                        if (de430_json_stream_skip(&json, token) != DE430_ERROR_NONE) break;
+                        entry->point_count++;
+                    }
+                    if (token != DE430_JSON_ARRAY_END) break;
+                } else if (de430_json_stream_skip(&json, de430_json_stream_next(&json)) != DE430_ERROR_NONE) {
+                    break;
+                }
+            }
+
+            if (token != DE430_JSON_OBJECT_END) {
+                status = DE430_ERROR_JSON_PARSE;
+            }
+        }
+
+        if (status == DE430_ERROR_NONE && token != DE430_JSON_ARRAY_END) {
+            status = DE430_ERROR_JSON_PARSE;
+        }
+        break;
+    }
+
+    fclose(fp);
+    return status;
+}
+
+// Cursors
+
+static int cursor_open(DE430ChunkReader *reader, ChunkCursor *cursor, int first_object, int end_object) {
+    memset(cursor, 0, sizeof(ChunkCursor));
+    cursor->object = first_object - 1;
+    cursor->end_object = end_object;
+
+    // A cursor over a single object only needs a small window
+    int single = end_object - first_object == 1;
+
+    if (reader->format == DE430_FORMAT_BINARY) {
+        int status = single
+                     ? de430_binary_reader_open_sized(&cursor->binary, reader->filename, CHUNK_CURSOR_BUFFER_SIZE)
+                     : de430_binary_reader_open(&cursor->binary, reader->filename);
+        if (status != DE430_ERROR_NONE) {
+            return status;
+        }
+    } else {
+        cursor->fp = fopen(reader->filename, "r");
+        if (!cursor->fp) {
+            return DE430_ERROR_FILE_IO;
+        }
+
+        cursor->file_buffer = de430_malloc(CHUNK_CURSOR_BUFFER_SIZE);
+        if (cursor->file_buffer) {
+            setvbuf(cursor->fp, cursor->file_buffer, _IOFBF, CHUNK_CURSOR_BUFFER_SIZE);
+        }
+        de430_json_stream_init(&cursor->json, cursor->fp);
+    }
+
+    cursor->open = 1;
+    return DE430_ERROR_NONE;
+}
+
+static void cursor_close(DE430ChunkReader *reader, ChunkCursor *cursor) {
+    if (!cursor->open) return;
+
+    if (reader->format == DE430_FORMAT_BINARY) {
+        de430_binary_reader_close(&cursor->binary);
+    } else {
+        fclose(cursor->fp);
+        de430_free(cursor->file_buffer);
+    }
+
+    cursor->open = 0;
+}
+
+// Move to the start of the next object that has points
+static int cursor_advance(DE430ChunkReader *reader, ChunkCursor *cursor) {
+    while (cursor->remaining == 0) {
+        if (cursor->object + 1 >= cursor->end_object) {
+            return 0;
+        }
+
+        const DE430BinaryDirectoryEntry *entry = &reader->entries[++cursor->object];
+        cursor->remaining = entry->point_count;
+        if (cursor->remaining == 0) continue;
+
+        if (reader->format == DE430_FORMAT_BINARY) {
+            if (de430_binary_reader_seek(&cursor->binary, entry->offset) != DE430_ERROR_NONE) {
+                return DE430_ERROR_FILE_IO;
+            }
+        } else if (fseek(cursor->fp, (long)entry->offset, SEEK_SET) != 0) {
+            return DE430_ERROR_FILE_IO;
+        }
+    }
+
+    return 1;
+}
+
+// Read the next point of the cursor: 1 if a point was read, 0 at the end
+static int cursor_read(DE430ChunkReader *reader, ChunkCursor *cursor, DE430EphemerisPoint *point) {
+    int status = cursor_advance(reader, cursor);
+    if (status <= 0) {
+        return status;
+    }
+
+    if (reader->format == DE430_FORMAT_BINARY) {
+        status = reader->version == DE430_BINARY_VERSION_1
+                 ? de430_binary_decode_points_v1(&cursor->binary, point, 1)
+                 : de430_binary_reader_take(&cursor->binary, point, sizeof(DE430EphemerisPoint));
+        if (status == DE430_ERROR_NONE) {
+            de430_binary_terminate_points(point, 1);
+        }
+    } else if (reader->format == DE430_FORMAT_CSV) {
+        // Rows of other objects may be interleaved and are skipped
+        const char *name = reader->entries[cursor->object].name;
+        char line[LINE_BUFFER_SIZE];
+        char object_name[64];
+
+        status = DE430_ERROR_PARSE_FAILED;
+        while (fgets(line, sizeof(line), cursor->fp)) {
+            if (de430_csv_parse_row(line, object_name, point) == 0 && strcmp(object_name, name) == 0) {
+                status = DE430_ERROR_NONE;
+                break;
+            }
+        }
+    } else {
+        status = de430_json_stream_next(&cursor->json) == DE430_JSON_OBJECT_BEGIN
+                 ? de430_json_stream_read_point(&cursor->json, point)
+                 : DE430_ERROR_JSON_PARSE;
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    cursor->remaining--;
+    return 1;
+}
+
+// Time order merge
+
+static int heap_less(const DE430ChunkReader *reader, int a, int b) {
+    double jd_a = reader->lookahead[a].jd;
+    double jd_b = reader->lookahead[b].jd;
+    return jd_a < jd_b || (jd_a == jd_b && a < b);
+}
+
+static void heap_sift_down(DE430ChunkReader *reader, int i) {
+    int *heap = reader->heap;
+
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+
+        if (left < reader->heap_size && heap_less(reader, heap[left], heap[smallest])) smallest = left;
+        if (right < reader->heap_size && heap_less(reader, heap[right], heap[smallest])) smallest = right;
+        if (smallest == i) return;
+
+        int tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static int reader_start_time_order(DE430ChunkReader *reader) {
+    reader->lookahead = de430_malloc((reader->cursor_count > 0 ? reader->cursor_count : 1) * sizeof(DE430EphemerisPoint));
+    reader->heap = de430_malloc((reader->cursor_count > 0 ? reader->cursor_count : 1) * sizeof(int));
+    if (!reader->lookahead || !reader->heap) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (int i = 0; i < reader->cursor_count; i++) {
+        int status = cursor_open(reader, &reader->cursors[i], i, i + 1);
+        if (status != DE430_ERROR_NONE) {
+            return status;
+        }
+
+        status = cursor_read(reader, &reader->cursors[i], &reader->lookahead[i]);
+        if (status < 0) {
+            return status;
+        }
+        if (status > 0) {
+            reader->heap[reader->heap_size++] = i;
+        } else {
+            cursor_close(reader, &reader->cursors[i]);
+        }
+    }
+
+    for (int i = reader->heap_size / 2 - 1; i >= 0; i--) {
+        heap_sift_down(reader, i);
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+static int reader_next_by_time(DE430ChunkReader *reader, DE430Chunk *chunk) {
+    int count = 0;
+
+    while (count < reader->chunk_size && reader->heap_size > 0) {
+        int c = reader->heap[0];
+        reader->points[count] = reader->lookahead[c];
+        reader->object_indices[count] = c;
+        count++;
+
+        // Refill from the same object, or drop it once it runs out
+        int status = cursor_read(reader, &reader->cursors[c], &reader->lookahead[c]);
+        if (status < 0) {
+            return status;
+        }
+        if (status == 0) {
+            cursor_close(reader, &reader->cursors[c]);
+            reader->heap[0] = reader->heap[--reader->heap_size];
+        }
+        heap_sift_down(reader, 0);
+    }
+
+    chunk->count = count;
+    return DE430_ERROR_NONE;
+}
+
+static int reader_next_by_object(DE430ChunkReader *reader, DE430Chunk *chunk) {
+    ChunkCursor *cursor = &reader->cursors[0];
+    int count = 0;
+
+    while (count < reader->chunk_size) {
+        // Chunks end where an object ends
+        if (cursor->remaining == 0 && count > 0) break;
+
+        int status = cursor_read(reader, cursor, &reader->points[count]);
+        if (status < 0) {
+            return status;
+        }
+        if (status == 0) break;
+
+        reader->object_indices[count] = cursor->object;
+        count++;
+    }
+
+    chunk->count = count;
+    return DE430_ERROR_NONE;
+}
+
+// Public API
+
+int de430_chunk_reader_open(const char *filename, DE430Format format, DE430ChunkOrder order,
+                            int chunk_size, DE430ChunkReader **reader) {
+    if (!filename || !reader || chunk_size < 0 ||
+        (format != DE430_FORMAT_JSON && format != DE430_FORMAT_CSV && format != DE430_FORMAT_BINARY) ||
+        (order != DE430_ORDER_BY_OBJECT && order != DE430_ORDER_BY_TIME)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430ChunkReader *r = de430_calloc(1, sizeof(DE430ChunkReader));
+    if (!r) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    r->format = format;
+    r->order = order;
+    r->chunk_size = chunk_size > 0 ? chunk_size : STREAM_CHUNK_POINTS;
+    r->filename = de430_malloc(strlen(filename) + 1);
+
+    int status = r->filename ? DE430_ERROR_NONE : DE430_ERROR_MEMORY_ALLOCATION;
+    if (status == DE430_ERROR_NONE) {
+        strcpy(r->filename, filename);
+
+        if (format == DE430_FORMAT_BINARY) {
+            status = reader_index_binary(r);
+        } else if (format == DE430_FORMAT_CSV) {
+            status = reader_index_csv(r);
+        } else {
+            status = reader_index_json(r);
+        }
+    }
+
+    // Chunk buffers are allocated once and reused for every chunk
+    if (status == DE430_ERROR_NONE) {
+        r->points = de430_malloc(r->chunk_size * sizeof(DE430EphemerisPoint));
+        r->object_indices = de430_malloc(r->chunk_size * sizeof(int));
+        r->cursor_count = order == DE430_ORDER_BY_TIME ? r->object_count : 1;
+        r->cursors = de430_calloc(r->cursor_count > 0 ? r->cursor_count : 1, sizeof(ChunkCursor));
+        if (!r->points || !r->object_indices || !r->cursors) {
+            status = DE430_ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    if (status == DE430_ERROR_NONE) {
+        status = order == DE430_ORDER_BY_TIME
+                 ? reader_start_time_order(r)
+                 : cursor_open(r, &r->cursors[0], 0, r->object_count);
+    }
+
+    if (status != DE430_ERROR_NONE) {
+        de430_chunk_reader_close(r);
+        return status;
+    }
+
+    *reader = r;
+    return DE430_ERROR_NONE;
+}
+
+int de430_chunk_reader_object_count(const DE430ChunkReader *reader) {
+    if (!reader) return 0;
+    return reader->object_count;
+}
+
+const char* de430_chunk_reader_object_name(const DE430ChunkReader *reader, int index) {
+    if (!reader || index < 0 || index >= reader->object_count) {
+        return NULL;
+    }
+    return reader->entries[index].name;
+}
+
+int de430_chunk_reader_next(DE430ChunkReader *reader, DE430Chunk *chunk) {
+    if (!reader || !chunk) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    chunk->points = reader->points;
+    chunk->object_indices = reader->object_indices;
+    chunk->count = 0;
+
+    return reader->order == DE430_ORDER_BY_TIME
+           ? reader_next_by_time(reader, chunk)
+           : reader_next_by_object(reader, chunk);
+}
+
+void de430_chunk_reader_close(DE430ChunkReader *reader) {
+    if (!reader) return;
+
+    for (int i = 0; reader->cursors && i < reader->cursor_count; i++) {
+        cursor_close(reader, &reader->cursors[i]);
+    }
+
+    de430_free(reader->cursors);
+    de430_free(reader->lookahead);
+    de430_free(reader->heap);
+    de430_free(reader->points);
+    de430_free(reader->object_indices);
+    de430_free(reader->entries);
+    de430_free(reader->filename);
+    de430_free(reader);
+}
@@ -0,0 +1,396 @@
+//
+// Rise, transit and set tables for many observer sites from one geocentric
+// dataset. Each object's RA/Dec are interpolated onto a scan grid once; every
+// site then evaluates altitudes over the grid and refines the crossings.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RISE_SET_DEFAULT_HORIZON (-34.0 / 60.0 * M_PI / 180.0)
+#define RISE_SET_DEFAULT_STEP (1.0 / 24.0)
+#define RISE_SET_ROOT_ITERATIONS 60
+#define RISE_SET_ROOT_TOLERANCE 1e-8        // Days, about a millisecond
+#define RISE_SET_INITIAL_CAPACITY 16
+#define RISE_SET_J2000 2451545.0
+
+void de430_init_rise_set_options(DE430RiseSetOptions *options) {
+    if (!options) return;
+
+    options->horizon = RISE_SET_DEFAULT_HORIZON;
+    options->horizons = NULL;
+    options->scan_step = RISE_SET_DEFAULT_STEP;
+    options->threads = 0;
+}
+
+static double rise_set_wrap(double angle) {
+    angle = fmod(angle, 2.0 * M_PI);
+    if (angle > M_PI) angle -= 2.0 * M_PI;
+    if (angle <= -M_PI) angle += 2.0 * M_PI;
+    return angle;
+}
+
+// Greenwich mean sidereal time (radians, IAU 1982)
+static double rise_set_gmst(double jd) {
+    double d = jd - RISE_SET_J2000;
+    double t = d / 36525.0;
+    double degrees = 280.46061837 + 360.98564736629 * d + t * t * (0.000387933 - t / 38710000.0);
+    return fmod(degrees, 360.0) * M_PI / 180.0;
+}
+
+// RA/Dec at any date on a cubic through the nearest samples. hint keeps the
+// last sample index so that scans in date order do not search.
+static void rise_set_position(const DE430EphemerisData *object, int *hint, double jd, double *ra, double *dec) {
+    const DE430EphemerisPoint *points = object->points;
+    int n = object->count;
+
+    // Sample k with points[k].jd <= jd < points[k + 1].jd, clamped to the ends
+    int k = *hint;
+    if (k < 0 || k > n - 2 || points[k].jd > jd) {
+        int lo = 0, hi = n - 1;
+        while (hi - lo > 1) {
+            int mid = (lo + hi) / 2;
+            if (points[mid].jd <= jd) lo = mid; else hi = mid;
+        }
+        k = lo;
+    }
+    while (k < n - 2 && points[k + 1].jd <= jd) k++;
+    *hint = k;
+
+    int first = k - 1 < 0 ? 0 : k - 1;
+    int last = k + 2 > n - 1 ? n - 1 : k + 2;
+
+    double origin = points[k].ra_dec[0];
+    double sum_ra = 0.0, sum_dec = 0.0;
+    for (int i = first; i <= last; i++) {
+        double basis = 1.0;
+        for (int j = first; j <= last; j++) {
+            if (j != i) basis *= (jd - points[j].jd) / (points[i].jd - points[j].jd);
+        }
+        sum_ra += basis * (origin + rise_set_wrap(points[i].ra_dec[0] - origin));
+        sum_dec += basis * points[i].ra_dec[1];
+    }
+    *ra = sum_ra;
+    *dec = sum_dec;
+}
+
+// One object's track on the scan grid, shared by all sites
+typedef struct {
+    int count;                  // Grid dates, 0 if the object has too few samples
+    double *jd;
+    double *ra_gmst;            // Greenwich hour angle, GMST - RA
+    double *sin_dec;
+    double *cos_dec;
+} RiseSetTrack;
+
+typedef struct {
+    const DE430EphemerisData *data;
+    int count;
+    const DE430Site *sites;
+    const DE430RiseSetOptions *options;
+    RiseSetTrack *tracks;
+    DE430RiseSetTable *tables;
+} RiseSetContext;
+
+static int rise_set_track_task(void *context, int index) {
+    RiseSetContext *work = (RiseSetContext*)context;
+    const DE430EphemerisData *object = &work->data[index];
+    RiseSetTrack *track = &work->tracks[index];
+
+    if (object->count < 2) {
+        return DE430_ERROR_NONE;
+    }
+
+    double first = object->points[0].jd;
+    double last = object->points[object->count - 1].jd;
+    int steps = (int)floor((last - first) / work->options->scan_step);
+    int count = steps + 1 + (first + steps * work->options->scan_step < last);
+
+    track->jd = de430_malloc((size_t)count * sizeof(double));
+    track->ra_gmst = de430_malloc((size_t)count * sizeof(double));
+    track->sin_dec = de430_malloc((size_t)count * sizeof(double));
+    track->cos_dec = de430_malloc((size_t)count * sizeof(double));
+    if (!track->jd || !track->ra_gmst || !track->sin_dec || !track->cos_dec) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int hint = 0;
+    for (int i = 0; i < count; i++) {
+        double jd = i <= steps ? first + i * work->options->scan_step : last;
+        double ra, dec;
+        rise_set_position(object, &hint, jd, &ra, &dec);
+        track->jd[i] = jd;
+        track->ra_gmst[i] = rise_set_gmst(jd) - ra;
+        track->sin_dec[i] = sin(dec);
+        track->cos_dec[i] = cos(dec);
+    }
+    track->count = count;
+    return DE430_ERROR_NONE;
+}
+
+// Altitude sines and local hour angles of a whole track at one site
+static void rise_set_altitudes(int count, double sin_lat, double cos_lat, double longitude,
+                               const double *restrict ra_gmst, const double *restrict sin_dec,
+                               const double *restrict cos_dec, double *restrict sin_alt,
+                               double *restrict hour_angle) {
+    for (int i = 0; i < count; i++) {
+        double h = ra_gmst[i] + longitude;
+        hour_angle[i] = h;
+        sin_alt[i] = sin_lat * sin_dec[i] + cos_lat * cos_dec[i] * cos(h);
+    }
+}
+
+// Site and object a crossing is refined for
+typedef struct {
+    const DE430EphemerisData *object;
+    int hint;
+    double sin_lat, cos_lat, longitude;
+    double sin_horizon;
+} RiseSetObserver;
+
+static void rise_set_observe(RiseSetObserver *observer, double jd, double *sin_alt, double *hour_angle,
+                             double *azimuth) {
+    double ra, dec;
+    rise_set_position(observer->object, &observer->hint, jd, &ra, &dec);
+    double h = rise_set_wrap(rise_set_gmst(jd) + observer->longitude - ra);
+    double sin_dec = sin(dec), cos_dec = cos(dec);
+
+    *sin_alt = observer->sin_lat * sin_dec + observer->cos_lat * cos_dec * cos(h);
+    *hour_angle = h;
+    if (azimuth) {
+        double a = atan2(-cos_dec * sin(h), sin_dec * observer->cos_lat - cos_dec * cos(h) * observer->sin_lat);
+        *azimuth = a < 0.0 ? a + 2.0 * M_PI : a;
+    }
+}
+
+static double rise_set_residual(RiseSetObserver *observer, DE430RiseSetType type, double jd) {
+    double sin_alt, hour_angle;
+    rise_set_observe(observer, jd, &sin_alt, &hour_angle, NULL);
+    return type == DE430_TRANSIT ? hour_angle : sin_alt - observer->sin_horizon;
+}
+
+// Root of the residual between a and b, whose residuals fa and fb differ
+// in sign (Illinois variant of regula falsi)
+static double rise_set_root(RiseSetObserver *observer, DE430RiseSetType type, double a, double b,
+                            double fa, double fb) {
+    int side = 0;
+    double c = a;
+    for (int iteration = 0; iteration < RISE_SET_ROOT_ITERATIONS && b - a > RISE_SET_ROOT_TOLERANCE; iteration++) {
+        c = (a * fb - b * fa) / (fb - fa);
+        if (!(c > a && c < b)) c = 0.5 * (a + b);
+        double fc = rise_set_residual(observer, type, c);
+
+        if ((fc < 0.0) == (fa < 0.0)) {
+            a = c;
+            fa = fc;
+            if (side == -1) fb *= 0.5;
+            side = -1;
+        } else {
+            b = c;
+            fb = fc;
+            if (side == 1) fa *= 0.5;
+            side = 1;
+        }
+    }
+    return c;
+}
+
+static int rise_set_add(DE430RiseSetTable *table, int *capacity, DE430RiseSetType type, double jd, double value) {
+    if (table->count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : RISE_SET_INITIAL_CAPACITY;
+        DE430RiseSetEvent *larger = de430_realloc(table->events, (size_t)grown * sizeof(DE430RiseSetEvent));
+        if (!larger) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        table->events = larger;
+        *capacity = grown;
+    }
+    table->events[table->count++] = (DE430RiseSetEvent){type, jd, value};
+    return DE430_ERROR_NONE;
+}
+
+static int rise_set_event_compare(const void *a, const void *b) {
+    double ja = ((const DE430RiseSetEvent*)a)->jd;
+    double jb = ((const DE430RiseSetEvent*)b)->jd;
+    return (ja > jb) - (ja < jb);
+}
+
+static int rise_set_scan(const RiseSetTrack *track, RiseSetObserver *observer, const double *sin_alt,
+                         const double *hour_angle, DE430RiseSetTable *table) {
+    int capacity = 0;
+    int status = DE430_ERROR_NONE;
+
+    for (int i = 0; status == DE430_ERROR_NONE && i < track->count - 1; i++) {
+        double a = track->jd[i], b = track->jd[i + 1];
+
+        // Altitude crossing the horizon
+        double ga = sin_alt[i] - observer->sin_horizon;
+        double gb = sin_alt[i + 1] - observer->sin_horizon;
+        if ((ga < 0.0) != (gb < 0.0)) {
+            DE430RiseSetType type = ga < 0.0 ? DE430_RISE : DE430_SET;
+            double jd = rise_set_root(observer, type, a, b, ga, gb);
+            double s, h, azimuth;
+            rise_set_observe(observer, jd, &s, &h, &azimuth);
+            status = rise_set_add(table, &capacity, type, jd, azimuth);
+        }
+
+        // Hour angle passing zero (not the jump at +-pi)
+        double ha = rise_set_wrap(hour_angle[i]);
+        double hb = rise_set_wrap(hour_angle[i + 1]);
+        if (status == DE430_ERROR_NONE && ha < 0.0 && hb >= 0.0 && hb - ha < M_PI) {
+            double jd = rise_set_root(observer, DE430_TRANSIT, a, b, ha, hb);
+            double s, h;
+            rise_set_observe(observer, jd, &s, &h, NULL);
+            status = rise_set_add(table, &capacity, DE430_TRANSIT, jd, asin(s < -1.0 ? -1.0 : s > 1.0 ? 1.0 : s));
+        }
+    }
+
+    // Events found in one step may come out of order
+    if (status == DE430_ERROR_NONE && table->count > 1) {
+        qsort(table->events, (size_t)table->count, sizeof(DE430RiseSetEvent), rise_set_event_compare);
+    }
+    return status;
+}
+
+static int rise_set_site_task(void *context, int index) {
+    RiseSetContext *work = (RiseSetContext*)context;
+    const DE430Site *site = &work->sites[index];
+
+    int longest = 0;
+    for (int o = 0; o < work->count; o++) {
+        if (work->tracks[o].count > longest) longest = work->tracks[o].count;
+    }
+
+    double *sin_alt = de430_malloc((size_t)(longest ? longest : 1) * sizeof(double));
+    double *hour_angle = de430_malloc((size_t)(longest ? longest : 1) * sizeof(double));
+    int status = DE430_ERROR_NONE;
+    if (!sin_alt || !hour_angle) {
+        status = DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    double latitude = site->latitude * M_PI / 180.0;
+    double longitude = site->longitude * M_PI / 180.0;
+
+    for (int o = 0; status == DE430_ERROR_NONE && o < work->count; o++) {
+        const RiseSetTrack *track = &work->tracks[o];
+        DE430RiseSetTable *table = &work->tables[(size_t)index * work->count + o];
+        table->site_index = index;
+        table->object_index = o;
+        if (track->count < 2) continue;
+
+        double horizon = work->options->horizons ? work->options->horizons[o] : work->options->horizon;
+        RiseSetObserver observer = {&work->data[o], 0, sin(latitude), cos(latitude), longitude, sin(horizon)};
+
+        rise_set_altitudes(track->count, observer.sin_lat, observer.cos_lat, longitude,
+                           track->ra_gmst, track->sin_dec, track->cos_dec, sin_alt, hour_angle);
+        status = rise_set_scan(track, &observer, sin_alt, hour_angle, table);
+    }
+
+    de430_free(sin_alt);
+    de430_free(hour_angle);
+    return status;
+}
+
+int de430_rise_set_tables(const DE430EphemerisData *data, int count, const DE430Site *sites, int site_count,
+                          const DE430RiseSetOptions *options, DE430RiseSetTable **tables) {
+    if ((!data && count > 0) || count < 0 || (!sites && site_count > 0) || site_count < 0 || !tables) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430RiseSetOptions defaults;
+    if (!options) {
+        de430_init_rise_set_options(&defaults);
+        options = &defaults;
+    }
+    if (!(options->scan_step > 0.0)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    size_t table_count = (size_t)site_count * (size_t)count;
+    DE430RiseSetTable *result = de430_calloc(table_count ? table_count : 1, sizeof(DE430RiseSetTable));
+    RiseSetTrack *tracks = de430_calloc(count ? (size_t)count : 1, sizeof(RiseSetTrack));
+    if (!result || !tracks) {
+        de430_free(result);
+        de430_free(tracks);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    RiseSetContext work = {data, count, sites, options, tracks, result};
+    int status = de430_parallel_for(count, options->threads, rise_set_track_task, &work);
+    if (status == DE430_ERROR_NONE) {
+        status = de430_parallel_for(site_count, options->threads, rise_set_site_task, &work);
+    }
+
+    for (int o = 0; o < count; o++) {
+        de430_free(tracks[o].jd);
+        de430_free(tracks[o].ra_gmst);
+        de430_free(tracks[o].sin_dec);
+        de430_free(tracks[o].cos_dec);
+    }
+    de430_free(tracks);
+
+    if (status != DE430_ERROR_NONE) {
+        de430_rise_set_tables_free(result, (int)table_count);
+        return status;
+    }
+
+    *tables = result;
+    return DE430_ERROR_NONE;
+}
+
+// Copy a name for a CSV field, replacing commas with spaces
+static void rise_set_csv_name(char *out, const char *name, size_t size) {
+    strncpy(out, name, size - 1);
+    out[size - 1] = '\0';
+
+    for (char *p = out; *p; p++) {
+        if (*p == ',') *p = ' ';
+    }
+}
+
+int de430_save_rise_set_csv(const DE430RiseSetTable *tables, int table_count, const DE430EphemerisData *data,
+                            const DE430Site *sites, const char *filename) {
+    static const char *const type_names[] = {"rise", "transit", "set"};
+
+    if ((!tables && table_count > 0) || table_count < 0 || !data || !sites || !filename) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    fprintf(fp, "site,object,event,jd,value\n");
+
+    for (int t = 0; t < table_count; t++) {
+        const DE430RiseSetTable *table = &tables[t];
+        char site_name[65], object_name[65];
+        rise_set_csv_name(site_name, sites[table->site_index].name, sizeof(site_name));
+        rise_set_csv_name(object_name, data[table->object_index].object_name, sizeof(object_name));
+
+        for (int e = 0; e < table->count; e++) {
+            const DE430RiseSetEvent *event = &table->events[e];
+            fprintf(fp, "%s,%s,%s,%.8f,%.6f\n", site_name, object_name, type_names[event->type],
+                    event->jd, event->value);
+        }
+    }
+
+    int status = ferror(fp) ? DE430_ERROR_FILE_IO : DE430_ERROR_NONE;
+    if (fclose(fp) != 0) status = DE430_ERROR_FILE_IO;
+    return status;
+}
+
+void de430_rise_set_tables_free(DE430RiseSetTable *tables, int table_count) {
+    if (!tables) return;
+
+    for (int t = 0; t < table_count; t++) {
+        de430_free(tables[t].events);
+    }
+    de430_free(tables);
+}
@@ -0,0 +1,328 @@
+//
+// Pairwise angular separations of objects sampled on a shared time grid:
+// single-epoch matrices, the full epoch-by-pair tensor, and reductions over
+// time that never hold more than one row of the matrix per thread.
+//
+// Directions are turned into unit vectors once, stored per epoch as plain
+// x, y and z arrays. Comparisons run on squared chords, which order the
+// same way as angles; only reported values are converted to angles.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const DE430EphemerisData *data;
+    int count;
+    int epochs;
+    int pair_count;
+    DE430SeparationSource source;
+
+    double *x, *y, *z;          // Unit vectors, object o at epoch e at e * count + o
+    double chord_limit;         // Squared chord of the summary threshold
+
+    double *tensor;
+    DE430SeparationSummary *summary;
+} SeparationWork;
+
+static void separation_direction(const DE430EphemerisPoint *point, DE430SeparationSource source, double u[3]) {
+    if (source == DE430_SEPARATION_RA_DEC) {
+        double cos_dec = cos(point->ra_dec[1]);
+        u[0] = cos_dec * cos(point->ra_dec[0]);
+        u[1] = cos_dec * sin(point->ra_dec[0]);
+        u[2] = sin(point->ra_dec[1]);
+        return;
+    }
+
+    double norm = sqrt(point->position[0] * point->position[0] +
+                       point->position[1] * point->position[1] +
+                       point->position[2] * point->position[2]);
+    // A zero vector has no direction; NaN keeps it out of every comparison
+    double scale = norm > 0.0 ? 1.0 / norm : NAN;
+    u[0] = point->position[0] * scale;
+    u[1] = point->position[1] * scale;
+    u[2] = point->position[2] * scale;
+}
+
+static double separation_angle(double chord2) {
+    double half = 0.5 * sqrt(chord2);
+    return 2.0 * asin(half > 1.0 ? 1.0 : half);
+}
+
+// Squared chords from one direction to a run of others. Plain arrays so the
+// compiler can vectorize the loop.
+static void separation_chord2(double ux, double uy, double uz, const double *restrict x, const double *restrict y,
+                              const double *restrict z, int n, double *restrict out) {
+    for (int k = 0; k < n; k++) {
+        double dx = x[k] - ux;
+        double dy = y[k] - uy;
+        double dz = z[k] - uz;
+        out[k] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+// Every object must be sampled at the same dates
+static int separation_check_dates(const DE430EphemerisData *data, int count) {
+    for (int i = 1; i < count; i++) {
+        if (data[i].count != data[0].count) {
+            return DE430_ERROR_INVALID_CONFIG;
+        }
+        for (int k = 0; k < data[0].count; k++) {
+            if (fabs(data[i].points[k].jd - data[0].points[k].jd) > 1e-7) {
+                return DE430_ERROR_INVALID_CONFIG;
+            }
+        }
+    }
+    return DE430_ERROR_NONE;
+}
+
+static int separation_direction_task(void *context, int index) {
+    SeparationWork *work = (SeparationWork*)context;
+    const DE430EphemerisData *object = &work->data[index];
+
+    for (int e = 0; e < work->epochs; e++) {
+        double u[3];
+        separation_direction(&object->points[e], work->source, u);
+        size_t slot = (size_t)e * work->count + index;
+        work->x[slot] = u[0];
+        work->y[slot] = u[1];
+        work->z[slot] = u[2];
+    }
+    return DE430_ERROR_NONE;
+}
+
+// Check the dates and fill in the unit vectors of every epoch
+static int separation_prepare(SeparationWork *work, const DE430EphemerisData *data, int count,
+                              DE430SeparationSource source, int threads) {
+    memset(work, 0, sizeof(SeparationWork));
+    if ((!data && count > 0) || count < 0 ||
+        (source != DE430_SEPARATION_RA_DEC && source != DE430_SEPARATION_POSITION)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    int status = separation_check_dates(data, count);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    work->data = data;
+    work->count = count;
+    work->epochs = count > 0 ? data[0].count : 0;
+    work->pair_count = count * (count - 1) / 2;
+    work->source = source;
+    if (work->pair_count == 0 || work->epochs == 0) {
+        return DE430_ERROR_NONE;
+    }
+
+    size_t size = (size_t)work->epochs * count * sizeof(double);
+    work->x = de430_malloc(size);
+    work->y = de430_malloc(size);
+    work->z = de430_malloc(size);
+    if (!work->x || !work->y || !work->z) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    return de430_parallel_for(count, threads, separation_direction_task, work);
+}
+
+static void separation_release(SeparationWork *work) {
+    de430_free(work->x);
+    de430_free(work->y);
+    de430_free(work->z);
+    work->x = work->y = work->z = NULL;
+}
+
+// One packed matrix from the unit vectors of one epoch
+static void separation_fill_matrix(int count, const double *x, const double *y, const double *z, double *matrix) {
+    double *out = matrix;
+    for (int a = 0; a < count - 1; a++) {
+        int n = count - a - 1;
+        separation_chord2(x[a], y[a], z[a], x + a + 1, y + a + 1, z + a + 1, n, out);
+        for (int k = 0; k < n; k++) {
+            out[k] = separation_angle(out[k]);
+        }
+        out += n;
+    }
+}
+
+int de430_separation_matrix(const DE430EphemerisData *data, int count, int epoch,
+                            DE430SeparationSource source, double *matrix) {
+    if ((!data && count > 0) || count < 0 || !matrix || epoch < 0 ||
+        (source != DE430_SEPARATION_RA_DEC && source != DE430_SEPARATION_POSITION)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+    if (count < 2) {
+        return DE430_ERROR_NONE;
+    }
+    for (int i = 0; i < count; i++) {
+        if (epoch >= data[i].count || fabs(data[i].points[epoch].jd - data[0].points[epoch].jd) > 1e-7) {
+            return DE430_ERROR_INVALID_CONFIG;
+        }
+    }
+
+    double *directions = de430_malloc((size_t)count * 3 * sizeof(double));
+    if (!directions) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+    double *x = directions, *y = directions + count, *z = directions + 2 * count;
+    for (int i = 0; i < count; i++) {
+        double u[3];
+        separation_direction(&data[i].points[epoch], source, u);
+        x[i] = u[0];
+        y[i] = u[1];
+        z[i] = u[2];
+    }
+
+    separation_fill_matrix(count, x, y, z, matrix);
+    de430_free(directions);
+    return DE430_ERROR_NONE;
+}
+
+static int separation_tensor_task(void *context, int epoch) {
+    SeparationWork *work = (SeparationWork*)context;
+    size_t offset = (size_t)epoch * work->count;
+    separation_fill_matrix(work->count, work->x + offset, work->y + offset, work->z + offset,
+                           work->tensor + (size_t)epoch * work->pair_count);
+    return DE430_ERROR_NONE;
+}
+
+int de430_separation_tensor(const DE430EphemerisData *data, int count, DE430SeparationSource source,
+                            int threads, double **tensor) {
+    if (!tensor) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+    *tensor = NULL;
+
+    SeparationWork work;
+    int status = separation_prepare(&work, data, count, source, threads);
+    if (status == DE430_ERROR_NONE && work.pair_count > 0 && work.epochs > 0) {
+        if ((size_t)work.epochs > SIZE_MAX / sizeof(double) / (size_t)work.pair_count) {
+            status = DE430_ERROR_MEMORY_ALLOCATION;
+        } else {
+            work.tensor = de430_malloc((size_t)work.epochs * work.pair_count * sizeof(double));
+            if (!work.tensor) {
+                status = DE430_ERROR_MEMORY_ALLOCATION;
+            } else {
+                status = de430_parallel_for(work.epochs, threads, separation_tensor_task, &work);
+            }
+        }
+    }
+    separation_release(&work);
+
+    if (status != DE430_ERROR_NONE) {
+        de430_free(work.tensor);
+        return status;
+    }
+    *tensor = work.tensor;
+    return DE430_ERROR_NONE;
+}
+
+// One row of the matrix, object a against every later object, over all epochs
+static int separation_summary_task(void *context, int a) {
+    SeparationWork *work = (SeparationWork*)context;
+    DE430SeparationSummary *summary = work->summary;
+    int n = work->count - a - 1;
+    int first = DE430_PAIR_INDEX(a, a + 1, work->count);
+
+    double *chord2 = de430_malloc((size_t)n * sizeof(double));
+    if (!chord2) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    // Squared chords until the end, then angles
+    double *min = summary->min_separation + first;
+    double *max = summary->max_separation + first;
+    double *min_jd = summary->min_jd + first;
+    double *max_jd = summary->max_jd + first;
+    int *close = summary->close_epochs + first;
+    for (int k = 0; k < n; k++) {
+        min[k] = INFINITY;
+        max[k] = -INFINITY;
+        min_jd[k] = NAN;
+        max_jd[k] = NAN;
+        close[k] = 0;
+    }
+
+    for (int e = 0; e < work->epochs; e++) {
+        size_t offset = (size_t)e * work->count;
+        const double *x = work->x + offset, *y = work->y + offset, *z = work->z + offset;
+        double jd = work->data[0].points[e].jd;
+
+        separation_chord2(x[a], y[a], z[a], x + a + 1, y + a + 1, z + a + 1, n, chord2);
+        for (int k = 0; k < n; k++) {
+            double c = chord2[k];
+            if (c < min[k]) {
+                min[k] = c;
+                min_jd[k] = jd;
+            }
+            if (c > max[k]) {
+                max[k] = c;
+                max_jd[k] = jd;
+            }
+            close[k] += c <= work->chord_limit;
+        }
+    }
+
+    for (int k = 0; k < n; k++) {
+        min[k] = isnan(min_jd[k]) ? NAN : separation_angle(min[k]);
+        max[k] = isnan(max_jd[k]) ? NAN : separation_angle(max[k]);
+    }
+
+    de430_free(chord2);
+    return DE430_ERROR_NONE;
+}
+
+int de430_separation_summary(const DE430EphemerisData *data, int count, DE430SeparationSource source,
+                             double threshold, int threads, DE430SeparationSummary *summary) {
+    if (!summary || !(threshold >= 0.0)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+    memset(summary, 0, sizeof(DE430SeparationSummary));
+
+    SeparationWork work;
+    int status = separation_prepare(&work, data, count, source, threads);
+    if (status == DE430_ERROR_NONE && work.pair_count > 0) {
+        size_t pairs = (size_t)work.pair_count;
+        summary->pair_count = work.pair_count;
+        summary->min_separation = de430_malloc(pairs * sizeof(double));
+        summary->min_jd = de430_malloc(pairs * sizeof(double));
+        summary->max_separation = de430_malloc(pairs * sizeof(double));
+        summary->max_jd = de430_malloc(pairs * sizeof(double));
+        summary->close_epochs = de430_malloc(pairs * sizeof(int));
+        if (!summary->min_separation || !summary->min_jd || !summary->max_separation ||
+            !summary->max_jd || !summary->close_epochs) {
+            status = DE430_ERROR_MEMORY_ALLOCATION;
+        } else {
+            double half = threshold < M_PI ? sin(0.5 * threshold) : 1.0;
+            work.chord_limit = 4.0 * half * half;
+            work.summary = summary;
+            status = de430_parallel_for(count - 1, threads, separation_summary_task, &work);
+        }
+    }
+    separation_release(&work);
+
+    if (status != DE430_ERROR_NONE) {
+        de430_separation_summary_free(summary);
+    }
+    return status;
+}
+
+void de430_separation_tensor_free(double *tensor) {
+    de430_free(tensor);
+}
+
+void de430_separation_summary_free(DE430SeparationSummary *summary) {
+    if (!summary) return;
+
+    de430_free(summary->min_separation);
+    de430_free(summary->min_jd);
+    de430_free(summary->max_separation);
+    de430_free(summary->max_jd);
+    de430_free(summary->close_epochs);
+    memset(summary, 0, sizeof(DE430SeparationSummary));
+}
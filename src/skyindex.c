@@ -0,0 +1,389 @@
+//
+// Sky index: time buckets of k-d trees over unit direction vectors, for
+// "which objects are within r of this RA/Dec around time t" searches.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SKY_DEFAULT_BUCKET_DAYS 1.0
+#define SKY_BATCH_QUERIES 64        // Queries per task of a batch search
+#define SKY_INITIAL_MATCHES 16
+#define SKY_STACK_DEPTH 128         // Far deeper than any balanced tree here
+
+// An indexed point. Within a bucket the entries form an implicit balanced
+// k-d tree: the node of a range is its middle entry, split along `axis`.
+typedef struct {
+    double v[3];                // Unit vector towards RA/Dec
+    double jd;
+    int object;
+    int point;
+    int axis;
+} SkyEntry;
+
+// Entries first to first + count - 1, all with the same time bucket
+typedef struct {
+    long long key;
+    int first;
+    int count;
+} SkyBucket;
+
+struct DE430SkyIndex {
+    double jd_origin;           // Start of bucket 0
+    double bucket_days;
+    SkyEntry *entries;
+    int entry_count;
+    SkyBucket *buckets;
+    int bucket_count;
+};
+
+static void sky_unit_vector(double ra, double dec, double v[3]) {
+    double cos_dec = cos(dec);
+    v[0] = cos_dec * cos(ra);
+    v[1] = cos_dec * sin(ra);
+    v[2] = sin(dec);
+}
+
+static long long sky_bucket_key(const DE430SkyIndex *index, double jd) {
+    return (long long)floor((jd - index->jd_origin) / index->bucket_days);
+}
+
+static int sky_compare_jd(const void *a, const void *b) {
+    double ja = ((const SkyEntry*)a)->jd;
+    double jb = ((const SkyEntry*)b)->jd;
+    return (ja > jb) - (ja < jb);
+}
+
+// Reorder entries[lo..hi) so that entries[k] has the k-th smallest
+// coordinate along the axis, with no larger one before it and no smaller
+// one after it
+static void sky_select(SkyEntry *entries, int lo, int hi, int k, int axis) {
+    hi--;
+    while (lo < hi) {
+        // Median of three as the pivot
+        int mid = lo + (hi - lo) / 2;
+        double a = entries[lo].v[axis], b = entries[mid].v[axis], c = entries[hi].v[axis];
+        double pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+
+        int i = lo, j = hi;
+        while (i <= j) {
+            while (entries[i].v[axis] < pivot) i++;
+            while (entries[j].v[axis] > pivot) j--;
+            if (i <= j) {
+                SkyEntry swap = entries[i];
+                entries[i] = entries[j];
+                entries[j] = swap;
+                i++;
+                j--;
+            }
+        }
+
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            return;
+        }
+    }
+}
+
+static void sky_build_tree(SkyEntry *entries, int lo, int hi) {
+    while (hi - lo > 0) {
+        // Split along the axis with the widest spread
+        double min[3] = {INFINITY, INFINITY, INFINITY};
+        double max[3] = {-INFINITY, -INFINITY, -INFINITY};
+        for (int i = lo; i < hi; i++) {
+            for (int d = 0; d < 3; d++) {
+                if (entries[i].v[d] < min[d]) min[d] = entries[i].v[d];
+                if (entries[i].v[d] > max[d]) max[d] = entries[i].v[d];
+            }
+        }
+        int axis = 0;
+        for (int d = 1; d < 3; d++) {
+            if (max[d] - min[d] > max[axis] - min[axis]) axis = d;
+        }
+
+        int mid = lo + (hi - lo) / 2;
+        sky_select(entries, lo, hi, mid, axis);
+        entries[mid].axis = axis;
+
+        // Recurse into the smaller half, loop on the larger one
+        if (mid - lo < hi - mid - 1) {
+            sky_build_tree(entries, lo, mid);
+            lo = mid + 1;
+        } else {
+            sky_build_tree(entries, mid + 1, hi);
+            hi = mid;
+        }
+    }
+}
+
+static int sky_build_task(void *context, int index) {
+    DE430SkyIndex *sky = (DE430SkyIndex*)context;
+    const SkyBucket *bucket = &sky->buckets[index];
+    sky_build_tree(sky->entries, bucket->first, bucket->first + bucket->count);
+    return DE430_ERROR_NONE;
+}
+
+int de430_sky_index_build(const DE430EphemerisData *data, int count, double bucket_days, int threads,
+                          DE430SkyIndex **index) {
+    if ((!data && count > 0) || count < 0 || !index || bucket_days < 0.0 || isnan(bucket_days)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430SkyIndex *sky = de430_calloc(1, sizeof(DE430SkyIndex));
+    if (!sky) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+    sky->bucket_days = bucket_days > 0.0 ? bucket_days : SKY_DEFAULT_BUCKET_DAYS;
+
+    // Points without a direction or date cannot be found by any search
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += (size_t)data[i].count;
+    }
+    sky->entries = total > 0 ? de430_malloc(total * sizeof(SkyEntry)) : NULL;
+    if (total > 0 && !sky->entries) {
+        de430_sky_index_free(sky);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < data[i].count; j++) {
+            const DE430EphemerisPoint *point = &data[i].points[j];
+            if (!isfinite(point->jd) || !isfinite(point->ra_dec[0]) || !isfinite(point->ra_dec[1])) {
+                continue;
+            }
+            SkyEntry *entry = &sky->entries[sky->entry_count++];
+            sky_unit_vector(point->ra_dec[0], point->ra_dec[1], entry->v);
+            entry->jd = point->jd;
+            entry->object = i;
+            entry->point = j;
+            entry->axis = 0;
+        }
+    }
+
+    if (sky->entry_count == 0) {
+        *index = sky;
+        return DE430_ERROR_NONE;
+    }
+
+    // Buckets are runs of the entries in date order
+    qsort(sky->entries, (size_t)sky->entry_count, sizeof(SkyEntry), sky_compare_jd);
+    sky->jd_origin = sky->entries[0].jd;
+
+    int bucket_count = 1;
+    for (int i = 1; i < sky->entry_count; i++) {
+        if (sky_bucket_key(sky, sky->entries[i].jd) != sky_bucket_key(sky, sky->entries[i - 1].jd)) {
+            bucket_count++;
+        }
+    }
+    sky->buckets = de430_malloc((size_t)bucket_count * sizeof(SkyBucket));
+    if (!sky->buckets) {
+        de430_sky_index_free(sky);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (int i = 0; i < sky->entry_count; i++) {
+        long long key = sky_bucket_key(sky, sky->entries[i].jd);
+        SkyBucket *bucket = sky->bucket_count > 0 ? &sky->buckets[sky->bucket_count - 1] : NULL;
+        if (!bucket || bucket->key != key) {
+            bucket = &sky->buckets[sky->bucket_count++];
+            bucket->key = key;
+            bucket->first = i;
+            bucket->count = 0;
+        }
+        bucket->count++;
+    }
+
+    int status = de430_parallel_for(sky->bucket_count, threads, sky_build_task, sky);
+    if (status != DE430_ERROR_NONE) {
+        de430_sky_index_free(sky);
+        return status;
+    }
+
+    *index = sky;
+    return DE430_ERROR_NONE;
+}
+
+int de430_sky_index_point_count(const DE430SkyIndex *index) {
+    return index ? index->entry_count : 0;
+}
+
+static int sky_add_match(DE430SkyMatches *result, int *capacity, const SkyEntry *entry, double chord) {
+    if (result->count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : SKY_INITIAL_MATCHES;
+        DE430SkyMatch *matches = de430_realloc(result->matches, (size_t)grown * sizeof(DE430SkyMatch));
+        if (!matches) {
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        result->matches = matches;
+        *capacity = grown;
+    }
+
+    DE430SkyMatch *match = &result->matches[result->count++];
+    match->object_index = entry->object;
+    match->point_index = entry->point;
+    match->separation = 2.0 * asin(fmin(chord / 2.0, 1.0));
+    return DE430_ERROR_NONE;
+}
+
+static int sky_compare_matches(const void *a, const void *b) {
+    const DE430SkyMatch *ma = (const DE430SkyMatch*)a;
+    const DE430SkyMatch *mb = (const DE430SkyMatch*)b;
+    if (ma->object_index != mb->object_index) return ma->object_index < mb->object_index ? -1 : 1;
+    return (ma->point_index > mb->point_index) - (ma->point_index < mb->point_index);
+}
+
+// Walk the tree of one bucket, skipping subtrees that lie beyond the cone
+static int sky_search_bucket(const DE430SkyIndex *index, const SkyBucket *bucket, const DE430ConeQuery *query,
+                             const double centre[3], double chord_limit, DE430SkyMatches *result, int *capacity) {
+    int stack[SKY_STACK_DEPTH][2];
+    int depth = 0;
+    stack[depth][0] = bucket->first;
+    stack[depth][1] = bucket->first + bucket->count;
+    depth++;
+
+    const double chord_limit2 = chord_limit * chord_limit;
+
+    while (depth > 0) {
+        depth--;
+        int lo = stack[depth][0];
+        int hi = stack[depth][1];
+        if (hi <= lo) continue;
+
+        int mid = lo + (hi - lo) / 2;
+        const SkyEntry *entry = &index->entries[mid];
+
+        double dx = entry->v[0] - centre[0];
+        double dy = entry->v[1] - centre[1];
+        double dz = entry->v[2] - centre[2];
+        double chord2 = dx * dx + dy * dy + dz * dz;
+        if (chord2 <= chord_limit2 && entry->jd >= query->jd_min && entry->jd <= query->jd_max) {
+            int status = sky_add_match(result, capacity, entry, sqrt(chord2));
+            if (status != DE430_ERROR_NONE) return status;
+        }
+
+        double split = entry->v[entry->axis];
+        double c = centre[entry->axis];
+        if (c - chord_limit <= split && depth < SKY_STACK_DEPTH) {
+            stack[depth][0] = lo;
+            stack[depth][1] = mid;
+            depth++;
+        }
+        if (c + chord_limit >= split && depth < SKY_STACK_DEPTH) {
+            stack[depth][0] = mid + 1;
+            stack[depth][1] = hi;
+            depth++;
+        }
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+int de430_sky_index_search(const DE430SkyIndex *index, const DE430ConeQuery *query, DE430SkyMatches *result) {
+    if (!index || !query || !result || !(query->radius >= 0.0)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    result->matches = NULL;
+    result->count = 0;
+    if (index->bucket_count == 0 || !(query->jd_max >= query->jd_min)) {
+        return DE430_ERROR_NONE;
+    }
+
+    double centre[3];
+    sky_unit_vector(query->ra, query->dec, centre);
+    double chord_limit = 2.0 * sin(fmin(query->radius, M_PI) / 2.0);
+
+    // First bucket that can hold jd_min
+    long long first_key = sky_bucket_key(index, query->jd_min);
+    long long last_key = sky_bucket_key(index, query->jd_max);
+    int lo = 0, hi = index->bucket_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (index->buckets[mid].key < first_key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    int capacity = 0;
+    int status = DE430_ERROR_NONE;
+    for (int b = lo; b < index->bucket_count && index->buckets[b].key <= last_key; b++) {
+        status = sky_search_bucket(index, &index->buckets[b], query, centre, chord_limit, result, &capacity);
+        if (status != DE430_ERROR_NONE) {
+            de430_sky_matches_free(result, 1);
+            return status;
+        }
+    }
+
+    if (result->count > 1) {
+        qsort(result->matches, (size_t)result->count, sizeof(DE430SkyMatch), sky_compare_matches);
+    }
+    return DE430_ERROR_NONE;
+}
+
+typedef struct {
+    const DE430SkyIndex *index;
+    const DE430ConeQuery *queries;
+    int query_count;
+    DE430SkyMatches *results;
+} SkyBatch;
+
+static int sky_batch_task(void *context, int index) {
+    SkyBatch *batch = (SkyBatch*)context;
+    int first = index * SKY_BATCH_QUERIES;
+    int last = first + SKY_BATCH_QUERIES < batch->query_count ? first + SKY_BATCH_QUERIES : batch->query_count;
+
+    for (int q = first; q < last; q++) {
+        int status = de430_sky_index_search(batch->index, &batch->queries[q], &batch->results[q]);
+        if (status != DE430_ERROR_NONE) return status;
+    }
+    return DE430_ERROR_NONE;
+}
+
+int de430_sky_index_search_batch(const DE430SkyIndex *index, const DE430ConeQuery *queries, int query_count,
+                                 int threads, DE430SkyMatches *results) {
+    if (!index || (!queries && query_count > 0) || query_count < 0 || (!results && query_count > 0)) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+    if (query_count == 0) {
+        return DE430_ERROR_NONE;
+    }
+
+    // Untouched results of skipped queries are safe to free
+    memset(results, 0, (size_t)query_count * sizeof(DE430SkyMatches));
+
+    SkyBatch batch = {index, queries, query_count, results};
+    int task_count = (query_count + SKY_BATCH_QUERIES - 1) / SKY_BATCH_QUERIES;
+    int status = de430_parallel_for(task_count, threads, sky_batch_task, &batch);
+    if (status != DE430_ERROR_NONE) {
+        de430_sky_matches_free(results, query_count);
+    }
+    return status;
+}
+
+void de430_sky_matches_free(DE430SkyMatches *results, int count) {
+    if (!results) return;
+
+    for (int i = 0; i < count; i++) {
+        de430_free(results[i].matches);
+        results[i].matches = NULL;
+        results[i].count = 0;
+    }
+}
+
+void de430_sky_index_free(DE430SkyIndex *index) {
+    if (!index) return;
+
+    de430_free(index->entries);
+    de430_free(index->buckets);
+    de430_free(index);
+}
@@ -0,0 +1,158 @@
+//
+// Per-object temporary files for the streaming writers.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Size of the buffer used when copying spooled data to the output
+#define SPOOL_COPY_BUFFER_SIZE 65536
+
+int de430_spool_open(DE430Spool *spool, int count) {
+    if (!spool || count <= 0) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    spool->count = 0;
+    spool->files = (FILE**)de430_calloc(count, sizeof(FILE*));
+    if (!spool->files) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (int i = 0; i < count; i++) {
+        spool->files[i] = tmpfile();
+        if (!spool->files[i]) {
+            de430_spool_close(spool);
+            return DE430_ERROR_FILE_IO;
+        }
+        spool->count++;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+int de430_spool_copy(DE430Spool *spool, int index, FILE *out) {
+    if (!spool || index < 0 || index >= spool->count || !out) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    FILE *fp = spool->files[index];
+    if (fflush(fp) != 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    char *buffer = (char*)de430_malloc(SPOOL_COPY_BUFFER_SIZE);
+    if (!buffer) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = DE430_ERROR_NONE;
+    size_t n;
+    while ((n = fread(buffer, 1, SPOOL_COPY_BUFFER_SIZE, fp)) > 0) {
+        if (fwrite(buffer, 1, n, out) != n) {
+            status = DE430_ERROR_FILE_IO;
+            break;
+        }
+    }
+
+    if (status == DE430_ERROR_NONE && ferror(fp)) {
+        status = DE430_ERROR_FILE_IO;
+    }
+
+    de430_free(buffer);
+    return status;
+}
+
+void de430_spool_close(DE430Spool *spool) {
+    if (!spool || !spool->files) return;
+
+    for (int i = 0; i < spool->count; i++) {
+        fclose(spool->files[i]);
+    }
+
+    de430_free(spool->files);
+    spool->files = NULL;
+    spool->count = 0;
+}
+
+// Spool files mapped into memory as result arrays. de430_free_data checks
+// this list so mapped arrays are released with munmap rather than free.
+typedef struct {
+    void *address;
+    size_t size;
+} SpoolMapping;
+
+static pthread_mutex_t spool_map_lock = PTHREAD_MUTEX_INITIALIZER;
+static SpoolMapping *spool_maps;
+static int spool_map_count;
+static int spool_map_capacity;
+static atomic_int spool_map_live;  // Lets de430_spool_unmap skip the lock when nothing is mapped
+
+int de430_spool_map(DE430Spool *spool, int index, size_t size, void **address) {
+    if (!spool || index < 0 || index >= spool->count || !address || size == 0) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    FILE *fp = spool->files[index];
+    if (fflush(fp) != 0) {
+        return DE430_ERROR_FILE_IO;
+    }
+
+    // Shared, so pages written by the caller go back to the file instead of swap
+    void *mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(fp), 0);
+    if (mapped == MAP_FAILED) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    pthread_mutex_lock(&spool_map_lock);
+    if (spool_map_count == spool_map_capacity) {
+        int new_capacity = spool_map_capacity > 0 ? spool_map_capacity * 2 : 16;
+        SpoolMapping *grown = de430_realloc(spool_maps, new_capacity * sizeof(SpoolMapping));
+        if (!grown) {
+            pthread_mutex_unlock(&spool_map_lock);
+            munmap(mapped, size);
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+        spool_maps = grown;
+        spool_map_capacity = new_capacity;
+    }
+    spool_maps[spool_map_count].address = mapped;
+    spool_maps[spool_map_count].size = size;
+    spool_map_count++;
+    atomic_fetch_add(&spool_map_live, 1);
+    pthread_mutex_unlock(&spool_map_lock);
+
+    *address = mapped;
+    return DE430_ERROR_NONE;
+}
+
+int de430_spool_unmap(void *address) {
+    if (!address || atomic_load(&spool_map_live) == 0) {
+        return 0;
+    }
+
+    size_t size = 0;
+    pthread_mutex_lock(&spool_map_lock);
+    for (int i = 0; i < spool_map_count; i++) {
+        if (spool_maps[i].address == address) {
+            size = spool_maps[i].size;
+            spool_maps[i] = spool_maps[--spool_map_count];
+            atomic_fetch_sub(&spool_map_live, 1);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&spool_map_lock);
+
+    if (size == 0) {
+        return 0;
+    }
+
+    munmap(address, size);
+    return 1;
+}
@@ -0,0 +1,361 @@
+//
+// Real-time position tracker backed by a ring-buffered sample window.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Julian date of the Unix epoch (1970-01-01T00:00:00 UTC)
+#define UNIX_EPOCH_JD 2440587.5
+
+// Extra ring slots kept beyond the requested window so the
+// interpolation stencil never runs off the end of fresh data
+#define TRACKER_RING_MARGIN 4
+
+// Per-object ring of sampled positions; slot i of every ring
+// corresponds to the same Julian date
+typedef struct {
+    char name[64];
+    double (*position)[3];
+} TrackerRing;
+
+struct DE430Tracker {
+    DE430Config config;         // Backend configuration (objects, format, site)
+    double window;              // Span of the sampled window in days
+    double step;                // Sampling interval in days
+    double refresh_interval;    // Seconds between background refreshes
+
+    int object_count;
+    int capacity;               // Number of slots in each ring
+    TrackerRing *rings;
+
+    // Window state, published under the seqlock
+    atomic_uint sequence;       // Odd while the writer is updating
+    int head;                   // Slot of the oldest sample
+    int size;                   // Number of valid samples
+    double first_jd;            // Julian date of the oldest sample
+
+    atomic_int last_status;     // Result of the most recent refresh
+    DE430ResultBuffer results;  // Fetched samples, reused by every refresh
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    int stop;
+};
+
+double de430_jd_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return UNIX_EPOCH_JD + ((double)ts.tv_sec + ts.tv_nsec * 1e-9) / 86400.0;
+}
+
+// Fetch samples covering [jd_min, jd_max] from the backend into tracker->results
+static int tracker_fetch(DE430Tracker *tracker, double jd_min, double jd_max) {
+    DE430Config request = tracker->config;
+    request.jd_list = NULL;
+    request.jd_list_count = 0;
+    request.jd_min = jd_min;
+    request.jd_max = jd_max;
+    request.jd_step = tracker->step;
+
+    int status = de430_get_ephemeris_into(&request, &tracker->results);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    if (tracker->object_count && tracker->results.count != tracker->object_count) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+// Append freshly fetched samples to the rings, dropping the oldest
+// ones once the rings are full. Runs on the refresh thread only.
+static void tracker_publish(DE430Tracker *tracker, const DE430EphemerisData *data, int reset) {
+    int new_count = data[0].count;
+    if (new_count <= 0) return;
+
+    // Samples that do not fit are the oldest of the batch
+    int skip = new_count > tracker->capacity ? new_count - tracker->capacity : 0;
+
+    unsigned int seq = atomic_load_explicit(&tracker->sequence, memory_order_relaxed);
+    atomic_store_explicit(&tracker->sequence, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (reset) {
+        tracker->head = 0;
+        tracker->size = 0;
+        tracker->first_jd = data[0].points[skip].jd;
+    }
+
+    for (int j = skip; j < new_count; j++) {
+        int slot;
+        if (tracker->size < tracker->capacity) {
+            slot = (tracker->head + tracker->size) % tracker->capacity;
+            tracker->size++;
+        } else {
+            slot = tracker->head;
+            tracker->head = (tracker->head + 1) % tracker->capacity;
+            tracker->first_jd += tracker->step;
+        }
+
+        for (int i = 0; i < tracker->object_count; i++) {
+            memcpy(tracker->rings[i].position[slot], data[i].points[j].position,
+                   sizeof(tracker->rings[i].position[slot]));
+        }
+    }
+
+    atomic_store_explicit(&tracker->sequence, seq + 2, memory_order_release);
+}
+
+// Bring the window up to date around the current time
+static int tracker_refresh(DE430Tracker *tracker) {
+    double now = de430_jd_now();
+    double half = tracker->window / 2.0;
+
+    // Only the refresh thread writes these, so plain reads are safe here
+    double last_jd = tracker->first_jd + (tracker->size - 1) * tracker->step;
+    int reset = tracker->size == 0 || last_jd < now - half;
+
+    double jd_min = reset ? now - half : last_jd + tracker->step;
+    double jd_max = now + half;
+    if (jd_min > jd_max) {
+        return DE430_ERROR_NONE;
+    }
+
+    int status = tracker_fetch(tracker, jd_min, jd_max);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    const DE430EphemerisData *data = tracker->results.data;
+    if (reset && data[0].count == 0) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    tracker_publish(tracker, data, reset);
+    return DE430_ERROR_NONE;
+}
+
+static void* tracker_thread(void *arg) {
+    DE430Tracker *tracker = (DE430Tracker*)arg;
+
+    pthread_mutex_lock(&tracker->lock);
+    while (!tracker->stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        double whole = floor(tracker->refresh_interval);
+        deadline.tv_sec += (time_t)whole;
+        deadline.tv_nsec += (long)((tracker->refresh_interval - whole) * 1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        int rc = 0;
+        while (!tracker->stop && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&tracker->wakeup, &tracker->lock, &deadline);
+        }
+        if (tracker->stop) break;
+
+        pthread_mutex_unlock(&tracker->lock);
+        int status = tracker_refresh(tracker);
+        atomic_store_explicit(&tracker->last_status, status, memory_order_relaxed);
+        pthread_mutex_lock(&tracker->lock);
+    }
+    pthread_mutex_unlock(&tracker->lock);
+
+    return NULL;
+}
+
+static void tracker_release(DE430Tracker *tracker) {
+    if (tracker->rings) {
+        for (int i = 0; i < tracker->object_count; i++) {
+            de430_free(tracker->rings[i].position);
+        }
+        de430_free(tracker->rings);
+    }
+    de430_result_buffer_free(&tracker->results);
+    de430_free(tracker);
+}
+
+int de430_tracker_create(const DE430Config *config, double window_days, double refresh_interval,
+                         DE430Tracker **tracker) {
+    if (!config || !tracker || config->jd_step <= 0.0 ||
+        window_days < 2.0 * config->jd_step || refresh_interval <= 0.0) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    DE430Tracker *t = (DE430Tracker*)de430_calloc(1, sizeof(DE430Tracker));
+    if (!t) {
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    t->config = *config;
+    t->window = window_days;
+    t->step = config->jd_step;
+    t->refresh_interval = refresh_interval;
+    t->capacity = (int)ceil(window_days / config->jd_step) + 1 + TRACKER_RING_MARGIN;
+    atomic_init(&t->sequence, 0);
+    atomic_init(&t->last_status, DE430_ERROR_NONE);
+
+    // Initial synchronous fill, so the tracker is usable as soon as it is returned
+    double now = de430_jd_now();
+    de430_result_buffer_init(&t->results);
+    int status = tracker_fetch(t, now - window_days / 2.0, now + window_days / 2.0);
+    if (status != DE430_ERROR_NONE) {
+        tracker_release(t);
+        return status;
+    }
+
+    const DE430EphemerisData *data = t->results.data;
+    int count = t->results.count;
+    if (count <= 0 || data[0].count == 0) {
+        tracker_release(t);
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    t->object_count = count;
+    t->rings = (TrackerRing*)de430_calloc(count, sizeof(TrackerRing));
+    if (!t->rings) {
+        tracker_release(t);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (int i = 0; i < count; i++) {
+        strncpy(t->rings[i].name, data[i].object_name, sizeof(t->rings[i].name) - 1);
+        t->rings[i].position = de430_malloc(t->capacity * sizeof(*t->rings[i].position));
+        if (!t->rings[i].position) {
+            tracker_release(t);
+            return DE430_ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    tracker_publish(t, data, 1);
+
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->wakeup, NULL);
+
+    if (pthread_create(&t->thread, NULL, tracker_thread, t) != 0) {
+        pthread_cond_destroy(&t->wakeup);
+        pthread_mutex_destroy(&t->lock);
+        tracker_release(t);
+        return DE430_ERROR_MEMORY_ALLOCATION;
+    }
+
+    *tracker = t;
+    return DE430_ERROR_NONE;
+}
+
+int de430_tracker_find_object(const DE430Tracker *tracker, const char *name) {
+    if (!tracker || !name) return -1;
+
+    for (int i = 0; i < tracker->object_count; i++) {
+        if (strcmp(tracker->rings[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int de430_tracker_position_at(const DE430Tracker *tracker, int object_index, double jd,
+                              double position[3]) {
+    if (!tracker || !position || object_index < 0 || object_index >= tracker->object_count) {
+        return DE430_ERROR_INVALID_CONFIG;
+    }
+
+    const double (*ring)[3] = (const double (*)[3])tracker->rings[object_index].position;
+    const int capacity = tracker->capacity;
+    double stencil[4][3];
+    double u;
+    int cubic;
+    unsigned int before, after;
+
+    do {
+        before = atomic_load_explicit(&tracker->sequence, memory_order_acquire);
+        if (before & 1u) continue;
+
+        int head = tracker->head;
+        int size = tracker->size;
+        double offset = (jd - tracker->first_jd) / tracker->step;
+
+        if (size < 2 || offset < 0.0 || offset > (double)(size - 1)) {
+            atomic_thread_fence(memory_order_acquire);
+            after = atomic_load_explicit(&tracker->sequence, memory_order_relaxed);
+            if (after != before) continue;
+            return DE430_ERROR_OUT_OF_RANGE;
+        }
+
+        // Interval [k, k+1] containing jd, clamped so k+1 exists
+        int k = (int)offset;
+        if (k > size - 2) k = size - 2;
+        u = offset - k;
+
+        // Four-point stencil k-1..k+2 when available, two points otherwise
+        cubic = k >= 1 && k + 2 <= size - 1;
+        int first = cubic ? k - 1 : k;
+        int n = cubic ? 4 : 2;
+        for (int m = 0; m < n; m++) {
+            int slot = (head + first + m) % capacity;
+            stencil[m][0] = ring[slot][0];
+            stencil[m][1] = ring[slot][1];
+            stencil[m][2] = ring[slot][2];
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&tracker->sequence, memory_order_relaxed);
+    } while (before != after || (before & 1u));
+
+    if (cubic) {
+        // Lagrange weights for nodes at -1, 0, 1, 2
+        double w0 = -u * (u - 1.0) * (u - 2.0) / 6.0;
+        double w1 = (u + 1.0) * (u - 1.0) * (u - 2.0) / 2.0;
+        double w2 = -(u + 1.0) * u * (u - 2.0) / 2.0;
+        double w3 = (u + 1.0) * u * (u - 1.0) / 6.0;
+        for (int c = 0; c < 3; c++) {
+            position[c] = w0 * stencil[0][c] + w1 * stencil[1][c] +
+                          w2 * stencil[2][c] + w3 * stencil[3][c];
+        }
+    } else {
+        for (int c = 0; c < 3; c++) {
+            position[c] = stencil[0][c] + u * (stencil[1][c] - stencil[0][c]);
+        }
+    }
+
+    return DE430_ERROR_NONE;
+}
+
+int de430_tracker_position_now(const DE430Tracker *tracker, int object_index, double position[3]) {
+    return de430_tracker_position_at(tracker, object_index, de430_jd_now(), position);
+}
+
+int de430_tracker_status(const DE430Tracker *tracker) {
+    if (!tracker) return DE430_ERROR_INVALID_CONFIG;
+    return atomic_load_explicit(&tracker->last_status, memory_order_relaxed);
+}
+
+void de430_tracker_destroy(DE430Tracker *tracker) {
+    if (!tracker) return;
+
+    pthread_mutex_lock(&tracker->lock);
+    tracker->stop = 1;
+    pthread_cond_signal(&tracker->wakeup);
+    pthread_mutex_unlock(&tracker->lock);
+
+    pthread_join(tracker->thread, NULL);
+    pthread_cond_destroy(&tracker->wakeup);
+    pthread_mutex_destroy(&tracker->lock);
+    tracker_release(tracker);
+}
@@ -0,0 +1,129 @@
+//
+// Per-block statistics of version 2 binary files, used to skip blocks
+// that cannot satisfy a filter.
+//
+
+#include "de430_parser.h"
+#include "de430_internal.h"
+
+#include <math.h>
+#include <string.h>
+
+// Bit index of a name in the dictionary, or -1
+static int zone_dictionary_find(const DE430ZoneDictionary *dictionary, const char *name) {
+    if (dictionary->count == DE430_ZONE_NO_CONSTELLATIONS) return -1;
+
+    for (uint32_t i = 0; i < dictionary->count; i++) {
+        if (strncmp(dictionary->names[i], name, sizeof(dictionary->names[i])) == 0) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+void de430_zone_dictionary_add(DE430ZoneDictionary *dictionary, const char *name) {
+    if (dictionary->count == DE430_ZONE_NO_CONSTELLATIONS || zone_dictionary_find(dictionary, name) >= 0) {
+        return;
+    }
+
+    if (dictionary->count == DE430_ZONE_MAX_CONSTELLATIONS) {
+        dictionary->count = DE430_ZONE_NO_CONSTELLATIONS;
+        return;
+    }
+
+    char *slot = dictionary->names[dictionary->count++];
+    memset(slot, 0, sizeof(dictionary->names[0]));
+    strncpy(slot, name, sizeof(dictionary->names[0]) - 1);
+}
+
+void de430_zone_map_compute(const DE430EphemerisPoint *points, int count,
+                            const DE430ZoneDictionary *dictionary, DE430BinaryZoneMap *zone) {
+    for (int f = 0; f < DE430_FIELD_COUNT; f++) {
+        zone->min[f] = INFINITY;
+        zone->max[f] = -INFINITY;
+    }
+    zone->constellations[0] = 0;
+    zone->constellations[1] = 0;
+
+    for (int j = 0; j < count; j++) {
+        const double *values = (const double*)&points[j];
+
+        // NaN never satisfies a range, so it does not widen the bounds
+        for (int f = 0; f < DE430_FIELD_COUNT; f++) {
+            if (values[f] < zone->min[f]) zone->min[f] = values[f];
+            if (values[f] > zone->max[f]) zone->max[f] = values[f];
+        }
+
+        int bit = zone_dictionary_find(dictionary, points[j].constellation);
+        if (bit >= 0) {
+            zone->constellations[bit / 64] |= (uint64_t)1 << (bit % 64);
+        }
+    }
+}
+
+int de430_zone_filter_mask(const DE430ZoneDictionary *dictionary, const DE430Filter *filter, uint64_t mask[2]) {
+    mask[0] = 0;
+    mask[1] = 0;
+
+    if (!filter || !filter->constellations || dictionary->count == DE430_ZONE_NO_CONSTELLATIONS) {
+        return 0;
+    }
+
+    // Names missing from the dictionary occur nowhere in the file
+    for (int i = 0; i < filter->constellation_count; i++) {
+        int bit = zone_dictionary_find(dictionary, filter->constellations[i]);
+        if (bit >= 0) {
+            mask[bit / 64] |= (uint64_t)1 << (bit % 64);
+        }
+    }
+
+    return 1;
+}
+
+int de430_zone_map_may_match(const DE430BinaryZoneMap *zone, const DE430Filter *filter, const uint64_t mask[2]) {
+    if (!filter) return 1;
+
+    if (zone->max[DE430_FIELD_JD] < filter->jd_min || zone->min[DE430_FIELD_JD] > filter->jd_max) {
+        return 0;
+    }
+
+    for (int i = 0; i < filter->range_count; i++) {
+        const DE430FieldRange *range = &filter->ranges[i];
+        if (zone->max[range->field] < range->min || zone->min[range->field] > range->max) {
+            return 0;
+        }
+    }
+
+    if (mask && !(zone->constellations[0] & mask[0]) && !(zone->constellations[1] & mask[1])) {
+        return 0;
+    }
+
+    return 1;
+}
+
+int de430_zone_dictionary_read(int fd, const DE430BinaryHeader *header, DE430ZoneDictionary *dictionary) {
+    dictionary->count = 0;
+
+    if (header->version != DE430_BINARY_VERSION_2 || !(header->flags & DE430_BINARY_FLAG_ZONE_MAPS)) {
+        return DE430_ERROR_NONE;
+    }
+
+    uint64_t offset = sizeof(DE430BinaryHeader) + (uint64_t)header->object_count * sizeof(DE430BinaryDirectoryEntry);
+    uint32_t counts[2];
+    int status = de430_pread_all(fd, counts, sizeof(counts), offset);
+    if (status != DE430_ERROR_NONE) {
+        return status;
+    }
+
+    if (counts[0] == DE430_ZONE_NO_CONSTELLATIONS) {
+        dictionary->count = DE430_ZONE_NO_CONSTELLATIONS;
+        return DE430_ERROR_NONE;
+    }
+    if (counts[0] > DE430_ZONE_MAX_CONSTELLATIONS) {
+        return DE430_ERROR_PARSE_FAILED;
+    }
+
+    dictionary->count = counts[0];
+    return de430_pread_all(fd, dictionary->names, counts[0] * sizeof(dictionary->names[0]), offset + sizeof(counts));
+}